@@ -3,6 +3,9 @@
 typedef struct BENCHMARK_PREFIX(region_node_s) BENCHMARK_PREFIX(region_node_t);
 struct BENCHMARK_PREFIX(region_node_s) {
   REGION_ENTRY(BENCHMARK_PREFIX(region_node_s)) link;
+#if KEYDISTANCE > 0
+  char keydistance[KEYDISTANCE];
+#endif
   size_t key;
 };
 #ifndef BENCHMARK_NOHEADTYPE
@@ -40,6 +43,9 @@ static void BENCHMARK_PREFIX(RunTest)(AlgorithmInfo *ai)
 {
   static BENCHMARK_PREFIX(region_node2_t) nodes[1<<ALLOCATIONS];
   static BENCHMARK_PREFIX(region_node_t) *r;
+#ifdef REGION_INSERTBATCH
+  static BENCHMARK_PREFIX(region_node_t) *batch[1<<ALLOCATIONS];
+#endif
   int l, n, m;
   usCount start, end;
   printf("\nRunning scalability test for %s\n", ai->name);
@@ -56,11 +62,14 @@ static void BENCHMARK_PREFIX(RunTest)(AlgorithmInfo *ai)
       REGION_INSERT(BENCHMARK_PREFIX(region_tree_s), &BENCHMARK_PREFIX(regiontree), &(nodes+n)->node);
     }
     else goto tryagain;
+#ifdef REGION_INSERTBATCH
+    batch[n]=&(nodes+n)->node;
+#endif
   }
   REGION_INIT(&BENCHMARK_PREFIX(regiontree));
   for(m=0; m<ALLOCATIONS; m++)
   {
-    usCount insert=0, find1=0, find2=0, remove=0, iterate=0, nfind=0, cfind1=0, cfind2=0;
+    usCount insert=0, insertbatch=0, find1=0, find2=0, findmiss=0, remove=0, iterate=0, nfind=0, cfind1=0, cfind2=0, cfindsmaller1=0, nfindsmaller=0;
     int lmax=(ALLOCATIONS*ALLOCATIONS*8-(m*m*m*m)); /* Loop more when m is smaller */
     lmax*=AVERAGE;
     if(lmax<1) lmax=1;
@@ -80,6 +89,7 @@ static void BENCHMARK_PREFIX(RunTest)(AlgorithmInfo *ai)
         if(!r) abort();
         find1+=end-start-usCountOverhead;
       }
+      findmiss-=GetCacheMisses();
       for(n=0; n<(1<<m); n++)
       {
         start=GetUsCount();
@@ -88,6 +98,7 @@ static void BENCHMARK_PREFIX(RunTest)(AlgorithmInfo *ai)
         if(!r) abort();
         find2+=end-start-usCountOverhead;
       }
+      findmiss+=GetCacheMisses();
 #ifdef REGION_CFIND1
       for(n=0; n<(1<<m); n++)
       {
@@ -114,17 +125,36 @@ static void BENCHMARK_PREFIX(RunTest)(AlgorithmInfo *ai)
       }
 #endif
 #ifdef REGION_NFIND
-      if(m<=15)
+      for(n=0; n<(1<<m); n++)
       {
-        for(n=0; n<(1<<m); n++)
-        {
-          BENCHMARK_PREFIX(region_node_t) t;
-          t.key=gen_rand32();
-          start=GetUsCount();
-          r=REGION_NFIND(BENCHMARK_PREFIX(region_tree_s), &BENCHMARK_PREFIX(regiontree), &t);
-          end=GetUsCount();
-          nfind+=end-start-usCountOverhead;
-        }
+        BENCHMARK_PREFIX(region_node_t) t;
+        t.key=gen_rand32();
+        start=GetUsCount();
+        r=REGION_NFIND(BENCHMARK_PREFIX(region_tree_s), &BENCHMARK_PREFIX(regiontree), &t);
+        end=GetUsCount();
+        nfind+=end-start-usCountOverhead;
+      }
+#endif
+#ifdef REGION_CFINDSMALLER1
+      for(n=0; n<(1<<m); n++)
+      {
+        BENCHMARK_PREFIX(region_node_t) t;
+        t.key=gen_rand32();
+        start=GetUsCount();
+        r=REGION_CFINDSMALLER1(BENCHMARK_PREFIX(region_tree_s), &BENCHMARK_PREFIX(regiontree), &t);
+        end=GetUsCount();
+        cfindsmaller1+=end-start-usCountOverhead;
+      }
+#endif
+#ifdef REGION_NFINDSMALLER
+      for(n=0; n<(1<<m); n++)
+      {
+        BENCHMARK_PREFIX(region_node_t) t;
+        t.key=gen_rand32();
+        start=GetUsCount();
+        r=REGION_NFINDSMALLER(BENCHMARK_PREFIX(region_tree_s), &BENCHMARK_PREFIX(regiontree), &t);
+        end=GetUsCount();
+        nfindsmaller+=end-start-usCountOverhead;
       }
 #endif
       for(r=REGION_MIN(BENCHMARK_PREFIX(region_tree_s), &BENCHMARK_PREFIX(regiontree)); r;)
@@ -141,15 +171,29 @@ static void BENCHMARK_PREFIX(RunTest)(AlgorithmInfo *ai)
         end=GetUsCount();
         remove+=end-start-usCountOverhead;
       }
+#ifdef REGION_INSERTBATCH
+      start=GetUsCount();
+      REGION_INSERTBATCH(BENCHMARK_PREFIX(region_tree_s), &BENCHMARK_PREFIX(regiontree), batch, 1<<m);
+      end=GetUsCount();
+      insertbatch+=end-start-usCountOverhead;
+      for(n=0; n<(1<<m); n++)
+      {
+        REGION_REMOVE(BENCHMARK_PREFIX(region_tree_s), &BENCHMARK_PREFIX(regiontree), &(nodes+n)->node);
+      }
+#endif
     }
     ai->inserts[m]=(usCount)((double) insert/l);
+    ai->insertbatches[m]=(usCount)((double) insertbatch/l);
     ai->finds1[m]=(usCount)((double)find1/l);
     ai->finds2[m]=(usCount)((double)find2/l);
+    ai->findmisses[m]=(usCount)((double)findmiss/l);
     ai->removes[m]=(usCount)((double)remove/l);
     ai->iterates[m]=(usCount)((double)iterate/l);
     ai->cfind1s[m]=(usCount)((double)cfind1/l);
     ai->cfind2s[m]=(usCount)((double)cfind2/l);
     ai->nfinds[m]=(usCount)((double)nfind/l);
+    ai->cfindsmaller1s[m]=(usCount)((double)cfindsmaller1/l);
+    ai->nfindsmallers[m]=(usCount)((double)nfindsmaller/l);
     /*if(!(m & 127)) printf("At %d = %llu, %llu, %llu, %llu, %llu\n", m, ai->inserts[m], ai->finds1[m], ai->finds2[m], ai->removes[m], ai->iterates[m]);*/
   }
 }
\ No newline at end of file
@@ -38,6 +38,7 @@ DEALINGS IN THE SOFTWARE.
 #define ALLOCATIONS 23        /* How far up to test scaling */
 #define AVERAGE 16            /* Smoothing factor */
 #define ITEMSIZE 0            /* Set =page size to test TLB scaling */
+#define KEYDISTANCE 0         /* Set =cache line size to put the key on a different cache line to the link */
 
 #include "nedtrie.h"
 #include "rbtree.h"
@@ -90,6 +91,37 @@ static usCount GetUsCount()
 #endif
 }
 #endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+/* Returns how many cache misses this thread has caused so far, or zero if the
+kernel won't let us have a hardware counter (e.g. inside many VMs) */
+static usCount GetCacheMisses()
+{
+  static int fd=-1;
+  unsigned long long count=0;
+  if(-1==fd)
+  {
+    struct perf_event_attr pe;
+    memset(&pe, 0, sizeof(pe));
+    pe.type=PERF_TYPE_HARDWARE;
+    pe.size=sizeof(pe);
+    pe.config=PERF_COUNT_HW_CACHE_MISSES;
+    pe.exclude_kernel=1;
+    pe.exclude_hv=1;
+    if(-1==(fd=(int) syscall(__NR_perf_event_open, &pe, 0, -1, -1, 0)))
+    {
+      printf("NOTE: No cache miss counter available, cache misses will read as zero\n");
+      fd=-2;
+    }
+  }
+  if(fd<0 || sizeof(count)!=read(fd, &count, sizeof(count))) return 0;
+  return (usCount) count;
+}
+#else
+static usCount GetCacheMisses() { return 0; }
+#endif
 static usCount usCountOverhead, CPUClockSpeed;
 static unsigned long long rdtsc()
 {
@@ -154,7 +186,7 @@ typedef struct AlgorithmInfo_t
 {
   const char *name;
   int has_cfinds, has_nfinds;
-  usCount inserts[ALLOCATIONS], finds1[ALLOCATIONS], finds2[ALLOCATIONS], removes[ALLOCATIONS], iterates[ALLOCATIONS], cfind1s[ALLOCATIONS], cfind2s[ALLOCATIONS], nfinds[ALLOCATIONS];
+  usCount inserts[ALLOCATIONS], insertbatches[ALLOCATIONS], finds1[ALLOCATIONS], finds2[ALLOCATIONS], removes[ALLOCATIONS], iterates[ALLOCATIONS], cfind1s[ALLOCATIONS], cfind2s[ALLOCATIONS], nfinds[ALLOCATIONS], cfindsmaller1s[ALLOCATIONS], nfindsmallers[ALLOCATIONS], findmisses[ALLOCATIONS];
 } AlgorithmInfo;
 
 #define BENCHMARK_PREFIX(foo)                     nedtrie_##foo
@@ -164,11 +196,62 @@ typedef struct AlgorithmInfo_t
 #define REGION_EMPTY(treevar)                     NEDTRIE_EMPTY(treevar)
 #define REGION_GENERATE(proto, treetype, nodetype, link, cmpfunct) NEDTRIE_GENERATE(proto, treetype, nodetype, link, cmpfunct, NEDTRIE_NOBBLEZEROS(treetype))
 #define REGION_INSERT(treetype, treevar, node)    NEDTRIE_INSERT(treetype, treevar, node)
+#define REGION_INSERTBATCH(treetype, treevar, nodes, n) NEDTRIE_INSERT_BATCH(treetype, treevar, nodes, n)
 #define REGION_REMOVE(treetype, treevar, node)    NEDTRIE_REMOVE(treetype, treevar, node)
 #define REGION_FIND(treetype, treevar, node)      NEDTRIE_FIND(treetype, treevar, node)
 #define REGION_CFIND1(treetype, treevar, node)    NEDTRIE_CFIND(treetype, treevar, node, 0)
 #define REGION_CFIND2(treetype, treevar, node)    NEDTRIE_CFIND(treetype, treevar, node, INT_MAX)
 #define REGION_NFIND(treetype, treevar, node)     NEDTRIE_NFIND(treetype, treevar, node)
+#define REGION_CFINDSMALLER1(treetype, treevar, node) NEDTRIE_CFINDSMALLER(treetype, treevar, node, 0)
+#define REGION_NFINDSMALLER(treetype, treevar, node) NEDTRIE_NFINDSMALLER(treetype, treevar, node)
+#define REGION_MAX(treetype, treevar)             NEDTRIE_MAX(treetype, treevar)
+#define REGION_MIN(treetype, treevar)             NEDTRIE_MIN(treetype, treevar)
+#define REGION_NEXT(treetype, treevar, node)      NEDTRIE_NEXT(treetype, treevar, node)
+#define REGION_PREV(treetype, treevar, node)      NEDTRIE_PREV(treetype, treevar, node)
+#define REGION_FOREACH(var, treetype, treevar)    NEDTRIE_FOREACH(var, treetype, treevar)
+#define REGION_HASNODEHEADER(treevar, node, link) NEDTRIE_HASNODEHEADER(treevar, node, link)
+#define BENCHMARK_USEKEYFUNCT
+#include "benchmark.c.h"
+#undef BENCHMARK_USEKEYFUNCT
+#undef BENCHMARK_PREFIX
+#undef REGION_ENTRY
+#undef REGION_HEAD
+#undef REGION_INIT
+#undef REGION_EMPTY
+#undef REGION_GENERATE
+#undef REGION_INSERT
+#undef REGION_INSERTBATCH
+#undef REGION_REMOVE
+#undef REGION_FIND
+#undef REGION_CFIND1
+#undef REGION_CFIND2
+#undef REGION_NFIND
+#undef REGION_CFINDSMALLER1
+#undef REGION_NFINDSMALLER
+#undef REGION_MAX
+#undef REGION_MIN
+#undef REGION_NEXT
+#undef REGION_PREV
+#undef REGION_FOREACH
+#undef REGION_HASNODEHEADER
+
+/* As above, but with the key cached in the link so finds never touch the rest of the node */
+#define BENCHMARK_PREFIX(foo)                     nedtriek_##foo
+#define REGION_ENTRY(type)                        NEDTRIE_ENTRY_WITHKEY(type)
+#define REGION_HEAD(name, type)                   NEDTRIE_HEAD(name, type)
+#define REGION_INIT(treevar)                      NEDTRIE_INIT(treevar)
+#define REGION_EMPTY(treevar)                     NEDTRIE_EMPTY(treevar)
+#define REGION_GENERATE(proto, treetype, nodetype, link, cmpfunct) NEDTRIE_GENERATE_LINKKEY(proto, treetype, nodetype, link) NEDTRIE_GENERATE(proto, treetype, nodetype, link, NEDTRIE_LINKKEY(treetype), NEDTRIE_NOBBLEZEROS(treetype))
+#define REGION_SETKEY(node)                       ((node)->link.trie_key=(node)->key)
+#define REGION_INSERT(treetype, treevar, node)    (REGION_SETKEY(node), NEDTRIE_INSERT(treetype, treevar, node))
+#define REGION_INSERTBATCH(treetype, treevar, nodes, n) NEDTRIE_INSERT_BATCH(treetype, treevar, nodes, n)
+#define REGION_REMOVE(treetype, treevar, node)    NEDTRIE_REMOVE(treetype, treevar, node)
+#define REGION_FIND(treetype, treevar, node)      (REGION_SETKEY(node), NEDTRIE_FIND(treetype, treevar, node))
+#define REGION_CFIND1(treetype, treevar, node)    (REGION_SETKEY(node), NEDTRIE_CFIND(treetype, treevar, node, 0))
+#define REGION_CFIND2(treetype, treevar, node)    (REGION_SETKEY(node), NEDTRIE_CFIND(treetype, treevar, node, INT_MAX))
+#define REGION_NFIND(treetype, treevar, node)     (REGION_SETKEY(node), NEDTRIE_NFIND(treetype, treevar, node))
+#define REGION_CFINDSMALLER1(treetype, treevar, node) (REGION_SETKEY(node), NEDTRIE_CFINDSMALLER(treetype, treevar, node, 0))
+#define REGION_NFINDSMALLER(treetype, treevar, node) (REGION_SETKEY(node), NEDTRIE_NFINDSMALLER(treetype, treevar, node))
 #define REGION_MAX(treetype, treevar)             NEDTRIE_MAX(treetype, treevar)
 #define REGION_MIN(treetype, treevar)             NEDTRIE_MIN(treetype, treevar)
 #define REGION_NEXT(treetype, treevar, node)      NEDTRIE_NEXT(treetype, treevar, node)
@@ -184,12 +267,16 @@ typedef struct AlgorithmInfo_t
 #undef REGION_INIT
 #undef REGION_EMPTY
 #undef REGION_GENERATE
+#undef REGION_SETKEY
 #undef REGION_INSERT
+#undef REGION_INSERTBATCH
 #undef REGION_REMOVE
 #undef REGION_FIND
 #undef REGION_CFIND1
 #undef REGION_CFIND2
 #undef REGION_NFIND
+#undef REGION_CFINDSMALLER1
+#undef REGION_NFINDSMALLER
 #undef REGION_MAX
 #undef REGION_MIN
 #undef REGION_NEXT
@@ -289,7 +376,7 @@ template<class stlcontainer> void RunTest(AlgorithmInfo *ai)
   }
   for(m=0; m<ALLOCATIONS; m++)
   {
-    usCount insert=0, find1=0, find2=0, remove=0, iterate=0;
+    usCount insert=0, find1=0, find2=0, findmiss=0, remove=0, iterate=0;
     int lmax=(ALLOCATIONS*ALLOCATIONS-(m*m*m)); /* Loop more when m is smaller */
     lmax*=AVERAGE;
     if(lmax<1) lmax=1;
@@ -309,6 +396,7 @@ template<class stlcontainer> void RunTest(AlgorithmInfo *ai)
         if(nodes.end()==it) abort();
         find1+=end-start-usCountOverhead;
       }
+      findmiss-=GetCacheMisses();
       for(n=0; n<(1<<m); n++)
       {
         start=GetUsCount();
@@ -317,6 +405,7 @@ template<class stlcontainer> void RunTest(AlgorithmInfo *ai)
         if(nodes.end()==it) abort();
         find2+=end-start-usCountOverhead;
       }
+      findmiss+=GetCacheMisses();
       for(it=nodes.begin(); it!=nodes.end();)
       {
         start=GetUsCount();
@@ -335,6 +424,7 @@ template<class stlcontainer> void RunTest(AlgorithmInfo *ai)
     ai->inserts[m]=(usCount)((double) insert/l);
     ai->finds1[m]=(usCount)((double)find1/l);
     ai->finds2[m]=(usCount)((double)find2/l);
+    ai->findmisses[m]=(usCount)((double)findmiss/l);
     ai->removes[m]=(usCount)((double)remove/l);
     ai->iterates[m]=(usCount)((double)iterate/l);
     //if(!(m & 127)) printf("At %d = %lu, %lu, %lu, %lu, %lu\n", m, ai->inserts[m], ai->finds1[m], ai->finds2[m], ai->removes[m], ai->iterates[m]);
@@ -343,7 +433,7 @@ template<class stlcontainer> void RunTest(AlgorithmInfo *ai)
 #endif /* __cplusplus */
 
 
-#define ALGORITHMS 6
+#define ALGORITHMS 8
 int main(void)
 {
   int n, m, algorithmslen=0;
@@ -373,6 +463,8 @@ int main(void)
     /* These are the C benchmarks */
     algorithms[algorithmslen].name="nedtrie";
     nedtrie_RunTest(algorithms+algorithmslen++);
+    algorithms[algorithmslen].name="nedtrie key in link";
+    nedtriek_RunTest(algorithms+algorithmslen++);
     algorithms[algorithmslen].name="rbtree";
      rbtree_RunTest(algorithms+algorithmslen++);
     algorithms[algorithmslen].name="hash";
@@ -384,6 +476,12 @@ int main(void)
     using namespace std;
     algorithms[algorithmslen].name="trie_map<size_t>";
     RunTest<nedtries::trie_map<size_t, size_t> >(algorithms+algorithmslen++);
+    {
+      typedef nedtries::trie_maptype<size_t, size_t, nedtries::trie_maptype_keyfunct<size_t, size_t>, std::list<size_t>::iterator> slabmaptype;
+      algorithms[algorithmslen].name="trie_map<size_t> slab_list";
+      RunTest<nedtries::trie_map<size_t, size_t, nedtries::trie_maptype_keyfunct<size_t, size_t>, std::allocator<slabmaptype>,
+        nedtries::nedpolicy::nobblezeros, nedtries::slab_list<slabmaptype> > >(algorithms+algorithmslen++);
+    }
     algorithms[algorithmslen].name="map<size_t>";
     RunTest<map<size_t, size_t> >(algorithms+algorithmslen++);
 #ifdef HAVE_UNORDERED_MAP
@@ -405,8 +503,8 @@ int main(void)
   if(!oh) abort();
   for(m=0; m<algorithmslen; m++)
   {
-    fprintf(oh, "\"Items\",\"Insert (%s)\",\"Find 0-N (%s)\",\"Find N (%s)\",\"Remove (%s)\",\"Iterate (%s)\",\"Close find 0 (%s)\",\"Close find INF (%s)\",\"Nearest find (%s)\"%c", algorithms[m].name, algorithms[m].name, algorithms[m].name, algorithms[m].name, algorithms[m].name, algorithms[m].name, algorithms[m].name, algorithms[m].name, m==algorithmslen-1 ? '\n' : ',');
-    algorithms[m].inserts[0]=algorithms[m].finds1[0]=algorithms[m].finds2[0]=algorithms[m].removes[0]=algorithms[m].iterates[0]=algorithms[m].cfind1s[0]=algorithms[m].cfind2s[0]=algorithms[m].nfinds[0]=1;
+    fprintf(oh, "\"Items\",\"Insert (%s)\",\"Find 0-N (%s)\",\"Find N (%s)\",\"Remove (%s)\",\"Iterate (%s)\",\"Close find 0 (%s)\",\"Close find INF (%s)\",\"Nearest find (%s)\",\"Batch insert (%s)\",\"Close find smaller 0 (%s)\",\"Nearest smaller find (%s)\",\"Find N cache misses per find (%s)\"%c", algorithms[m].name, algorithms[m].name, algorithms[m].name, algorithms[m].name, algorithms[m].name, algorithms[m].name, algorithms[m].name, algorithms[m].name, algorithms[m].name, algorithms[m].name, algorithms[m].name, algorithms[m].name, m==algorithmslen-1 ? '\n' : ',');
+    algorithms[m].inserts[0]=algorithms[m].finds1[0]=algorithms[m].finds2[0]=algorithms[m].removes[0]=algorithms[m].iterates[0]=algorithms[m].cfind1s[0]=algorithms[m].cfind2s[0]=algorithms[m].nfinds[0]=algorithms[m].insertbatches[0]=algorithms[m].cfindsmaller1s[0]=algorithms[m].nfindsmallers[0]=1;
   }
   /* Max out the CPU to try to counter SpeedStep */
   {
@@ -418,10 +516,11 @@ int main(void)
     for(m=0; m<algorithmslen; m++)
     {
       int k, added=0;
-      double inserts=0, finds1=0, finds2=0, removes=0, iterates=0, cfind1s=0, cfind2s=0, nfinds=0;
+      double inserts=0, insertbatches=0, finds1=0, finds2=0, removes=0, iterates=0, cfind1s=0, cfind2s=0, nfinds=0, cfindsmaller1s=0, nfindsmallers=0;
       k=n;
       {
         inserts+=pow(algorithms[m].inserts[k]/1000000000000.0, 1.0/3);
+        insertbatches+=pow(algorithms[m].insertbatches[k]/1000000000000.0, 1.0/3);
         finds1+=pow(algorithms[m].finds1[k]/1000000000000.0, 1.0/3);
         finds2+=pow(algorithms[m].finds2[k]/1000000000000.0, 1.0/3);
         removes+=pow(algorithms[m].removes[k]/1000000000000.0, 1.0/3);
@@ -429,13 +528,18 @@ int main(void)
         cfind1s+=pow(algorithms[m].cfind1s[k]/1000000000000.0, 1.0/3);
         cfind2s+=pow(algorithms[m].cfind2s[k]/1000000000000.0, 1.0/3);
         nfinds+=pow(algorithms[m].nfinds[k]/1000000000000.0, 1.0/3);
+        cfindsmaller1s+=pow(algorithms[m].cfindsmaller1s[k]/1000000000000.0, 1.0/3);
+        nfindsmallers+=pow(algorithms[m].nfindsmallers[k]/1000000000000.0, 1.0/3);
         added++;
       }
 #ifdef USE_CPU_CYCLES
       if(cfind1s<0.01) cfind1s=0;
       if(cfind2s<0.01) cfind2s=0;
       if(nfinds<0.01) nfinds=0;
-      fprintf(oh, "%d,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf%c", (1<<n),
+      if(insertbatches<0.01) insertbatches=0;
+      if(cfindsmaller1s<0.01) cfindsmaller1s=0;
+      if(nfindsmallers<0.01) nfindsmallers=0;
+      fprintf(oh, "%d,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf%c", (1<<n),
         CPUClockSpeed/((1<<n)/(pow(inserts/added, 3))),
         CPUClockSpeed/((1<<n)/(pow(finds1/added, 3))),
         CPUClockSpeed/((1<<n)/(pow(finds2/added, 3))),
@@ -444,12 +548,19 @@ int main(void)
         CPUClockSpeed/((1<<n)/(pow(cfind1s/added, 3))),
         CPUClockSpeed/((1<<n)/(pow(cfind2s/added, 3))),
         CPUClockSpeed/((1<<n)/(pow(nfinds/added, 3))),
+        CPUClockSpeed/((1<<n)/(pow(insertbatches/added, 3))),
+        CPUClockSpeed/((1<<n)/(pow(cfindsmaller1s/added, 3))),
+        CPUClockSpeed/((1<<n)/(pow(nfindsmallers/added, 3))),
+        (double) algorithms[m].findmisses[n]/(1<<n),
         m==algorithmslen-1 ? '\n' : ',');
 #else
       if(cfind1s<0.01) cfind1s=HUGE_VAL;
       if(cfind2s<0.01) cfind2s=HUGE_VAL;
       if(nfinds<0.01) nfinds=HUGE_VAL;
-      fprintf(oh, "%d,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf%c", (1<<n),
+      if(insertbatches<0.01) insertbatches=HUGE_VAL;
+      if(cfindsmaller1s<0.01) cfindsmaller1s=HUGE_VAL;
+      if(nfindsmallers<0.01) nfindsmallers=HUGE_VAL;
+      fprintf(oh, "%d,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf%c", (1<<n),
         (1<<n)/(pow(inserts/added, 3)),
         (1<<n)/(pow(finds1/added, 3)),
         (1<<n)/(pow(finds2/added, 3)),
@@ -458,6 +569,10 @@ int main(void)
         (1<<n)/(pow(cfind1s/added, 3)),
         (1<<n)/(pow(cfind2s/added, 3)),
         (1<<n)/(pow(nfinds/added, 3)),
+        (1<<n)/(pow(insertbatches/added, 3)),
+        (1<<n)/(pow(cfindsmaller1s/added, 3)),
+        (1<<n)/(pow(nfindsmallers/added, 3)),
+        (double) algorithms[m].findmisses[n]/(1<<n),
         m==algorithmslen-1 ? '\n' : ',');
 #endif
     }
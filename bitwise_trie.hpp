@@ -124,15 +124,23 @@ duration 134773 ms
 
 #include "../declval.hpp"
 
+#include <atomic>
 #include <cassert>
 #include <cstring>  // for memset
 #include <iterator>
+#include <thread>  // for yield
 #include <type_traits>
+#include <utility>  // for pair
+#include <vector>
 
 #if __cpp_exceptions && !QUICKCPPLIB_ALGORITHM_BITWISE_TRIE_DISABLE_EXCEPTION_THROWS
 #include <stdexcept>
 #endif
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 QUICKCPPLIB_NAMESPACE_BEGIN
 
 namespace algorithm
@@ -201,6 +209,95 @@ namespace algorithm
 #endif
 #endif
       }
+#if defined(__SIZEOF_INT128__)
+      template <class T, typename std::enable_if<std::is_same<T, unsigned __int128>::value, int>::type = 0>
+      inline unsigned bitscanr(T value)
+      {
+        const auto high = (size_t) (value >> 64);
+        return (high != 0) ? (64 + bitscanr(high)) : bitscanr((size_t) value);
+      }
+#endif
+      // value must not be zero
+      inline unsigned bitscanf(size_t value) noexcept
+      {
+#if defined(_MSC_VER) && !defined(__cplusplus_cli)
+        unsigned long bitpos;
+#if defined(_M_IA64) || defined(_M_X64) || defined(WIN64) || defined(_WIN64)
+        _BitScanForward64(&bitpos, value);
+#else
+        _BitScanForward(&bitpos, (unsigned) value);
+#endif
+        return (unsigned) bitpos;
+#elif defined(__GNUC__)
+        return (unsigned) __builtin_ctzl(value);
+#else
+        return bitscanr(value & (0 - value));
+#endif
+      }
+      // Key types are unsigned integers, including ones the standard library may not consider such
+      template <class T> struct is_unsigned_key : std::is_unsigned<T>
+      {
+      };
+#if defined(__SIZEOF_INT128__)
+      template <> struct is_unsigned_key<unsigned __int128> : std::true_type
+      {
+      };
+#endif
+      // Spin politely, yielding the CPU if the lock holder is probably not running
+      inline void spin_pause(unsigned &spins) noexcept
+      {
+        if(++spins % 64 == 0)
+        {
+          std::this_thread::yield();
+          return;
+        }
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+        _mm_pause();
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+        __builtin_ia32_pause();
+#endif
+      }
+      // Ask the CPU to start fetching addr into cache
+      inline void prefetch(const void *addr) noexcept
+      {
+#if defined(__GNUC__)
+        __builtin_prefetch(addr);
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+        _mm_prefetch((const char *) addr, _MM_HINT_T0);
+#else
+        (void) addr;
+#endif
+      }
+      /* Links may be read by optimistic finds while a writer modifies them, so are atomics. They
+      are stored with release and loaded with acquire semantics, so an item newly linked in is
+      seen as it was when linked. On x86 these compile to the same plain moves. */
+      template <class T> inline T link_load(const T &v) noexcept
+      {
+#if defined(__GNUC__)
+        return __atomic_load_n(&v, __ATOMIC_ACQUIRE);
+#elif __cpp_lib_atomic_ref
+        return std::atomic_ref<T>(const_cast<T &>(v)).load(std::memory_order_acquire);
+#else
+        return *(const volatile T *) &v;
+#endif
+      }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wstringop-overflow"  // sees offset pointers as possibly null
+#endif
+      template <class T> inline void link_store(T &v, typename std::decay<T>::type x) noexcept
+      {
+#if defined(__GNUC__)
+        __atomic_store_n(&v, x, __ATOMIC_RELEASE);
+#elif __cpp_lib_atomic_ref
+        std::atomic_ref<T>(v).store(x, std::memory_order_release);
+#else
+        *(volatile T *) &v = x;
+#endif
+      }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
       template <int Dir> struct nobble_function_implementation
       {
         template <class T> constexpr bool operator()(T &&accessors) const noexcept
@@ -223,18 +320,358 @@ namespace algorithm
       };
       template <class T, class ItemType> struct trie_sibling<T, ItemType, decltype((void) ItemType::trie_sibling, 0)>
       {
-        static constexpr ItemType *get(const T *inst, bool right, const ItemType * /*unused*/) noexcept
+        static ItemType *get(const T *inst, bool right, const ItemType * /*unused*/) noexcept
+        {
+          return link_load(inst->trie_sibling[right]);
+        }
+        static bool set(T *inst, bool right, ItemType *x) noexcept
+        {
+          link_store(inst->trie_sibling[right], x);
+          return true;
+        }
+      };
+      template <class H, class = int> struct has_unlocked_branches : std::false_type
+      {
+      };
+      template <class H>
+      struct has_unlocked_branches<H, decltype((void) H::unlocked_branches, 0)>
+          : std::integral_constant<bool, H::unlocked_branches>
+      {
+      };
+      /* An item type without `trie_sibling` may declare `static constexpr bool
+      trie_inline_duplicates() { return true; }`, whereupon items with a key already in the index are
+      stored as ordinary nodes further down that key's path instead of being refused. */
+      template <class T, class = int> struct has_inline_duplicates : std::false_type
+      {
+      };
+      template <class T>
+      struct has_inline_duplicates<T, decltype((void) T::trie_inline_duplicates(), 0)>
+          : std::integral_constant<bool, T::trie_inline_duplicates()>
+      {
+      };
+      /* A trie index head may optionally keep a `trie_occupancy` word with bit n set if bin n is
+      non-empty, so the next non-empty bin can be found with a bitscan rather than by loading
+      every bin in turn. Without one, every bin is reported as possibly occupied. */
+      inline constexpr size_t occupancy_load(const size_t &v) noexcept { return v; }
+      inline size_t occupancy_load(const std::atomic<size_t> &v) noexcept { return v.load(std::memory_order_relaxed); }
+      inline constexpr void occupancy_update(size_t &v, size_t bit, bool occupied) noexcept
+      {
+        v = occupied ? (v | bit) : (v & ~bit);
+      }
+      inline void occupancy_update(std::atomic<size_t> &v, size_t bit, bool occupied) noexcept
+      {
+        // Other bins are modified concurrently, so this must be a single atomic op
+        if(occupied)
+        {
+          v.fetch_or(bit, std::memory_order_relaxed);
+        }
+        else
+        {
+          v.fetch_and(~bit, std::memory_order_relaxed);
+        }
+      }
+      template <class T, class = int> struct trie_occupancy
+      {
+        static constexpr size_t get(const T * /*unused*/) noexcept { return (size_t) -1; }
+        static constexpr void set(T * /*unused*/, unsigned /*unused*/, bool /*unused*/) noexcept {}
+      };
+      template <class T> struct trie_occupancy<T, decltype((void) T::trie_occupancy, 0)>
+      {
+        static constexpr size_t get(const T *inst) noexcept { return occupancy_load(inst->trie_occupancy); }
+        static constexpr void set(T *inst, unsigned idx, bool occupied) noexcept
+        {
+          // Bins beyond the occupancy word are not tracked
+          if(idx < 8 * sizeof(size_t))
+          {
+            occupancy_update(inst->trie_occupancy, (size_t) 1 << idx, occupied);
+          }
+        }
+      };
+      template <class H, class = int> struct has_epochs : std::false_type
+      {
+      };
+      template <class H> struct has_epochs<H, decltype((void) declval<const H &>().epochs(), 0)> : std::true_type
+      {
+      };
+      template <class H, class = int> struct has_occupancy : std::false_type
+      {
+      };
+      template <class H> struct has_occupancy<H, decltype((void) declval<const H &>().occupancy(), 0)> : std::true_type
+      {
+      };
+      /* Item accessors may optionally provide `subtree_count()` and `set_subtree_count()`, the
+      number of items in the subtree rooted at an item including the item and its siblings. The
+      index then keeps them up to date, which lets it rank and select in O(depth). Indexes whose
+      accessors don't provide them maintain nothing. */
+      template <class A, class = int> struct has_subtree_count : std::false_type
+      {
+      };
+      template <class A>
+      struct has_subtree_count<A, decltype((void) declval<const A &>().subtree_count(), 0)> : std::true_type
+      {
+      };
+      template <class H, class K, class = int> struct has_optimistic_lock_branch : std::false_type
+      {
+      };
+      template <class H, class K>
+      struct has_optimistic_lock_branch<H, K, decltype((void) declval<H &>().optimistic_lock_branch(declval<K>(), 0u), 0)>
+          : std::true_type
+      {
+      };
+      /* Self relative offset pointers. The offset is from the address of the member storing it,
+      so both the member and what it points to can be relocated together. 1 is null, as items
+      are at least four byte aligned, and odd values with both bottom bits set are tags. */
+      template <class T, class Offset> inline T *offset_ptr_get(const Offset &member) noexcept
+      {
+        const Offset offset = link_load(member);
+        return (1 == offset) ? nullptr : (T *) ((uintptr_t) &member + (intptr_t) offset);
+      }
+      template <class T, class Offset> inline void offset_ptr_set(Offset &member, T *x) noexcept
+      {
+        static_assert(std::is_signed<Offset>::value, "offset type must be signed");
+        if(x == nullptr)
         {
-          return inst->trie_sibling[right];
+          link_store(member, (Offset) 1);
+          return;
         }
-        static constexpr bool set(T *inst, bool right, ItemType *x) noexcept
+        const intptr_t offset = (intptr_t) ((uintptr_t) x - (uintptr_t) &member);
+        assert((intptr_t) (Offset) offset == offset);  // offset must fit into the member
+        link_store(member, (Offset) offset);
+      }
+      // As trie_sibling above, for sibling links stored as offset pointers
+      template <class ItemType, class = int> struct offset_trie_sibling
+      {
+        static constexpr ItemType *get(ItemType *inst, bool /*unused*/) noexcept { return inst; }
+        static constexpr bool set(ItemType * /*unused*/, bool /*unused*/, ItemType * /*unused*/) noexcept { return false; }
+      };
+      template <class ItemType> struct offset_trie_sibling<ItemType, decltype((void) ItemType::trie_sibling, 0)>
+      {
+        static ItemType *get(ItemType *inst, bool right) noexcept { return offset_ptr_get<ItemType>(inst->trie_sibling[right]); }
+        static bool set(ItemType *inst, bool right, ItemType *x) noexcept
         {
-          inst->trie_sibling[right] = x;
+          offset_ptr_set(inst->trie_sibling[right], x);
           return true;
         }
       };
     }  // namespace detail
 
+    /*! \class bitwise_trie_wide_key
+    \brief An unsigned integer of `Bytes` bytes, for use as a key wider than any native integer.
+    \tparam Bytes The width of the key, which must be a multiple of eight.
+
+    Use this as the type of `trie_key` to index UUIDs, content hashes, or fixed length string
+    prefixes without folding them into a narrower key. The index head then needs `8 * Bytes`
+    bins. `from_bytes()` treats the first byte as the most significant, so keys order as
+    `memcmp()` would order the bytes.
+     */
+    template <size_t Bytes> class bitwise_trie_wide_key
+    {
+      static_assert(Bytes > 0 && Bytes % 8 == 0, "Bytes must be a non-zero multiple of eight");
+      static constexpr size_t _words = Bytes / 8;
+      uint64_t _v[_words];  // least significant word first
+
+    public:
+      bitwise_trie_wide_key() = default;
+      //! Implicitly constructs from an integer, sign extending negative values.
+      template <class T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+      constexpr bitwise_trie_wide_key(T v) noexcept
+          : _v{}
+      {
+        const uint64_t fill = (std::is_signed<T>::value && v < 0) ? (uint64_t) -1 : 0;
+        _v[0] = (uint64_t) v;
+        for(size_t n = 1; n < _words; n++)
+        {
+          _v[n] = fill;
+        }
+      }
+      //! Constructs from up to `Bytes` bytes, most significant first. Missing bytes are zero.
+      static bitwise_trie_wide_key from_bytes(const void *data, size_t len = Bytes) noexcept
+      {
+        bitwise_trie_wide_key ret(0);
+        const unsigned char *p = (const unsigned char *) data;
+        for(size_t n = 0; n < len && n < Bytes; n++)
+        {
+          const size_t bit = (Bytes - 1 - n) * 8;
+          ret._v[bit / 64] |= (uint64_t) p[n] << (bit % 64);
+        }
+        return ret;
+      }
+      //! Returns a word of the key, zero being the least significant.
+      constexpr uint64_t word(size_t idx) const noexcept { return _v[idx]; }
+
+      constexpr explicit operator bool() const noexcept
+      {
+        for(size_t n = 0; n < _words; n++)
+        {
+          if(_v[n] != 0)
+          {
+            return true;
+          }
+        }
+        return false;
+      }
+      //! Returns the index of the topmost set bit, or zero if none set.
+      constexpr unsigned bitscanr() const noexcept
+      {
+        for(size_t n = _words - 1; n > 0; n--)
+        {
+          if(_v[n] != 0)
+          {
+            return (unsigned) (n * 64) + detail::bitscanr((size_t) _v[n]);
+          }
+        }
+        return detail::bitscanr((size_t) _v[0]);
+      }
+
+      constexpr bitwise_trie_wide_key &operator<<=(unsigned n) noexcept
+      {
+        const size_t words = n / 64, bits = n % 64;
+        for(size_t i = _words; i-- > 0;)
+        {
+          uint64_t x = (i >= words) ? (_v[i - words] << bits) : 0;
+          if(bits != 0 && i >= words + 1)
+          {
+            x |= _v[i - words - 1] >> (64 - bits);
+          }
+          _v[i] = x;
+        }
+        return *this;
+      }
+      constexpr bitwise_trie_wide_key &operator>>=(unsigned n) noexcept
+      {
+        const size_t words = n / 64, bits = n % 64;
+        for(size_t i = 0; i < _words; i++)
+        {
+          uint64_t x = (i + words < _words) ? (_v[i + words] >> bits) : 0;
+          if(bits != 0 && i + words + 1 < _words)
+          {
+            x |= _v[i + words + 1] << (64 - bits);
+          }
+          _v[i] = x;
+        }
+        return *this;
+      }
+      friend constexpr bitwise_trie_wide_key operator<<(bitwise_trie_wide_key a, unsigned n) noexcept { return a <<= n; }
+      friend constexpr bitwise_trie_wide_key operator>>(bitwise_trie_wide_key a, unsigned n) noexcept { return a >>= n; }
+
+      friend constexpr bitwise_trie_wide_key operator&(bitwise_trie_wide_key a, const bitwise_trie_wide_key &b) noexcept
+      {
+        for(size_t n = 0; n < _words; n++)
+        {
+          a._v[n] &= b._v[n];
+        }
+        return a;
+      }
+      friend constexpr bitwise_trie_wide_key operator|(bitwise_trie_wide_key a, const bitwise_trie_wide_key &b) noexcept
+      {
+        for(size_t n = 0; n < _words; n++)
+        {
+          a._v[n] |= b._v[n];
+        }
+        return a;
+      }
+      friend constexpr bitwise_trie_wide_key operator^(bitwise_trie_wide_key a, const bitwise_trie_wide_key &b) noexcept
+      {
+        for(size_t n = 0; n < _words; n++)
+        {
+          a._v[n] ^= b._v[n];
+        }
+        return a;
+      }
+      friend constexpr bitwise_trie_wide_key operator~(bitwise_trie_wide_key a) noexcept
+      {
+        for(size_t n = 0; n < _words; n++)
+        {
+          a._v[n] = ~a._v[n];
+        }
+        return a;
+      }
+      friend constexpr bitwise_trie_wide_key operator+(bitwise_trie_wide_key a, const bitwise_trie_wide_key &b) noexcept
+      {
+        uint64_t carry = 0;
+        for(size_t n = 0; n < _words; n++)
+        {
+          const uint64_t x = a._v[n] + carry;
+          carry = (x < carry);
+          a._v[n] = x + b._v[n];
+          carry += (a._v[n] < x);
+        }
+        return a;
+      }
+      friend constexpr bitwise_trie_wide_key operator-(bitwise_trie_wide_key a, const bitwise_trie_wide_key &b) noexcept
+      {
+        uint64_t borrow = 0;
+        for(size_t n = 0; n < _words; n++)
+        {
+          const uint64_t x = a._v[n] - borrow;
+          borrow = (x > a._v[n]);
+          a._v[n] = x - b._v[n];
+          borrow += (a._v[n] > x);
+        }
+        return a;
+      }
+
+      friend constexpr bool operator==(const bitwise_trie_wide_key &a, const bitwise_trie_wide_key &b) noexcept
+      {
+        for(size_t n = 0; n < _words; n++)
+        {
+          if(a._v[n] != b._v[n])
+          {
+            return false;
+          }
+        }
+        return true;
+      }
+      friend constexpr bool operator!=(const bitwise_trie_wide_key &a, const bitwise_trie_wide_key &b) noexcept { return !(a == b); }
+      friend constexpr bool operator<(const bitwise_trie_wide_key &a, const bitwise_trie_wide_key &b) noexcept
+      {
+        for(size_t n = _words; n-- > 0;)
+        {
+          if(a._v[n] != b._v[n])
+          {
+            return a._v[n] < b._v[n];
+          }
+        }
+        return false;
+      }
+      friend constexpr bool operator>(const bitwise_trie_wide_key &a, const bitwise_trie_wide_key &b) noexcept { return b < a; }
+      friend constexpr bool operator<=(const bitwise_trie_wide_key &a, const bitwise_trie_wide_key &b) noexcept { return !(b < a); }
+      friend constexpr bool operator>=(const bitwise_trie_wide_key &a, const bitwise_trie_wide_key &b) noexcept { return !(a < b); }
+    };
+    namespace detail
+    {
+      template <size_t Bytes> inline unsigned bitscanr(const bitwise_trie_wide_key<Bytes> &value) { return value.bitscanr(); }
+      template <size_t Bytes> struct is_unsigned_key<bitwise_trie_wide_key<Bytes>> : std::true_type
+      {
+      };
+      /* Walks down the bits of a key from its topmost set bit. Avoid unknown bit shifts where
+      possible, their performance can suck, so native keys keep a mask which is shifted by one
+      each step, and wide keys keep a word index and a mask within that word rather than a key
+      wide mask which would cost a multiword shift and AND per step. */
+      template <class KeyType> struct keybit_cursor
+      {
+        KeyType keybit;
+        keybit_cursor() = default;
+        explicit keybit_cursor(unsigned bitidx) noexcept
+            : keybit((KeyType) 1 << bitidx)
+        {
+        }
+        void next() noexcept { keybit >>= 1; }
+        bool test(const KeyType &key) const noexcept { return !!(key & keybit); }
+      };
+      template <size_t Bytes> struct keybit_cursor<bitwise_trie_wide_key<Bytes>>
+      {
+        unsigned bitidx;
+        keybit_cursor() = default;
+        explicit keybit_cursor(unsigned _bitidx) noexcept
+            : bitidx(_bitidx)
+        {
+        }
+        void next() noexcept { bitidx -= (bitidx != 0); }
+        bool test(const bitwise_trie_wide_key<Bytes> &key) const noexcept { return !!((key.word(bitidx / 64) >> (bitidx % 64)) & 1); }
+      };
+    }  // namespace detail
+
     /*! \class bitwise_trie_item_accessors
     \brief Default accessor for a bitwise trie item.
     \tparam ItemType The type of item indexed.
@@ -245,6 +682,7 @@ namespace algorithm
     - `ItemType *trie_child[2]`
     - `ItemType *trie_sibling[2]`
     - `KeyType trie_key`
+    - `size_t trie_subtree_count` (optional, enables `rank()` and `select()`)
      */
     template <class ItemType> class bitwise_trie_item_accessors
     {
@@ -257,17 +695,17 @@ namespace algorithm
       }
       constexpr explicit operator bool() const noexcept { return _v != nullptr; }
 
-      constexpr const ItemType *parent() const noexcept
+      const ItemType *parent() const noexcept
       {
         assert(!parent_is_index());
-        return _v->trie_parent;
+        return detail::link_load(_v->trie_parent);
       }
-      constexpr ItemType *parent() noexcept
+      ItemType *parent() noexcept
       {
         assert(!parent_is_index());
-        return _v->trie_parent;
+        return detail::link_load(_v->trie_parent);
       }
-      constexpr void set_parent(ItemType *x) noexcept { _v->trie_parent = x; }
+      void set_parent(ItemType *x) noexcept { detail::link_store(_v->trie_parent, x); }
 
       constexpr bool parent_is_index() const noexcept { return ((uintptr_t) _v->trie_parent & 3) == 3; }
       constexpr unsigned bit_index() const noexcept
@@ -280,25 +718,36 @@ namespace algorithm
         _v->trie_parent = (ItemType *) (((uintptr_t) bit_index << 2) | 3);
       }
 
-      constexpr const ItemType *child(bool right) const noexcept { return _v->trie_child[right]; }
-      constexpr ItemType *child(bool right) noexcept { return _v->trie_child[right]; }
-      constexpr void set_child(bool right, ItemType *x) noexcept { _v->trie_child[right] = x; }
+      const ItemType *child(bool right) const noexcept { return detail::link_load(_v->trie_child[right]); }
+      ItemType *child(bool right) noexcept { return detail::link_load(_v->trie_child[right]); }
+      void set_child(bool right, ItemType *x) noexcept { detail::link_store(_v->trie_child[right], x); }
 
-      constexpr const ItemType *sibling(bool right) const noexcept
+      const ItemType *sibling(bool right) const noexcept
       {
         return detail::trie_sibling<ItemType, ItemType>::get(_v, right, _v);
       }
-      constexpr ItemType *sibling(bool right) noexcept
+      ItemType *sibling(bool right) noexcept
       {
         return detail::trie_sibling<ItemType, ItemType>::get(_v, right, _v);
       }
-      constexpr bool set_sibling(bool right, ItemType *x) noexcept
+      bool set_sibling(bool right, ItemType *x) noexcept
       {
         return detail::trie_sibling<ItemType, ItemType>::set(_v, right, x);
       }
 
       constexpr auto key() const noexcept { return _v->trie_key; }
 
+      template <class T = ItemType>
+      constexpr auto subtree_count() const noexcept -> decltype((size_t) T::trie_subtree_count)
+      {
+        return (size_t) _v->trie_subtree_count;
+      }
+      template <class T = ItemType>
+      constexpr auto set_subtree_count(size_t x) noexcept -> decltype((void) T::trie_subtree_count)
+      {
+        _v->trie_subtree_count = (decltype(T::trie_subtree_count)) x;
+      }
+
       constexpr bool is_primary_sibling() const noexcept
       {
         return _v->trie_parent != nullptr;
@@ -312,79 +761,839 @@ namespace algorithm
       constexpr void set_is_secondary_sibling() noexcept { _v->trie_parent = nullptr; }
     };
 
-    /*! \class bitwise_trie_head_accessors
-    \brief Default accessor for a bitwise trie index head.
-    \tparam HeadBaseType The type from which `bitwise_trie` inherits
+    /*! \class offset_bitwise_trie_item_accessors
+    \brief Accessor for a bitwise trie item which stores self relative offsets instead of pointers.
     \tparam ItemType The type of item indexed.
 
-    This default accessor requires the following member variables in the trie index head type:
+    This accessor requires the following member variables in the trie item type:
 
-    - `<unsigned type> trie_count`
-    - `ItemType *trie_children[8 * sizeof(<unsigned type>)]`
-    - `bool trie_nobbledir` (if you use equal nobbling only)
+    - `<signed type> trie_parent`
+    - `<signed type> trie_child[2]`
+    - `<signed type> trie_sibling[2]` (if you allow multiple items with the same key value only)
+    - `KeyType trie_key`
+    - `<unsigned type> trie_subtree_count` (optional, enables `rank()` and `select()`)
+
+    Each link stores the distance in bytes from itself to the item it refers to, so items
+    which are relocated together, such as when a file containing them is memory mapped
+    at a different address, remain correctly linked. Use `int32_t` for the links if all
+    items are within 2Gb of one another, else `int64_t`. Items must be at least four byte
+    aligned.
      */
-    template <class HeadBaseType, class ItemType> class bitwise_trie_head_accessors
+    template <class ItemType> class offset_bitwise_trie_item_accessors
     {
-      HeadBaseType *_v;
-      using _index_type = decltype(_v->trie_count);
-      static_assert(std::is_unsigned<_index_type>::value, "count type must be unsigned");
-      static constexpr size_t _index_type_bits = 8 * sizeof(_index_type);
-      using _child_array_type = decltype(_v->trie_children);
-      static_assert(sizeof(_child_array_type) / sizeof(void *) >= _index_type_bits, "children array is not big enough");
-      using _key_type = decltype(declval<bitwise_trie_item_accessors<ItemType> *>()->key());
+      ItemType *_v;
+      using _offset_type = typename std::remove_cv<decltype(_v->trie_parent)>::type;
+      static_assert(std::is_signed<_offset_type>::value, "offset type must be signed");
+      static_assert(alignof(ItemType) >= 4, "items must be at least four byte aligned");
 
     public:
-      constexpr bitwise_trie_head_accessors(HeadBaseType *v)
+      constexpr offset_bitwise_trie_item_accessors(ItemType *v)
           : _v(v)
       {
       }
       constexpr explicit operator bool() const noexcept { return _v != nullptr; }
 
-      constexpr _index_type size() const noexcept { return _v->trie_count; }
-      constexpr void incr_size() noexcept { ++_v->trie_count; }
-      constexpr void decr_size() noexcept { --_v->trie_count; }
-      constexpr void set_size(_index_type x) noexcept { _v->trie_count = x; }
-
-      constexpr _index_type max_size() const noexcept { return (_index_type) -1; }
-
-      constexpr const ItemType *child(unsigned idx) const noexcept
+      const ItemType *parent() const noexcept
       {
-        assert(idx <= _index_type(-1));
-        return _v->trie_children[idx];
+        assert(!parent_is_index());
+        return detail::offset_ptr_get<const ItemType>(_v->trie_parent);
       }
-      constexpr ItemType *child(unsigned idx) noexcept
+      ItemType *parent() noexcept
       {
-        assert(idx <= _index_type(-1));
-        return _v->trie_children[idx];
+        assert(!parent_is_index());
+        return detail::offset_ptr_get<ItemType>(_v->trie_parent);
       }
-      constexpr void set_child(unsigned idx, ItemType *x) noexcept
+      void set_parent(ItemType *x) noexcept { detail::offset_ptr_set(_v->trie_parent, x); }
+
+      constexpr bool parent_is_index() const noexcept { return (_v->trie_parent & 3) == 3; }
+      constexpr unsigned bit_index() const noexcept
       {
-        assert(idx <= _index_type(-1));
-        _v->trie_children[idx] = x;
+        assert(parent_is_index());
+        return ((unsigned) _v->trie_parent) >> 2;
+      }
+      void set_parent_is_index(unsigned bit_index) noexcept
+      {
+        _v->trie_parent = (_offset_type) (((_offset_type) bit_index << 2) | 3);
       }
 
-      constexpr _index_type
-      lock_branch(_key_type key, bool exclusive,
-                  unsigned bitidxhint = (unsigned) -1) const noexcept  // note return type can be ANY type
+      const ItemType *child(bool right) const noexcept
       {
-        (void) key;
-        (void) exclusive;
-        (void) bitidxhint;
-        return 0;
+        return detail::offset_ptr_get<const ItemType>(_v->trie_child[right]);
       }
-      constexpr void unlock_branch(_index_type /*unused*/, bool /*unused*/) const noexcept {}
+      ItemType *child(bool right) noexcept { return detail::offset_ptr_get<ItemType>(_v->trie_child[right]); }
+      void set_child(bool right, ItemType *x) noexcept { detail::offset_ptr_set(_v->trie_child[right], x); }
 
-      constexpr bool flip_nobbledir() noexcept { return (_v->trie_nobbledir = !_v->trie_nobbledir); }
-    };
+      const ItemType *sibling(bool right) const noexcept
+      {
+        return detail::offset_trie_sibling<const ItemType>::get(_v, right);
+      }
+      ItemType *sibling(bool right) noexcept { return detail::offset_trie_sibling<ItemType>::get(_v, right); }
+      bool set_sibling(bool right, ItemType *x) noexcept { return detail::offset_trie_sibling<ItemType>::set(_v, right, x); }
 
-    /*! \class bitwise_trie
-    \brief Never-allocating in-place bitwise Fredkin trie index head type.
-    \tparam Base The base type from which to inherit (and thus overlay the index member functions).
-    \tparam ItemType The type of item indexed.
-    \tparam NobbleDir -1 to nobble zeros, +1 to nobble ones, 0 to nobble both equally (see below).
+      constexpr auto key() const noexcept { return _v->trie_key; }
 
-    This uses the bitwise Fredkin trie algorithm to index a collection of items by an unsigned
-    integral key (e.g. a `size_t` from `std::hash`), providing identical O(log2 N) time insertion,
+      template <class T = ItemType>
+      constexpr auto subtree_count() const noexcept -> decltype((size_t) T::trie_subtree_count)
+      {
+        return (size_t) _v->trie_subtree_count;
+      }
+      template <class T = ItemType>
+      constexpr auto set_subtree_count(size_t x) noexcept -> decltype((void) T::trie_subtree_count)
+      {
+        _v->trie_subtree_count = (decltype(T::trie_subtree_count)) x;
+      }
+
+      constexpr bool is_primary_sibling() const noexcept
+      {
+        return _v->trie_parent != 1;
+      }  // there is exactly one of these ever per key value
+      constexpr void set_is_primary_sibling() noexcept { assert(_v->trie_parent != 1); }
+
+      constexpr bool is_secondary_sibling() const noexcept
+      {
+        return _v->trie_parent == 1;
+      }  // i.e. has same key as primary sibling
+      constexpr void set_is_secondary_sibling() noexcept { _v->trie_parent = 1; }
+    };
+
+    /*! \class compact_bitwise_trie_item_accessors
+    \brief Accessor for a bitwise trie item which stores links as indices into an array of items.
+    \tparam ItemType The type of item indexed.
+
+    This accessor requires the following in the trie item type:
+
+    - `<unsigned type> trie_parent`
+    - `<unsigned type> trie_child[2]`
+    - `<unsigned type> trie_sibling[2]`
+    - `KeyType trie_key`
+    - `<unsigned type> trie_subtree_count` (optional, enables `rank()` and `select()`)
+    - `static ItemType *trie_index_base()`, returning the array all indexed items are in
+
+    Each link stores one plus the index of the item it refers to, or zero for null. The top bit
+    flags a bin root, whose link to the index head stores the bin instead. With `uint32_t`
+    links and a `uint32_t` key an item needs 24 bytes of housekeeping instead of 48, so
+    twice as many fit into cache, and up to 2^31 - 1 items can be indexed.
+     */
+    template <class ItemType> class compact_bitwise_trie_item_accessors
+    {
+      ItemType *_v;
+      using _link_type = typename std::remove_cv<decltype(_v->trie_parent)>::type;
+      static_assert(std::is_unsigned<_link_type>::value, "link type must be unsigned");
+      static constexpr _link_type _index_flag = (_link_type) 1 << (8 * sizeof(_link_type) - 1);
+
+      static ItemType *_get(_link_type x) noexcept
+      {
+        return (0 == x) ? nullptr : (std::remove_const<ItemType>::type::trie_index_base() + (x - 1));
+      }
+      static _link_type _to_link(const ItemType *x) noexcept
+      {
+        if(x == nullptr)
+        {
+          return 0;
+        }
+        const ptrdiff_t idx = x - std::remove_const<ItemType>::type::trie_index_base();
+        assert(idx >= 0 && (size_t) idx + 1 < (size_t) _index_flag);  // item must be in the array
+        return (_link_type) (idx + 1);
+      }
+
+    public:
+      constexpr compact_bitwise_trie_item_accessors(ItemType *v)
+          : _v(v)
+      {
+      }
+      constexpr explicit operator bool() const noexcept { return _v != nullptr; }
+
+      const ItemType *parent() const noexcept
+      {
+        assert(!parent_is_index());
+        return _get(detail::link_load(_v->trie_parent));
+      }
+      ItemType *parent() noexcept
+      {
+        assert(!parent_is_index());
+        return _get(detail::link_load(_v->trie_parent));
+      }
+      void set_parent(ItemType *x) noexcept { detail::link_store(_v->trie_parent, _to_link(x)); }
+
+      constexpr bool parent_is_index() const noexcept { return (_v->trie_parent & _index_flag) != 0; }
+      constexpr unsigned bit_index() const noexcept
+      {
+        assert(parent_is_index());
+        return (unsigned) (_v->trie_parent & ~_index_flag);
+      }
+      void set_parent_is_index(unsigned bit_index) noexcept { _v->trie_parent = (_link_type) (_index_flag | bit_index); }
+
+      const ItemType *child(bool right) const noexcept { return _get(detail::link_load(_v->trie_child[right])); }
+      ItemType *child(bool right) noexcept { return _get(detail::link_load(_v->trie_child[right])); }
+      void set_child(bool right, ItemType *x) noexcept { detail::link_store(_v->trie_child[right], _to_link(x)); }
+
+      const ItemType *sibling(bool right) const noexcept { return _get(detail::link_load(_v->trie_sibling[right])); }
+      ItemType *sibling(bool right) noexcept { return _get(detail::link_load(_v->trie_sibling[right])); }
+      bool set_sibling(bool right, ItemType *x) noexcept
+      {
+        detail::link_store(_v->trie_sibling[right], _to_link(x));
+        return true;
+      }
+
+      constexpr auto key() const noexcept { return _v->trie_key; }
+
+      template <class T = ItemType>
+      constexpr auto subtree_count() const noexcept -> decltype((size_t) T::trie_subtree_count)
+      {
+        return (size_t) _v->trie_subtree_count;
+      }
+      template <class T = ItemType>
+      constexpr auto set_subtree_count(size_t x) noexcept -> decltype((void) T::trie_subtree_count)
+      {
+        _v->trie_subtree_count = (decltype(T::trie_subtree_count)) x;
+      }
+
+      constexpr bool is_primary_sibling() const noexcept
+      {
+        return _v->trie_parent != 0;
+      }  // there is exactly one of these ever per key value
+      constexpr void set_is_primary_sibling() noexcept { assert(_v->trie_parent != 0); }
+
+      constexpr bool is_secondary_sibling() const noexcept
+      {
+        return _v->trie_parent == 0;
+      }  // i.e. has same key as primary sibling
+      constexpr void set_is_secondary_sibling() noexcept { _v->trie_parent = 0; }
+    };
+
+    /*! \class bitwise_trie_head_accessors
+    \brief Default accessor for a bitwise trie index head.
+    \tparam HeadBaseType The type from which `bitwise_trie` inherits
+    \tparam ItemType The type of item indexed.
+
+    This default accessor requires the following member variables in the trie index head type:
+
+    - `<unsigned type> trie_count`
+    - `ItemType *trie_children[8 * sizeof(<unsigned type>)]`
+    - `bool trie_nobbledir` (if you use equal nobbling only)
+    - `size_t trie_occupancy` (optional, lets searches skip empty bins with a bitscan)
+
+    Head accessors whose `lock_branch()` does nothing may declare `static constexpr bool
+    unlocked_branches = true`, which lets `find_many()` interleave its lookups.
+     */
+    template <class HeadBaseType, class ItemType> class bitwise_trie_head_accessors
+    {
+      HeadBaseType *_v;
+      using _index_type = decltype(_v->trie_count);
+      static_assert(std::is_unsigned<_index_type>::value, "count type must be unsigned");
+      static constexpr size_t _index_type_bits = 8 * sizeof(_index_type);
+      using _child_array_type = decltype(_v->trie_children);
+      static_assert(sizeof(_child_array_type) / sizeof(void *) >= _index_type_bits, "children array is not big enough");
+      using _key_type = decltype(declval<bitwise_trie_item_accessors<ItemType> *>()->key());
+      static_assert(std::extent<_child_array_type>::value >= 8 * sizeof(_key_type), "children array is not big enough for the key type");
+
+    public:
+      //! `lock_branch()` does nothing
+      static constexpr bool unlocked_branches = true;
+
+      constexpr bitwise_trie_head_accessors(HeadBaseType *v)
+          : _v(v)
+      {
+      }
+      constexpr explicit operator bool() const noexcept { return _v != nullptr; }
+
+      constexpr _index_type size() const noexcept { return _v->trie_count; }
+      constexpr void incr_size() noexcept { ++_v->trie_count; }
+      constexpr void decr_size() noexcept { --_v->trie_count; }
+      constexpr void set_size(_index_type x) noexcept { _v->trie_count = x; }
+
+      constexpr _index_type max_size() const noexcept { return (_index_type) -1; }
+
+      constexpr const ItemType *child(unsigned idx) const noexcept
+      {
+        assert(idx <= _index_type(-1));
+        return _v->trie_children[idx];
+      }
+      constexpr ItemType *child(unsigned idx) noexcept
+      {
+        assert(idx <= _index_type(-1));
+        return _v->trie_children[idx];
+      }
+      constexpr void set_child(unsigned idx, ItemType *x) noexcept
+      {
+        assert(idx <= _index_type(-1));
+        _v->trie_children[idx] = x;
+        detail::trie_occupancy<HeadBaseType>::set(_v, idx, x != nullptr);
+      }
+      //! Bit n is set if `child(n)` may be non-null
+      constexpr size_t occupancy() const noexcept { return detail::trie_occupancy<HeadBaseType>::get(_v); }
+
+      constexpr _index_type
+      lock_branch(_key_type key, bool exclusive,
+                  unsigned bitidxhint = (unsigned) -1) const noexcept  // note return type can be ANY type
+      {
+        (void) key;
+        (void) exclusive;
+        (void) bitidxhint;
+        return 0;
+      }
+      constexpr void unlock_branch(_index_type /*unused*/, bool /*unused*/) const noexcept {}
+
+      constexpr bool flip_nobbledir() noexcept { return (_v->trie_nobbledir = !_v->trie_nobbledir); }
+    };
+
+    /*! \class offset_bitwise_trie_head_accessors
+    \brief Accessor for a bitwise trie index head which stores self relative offsets instead of pointers.
+    \tparam HeadBaseType The type from which `bitwise_trie` inherits
+    \tparam ItemType The type of item indexed.
+
+    This accessor requires the following member variables in the trie index head type:
+
+    - `<unsigned type> trie_count`
+    - `<signed type> trie_children[8 * sizeof(<unsigned type>)]`
+    - `bool trie_nobbledir` (if you use equal nobbling only)
+    - `size_t trie_occupancy` (optional, lets searches skip empty bins with a bitscan)
+
+    Use with `offset_bitwise_trie_item_accessors` to place an index and all the items it
+    indexes into memory which may be relocated, such as a memory mapped file. So long as
+    the index and its items keep their relative positions, the index can be used wherever
+    that memory is mapped with no fix up.
+     */
+    template <class HeadBaseType, class ItemType> class offset_bitwise_trie_head_accessors
+    {
+      HeadBaseType *_v;
+      using _index_type = decltype(_v->trie_count);
+      static_assert(std::is_unsigned<_index_type>::value, "count type must be unsigned");
+      static constexpr size_t _index_type_bits = 8 * sizeof(_index_type);
+      using _child_array_type = decltype(_v->trie_children);
+      static_assert(std::extent<_child_array_type>::value >= _index_type_bits, "children array is not big enough");
+      using _key_type = decltype(declval<bitwise_trie_item_accessors<ItemType> *>()->key());
+      static_assert(std::extent<_child_array_type>::value >= 8 * sizeof(_key_type), "children array is not big enough for the key type");
+
+    public:
+      //! `lock_branch()` does nothing
+      static constexpr bool unlocked_branches = true;
+
+      constexpr offset_bitwise_trie_head_accessors(HeadBaseType *v)
+          : _v(v)
+      {
+      }
+      constexpr explicit operator bool() const noexcept { return _v != nullptr; }
+
+      constexpr _index_type size() const noexcept { return _v->trie_count; }
+      constexpr void incr_size() noexcept { ++_v->trie_count; }
+      constexpr void decr_size() noexcept { --_v->trie_count; }
+      constexpr void set_size(_index_type x) noexcept { _v->trie_count = x; }
+
+      constexpr _index_type max_size() const noexcept { return (_index_type) -1; }
+
+      const ItemType *child(unsigned idx) const noexcept
+      {
+        return detail::offset_ptr_get<const ItemType>(_v->trie_children[idx]);
+      }
+      ItemType *child(unsigned idx) noexcept { return detail::offset_ptr_get<ItemType>(_v->trie_children[idx]); }
+      void set_child(unsigned idx, ItemType *x) noexcept
+      {
+        detail::offset_ptr_set(_v->trie_children[idx], x);
+        detail::trie_occupancy<HeadBaseType>::set(_v, idx, x != nullptr);
+      }
+      //! Bit n is set if `child(n)` may be non-null
+      constexpr size_t occupancy() const noexcept { return detail::trie_occupancy<HeadBaseType>::get(_v); }
+
+      constexpr _index_type lock_branch(_key_type key, bool exclusive, unsigned bitidxhint = (unsigned) -1) const noexcept
+      {
+        (void) key;
+        (void) exclusive;
+        (void) bitidxhint;
+        return 0;
+      }
+      constexpr void unlock_branch(_index_type /*unused*/, bool /*unused*/) const noexcept {}
+
+      constexpr bool flip_nobbledir() noexcept { return (_v->trie_nobbledir = !_v->trie_nobbledir); }
+    };
+
+    /*! \class bitwise_trie_branch_lock
+    \brief A cache line sized reader-writer spinlock, one of which guards each top bit set bin
+    of a concurrently modified bitwise trie.
+
+    This meets the `SharedMutex` concept, so you can use `std::shared_mutex` in its place
+    if you would prefer that threads sleep rather than spin.
+    */
+    class alignas(64) bitwise_trie_branch_lock
+    {
+      // Bit 0 is held by the exclusive locker, the remaining bits count the shared lockers
+      std::atomic<unsigned> _v{0};
+
+    public:
+      bitwise_trie_branch_lock() = default;
+      bitwise_trie_branch_lock(const bitwise_trie_branch_lock &) = delete;
+      bitwise_trie_branch_lock &operator=(const bitwise_trie_branch_lock &) = delete;
+
+      bool try_lock() noexcept
+      {
+        unsigned expected = 0;
+        return _v.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed);
+      }
+      void lock() noexcept
+      {
+        unsigned spins = 0;
+        while(_v.load(std::memory_order_relaxed) != 0 || !try_lock())
+        {
+          detail::spin_pause(spins);
+        }
+      }
+      void unlock() noexcept { _v.fetch_sub(1, std::memory_order_release); }
+
+      bool try_lock_shared() noexcept
+      {
+        if(_v.fetch_add(2, std::memory_order_acquire) & 1)
+        {
+          _v.fetch_sub(2, std::memory_order_relaxed);
+          return false;
+        }
+        return true;
+      }
+      void lock_shared() noexcept
+      {
+        unsigned spins = 0;
+        while((_v.load(std::memory_order_relaxed) & 1) != 0 || !try_lock_shared())
+        {
+          detail::spin_pause(spins);
+        }
+      }
+      void unlock_shared() noexcept { _v.fetch_sub(2, std::memory_order_release); }
+    };
+
+    /*! \class bitwise_trie_branch_seqlock
+    \brief A cache line sized sequence lock which lets finds in a concurrently modified bitwise
+    trie proceed without writing to shared memory.
+
+    Writers take an exclusive spinlock, and increment the sequence count before and after
+    modifying the bin, so the count is odd whilst a modification is in progress. Optimistic
+    readers note the sequence count, traverse the bin without locking anything, and retry
+    if the sequence count changed in the meantime. Readers which cannot retry, such as
+    iteration, take the spinlock without changing the sequence count, so they exclude
+    writers and each other but never cause optimistic readers to retry.
+    */
+    class alignas(64) bitwise_trie_branch_seqlock
+    {
+      std::atomic<unsigned> _lock{0}, _seq{0};
+
+    public:
+      bitwise_trie_branch_seqlock() = default;
+      bitwise_trie_branch_seqlock(const bitwise_trie_branch_seqlock &) = delete;
+      bitwise_trie_branch_seqlock &operator=(const bitwise_trie_branch_seqlock &) = delete;
+
+      bool try_lock_shared() noexcept
+      {
+        unsigned expected = 0;
+        return _lock.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed);
+      }
+      void lock_shared() noexcept
+      {
+        unsigned spins = 0;
+        while(_lock.load(std::memory_order_relaxed) != 0 || !try_lock_shared())
+        {
+          detail::spin_pause(spins);
+        }
+      }
+      void unlock_shared() noexcept { _lock.store(0, std::memory_order_release); }
+
+      bool try_lock() noexcept
+      {
+        if(!try_lock_shared())
+        {
+          return false;
+        }
+        _seq.store(_seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return true;
+      }
+      void lock() noexcept
+      {
+        lock_shared();
+        _seq.store(_seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+      }
+      void unlock() noexcept
+      {
+        _seq.store(_seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        unlock_shared();
+      }
+
+      //! Begins an optimistic read, returning the sequence count to later validate against.
+      unsigned read_begin() const noexcept
+      {
+        unsigned ret, spins = 0;
+        while((ret = _seq.load(std::memory_order_acquire)) & 1)
+        {
+          detail::spin_pause(spins);
+        }
+        return ret;
+      }
+      //! True if no modification occurred since the optimistic read began.
+      bool read_validate(unsigned seq) const noexcept
+      {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return _seq.load(std::memory_order_relaxed) == seq;
+      }
+    };
+
+    /*! \class bitwise_trie_epoch_domain
+    \brief Epoch based deferred reclamation of items erased from a concurrently searched bitwise trie.
+    \tparam ItemType The type of item indexed.
+
+    Finds traversing a bin optimistically may still be reading an item's links after it has
+    been erased, so its storage cannot be reused immediately. If the index head has a
+    `trie_epochs` member of this type, every optimistic find is a read side critical
+    section, and `bitwise_trie::retire()` erases an item and hands it to a reclaim callback
+    only once every critical section which began before the erase has ended. Code which
+    keeps using items found beyond the find, or which iterates, can make its own critical
+    section with a `read_guard`, and critical sections may nest.
+
+    Readers entering and leaving a critical section touch only a counter in one of
+    `Slots` cache lines, chosen per thread, so readers on different threads mostly do not
+    contend. Writers never wait for readers: retired items are kept on a list, and each
+    `retire()` or `reclaim()` advances the epoch if no critical section remains from the
+    previous epoch, and calls the callbacks of those items retired two or more epochs ago.
+    The retire list is allocated from the heap. Should that fail, `retire()` instead waits
+    for every critical section in progress to end, and reclaims the item immediately.
+    */
+    template <class ItemType, size_t Slots = 64> class bitwise_trie_epoch_domain
+    {
+      struct alignas(64) _slot
+      {
+        std::atomic<size_t> readers[2]{{0}, {0}};  // critical sections in epochs of each parity
+      };
+      struct _retired
+      {
+        ItemType *item;
+        void (*reclaim)(ItemType *, void *);
+        void *context;
+        size_t epoch;
+      };
+      std::atomic<size_t> _epoch{0};
+      _slot _slots[Slots];
+      mutable std::atomic<unsigned> _lock{0};
+      std::vector<_retired> _list;
+      size_t _list_head{0};
+
+      static unsigned _my_slot() noexcept
+      {
+        static std::atomic<unsigned> next{0};
+        static thread_local unsigned slot = next.fetch_add(1, std::memory_order_relaxed) % Slots;
+        return slot;
+      }
+      void _acquire() const noexcept
+      {
+        unsigned spins = 0;
+        for(;;)
+        {
+          unsigned expected = 0;
+          if(_lock.compare_exchange_weak(expected, 1, std::memory_order_acquire, std::memory_order_relaxed))
+          {
+            return;
+          }
+          detail::spin_pause(spins);
+        }
+      }
+      void _release() const noexcept { _lock.store(0, std::memory_order_release); }
+      // Advances the epoch if no critical section remains from the previous epoch
+      bool _try_advance() noexcept
+      {
+        const size_t epoch = _epoch.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for(auto &i : _slots)
+        {
+          if(i.readers[(epoch + 1) & 1].load(std::memory_order_acquire) != 0)
+          {
+            return false;
+          }
+        }
+        _epoch.store(epoch + 1, std::memory_order_seq_cst);
+        return true;
+      }
+      // Removes up to n items which can now be reclaimed from the retire list. Lock must be held.
+      size_t _take_reclaimable(_retired *out, size_t n) noexcept
+      {
+        const size_t epoch = _epoch.load(std::memory_order_relaxed);
+        size_t ret = 0;
+        while(ret < n && _list_head < _list.size() && _list[_list_head].epoch + 2 <= epoch)
+        {
+          out[ret++] = _list[_list_head++];
+        }
+        if(_list_head == _list.size())
+        {
+          _list.clear();
+          _list_head = 0;
+        }
+        return ret;
+      }
+
+    public:
+      bitwise_trie_epoch_domain() = default;
+      bitwise_trie_epoch_domain(const bitwise_trie_epoch_domain &) = delete;
+      bitwise_trie_epoch_domain &operator=(const bitwise_trie_epoch_domain &) = delete;
+      //! Reclaims every item still retired. No critical section may be in progress.
+      ~bitwise_trie_epoch_domain()
+      {
+        for(size_t n = _list_head; n < _list.size(); n++)
+        {
+          _list[n].reclaim(_list[n].item, _list[n].context);
+        }
+      }
+
+      //! Enters a read side critical section, returning a token to pass to `read_leave()`.
+      unsigned read_enter() noexcept
+      {
+        const unsigned slot = _my_slot();
+        for(;;)
+        {
+          const size_t epoch = _epoch.load(std::memory_order_relaxed);
+          auto &readers = _slots[slot].readers[epoch & 1];
+          readers.fetch_add(1, std::memory_order_seq_cst);
+          // If the epoch advanced meanwhile, a writer may not have seen me, so go again
+          if(_epoch.load(std::memory_order_seq_cst) == epoch)
+          {
+            return (slot << 1) | (unsigned) (epoch & 1);
+          }
+          readers.fetch_sub(1, std::memory_order_relaxed);
+        }
+      }
+      //! Leaves a read side critical section.
+      void read_leave(unsigned token) noexcept { _slots[token >> 1].readers[token & 1].fetch_sub(1, std::memory_order_release); }
+
+      //! A read side critical section for the lifetime of the guard.
+      class read_guard
+      {
+        bitwise_trie_epoch_domain *_parent;
+        unsigned _token;
+
+      public:
+        explicit read_guard(bitwise_trie_epoch_domain &parent) noexcept
+            : _parent(&parent)
+            , _token(parent.read_enter())
+        {
+        }
+        read_guard(const read_guard &) = delete;
+        read_guard &operator=(const read_guard &) = delete;
+        ~read_guard() { _parent->read_leave(_token); }
+      };
+
+      /*! Arranges for `reclaim(item, context)` to be called once every critical section in
+      progress has ended. The item must already be unreachable by new finds.
+      */
+      void retire(ItemType *item, void (*reclaim)(ItemType *, void *), void *context = nullptr) noexcept
+      {
+        _acquire();
+        const _retired r{item, reclaim, context, _epoch.load(std::memory_order_relaxed)};
+#if __cpp_exceptions
+        try
+        {
+#endif
+          _list.push_back(r);
+#if __cpp_exceptions
+        }
+        catch(...)
+        {
+          _release();
+          synchronize();
+          reclaim(item, context);
+          return;
+        }
+#endif
+        _release();
+        this->reclaim();
+      }
+      //! Advances the epoch if possible, and calls the callbacks of items which can now be reclaimed.
+      void reclaim() noexcept
+      {
+        static constexpr size_t batch = 64;
+        _retired items[batch];
+        size_t n;
+        do
+        {
+          _acquire();
+          // Two advances suffice to make everything retired so far reclaimable
+          if(_try_advance())
+          {
+            _try_advance();
+          }
+          n = _take_reclaimable(items, batch);
+          _release();
+          for(size_t i = 0; i < n; i++)
+          {
+            items[i].reclaim(items[i].item, items[i].context);
+          }
+        } while(n == batch);
+      }
+      //! Waits until every critical section in progress has ended.
+      void synchronize() noexcept
+      {
+        unsigned spins = 0;
+        _acquire();
+        const size_t target = _epoch.load(std::memory_order_relaxed) + 2;
+        _release();
+        for(;;)
+        {
+          _acquire();
+          if(_epoch.load(std::memory_order_relaxed) < target)
+          {
+            _try_advance();
+          }
+          const bool done = _epoch.load(std::memory_order_relaxed) >= target;
+          _release();
+          if(done)
+          {
+            return;
+          }
+          detail::spin_pause(spins);
+        }
+      }
+      //! The number of items retired but not yet reclaimed.
+      size_t retired() const noexcept
+      {
+        _acquire();
+        const size_t ret = _list.size() - _list_head;
+        _release();
+        return ret;
+      }
+    };
+
+    /*! \class concurrent_bitwise_trie_head_accessors
+    \brief Accessor for a bitwise trie index head which may be modified and searched by many threads at once.
+    \tparam HeadBaseType The type from which `bitwise_trie` inherits
+    \tparam ItemType The type of item indexed.
+
+    Each top bit set bin in the index head gets its own reader-writer lock, so inserts,
+    removals and finds of keys whose topmost set bit differs proceed in parallel, and finds
+    of keys whose topmost set bit is the same proceed in parallel with one another.
+
+    This accessor requires the following member variables in the trie index head type:
+
+    - `std::atomic<<unsigned type>> trie_count`
+    - `ItemType *trie_children[8 * sizeof(<unsigned type>)]`
+    - `<SharedMutex type> trie_locks[8 * sizeof(<unsigned type>)]`, usually `bitwise_trie_branch_lock`
+    - `std::atomic<bool> trie_nobbledir` (if you use equal nobbling only)
+    - `std::atomic<size_t> trie_occupancy` (optional, lets searches skip empty bins without
+    locking them)
+    - `bitwise_trie_epoch_domain<ItemType> trie_epochs` (optional, enables `bitwise_trie::retire()`)
+
+    If the lock type is `bitwise_trie_branch_seqlock`, or anything else providing `read_begin()`
+    and `read_validate()`, finds take no lock at all. Instead they traverse the bin
+    optimistically, and retry if a writer modified the bin whilst they were traversing it.
+    This requires that erased items remain readable memory until all finds which might be
+    traversing them have completed, which `trie_epochs` can track for you.
+     */
+    template <class HeadBaseType, class ItemType> class concurrent_bitwise_trie_head_accessors
+    {
+      HeadBaseType *_v;
+      using _index_type = decltype(_v->trie_count.load());
+      static_assert(std::is_unsigned<_index_type>::value, "count type must be unsigned");
+      static constexpr size_t _index_type_bits = 8 * sizeof(_index_type);
+      using _child_array_type = decltype(_v->trie_children);
+      static_assert(sizeof(_child_array_type) / sizeof(void *) >= _index_type_bits, "children array is not big enough");
+      using _lock_type = typename std::remove_cv<typename std::remove_reference<decltype(_v->trie_locks[0])>::type>::type;
+      static_assert(sizeof(_v->trie_locks) / sizeof(_lock_type) >= _index_type_bits, "locks array is not big enough");
+      using _key_type = decltype(declval<bitwise_trie_item_accessors<ItemType> *>()->key());
+      static_assert(std::extent<_child_array_type>::value >= 8 * sizeof(_key_type), "children array is not big enough for the key type");
+      static_assert(std::extent<decltype(_v->trie_locks)>::value >= 8 * sizeof(_key_type), "locks array is not big enough for the key type");
+
+      // Locking does not modify the index, so it is permitted on a const head
+      _lock_type &_lock(unsigned idx) const noexcept { return const_cast<_lock_type &>(_v->trie_locks[idx]); }
+
+    public:
+      constexpr concurrent_bitwise_trie_head_accessors(HeadBaseType *v)
+          : _v(v)
+      {
+      }
+      constexpr explicit operator bool() const noexcept { return _v != nullptr; }
+
+      _index_type size() const noexcept { return _v->trie_count.load(std::memory_order_relaxed); }
+      void incr_size() noexcept { _v->trie_count.fetch_add(1, std::memory_order_relaxed); }
+      void decr_size() noexcept { _v->trie_count.fetch_sub(1, std::memory_order_relaxed); }
+      void set_size(_index_type x) noexcept { _v->trie_count.store(x, std::memory_order_relaxed); }
+
+      constexpr _index_type max_size() const noexcept { return (_index_type) -1; }
+
+      const ItemType *child(unsigned idx) const noexcept
+      {
+        assert(idx <= _index_type(-1));
+        return detail::link_load(_v->trie_children[idx]);
+      }
+      ItemType *child(unsigned idx) noexcept
+      {
+        assert(idx <= _index_type(-1));
+        return detail::link_load(_v->trie_children[idx]);
+      }
+      void set_child(unsigned idx, ItemType *x) noexcept
+      {
+        assert(idx <= _index_type(-1));
+        detail::link_store(_v->trie_children[idx], x);
+        detail::trie_occupancy<HeadBaseType>::set(_v, idx, x != nullptr);
+      }
+      //! Bit n is set if `child(n)` may be non-null. Only a hint until the bin's lock is held.
+      size_t occupancy() const noexcept { return detail::trie_occupancy<HeadBaseType>::get(_v); }
+
+      template <class KeyType>
+      unsigned lock_branch(KeyType key, bool exclusive, unsigned bitidxhint = (unsigned) -1) const noexcept
+      {
+        const unsigned bitidx = (bitidxhint != (unsigned) -1) ? bitidxhint : detail::bitscanr(key);
+        if(exclusive)
+        {
+          _lock(bitidx).lock();
+        }
+        else
+        {
+          _lock(bitidx).lock_shared();
+        }
+        return bitidx;
+      }
+      void unlock_branch(unsigned bitidx, bool exclusive) const noexcept
+      {
+        if(exclusive)
+        {
+          _lock(bitidx).unlock();
+        }
+        else
+        {
+          _lock(bitidx).unlock_shared();
+        }
+      }
+
+      template <class KeyType, class L = _lock_type>
+      auto optimistic_lock_branch(KeyType key, unsigned bitidxhint = (unsigned) -1) const noexcept
+      -> std::pair<unsigned, decltype(declval<const L &>().read_begin())>
+      {
+        const unsigned bitidx = (bitidxhint != (unsigned) -1) ? bitidxhint : detail::bitscanr(key);
+        return {bitidx, _lock(bitidx).read_begin()};
+      }
+      template <class Token> bool optimistic_unlock_branch(const Token &token) const noexcept
+      {
+        return _lock(token.first).read_validate(token.second);
+      }
+
+      //! The epoch domain of the index, if the head has one. Readers modify it, so it is never const.
+      template <class H = HeadBaseType>
+      auto epochs() const noexcept -> typename std::remove_cv<decltype(declval<H *>()->trie_epochs)>::type *
+      {
+        using type = typename std::remove_cv<decltype(declval<H *>()->trie_epochs)>::type;
+        return const_cast<type *>(&_v->trie_epochs);
+      }
+
+      bool flip_nobbledir() noexcept
+      {
+        // Racing flips merely perturb the nobble distribution, so this need not be a single atomic op
+        const bool ret = !_v->trie_nobbledir.load(std::memory_order_relaxed);
+        _v->trie_nobbledir.store(ret, std::memory_order_relaxed);
+        return ret;
+      }
+    };
+
+    /*! \class bitwise_trie
+    \brief Never-allocating in-place bitwise Fredkin trie index head type.
+    \tparam Base The base type from which to inherit (and thus overlay the index member functions).
+    \tparam ItemType The type of item indexed.
+    \tparam NobbleDir -1 to nobble zeros, +1 to nobble ones, 0 to nobble both equally (see below).
+    \tparam HeadAccessors The accessor type for the index head, `bitwise_trie_head_accessors` by default.
+
+    This uses the bitwise Fredkin trie algorithm to index a collection of items by an unsigned
+    integral key (e.g. a `size_t` from `std::hash`), providing identical O(log2 N) time insertion,
     removal, and finds (i.e. insert, remove and find all take identical time). It is thus most like a
     red-black tree. However it has a number of very useful characteristics which make
     it invaluable in certain use cases.
@@ -440,6 +1649,7 @@ namespace algorithm
       - `<unsigned type> trie_count`
       - `ItemType *trie_children[8 * sizeof(<unsigned type>)]`
       - `bool trie_nobbledir` (if you use equal nobbling only)
+      - `size_t trie_occupancy` (optional, lets searches skip empty bins with a bitscan)
 
     - The default `bitwise_trie_item_accessors<ItemType>` requires the following member
     variables in the trie item type:
@@ -448,15 +1658,56 @@ namespace algorithm
       - `ItemType *trie_child[2]`
       - `ItemType *trie_sibling[2]` (if you allow multiple items with the same key value only)
       - `KeyType trie_key`
+      - `static constexpr bool trie_inline_duplicates() { return true; }` (optional, instead of `trie_sibling`)
+      - `size_t trie_subtree_count` (optional, enables `rank()` and `select()`)
 
     Again, I stress that the above can be completely customised and packed tighter with
-    custom accessor type specialisations for your type. The tigher you can pack your
-    structures, the more fits into L3 cache, and the faster everything goes. You can
-    also store these in a file, and store offset pointers which are safe when a
-    memory map relocates in memory.
+    custom accessor type specialisations for your type, or with your own accessor types
+    passed as the `HeadAccessors` and `ItemAccessors` template parameters. The tigher you
+    can pack your structures, the more fits into L3 cache, and the faster everything goes.
+
+    If duplicate keys are rare, the two sibling links are mostly dead weight in every item.
+    Leave out `trie_sibling` and declare `trie_inline_duplicates` in your item type, and items
+    with a key already present are stored as ordinary nodes further down that key's path
+    instead, so each item carries only its parent and two children. `find()` returns the
+    highest of them, `count()` walks the key's path, and iteration visits them all but not
+    necessarily one after another. At most three times as many items as there are key bits
+    (96 for a 32 bit key) are stored per key in this mode; `insert()` returns the existing
+    item for any more, as it does for a duplicate when duplicates are not stored.
+
+    `compact_bitwise_trie_item_accessors` stores links as indices into an array of items,
+    which with 32 bit indices halves the housekeeping per item on 64 bit systems.
+
+    You can also store these in a file. `offset_bitwise_trie_head_accessors` and
+    `offset_bitwise_trie_item_accessors` store self relative offsets instead of pointers,
+    so an index and its items built into a file can be memory mapped at any address, and
+    used immediately with no deserialisation.
+
+    Keys need not fit into a native integer. `unsigned __int128` works where the compiler
+    has it, and `bitwise_trie_wide_key<Bytes>` gives an unsigned key of any multiple of eight
+    bytes, so UUIDs and content hashes can be indexed whole. The head then needs one child
+    per key bit, so `trie_children[128]` for a 128 bit key. Finds walk wide keys a word at a
+    time, so cost is dominated by the extra bytes per item rather than by key arithmetic.
+
+    Close and closest fit finds come in both directions. `find_equal_or_larger()` and
+    `find_equal_or_next_largest()` find an item whose key is larger or equal to the key
+    sought, and `find_equal_or_smaller()` and `find_equal_or_next_smallest()` one whose
+    key is smaller or equal, e.g. the largest free block no bigger than a size.
+
+    If items keep a `trie_subtree_count`, every item counts the items in the subtree below
+    it, and `rank()` returns how many items have a smaller key than some key and `select()`
+    the item with the n-th smallest key, both in `O(depth)`. Keeping the counts costs a
+    walk back up the branch on every insert and erase, so leave the member out of items
+    which don't need it, and nothing is maintained.
 
-    Close and closest fit finds always find an item whose key is larger or equal to
-    the key sought. Lower bound is not implemented yet.
+    `merge()` moves all the items of one index into another, and `split_at_key()` moves all
+    items with a key from some key upwards into another index. Top bit bins which only one
+    side populates are moved whole rather than item by item, so rebalancing indices whose
+    keys mostly fall into different bins costs little more than `O(bins)`.
+
+    `bulk_build()` inserts an array of items using many threads, each building the subtrees
+    of different parts of the key space, and `parallel_for_each()` visits every item using
+    many threads, which steal subtrees from one another to keep busy.
 
     Most of this implementation is lifted from https://github.com/ned14/nedtries, but
     it has been modernised for current C++ idomatic practice.
@@ -488,30 +1739,50 @@ namespace algorithm
     results from a pointer, or is some number which clusters on regular even boundaries,
     choose `NobbleDir = -1`.
 
-    \todo Implement `lower_bound()`.
+    ### Concurrency
+
+    With the default head accessor, the index is no more thread safe than any STL container.
+    If you choose `concurrent_bitwise_trie_head_accessors` for `HeadAccessors`, each top bit
+    set bin of the index gets its own reader-writer lock, and `insert()`, `erase()`, `find()`,
+    `contains()`, `find_equal_or_larger()` and their variants become safe to call from many
+    threads at once. Modifications of keys whose topmost set bit differs then proceed in
+    parallel. Iterating is safe so long as no other thread erases the item currently
+    referred to, but `clear()`, `swap()` and copying are not safe against concurrent
+    modification.
+
+    If the lock type in the index head is `bitwise_trie_branch_seqlock`, finds write nothing
+    to shared memory at all. They traverse the bin optimistically, and retry if a writer
+    modified that bin in the meantime, which scales much better for read mostly workloads.
+    You must then not reuse the storage of an erased item until all finds which might be
+    traversing it have completed. Adding a `bitwise_trie_epoch_domain` to the index head
+    tracks that for you, whereupon `retire()` erases an item and hands it back to a callback
+    once no find can be traversing it.
     */
-    template <class Base, class ItemType, int NobbleDir = 0> class bitwise_trie : public Base
+    template <class Base, class ItemType, int NobbleDir = 0,
+              template <class, class> class HeadAccessors = bitwise_trie_head_accessors,
+              template <class> class ItemAccessors = bitwise_trie_item_accessors>
+    class bitwise_trie : public Base
     {
-      constexpr bitwise_trie_head_accessors<const Base, const ItemType> _head_accessors() const noexcept
+      constexpr HeadAccessors<const Base, const ItemType> _head_accessors() const noexcept
       {
-        return bitwise_trie_head_accessors<const Base, const ItemType>(this);
+        return HeadAccessors<const Base, const ItemType>(this);
       }
-      constexpr bitwise_trie_head_accessors<Base, ItemType> _head_accessors() noexcept
+      constexpr HeadAccessors<Base, ItemType> _head_accessors() noexcept
       {
-        return bitwise_trie_head_accessors<Base, ItemType>(this);
+        return HeadAccessors<Base, ItemType>(this);
       }
 
-      static constexpr bitwise_trie_item_accessors<const ItemType> _item_accessors(const ItemType *item) noexcept
+      static constexpr ItemAccessors<const ItemType> _item_accessors(const ItemType *item) noexcept
       {
-        return bitwise_trie_item_accessors<const ItemType>(item);
+        return ItemAccessors<const ItemType>(item);
       }
-      static constexpr bitwise_trie_item_accessors<ItemType> _item_accessors(ItemType *item) noexcept
+      static constexpr ItemAccessors<ItemType> _item_accessors(ItemType *item) noexcept
       {
-        return bitwise_trie_item_accessors<ItemType>(item);
+        return ItemAccessors<ItemType>(item);
       }
-      template <class T> static constexpr bitwise_trie_item_accessors<T> _null_item_accessors(T * /*unused*/) noexcept
+      template <class T> static constexpr ItemAccessors<T> _null_item_accessors(T * /*unused*/) noexcept
       {
-        return bitwise_trie_item_accessors<T>(nullptr);
+        return ItemAccessors<T>(nullptr);
       }
 
     public:
@@ -522,7 +1793,7 @@ namespace algorithm
       //! The value type
       using value_type = ItemType *;
       //! The size type
-      using size_type = decltype(bitwise_trie_head_accessors<const Base, const ItemType>(nullptr).size());
+      using size_type = decltype(HeadAccessors<const Base, const ItemType>(nullptr).size());
       //! The type of a difference between pointers to the type of item indexed
       using difference_type = ptrdiff_t;
       //! A reference to the type of item indexed
@@ -538,7 +1809,7 @@ namespace algorithm
 
     private:
       static constexpr unsigned _key_type_bits = (unsigned) (8 * sizeof(key_type));
-      static_assert(std::is_unsigned<key_type>::value, "key type must be unsigned");
+      static_assert(detail::is_unsigned_key<key_type>::value, "key type must be unsigned");
       static_assert(std::is_unsigned<size_type>::value, "head_accessor size type must be unsigned");
 
       bool _to_nobble() noexcept
@@ -546,26 +1817,153 @@ namespace algorithm
         return detail::nobble_function_implementation<nobble_direction>()(_head_accessors());
       }
 
+      static constexpr bool _inline_duplicates = detail::has_inline_duplicates<typename std::remove_cv<ItemType>::type>::value;
+
+      static constexpr bool _subtree_counts = detail::has_subtree_count<ItemAccessors<const ItemType>>::value;
+      static size_t _subtree_count(const_pointer node, std::true_type /*unused*/) noexcept
+      {
+        return (nullptr != node) ? _item_accessors(node).subtree_count() : 0;
+      }
+      static constexpr size_t _subtree_count(const_pointer /*unused*/, std::false_type /*unused*/) noexcept { return 0; }
+      static size_t _subtree_count(const_pointer node) noexcept
+      {
+        return _subtree_count(node, std::integral_constant<bool, _subtree_counts>());
+      }
+      static void _set_subtree_count(pointer node, size_t x, std::true_type /*unused*/) noexcept
+      {
+        _item_accessors(node).set_subtree_count(x);
+      }
+      static void _set_subtree_count(pointer /*unused*/, size_t /*unused*/, std::false_type /*unused*/) noexcept {}
+      static void _set_subtree_count(pointer node, size_t x) noexcept
+      {
+        _set_subtree_count(node, x, std::integral_constant<bool, _subtree_counts>());
+      }
+      // Adds to or subtracts from the subtree count of node and each of its ancestors before stop
+      static void _adjust_subtree_counts(pointer node, pointer stop, bool incr, size_t by = 1) noexcept
+      {
+        if(!_subtree_counts)
+        {
+          return;
+        }
+        while(node != stop)
+        {
+          auto nodelink = _item_accessors(node);
+          _set_subtree_count(node, incr ? _subtree_count(node) + by : _subtree_count(node) - by);
+          if(nodelink.parent_is_index())
+          {
+            break;
+          }
+          node = nodelink.parent();
+        }
+      }
+
+      static constexpr unsigned _occupancy_bits = (unsigned) (8 * sizeof(size_t));
+      size_t _occupancy(std::true_type /*unused*/) const noexcept { return _head_accessors().occupancy(); }
+      static constexpr size_t _occupancy(std::false_type /*unused*/) noexcept { return (size_t) -1; }
+      size_t _occupancy() const noexcept
+      {
+        return _occupancy(detail::has_occupancy<HeadAccessors<const Base, const ItemType>>());
+      }
+      // The first bin at or above idx which may be occupied, or at least _key_type_bits if none
+      unsigned _next_bin(unsigned idx) const noexcept
+      {
+        // Bins beyond the occupancy word are always visited
+        if(idx >= _occupancy_bits)
+        {
+          return idx;
+        }
+        const size_t occupied = _occupancy() & ((size_t) -1 << idx);
+        return (occupied != 0) ? detail::bitscanf(occupied) : _occupancy_bits;
+      }
+      // The last bin at or below idx which may be occupied, or (unsigned) -1 if none
+      unsigned _prev_bin(unsigned idx) const noexcept
+      {
+        if(idx >= _occupancy_bits)
+        {
+          return idx;
+        }
+        const size_t occupied = _occupancy() & (((size_t) 2 << idx) - 1);
+        return (occupied != 0) ? detail::bitscanr(occupied) : (unsigned) -1;
+      }
+
       struct _lock_unlock_branch
       {
         const bitwise_trie *_parent{nullptr};
         bool _exclusive{false};
-        decltype(bitwise_trie_head_accessors<const Base, const ItemType>(nullptr).lock_branch((key_type) 0, 0)) _v;
+        decltype(HeadAccessors<const Base, const ItemType>(nullptr).lock_branch((key_type) 0, false)) _v;
         _lock_unlock_branch(const bitwise_trie *parent, key_type key, bool exclusive,
                             unsigned bitidxhint = (unsigned) -1) noexcept
             : _parent(parent)
             , _exclusive(exclusive)
-            , _v(parent->_head_accessors().lock_branch(key, bitidxhint))
+            , _v(parent->_head_accessors().lock_branch(key, exclusive, bitidxhint))
+        {
+        }
+        _lock_unlock_branch(const _lock_unlock_branch &) = delete;
+        _lock_unlock_branch &operator=(const _lock_unlock_branch &) = delete;
+        ~_lock_unlock_branch()
+        {
+          if(_parent != nullptr)
+          {
+            _parent->_head_accessors().unlock_branch(_v, _exclusive);
+          }
+        }
+      };
+
+      /* Runs f with the bin bitidx read locked. If the head accessors support optimistic reads,
+      f runs without locking anything, and is rerun if a writer modified the bin during the
+      read. f must therefore be free of side effects, and must return early rather than follow
+      links which could only be broken by a concurrent modification.
+      */
+      static constexpr unsigned _max_traversal_steps = 4 * _key_type_bits + 4;
+      /* At most this many inline duplicates of a key are stored. A key's path has at most
+      _key_type_bits - 1 nodes of other keys above its last key bit, so at this cap every path
+      stays within _max_traversal_steps. */
+      static constexpr unsigned _max_inline_duplicates = 3 * _key_type_bits;
+      // Optimistic reads are critical sections of the head's epoch domain, if it has one
+      template <class H = HeadAccessors<const Base, const ItemType>, bool = detail::has_epochs<H>::value> struct _epoch_guard
+      {
+        constexpr explicit _epoch_guard(const bitwise_trie * /*unused*/) noexcept {}
+      };
+      template <class H> struct _epoch_guard<H, true>
+      {
+        decltype(declval<const H &>().epochs()) _domain;
+        unsigned _token;
+        explicit _epoch_guard(const bitwise_trie *parent) noexcept
+            : _domain(parent->_head_accessors().epochs())
+            , _token(_domain->read_enter())
         {
         }
-        ~_lock_unlock_branch()
+        _epoch_guard(const _epoch_guard &) = delete;
+        _epoch_guard &operator=(const _epoch_guard &) = delete;
+        ~_epoch_guard() { _domain->read_leave(_token); }
+      };
+      template <class F>
+      auto _read_branch(key_type key, unsigned bitidx, F &&f, std::false_type /*unused*/) const noexcept -> decltype(f())
+      {
+        _lock_unlock_branch lock_unlock(this, key, false, bitidx);
+        return f();
+      }
+      template <class F>
+      auto _read_branch(key_type key, unsigned bitidx, F &&f, std::true_type /*unused*/) const noexcept -> decltype(f())
+      {
+        auto head = _head_accessors();
+        _epoch_guard<> epoch_guard(this);
+        for(;;)
         {
-          if(_parent != nullptr)
+          auto token = head.optimistic_lock_branch(key, bitidx);
+          auto ret = f();
+          if(head.optimistic_unlock_branch(token))
           {
-            _parent->_head_accessors().unlock_branch(_v, _exclusive);
+            return ret;
           }
         }
-      };
+      }
+      template <class F> auto _read_branch(key_type key, unsigned bitidx, F &&f) const noexcept -> decltype(f())
+      {
+        return _read_branch(
+        key, bitidx, static_cast<F &&>(f),
+        detail::has_optimistic_lock_branch<const HeadAccessors<const Base, const ItemType>, key_type>());
+      }
 
       const_pointer _triemin() const noexcept
       {
@@ -575,10 +1973,15 @@ namespace algorithm
         {
           return nullptr;
         }
-        for(unsigned bitidx = 0; bitidx < _key_type_bits && nullptr == (node = head.child(bitidx)); bitidx++)
-          ;
-        assert(node != nullptr);
-        return node;
+        for(unsigned bitidx = _next_bin(0); bitidx < _key_type_bits; bitidx = _next_bin(bitidx + 1))
+        {
+          _lock_unlock_branch lock_unlock(this, (key_type) 0, false, bitidx);
+          if(nullptr != (node = head.child(bitidx)))
+          {
+            return node;
+          }
+        }
+        return nullptr;
       }
       pointer _triemin() noexcept { return const_cast<pointer>(static_cast<const bitwise_trie *>(this)->_triemin()); }
       const_pointer _triemax() const noexcept
@@ -589,26 +1992,40 @@ namespace algorithm
         {
           return nullptr;
         }
-        unsigned bitidx = _key_type_bits - 1;
-        for(; bitidx < _key_type_bits && nullptr == (node = head.child(bitidx)); bitidx--)
-          ;
-        assert(node != nullptr);
-        auto nodelink = _item_accessors(node);
-        _lock_unlock_branch lock_unlock(this, nodelink.key(), false, bitidx);
-        while(nullptr != (child = (nodelink.child(true) != nullptr) ? nodelink.child(true) : nodelink.child(false)))
-        {
-          node = child;
-          nodelink = _item_accessors(node);
-        }
-        /* Now go to end leaf */
-        if(nodelink.sibling(false) != node)
+        for(unsigned bitidx = _prev_bin(_key_type_bits - 1); bitidx < _key_type_bits; bitidx = _prev_bin(bitidx - 1))
         {
-          return nodelink.sibling(false);
+          _lock_unlock_branch lock_unlock(this, (key_type) 0, false, bitidx);
+          if(nullptr == (node = head.child(bitidx)))
+          {
+            continue;
+          }
+          auto nodelink = _item_accessors(node);
+          while(nullptr != (child = (nodelink.child(true) != nullptr) ? nodelink.child(true) : nodelink.child(false)))
+          {
+            node = child;
+            nodelink = _item_accessors(node);
+          }
+          /* Now go to end leaf */
+          if(nodelink.sibling(false) != node)
+          {
+            return nodelink.sibling(false);
+          }
+          return node;
         }
-        return node;
+        return nullptr;
       }
       pointer _triemax() noexcept { return const_cast<pointer>(static_cast<const bitwise_trie *>(this)->_triemax()); }
 
+      static void _reset_links(pointer r) noexcept
+      {
+        auto rlink = _item_accessors(r);
+        rlink.set_parent(nullptr);
+        rlink.set_child(false, nullptr);
+        rlink.set_child(true, nullptr);
+        rlink.set_sibling(false, r);
+        rlink.set_sibling(true, r);
+        _set_subtree_count(r, 1);
+      }
       pointer _trieinsert(pointer r) noexcept
       {
         auto head = _head_accessors();
@@ -618,19 +2035,14 @@ namespace algorithm
         }
 
         pointer node = nullptr;
-        auto nodelink = _item_accessors(node);
         auto rlink = _item_accessors(r);
         key_type rkey = rlink.key();
 
-        rlink.set_parent(nullptr);
-        rlink.set_child(false, nullptr);
-        rlink.set_child(true, nullptr);
-        rlink.set_sibling(false, r);
-        rlink.set_sibling(true, r);
+        _reset_links(r);
         unsigned bitidx = detail::bitscanr(rkey);
-        /* Avoid unknown bit shifts where possible, their performance can suck */
-        key_type keybit = (key_type) 1 << bitidx;
+        detail::keybit_cursor<key_type> keybit(bitidx);
         assert(bitidx < _key_type_bits);
+        _lock_unlock_branch lock_unlock(this, rkey, true, bitidx);
         if(nullptr == (node = head.child(bitidx)))
         { /* Set parent is index flag */
           rlink.set_parent_is_index(bitidx);
@@ -638,12 +2050,57 @@ namespace algorithm
           head.incr_size();
           return r;
         }
-        _lock_unlock_branch lock_unlock(this, rkey, true, bitidx);
+        node = _trieinsert_below(node, r, keybit);
+        if(node == r)
+        {
+          head.incr_size();
+        }
+        return node;
+      }
+      /* Inserts r, whose links have been reset, into the subtree below node, where keybit is at
+      node's level. Subtree counts are only maintained within that subtree. Returns r, or the
+      item already holding r's key if r could not be stored as a duplicate of it. */
+      static pointer _trieinsert_below(pointer node, pointer r, detail::keybit_cursor<key_type> keybit) noexcept
+      {
+        auto nodelink = _item_accessors(node);
+        auto rlink = _item_accessors(r);
+        const key_type rkey = rlink.key();
+        const pointer stop = nodelink.parent_is_index() ? nullptr : nodelink.parent();
+        // Inline duplicates of rkey above node, and the highest of them, count towards the cap
+        unsigned duplicates = 0;
+        pointer firstduplicate = nullptr;
+        if(_inline_duplicates)
+        {
+          for(pointer above = stop; above != nullptr;)
+          {
+            auto abovelink = _item_accessors(above);
+            if(abovelink.key() == rkey)
+            {
+              duplicates++;
+              firstduplicate = above;
+            }
+            above = abovelink.parent_is_index() ? nullptr : abovelink.parent();
+          }
+        }
         for(pointer childnode = nullptr;; node = childnode)
         {
           nodelink = _item_accessors(node);
           key_type nodekey = nodelink.key();
-          if(nodekey == rkey)
+          // Count r into every subtree it will be in on the way down, while they are in cache
+          _set_subtree_count(node, _subtree_count(node) + 1);
+          if(nodekey == rkey && _inline_duplicates)
+          {
+            if(nullptr == firstduplicate)
+            {
+              firstduplicate = node;
+            }
+            if(++duplicates >= _max_inline_duplicates)
+            {
+              _adjust_subtree_counts(node, stop, false);
+              return firstduplicate;
+            }
+          }
+          if(nodekey == rkey && !_inline_duplicates)
           { /* Insert into end of ring list */
 #if 0
             {
@@ -678,6 +2135,7 @@ namespace algorithm
             rlink.set_is_secondary_sibling();
             if(!rlink.set_sibling(true, node))
             {
+              _adjust_subtree_counts(node, stop, false);
               return node;
             }
             auto *newest_sibling = nodelink.sibling(false);
@@ -742,21 +2200,247 @@ namespace algorithm
               assert(left == right);
             }
 #endif
-            break;
+            return r;
           }
-          keybit >>= 1;
-          const bool keybitset = !!(rkey & keybit);
+          keybit.next();
+          const bool keybitset = keybit.test(rkey);
           childnode = nodelink.child(keybitset);
           if(nullptr == childnode)
           { /* Insert here */
             rlink.set_parent(node);
             rlink.set_is_primary_sibling();
             nodelink.set_child(keybitset, r);
-            break;
+            return r;
+          }
+        }
+      }
+
+      /* Runs f(n) for each n in [0, threads), all but f(0) on threads of their own. Should a
+      thread not be creatable, its f(n) is run by the calling thread instead. */
+      template <class F> static void _for_each_worker(unsigned threads, F &&f)
+      {
+        std::vector<std::thread> workers;
+        unsigned n = 1;
+#if __cpp_exceptions
+        try
+        {
+#endif
+          workers.reserve(threads - 1);
+          for(; n < threads; n++)
+          {
+            workers.emplace_back([&f, n] { f(n); });
+          }
+#if __cpp_exceptions
+        }
+        catch(...)
+        {
+        }
+#endif
+        for(unsigned i = n; i < threads; i++)
+        {
+          f(i);
+        }
+        f(0);
+        for(auto &i : workers)
+        {
+          i.join();
+        }
+      }
+      /* A bulk build bucket holds the items of a bin whose first kbits bits below the top bit
+      are path. Their subtree hangs from root, so buckets can be built independently. */
+      struct _bulk_build_bucket
+      {
+        size_t begin{0}, end{0};  // the items not yet inserted
+        size_t deferred{0};       // [begin, deferred) must be inserted serially afterwards
+        size_t inserted{0};
+        unsigned bitidx{0}, kbits{0}, path{0};
+        pointer root{nullptr};
+      };
+      // The node at the end of a bucket's path, or null if it does not exist yet
+      pointer _bulk_build_root(const _bulk_build_bucket &bucket) noexcept
+      {
+        pointer node = _head_accessors().child(bucket.bitidx);
+        for(unsigned n = bucket.kbits; n > 0 && node != nullptr; n--)
+        {
+          node = _item_accessors(node).child(((bucket.path >> (n - 1)) & 1) != 0);
+        }
+        return node;
+      }
+      /* A queue of subtrees waiting to be walked by parallel_for_each(). Its owner pushes and
+      pops at the back, other threads steal from the front. Subtrees are only pushed when the
+      queue is empty, apart from the bin roots it starts with, so it never holds more than
+      one per bin. */
+      struct alignas(64) _parallel_queue
+      {
+        std::atomic<unsigned> lock{0};
+        std::atomic<unsigned> count{0};
+        unsigned head{0}, tail{0};
+        const_pointer subtrees[_key_type_bits + 1];
+
+        void acquire() noexcept
+        {
+          unsigned spins = 0;
+          for(unsigned expected = 0; !lock.compare_exchange_weak(expected, 1, std::memory_order_acquire, std::memory_order_relaxed);
+              expected = 0)
+          {
+            detail::spin_pause(spins);
+          }
+        }
+        void release() noexcept { lock.store(0, std::memory_order_release); }
+        void push(const_pointer node) noexcept
+        {
+          acquire();
+          if(head == tail)
+          {
+            head = tail = 0;
+          }
+          assert(tail < _key_type_bits + 1);
+          subtrees[tail++] = node;
+          count.store(tail - head, std::memory_order_relaxed);
+          release();
+        }
+        const_pointer pop(bool steal) noexcept
+        {
+          if(0 == count.load(std::memory_order_relaxed))
+          {
+            return nullptr;
+          }
+          acquire();
+          const_pointer ret = nullptr;
+          if(head != tail)
+          {
+            ret = steal ? subtrees[head++] : subtrees[--tail];
+            count.store(tail - head, std::memory_order_relaxed);
+          }
+          release();
+          return ret;
+        }
+      };
+      /* Walks subtrees taken from the queues, own queue first, calling f on every item until
+      no subtree remains anywhere. The walk is depth first with an explicit stack. Whilst some
+      thread has run out of work, the shallowest, and so probably largest, subtree pending on
+      the stack is handed over to the own queue for stealing. */
+      template <class F>
+      static size_type _parallel_walk(_parallel_queue *queues, unsigned threads, unsigned t, std::atomic<size_t> &outstanding,
+                                      std::atomic<unsigned> &hungry, F &f) noexcept
+      {
+        size_type count = 0;
+        const_pointer stack[_key_type_bits + 2];
+        bool is_hungry = false;
+        for(;;)
+        {
+          const_pointer node = queues[t].pop(false);
+          for(unsigned i = 1; nullptr == node && i < threads; i++)
+          {
+            node = queues[(t + i) % threads].pop(true);
+          }
+          if(nullptr == node)
+          {
+            if(0 == outstanding.load(std::memory_order_acquire))
+            {
+              break;
+            }
+            if(!is_hungry)
+            {
+              hungry.fetch_add(1, std::memory_order_relaxed);
+              is_hungry = true;
+            }
+            std::this_thread::yield();
+            continue;
+          }
+          if(is_hungry)
+          {
+            hungry.fetch_sub(1, std::memory_order_relaxed);
+            is_hungry = false;
+          }
+          unsigned lo = 0, sp = 0;
+          stack[sp++] = node;
+          while(sp > lo)
+          {
+            node = stack[--sp];
+            auto nodelink = _item_accessors(node);
+            const_pointer sibling = node;
+            do
+            {
+              f(sibling);
+              ++count;
+              sibling = _item_accessors(sibling).sibling(true);
+            } while(sibling != node);
+            assert(sp + 2 <= _key_type_bits + 2);
+            if(nodelink.child(true) != nullptr)
+            {
+              stack[sp++] = nodelink.child(true);
+            }
+            if(nodelink.child(false) != nullptr)
+            {
+              stack[sp++] = nodelink.child(false);
+            }
+            if(sp - lo >= 2 && hungry.load(std::memory_order_relaxed) > 0 && 0 == queues[t].count.load(std::memory_order_relaxed))
+            {
+              outstanding.fetch_add(1, std::memory_order_relaxed);
+              queues[t].push(stack[lo++]);
+            }
+          }
+          outstanding.fetch_sub(1, std::memory_order_release);
+        }
+        if(is_hungry)
+        {
+          hungry.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return count;
+      }
+
+      // Below this many items per thread, starting threads costs more than it saves
+      static constexpr size_t _min_items_per_thread = 4096;
+      // Shared by both overloads of parallel_for_each(), with f taking a const_pointer
+      template <class F> size_type _parallel_for_each(F &&f, unsigned threads) const
+      {
+        auto head = _head_accessors();
+        if(0 == threads)
+        {
+          threads = std::thread::hardware_concurrency();
+        }
+        if(threads > head.size() / _min_items_per_thread)
+        {
+          threads = (unsigned) (head.size() / _min_items_per_thread);
+        }
+        if(threads < 1)
+        {
+          threads = 1;
+        }
+        std::vector<_parallel_queue> queues(threads);
+        std::atomic<size_t> outstanding(0);
+        std::atomic<unsigned> hungry(0);
+        for(unsigned bitidx = _next_bin(0), n = 0; bitidx < _key_type_bits; bitidx = _next_bin(bitidx + 1))
+        {
+          if(head.child(bitidx) != nullptr)
+          {
+            // Owners pop from the back, so each starts on the largest of its bins
+            queues[n++ % threads].push(head.child(bitidx));
+            outstanding.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+        std::atomic<size_type> count(0);
+        _for_each_worker(threads, [&](unsigned t) noexcept {
+          count.fetch_add(_parallel_walk(queues.data(), threads, t, outstanding, hungry, f), std::memory_order_relaxed);
+        });
+        return count.load(std::memory_order_relaxed);
+      }
+
+      // True if a node above a bucket's root has the key
+      bool _bulk_build_above(const _bulk_build_bucket &bucket, key_type rkey) const noexcept
+      {
+        const_pointer node = _head_accessors().child(bucket.bitidx);
+        for(unsigned n = bucket.kbits; n > 0; n--)
+        {
+          auto nodelink = _item_accessors(node);
+          if(nodelink.key() == rkey)
+          {
+            return true;
           }
+          node = nodelink.child(((bucket.path >> (n - 1)) & 1) != 0);
         }
-        head.incr_size();
-        return r;
+        return false;
       }
 
       void _trieremove(pointer r) noexcept
@@ -766,7 +2450,7 @@ namespace algorithm
         pointer node = nullptr;
         auto nodelink = _item_accessors(node);
         auto rlink = _item_accessors(r);
-        _lock_unlock_branch lock_unlock(this, rlink.key(), true);
+        _lock_unlock_branch lock_unlock(this, rlink.key(), true, detail::bitscanr(rlink.key()));
 
         /* Am I a leaf off the tree? */
         if(rlink.is_secondary_sibling())
@@ -807,6 +2491,15 @@ namespace algorithm
           nodelink.set_sibling(true, right);
           nodelink = _item_accessors(right);
           nodelink.set_sibling(false, left);
+          if(_subtree_counts)
+          { /* Only my primary sibling, which is in the trie, counts me */
+            pointer primary = right;
+            while(_item_accessors(primary).is_secondary_sibling())
+            {
+              primary = _item_accessors(primary).sibling(true);
+            }
+            _adjust_subtree_counts(primary, nullptr, false);
+          }
 #if 0
           {
             auto link = _item_accessors(right);
@@ -884,6 +2577,7 @@ namespace algorithm
             nodelink.set_parent(rlink.parent());
           }
           nodelink.set_is_primary_sibling();
+          _set_subtree_count(node, _subtree_count(r));
 #ifndef NDEBUG
           assert(nodelink.key() == _item_accessors(nodelink.sibling(false)).key());
           rlink.set_parent(nullptr);
@@ -959,6 +2653,7 @@ namespace algorithm
 #endif
           node = right;
           set_parent();
+          _adjust_subtree_counts(node, nullptr, false);
           head.decr_size();
           return;
         }
@@ -984,6 +2679,7 @@ namespace algorithm
               assert(parentlink.child(true) == r);
               parentlink.set_child(true, nullptr);
             }
+            _adjust_subtree_counts(rlink.parent(), nullptr, false);
           }
           head.decr_size();
 #ifndef NDEBUG
@@ -1032,15 +2728,18 @@ namespace algorithm
         }
         // Detach this grandchild from its parent
         _item_accessors(childnodelink.parent()).set_child(parentchildidx, nullptr);
+        // It takes its siblings with it
+        _adjust_subtree_counts(childnodelink.parent(), r, false, _subtree_count(childnode));
         node = childnode;
         nodelink = childnodelink;
         // Set my parent to point at the replacement node
         set_parent();
+        _adjust_subtree_counts(node, nullptr, false);
         head.decr_size();
       }
 
       static const_pointer _triebranchprev(const_pointer r,
-                                           bitwise_trie_item_accessors<const ItemType> *rlinkaddr = nullptr) noexcept
+                                           ItemAccessors<const ItemType> *rlinkaddr = nullptr) noexcept
       {
         const_pointer node = nullptr, child = nullptr;
         auto nodelink = _item_accessors(node);
@@ -1089,35 +2788,41 @@ namespace algorithm
         const_pointer node = nullptr, child = nullptr;
         auto nodelink = _item_accessors(node);
         auto rlink = _item_accessors(r);
-        _lock_unlock_branch lock_unlock(this, rlink.key(), false);
-
-        rlink = _null_item_accessors(r);
-        if((node = _triebranchprev(r, &rlink)) != nullptr || !rlink)
-        {
-          return node;
-        }
-        /* I have reached the top of my trie, so on to prev bin */
-        unsigned bitidx = rlink.bit_index();
-        assert(head.child(bitidx) == r);
-        for(bitidx--; bitidx < _key_type_bits && nullptr == (node = head.child(bitidx)); bitidx--)
-          ;
-        if(bitidx >= _key_type_bits)
+        unsigned bitidx;
         {
-          return nullptr;
+          _lock_unlock_branch lock_unlock(this, rlink.key(), false);
+
+          rlink = _null_item_accessors(r);
+          if((node = _triebranchprev(r, &rlink)) != nullptr || !rlink)
+          {
+            return node;
+          }
+          /* I have reached the top of my trie, so on to prev bin */
+          bitidx = rlink.bit_index();
+          assert(head.child(bitidx) == r);
         }
-        nodelink = _item_accessors(node);
-        /* Follow child[1] preferentially downwards */
-        while(nullptr != (child = (nodelink.child(1) != nullptr) ? nodelink.child(1) : nodelink.child(0)))
+        for(bitidx = _prev_bin(bitidx - 1); bitidx < _key_type_bits; bitidx = _prev_bin(bitidx - 1))
         {
-          node = child;
+          _lock_unlock_branch lock_unlock(this, (key_type) 0, false, bitidx);
+          if(nullptr == (node = head.child(bitidx)))
+          {
+            continue;
+          }
           nodelink = _item_accessors(node);
+          /* Follow child[1] preferentially downwards */
+          while(nullptr != (child = (nodelink.child(1) != nullptr) ? nodelink.child(1) : nodelink.child(0)))
+          {
+            node = child;
+            nodelink = _item_accessors(node);
+          }
+          /* Now go to end leaf */
+          if(nodelink.sibling(false) != node)
+          {
+            return nodelink.sibling(false);
+          }
+          return node;
         }
-        /* Now go to end leaf */
-        if(nodelink.sibling(false) != node)
-        {
-          return nodelink.sibling(false);
-        }
-        return node;
+        return nullptr;
       }
       pointer _trieprev(const_pointer r) noexcept
       {
@@ -1125,7 +2830,7 @@ namespace algorithm
       }
 
       static const_pointer _triebranchnext(const_pointer r,
-                                           bitwise_trie_item_accessors<const ItemType> *rlinkaddr = nullptr) noexcept
+                                           ItemAccessors<const ItemType> *rlinkaddr = nullptr) noexcept
       {
         const_pointer node = nullptr;
         auto nodelink = _item_accessors(node);
@@ -1169,67 +2874,403 @@ namespace algorithm
       }
       const_pointer _trienext(const_pointer r) const noexcept
       {
-        auto head = _head_accessors();
-        const_pointer node = nullptr;
-        auto rlink = _item_accessors(r);
-        _lock_unlock_branch lock_unlock(this, rlink.key(), false);
-
-        rlink = _null_item_accessors(r);
-        if((node = _triebranchnext(r, &rlink)) != nullptr)
+        auto head = _head_accessors();
+        const_pointer node = nullptr;
+        auto rlink = _item_accessors(r);
+        unsigned bitidx;
+        {
+          _lock_unlock_branch lock_unlock(this, rlink.key(), false);
+
+          rlink = _null_item_accessors(r);
+          if((node = _triebranchnext(r, &rlink)) != nullptr)
+          {
+            return node;
+          }
+          /* I have reached the top of my trie, so on to next bin */
+          bitidx = rlink.bit_index();
+        }
+        for(bitidx = _next_bin(bitidx + 1); bitidx < _key_type_bits; bitidx = _next_bin(bitidx + 1))
+        {
+          _lock_unlock_branch lock_unlock(this, (key_type) 0, false, bitidx);
+          if(nullptr != (node = head.child(bitidx)))
+          {
+            return node;
+          }
+        }
+        return nullptr;
+      }
+      pointer _trienext(const_pointer r) noexcept
+      {
+        return const_cast<pointer>(static_cast<const bitwise_trie *>(this)->_trienext(r));
+      }
+
+      pointer _triefind(key_type rkey) const noexcept
+      {
+        auto head = _head_accessors();
+        if(0 == head.size())
+        {
+          return nullptr;
+        }
+
+        unsigned bitidx = detail::bitscanr(rkey);
+        assert(bitidx < _key_type_bits);
+        return const_cast<pointer>(_read_branch(rkey, bitidx, [&]() noexcept -> const_pointer {
+          const_pointer node = head.child(bitidx);
+          detail::keybit_cursor<key_type> keybit(bitidx);
+          for(unsigned steps = 0; node != nullptr && steps < _max_traversal_steps; steps++)
+          {
+            auto nodelink = _item_accessors(node);
+            key_type nodekey = nodelink.key();
+            if(nodekey == rkey)
+            {
+              return node;
+            }
+            keybit.next();
+            node = nodelink.child(keybit.test(rkey));
+          }
+          return nullptr;
+        }));
+      }
+      // Inline duplicates of a key can only be on that key's path, below the first found
+      size_type _count_inline(key_type rkey) const noexcept
+      {
+        auto head = _head_accessors();
+        if(0 == head.size())
+        {
+          return 0;
+        }
+
+        unsigned bitidx = detail::bitscanr(rkey);
+        assert(bitidx < _key_type_bits);
+        return _read_branch(rkey, bitidx, [&]() noexcept -> size_type {
+          const_pointer node = head.child(bitidx);
+          detail::keybit_cursor<key_type> keybit(bitidx);
+          size_type ret = 0;
+          for(unsigned steps = 0; node != nullptr && steps < _max_traversal_steps; steps++)
+          {
+            auto nodelink = _item_accessors(node);
+            ret += (nodelink.key() == rkey);
+            keybit.next();
+            node = nodelink.child(keybit.test(rkey));
+          }
+          return ret;
+        });
+      }
+      // How many items there are in the subtree below root, including duplicates
+      static size_type _subtree_size(const_pointer root) noexcept
+      {
+        if(_subtree_counts)
         {
-          return node;
+          return (size_type) _subtree_count(root);
         }
-        /* I have reached the top of my trie, so on to next bin */
-        unsigned bitidx = rlink.bit_index();
-        for(bitidx++; bitidx < _key_type_bits && nullptr == (node = head.child(bitidx)); bitidx++)
-          ;
-        if(bitidx >= _key_type_bits)
+        size_type ret = 0;
+        for(const_pointer node = root; node != nullptr;)
         {
-          return nullptr;
+          auto nodelink = _item_accessors(node);
+          ret++;
+          if(!_inline_duplicates)
+          {
+            for(const_pointer i = nodelink.sibling(true); i != node; i = _item_accessors(i).sibling(true))
+            {
+              ret++;
+            }
+          }
+          if(nodelink.child(false) != nullptr || nodelink.child(true) != nullptr)
+          {
+            node = (nodelink.child(false) != nullptr) ? nodelink.child(false) : nodelink.child(true);
+            continue;
+          }
+          // Climb until there is a right subtree not yet visited
+          for(;;)
+          {
+            if(node == root)
+            {
+              return ret;
+            }
+            const_pointer parent = _item_accessors(node).parent();
+            auto parentlink = _item_accessors(parent);
+            if(parentlink.child(false) == node && parentlink.child(true) != nullptr)
+            {
+              node = parentlink.child(true);
+              break;
+            }
+            node = parent;
+          }
         }
-        return node;
+        return ret;
       }
-      pointer _trienext(const_pointer r) noexcept
+      /* Takes apart the subtree below node, which must already be detached from its index,
+      calling f(pointer) on each of its items leaves first. An item's links are read before f
+      is called on it, so f may insert it into any index.
+      */
+      template <class F> static void _drain_subtree(pointer node, F &&f) noexcept
       {
-        return const_cast<pointer>(static_cast<const bitwise_trie *>(this)->_trienext(r));
+        while(node != nullptr)
+        {
+          auto nodelink = _item_accessors(node);
+          if(nodelink.child(false) != nullptr || nodelink.child(true) != nullptr)
+          {
+            node = (nodelink.child(false) != nullptr) ? nodelink.child(false) : nodelink.child(true);
+            continue;
+          }
+          pointer parent = nullptr;
+          if(!nodelink.parent_is_index())
+          {
+            parent = nodelink.parent();
+            auto parentlink = _item_accessors(parent);
+            parentlink.set_child(parentlink.child(true) == node, nullptr);
+          }
+          pointer sibling = _inline_duplicates ? node : nodelink.sibling(true);
+          f(node);
+          while(sibling != node)
+          {
+            pointer next = _item_accessors(sibling).sibling(true);
+            f(sibling);
+            sibling = next;
+          }
+          node = parent;
+        }
       }
 
-      pointer _triefind(key_type rkey) const noexcept
+      // How many items have a key smaller than rkey
+      size_type _trierank(key_type rkey) const noexcept
       {
         auto head = _head_accessors();
         if(0 == head.size())
         {
-          return nullptr;
+          return 0;
         }
 
-        const_pointer node = nullptr;
-
         unsigned bitidx = detail::bitscanr(rkey);
-        /* Avoid unknown bit shifts where possible, their performance can suck */
-        key_type keybit = (key_type) 1 << bitidx;
         assert(bitidx < _key_type_bits);
-        if(nullptr == (node = head.child(bitidx)))
+        size_type ret = 0;
+        // Every item in a lower bin has a smaller key
+        for(unsigned n = _next_bin(0); n < bitidx; n = _next_bin(n + 1))
+        {
+          ret += _read_branch((key_type) 0, n, [&]() noexcept -> size_type { return _subtree_count(head.child(n)); });
+        }
+        return ret + _read_branch(rkey, bitidx, [&]() noexcept -> size_type {
+                 const_pointer node = head.child(bitidx);
+                 detail::keybit_cursor<key_type> keybit(bitidx);
+                 size_type smaller = 0;
+                 for(unsigned steps = 0; node != nullptr && steps < _max_traversal_steps; steps++)
+                 {
+                   auto nodelink = _item_accessors(node);
+                   const_pointer left = nodelink.child(false), right = nodelink.child(true);
+                   if(nodelink.key() < rkey)
+                   {
+                     // The node and its siblings, but not its children
+                     smaller += _subtree_count(node) - _subtree_count(left) - _subtree_count(right);
+                   }
+                   keybit.next();
+                   if(keybit.test(rkey))
+                   {
+                     // Every key in the zero child is smaller
+                     smaller += _subtree_count(left);
+                     node = right;
+                   }
+                   else
+                   {
+                     node = left;
+                   }
+                 }
+                 return smaller;
+               });
+      }
+      /* An item with the idx-th smallest key. Node keys lie anywhere within the key range of their
+      subtree rather than between their children, so the nodes passed on the way down whose keys are
+      still within the range being descended into are carried along, and only placed by key once
+      there is no further subtree to descend into. They always share the key bits tested so far, so
+      there cannot be more distinct keys among them than there are key bits. */
+      pointer _trieselect(size_type idx) const noexcept
+      {
+        auto head = _head_accessors();
+        if(idx >= head.size())
         {
           return nullptr;
         }
-        _lock_unlock_branch lock_unlock(this, rkey, false, bitidx);
-        for(const_pointer childnode = nullptr;; node = childnode)
+        for(unsigned bitidx = _next_bin(0); bitidx < _key_type_bits; bitidx = _next_bin(bitidx + 1))
         {
-          auto nodelink = _item_accessors(node);
-          key_type nodekey = nodelink.key();
-          if(nodekey == rkey)
+          auto ret = _read_branch((key_type) 0, bitidx, [&]() noexcept -> std::pair<const_pointer, size_type> {
+            const_pointer node = head.child(bitidx);
+            const size_type bincount = _subtree_count(node);
+            if(idx >= bincount)
+            {
+              return {nullptr, bincount};
+            }
+            struct pending_t
+            {
+              const_pointer item;
+              key_type key;
+              size_type count;
+            } pending[_key_type_bits + 2];
+            unsigned npending = 0;
+            size_type i = idx;
+            detail::keybit_cursor<key_type> keybit(bitidx);
+            for(unsigned steps = 0; node != nullptr && steps < _max_traversal_steps; steps++)
+            {
+              auto nodelink = _item_accessors(node);
+              const_pointer left = nodelink.child(false), right = nodelink.child(true);
+              const key_type nodekey = nodelink.key();
+              unsigned n = 0;
+              while(n < npending && pending[n].key != nodekey)
+              {
+                n++;
+              }
+              if(n == npending)
+              {
+                if(npending == _key_type_bits + 2)
+                {
+                  return {nullptr, bincount};  // only possible if a writer is modifying the bin
+                }
+                pending[npending++] = {node, nodekey, 0};
+              }
+              pending[n].count += _subtree_count(node) - _subtree_count(left) - _subtree_count(right);
+              keybit.next();
+              size_type lower = _subtree_count(left);
+              for(n = 0; n < npending; n++)
+              {
+                if(!keybit.test(pending[n].key))
+                {
+                  lower += pending[n].count;
+                }
+              }
+              const bool upper = (i >= lower);
+              if(upper)
+              {
+                i -= lower;
+              }
+              unsigned kept = 0;
+              for(n = 0; n < npending; n++)
+              {
+                if(keybit.test(pending[n].key) == upper)
+                {
+                  pending[kept++] = pending[n];
+                }
+              }
+              npending = kept;
+              node = upper ? right : left;
+            }
+            // Only the carried nodes remain, so place them by key
+            while(npending > 0)
+            {
+              unsigned smallest = 0;
+              for(unsigned n = 1; n < npending; n++)
+              {
+                if(pending[n].key < pending[smallest].key)
+                {
+                  smallest = n;
+                }
+              }
+              if(i < pending[smallest].count)
+              {
+                return {pending[smallest].item, bincount};
+              }
+              i -= pending[smallest].count;
+              pending[smallest] = pending[--npending];
+            }
+            return {nullptr, bincount};
+          });
+          if(idx < ret.second)
           {
-            return const_cast<pointer>(node);
+            return const_cast<pointer>(ret.first);
           }
-          keybit >>= 1;
-          const bool keybitset = !!(rkey & keybit);
-          childnode = nodelink.child(keybitset);
-          if(childnode == nullptr)
+          idx -= ret.second;
+        }
+        return nullptr;
+      }
+      /* Looks up many keys at once, advancing _find_many_lanes independent traversals in
+      lockstep and prefetching each lane's next node, so up to that many cache misses are
+      outstanding at once instead of one. Lanes are refilled with the next key as soon as
+      their lookup completes. As lanes can be in different bins at once, this is only done
+      when branches are unlocked. */
+      static constexpr unsigned _find_many_lanes = 16;
+      size_t _find_many(const key_type *keys, size_t n, pointer *out, std::true_type /*unused*/) const noexcept
+      {
+        struct lane_t
+        {
+          const_pointer node;
+          detail::keybit_cursor<key_type> keybit{0};
+          size_t idx;
+        } lanes[_find_many_lanes];
+        auto head = _head_accessors();
+        size_t next = 0, found = 0;
+        unsigned active = 0;
+        auto fill = [&](lane_t &lane) noexcept {
+          while(next < n)
           {
-            return nullptr;
+            const key_type rkey = keys[next];
+            const unsigned bitidx = detail::bitscanr(rkey);
+            lane.node = head.child(bitidx);
+            if(lane.node != nullptr)
+            {
+              detail::prefetch(lane.node);
+              lane.keybit = detail::keybit_cursor<key_type>(bitidx);
+              lane.idx = next++;
+              return true;
+            }
+            out[next++] = nullptr;
+          }
+          return false;
+        };
+        if(0 == head.size())
+        {
+          for(; next < n; next++)
+          {
+            out[next] = nullptr;
+          }
+          return 0;
+        }
+        while(active < _find_many_lanes && fill(lanes[active]))
+        {
+          active++;
+        }
+        while(active > 0)
+        {
+          for(unsigned i = 0; i < active;)
+          {
+            lane_t &lane = lanes[i];
+            auto nodelink = _item_accessors(lane.node);
+            const key_type rkey = keys[lane.idx];
+            if(nodelink.key() == rkey)
+            {
+              out[lane.idx] = const_cast<pointer>(lane.node);
+              found++;
+            }
+            else
+            {
+              lane.keybit.next();
+              lane.node = nodelink.child(lane.keybit.test(rkey));
+              if(lane.node != nullptr)
+              {
+                detail::prefetch(lane.node);
+                i++;
+                continue;
+              }
+              out[lane.idx] = nullptr;
+            }
+            // This lane's lookup is complete, so start the next key in it or retire it
+            if(!fill(lane))
+            {
+              lane = lanes[--active];
+            }
+            else
+            {
+              i++;
+            }
           }
         }
-        return nullptr;
+        return found;
+      }
+      size_t _find_many(const key_type *keys, size_t n, pointer *out, std::false_type /*unused*/) const noexcept
+      {
+        size_t found = 0;
+        for(size_t i = 0; i < n; i++)
+        {
+          out[i] = _triefind(keys[i]);
+          found += (out[i] != nullptr);
+        }
+        return found;
       }
       /* The algorithm for this is the most complex in here, so it's worth documenting
       as it also documents the others.
@@ -1298,41 +3339,61 @@ namespace algorithm
       simply, if all your binary tree fits inside L2 cache, the CPU can do
       four chained indirections in a similar time to a single indirection.
       */
-      pointer _trieCfind(key_type rkey, int64_t rounds) const noexcept
+      // Close find within the bin whose root is node, also returning whether the search is complete
+      std::pair<const_pointer, bool> _trieCfindbin(const_pointer node, key_type rkey, unsigned bitidx,
+                                                   int64_t rounds) const noexcept
       {
-        auto head = _head_accessors();
-        if(0 == head.size())
+        if(nullptr == node)
         {
-          return 0;
+          return {nullptr, false};
         }
-
-        const_pointer node = nullptr, ret = nullptr;
-
-        unsigned bitidx = detail::bitscanr(rkey);
-        assert(bitidx < _key_type_bits);
-        do
+        const_pointer ret = nullptr;
+        unsigned steps = 0;
+        detail::keybit_cursor<key_type> keybit(bitidx);
+        key_type retkey = (key_type) -1;
+        /* Find where we would insert this key */
+        auto nodelink = _item_accessors(node);
+        bool keybitset;
+        for(const_pointer childnode = nullptr;; node = childnode, nodelink = _item_accessors(node))
         {
-          /* Keeping raising the bin until we find a larger key */
-          while(bitidx < _key_type_bits && nullptr == (node = head.child(bitidx)))
+          auto nodekey = nodelink.key();
+          /* If nodekey is a closer fit to search key, mark as best result so far */
+          if(nodekey >= rkey && nodekey - rkey < retkey)
           {
-            bitidx++;
-            rkey = (key_type) 1 << bitidx;
+            ret = node;
+            retkey = nodekey - rkey;
           }
-          if(bitidx >= _key_type_bits)
+          if(ret != nullptr)
           {
-            return nullptr;
+            --rounds;
           }
-          /* Avoid unknown bit shifts where possible, their performance can suck */
-          key_type keybit = (key_type) 1 << bitidx;
-          _lock_unlock_branch lock_unlock(this, keybit, false, bitidx);
-          key_type retkey = (key_type) -1;
-          /* Find where we would insert this key */
-          auto nodelink = _item_accessors(node);
-          bool keybitset;
-          for(const_pointer childnode = nullptr;; node = childnode, nodelink = _item_accessors(node))
+          if((retkey == 0 || rounds <= 0) && ret != nullptr)
+          {
+            return {ret, true};
+          }
+          /* Which child branch should we check? */
+          keybit.next();
+          keybitset = keybit.test(rkey);
+          childnode = nodelink.child(keybitset);
+          if(childnode == nullptr)
+          {
+            break;
+          }
+          if(++steps >= _max_traversal_steps)
+          {
+            return {nullptr, true};  // only possible during a concurrent modification
+          }
+        }
+        /* node now points at where we would insert the key.
+        Find the rightmost leaf.
+        */
+        if(keybitset == false && nodelink.child(true) != nullptr)
+        {
+          node = nodelink.child(true);
+          do
           {
+            nodelink = _item_accessors(node);
             auto nodekey = nodelink.key();
-            /* If nodekey is a closer fit to search key, mark as best result so far */
             if(nodekey >= rkey && nodekey - rkey < retkey)
             {
               ret = node;
@@ -1342,29 +3403,50 @@ namespace algorithm
             {
               --rounds;
             }
-            if((retkey == 0 || rounds <= 0) && ret != nullptr)
+            if(rounds <= 0 && ret != nullptr)
             {
-              return const_cast<pointer>(ret);
+              return {ret, true};
             }
-            /* Which child branch should we check? */
-            keybit >>= 1;
-            keybitset = !!(rkey & keybit);
-            childnode = nodelink.child(keybitset);
-            if(childnode == nullptr)
+            if(++steps >= _max_traversal_steps)
             {
-              break;
+              return {nullptr, true};  // only possible during a concurrent modification
             }
+            node = (nodelink.child(false) != nullptr) ? nodelink.child(false) : nodelink.child(true);
+          } while(node != nullptr);
+          // We are at the rightmost leaf, so we have by now encountered the closest possible value
+          return {ret, true};
+        }
+        auto *origin = node;
+        auto originlink = nodelink;
+        while(!originlink.parent_is_index())
+        {
+          node = originlink.parent();
+          if(nullptr == node || ++steps >= _max_traversal_steps)
+          {
+            return {nullptr, true};  // only possible during a concurrent modification
+          }
+          nodelink = _item_accessors(node);
+          auto nodekey = nodelink.key();
+          if(nodekey >= rkey && nodekey - rkey < retkey)
+          {
+            ret = node;
+            retkey = nodekey - rkey;
+          }
+          if(ret != nullptr)
+          {
+            --rounds;
+          }
+          if(rounds <= 0 && ret != nullptr)
+          {
+            return {ret, true};
           }
-          /* node now points at where we would insert the key.
-          Find the rightmost leaf.
-          */
-          if(keybitset == false && nodelink.child(true) != nullptr)
+          if(nodelink.child(false) == origin && nodelink.child(true) != nullptr)
           {
             node = nodelink.child(true);
             do
             {
               nodelink = _item_accessors(node);
-              auto nodekey = nodelink.key();
+              nodekey = nodelink.key();
               if(nodekey >= rkey && nodekey - rkey < retkey)
               {
                 ret = node;
@@ -1374,72 +3456,238 @@ namespace algorithm
               {
                 --rounds;
               }
-              if(rounds <= 0 && ret != nullptr)
+              if(++steps >= _max_traversal_steps)
               {
-                return const_cast<pointer>(ret);
+                return {nullptr, true};  // only possible during a concurrent modification
               }
               node = (nodelink.child(false) != nullptr) ? nodelink.child(false) : nodelink.child(true);
             } while(node != nullptr);
             // We are at the rightmost leaf, so we have by now encountered the closest possible value
-            return const_cast<pointer>(ret);
+            return {ret, true};
           }
-          auto *origin = node;
-          auto originlink = nodelink;
-          while(!originlink.parent_is_index())
+          else
           {
-            node = originlink.parent();
-            nodelink = _item_accessors(node);
-            auto nodekey = nodelink.key();
-            if(nodekey >= rkey && nodekey - rkey < retkey)
+            origin = node;
+            originlink = nodelink;
+          }
+        }
+        return {ret, ret != nullptr};
+      }
+      pointer _trieCfind(key_type rkey, int64_t rounds) const noexcept
+      {
+        auto head = _head_accessors();
+        if(0 == head.size())
+        {
+          return 0;
+        }
+
+        unsigned bitidx = detail::bitscanr(rkey);
+        assert(bitidx < _key_type_bits);
+        for(;;)
+        {
+          const unsigned nextbin = _next_bin(bitidx);
+          if(nextbin != bitidx)
+          {
+            /* The bin is empty, so move up to the next occupied branch,
+            resetting key sought to the smallest possible for that branch */
+            if((bitidx = nextbin) >= _key_type_bits)
             {
-              ret = node;
-              retkey = nodekey - rkey;
+              return nullptr;
             }
-            if(ret != nullptr)
+            rkey = (key_type) 1 << bitidx;
+          }
+          auto res = _read_branch(rkey, bitidx, [&]() noexcept { return _trieCfindbin(head.child(bitidx), rkey, bitidx, rounds); });
+          if(res.second)
+          {
+            return const_cast<pointer>(res.first);
+          }
+          /* Move up a branch, resetting key sought to the smallest
+          possible for that branch */
+          if(++bitidx >= _key_type_bits)
+          {
+            return nullptr;
+          }
+          rkey = (key_type) 1 << bitidx;
+        }
+      }
+
+      /* Close find of an equal or smaller key within the bin whose root is node. Every key under a
+      zero child passed over while following the search key is smaller than the search key, and
+      those under the deepest such child are the largest of them, so after the walk down only the
+      largest side of that one child needs walking. This makes the exact find `O(depth)`.
+      */
+      std::pair<const_pointer, bool> _trieCfindsmallerbin(const_pointer node, key_type rkey, unsigned bitidx,
+                                                          int64_t rounds) const noexcept
+      {
+        if(nullptr == node)
+        {
+          return {nullptr, false};
+        }
+        const_pointer ret = nullptr, smaller = nullptr;
+        unsigned steps = 0;
+        detail::keybit_cursor<key_type> keybit(bitidx);
+        key_type retkey = (key_type) -1;
+        for(;;)
+        {
+          auto nodelink = _item_accessors(node);
+          auto nodekey = nodelink.key();
+          /* If nodekey is a closer fit to search key, mark as best result so far */
+          if(nodekey <= rkey && rkey - nodekey < retkey)
+          {
+            ret = node;
+            retkey = rkey - nodekey;
+          }
+          if(ret != nullptr)
+          {
+            --rounds;
+          }
+          if((retkey == 0 || rounds <= 0) && ret != nullptr)
+          {
+            return {ret, true};
+          }
+          /* Which child branch should we check? */
+          keybit.next();
+          const bool keybitset = keybit.test(rkey);
+          if(keybitset && nodelink.child(false) != nullptr)
+          {
+            smaller = nodelink.child(false);
+          }
+          node = nodelink.child(keybitset);
+          if(node == nullptr)
+          {
+            break;
+          }
+          if(++steps >= _max_traversal_steps)
+          {
+            return {nullptr, true};  // only possible during a concurrent modification
+          }
+        }
+        for(node = smaller; node != nullptr;)
+        {
+          auto nodelink = _item_accessors(node);
+          auto nodekey = nodelink.key();
+          if(rkey - nodekey < retkey)
+          {
+            ret = node;
+            retkey = rkey - nodekey;
+          }
+          if(--rounds <= 0)
+          {
+            break;
+          }
+          if(++steps >= _max_traversal_steps)
+          {
+            return {nullptr, true};  // only possible during a concurrent modification
+          }
+          node = (nodelink.child(true) != nullptr) ? nodelink.child(true) : nodelink.child(false);
+        }
+        return {ret, ret != nullptr};
+      }
+      pointer _trieCfindsmaller(key_type rkey, int64_t rounds) const noexcept
+      {
+        auto head = _head_accessors();
+        if(0 == head.size())
+        {
+          return 0;
+        }
+
+        unsigned bitidx = detail::bitscanr(rkey);
+        assert(bitidx < _key_type_bits);
+        for(;;)
+        {
+          const unsigned prevbin = _prev_bin(bitidx);
+          if(prevbin != bitidx)
+          {
+            /* The bin is empty, so move down to the next occupied branch,
+            resetting key sought to the largest possible for that branch */
+            if((bitidx = prevbin) >= _key_type_bits)
             {
-              --rounds;
+              return nullptr;
             }
-            if(rounds <= 0 && ret != nullptr)
+            rkey = ((key_type) 1 << bitidx);
+            rkey = rkey | (rkey - 1);
+          }
+          auto res = _read_branch(rkey, bitidx, [&]() noexcept { return _trieCfindsmallerbin(head.child(bitidx), rkey, bitidx, rounds); });
+          if(res.second)
+          {
+            return const_cast<pointer>(res.first);
+          }
+          /* Move down a branch, resetting key sought to the largest
+          possible for that branch */
+          if(bitidx-- == 0)
+          {
+            return nullptr;
+          }
+          rkey = ((key_type) 1 << bitidx);
+          rkey = rkey | (rkey - 1);
+        }
+      }
+
+      /* Calls f on every item with key in [a, b) until f returns false, returning false if it did.
+      A subtree's keys share the bits above its depth, so each subtree spans a known interval of
+      keys and those not overlapping [a, b) are skipped without being visited. Bin zero holds keys
+      zero and one, but its children are not split by key bit, so is walked whole.
+      */
+      template <class F> bool _trie_for_each_in_range(key_type a, key_type b, F &&f) const
+      {
+        auto head = _head_accessors();
+        if(0 == head.size() || !(a < b))
+        {
+          return true;
+        }
+        struct entry_t
+        {
+          const_pointer node;
+          key_type lo;    // smallest key the subtree could hold
+          unsigned bits;  // the subtree could hold keys up to lo + (1 << bits) - 1
+        } stack[_key_type_bits + 2];
+        const unsigned lastbin = detail::bitscanr(key_type(b - 1));
+        for(unsigned bitidx = _next_bin(detail::bitscanr(a)); bitidx <= lastbin; bitidx = _next_bin(bitidx + 1))
+        {
+          _lock_unlock_branch lock_unlock(this, (key_type) 0, false, bitidx);
+          const_pointer node = head.child(bitidx);
+          if(nullptr == node)
+          {
+            continue;
+          }
+          unsigned sp = 0;
+          stack[sp++] = {node, (bitidx == 0) ? (key_type) 0 : ((key_type) 1 << bitidx), (bitidx == 0) ? 1 : bitidx};
+          while(sp > 0)
+          {
+            const entry_t e = stack[--sp];
+            const key_type hi = e.lo | (((key_type) 1 << e.bits) - 1);
+            if(hi < a || !(e.lo < b))
             {
-              return const_cast<pointer>(ret);
+              continue;
             }
-            if(nodelink.child(false) == origin && nodelink.child(true) != nullptr)
+            auto nodelink = _item_accessors(e.node);
+            const key_type nodekey = nodelink.key();
+            if(!(nodekey < a) && nodekey < b)
             {
-              node = nodelink.child(true);
+              const_pointer sibling = e.node;
               do
               {
-                nodelink = _item_accessors(node);
-                nodekey = nodelink.key();
-                if(nodekey >= rkey && nodekey - rkey < retkey)
-                {
-                  ret = node;
-                  retkey = nodekey - rkey;
-                }
-                if(ret != nullptr)
+                if(!f(sibling))
                 {
-                  --rounds;
+                  return false;
                 }
-                node = (nodelink.child(false) != nullptr) ? nodelink.child(false) : nodelink.child(true);
-              } while(node != nullptr);
-              // We are at the rightmost leaf, so we have by now encountered the closest possible value
-              return const_cast<pointer>(ret);
+                sibling = _item_accessors(sibling).sibling(true);
+              } while(sibling != e.node);
             }
-            else
+            assert(sp + 2 <= _key_type_bits + 2);
+            const bool split = (bitidx != 0 && e.bits != 0);
+            if(nodelink.child(true) != nullptr)
             {
-              origin = node;
-              originlink = nodelink;
+              stack[sp++] = {nodelink.child(true), split ? (e.lo | ((key_type) 1 << (e.bits - 1))) : e.lo,
+                             split ? e.bits - 1 : e.bits};
+            }
+            if(nodelink.child(false) != nullptr)
+            {
+              stack[sp++] = {nodelink.child(false), e.lo, split ? e.bits - 1 : e.bits};
             }
           }
-          /* Move up a branch, resetting key sought to the smallest
-          possible for that branch */
-          bitidx++;
-          if(bitidx >= _key_type_bits)
-          {
-            return const_cast<pointer>(ret);
-          }
-          rkey = (key_type) 1 << bitidx;
-        } while(nullptr == ret);
-        return const_cast<pointer>(ret);
+        }
+        return true;
       }
 
 #ifndef NDEBUG
@@ -1449,10 +3697,11 @@ namespace algorithm
         key_type smallestkey, largestkey;
       };
 
-      static void _triecheckvaliditybranch(const_pointer node, key_type bitidx, _trie_validity_state &state) noexcept
+      static void _triecheckvaliditybranch(const_pointer node, unsigned bitidx, _trie_validity_state &state) noexcept
       {
         auto nodelink = _item_accessors(node);
         key_type nodekey = nodelink.key();
+        const size_type countbefore = state.count;
 
         if(nodekey < state.smallestkey)
         {
@@ -1466,7 +3715,8 @@ namespace algorithm
         auto *child = nodelink.parent();
         auto childlink = _item_accessors(child);
         assert(childlink.child(0) == node || childlink.child(1) == node);
-        assert(node == childlink.child(!!(nodekey & ((key_type) 1 << bitidx))));
+        // Inline duplicates can sit below the last key bit
+        assert(bitidx >= _key_type_bits || node == childlink.child(!!(nodekey & ((key_type) 1 << bitidx))));
         while(_item_accessors(child = nodelink.sibling(true)).is_secondary_sibling())
         {
           state.leafs++;
@@ -1491,6 +3741,7 @@ namespace algorithm
           state.rights++;
           _triecheckvaliditybranch(nodelink.child(1), bitidx - 1, state);
         }
+        assert(!_subtree_counts || _subtree_count(node) == state.count - countbefore);
       }
 #endif
     public:
@@ -1511,16 +3762,18 @@ namespace algorithm
               continue;
             }
           }
+          _lock_unlock_branch lock_unlock(this, (key_type) 0, false, n);
           if((node = head.child(n)) != nullptr)
           {
             auto nodelink = _item_accessors(node);
             key_type nodekey = nodelink.key();
-            _lock_unlock_branch lock_unlock(this, nodekey, false, n);
+            const size_type countbefore = state.count;
             state.tops++;
+            assert(n >= _occupancy_bits || ((_occupancy() >> n) & 1) != 0);
             auto bitidx = nodelink.bit_index();
             assert(bitidx == n);
             assert(head.child(bitidx) == node);
-            assert(0 == nodekey || ((((size_t) -1) << bitidx) & nodekey) == ((size_t) 1 << bitidx));
+            assert(0 == nodekey || ((((key_type) -1) << bitidx) & nodekey) == ((key_type) 1 << bitidx));
             while(_item_accessors(child = nodelink.sibling(true)).is_secondary_sibling())
             {
               state.leafs++;
@@ -1553,6 +3806,7 @@ namespace algorithm
               assert(state.smallestkey >= (key_type) 1 << bitidx);
               assert(bitidx + 1 >= _key_type_bits || state.largestkey < (key_type) 1 << (bitidx + 1));
             }
+            assert(!_subtree_counts || _subtree_count(node) == state.count - countbefore);
           }
         }
         if(tocheck == nullptr)
@@ -1754,6 +4008,151 @@ namespace algorithm
         }
       };
 
+      /* Node keys lie anywhere within the key range of their subtree rather than between their
+      children, so a subtree is visited by carrying its node down as pending into whichever half
+      of the range its key is in, and pending nodes are returned by key once there is no subtree
+      left in their range. Pending nodes all share the key bits tested so far, and each stack
+      frame is a child of a node on the current path, so both stacks are bounded by the depth
+      of the trie and nothing is allocated. */
+      static constexpr unsigned _sorted_stack_size = _inline_duplicates ? _max_traversal_steps : (_key_type_bits + 2);
+      class _sorted_iterator
+      {
+        friend class bitwise_trie;
+        struct frame_t
+        {
+          const_pointer node;  // a subtree still to visit, or null if only pending nodes remain
+          detail::keybit_cursor<key_type> keybit;
+          unsigned pendingbegin;  // its pending nodes begin here
+        };
+        const bitwise_trie *_parent{nullptr};
+        const_pointer _p{nullptr}, _primary{nullptr};
+        unsigned _bin{0}, _frames{0}, _pending{0};
+        frame_t _frame[_sorted_stack_size];
+        const_pointer _pendingnode[_sorted_stack_size];
+
+        _sorted_iterator &_inc() noexcept
+        {
+          if(_p == nullptr)
+          {
+            return *this;
+          }
+          // Siblings with the same key follow their primary
+          _p = _item_accessors(_p).sibling(true);
+          if(_p != _primary)
+          {
+            return *this;
+          }
+          _primary = _p = _next();
+          return *this;
+        }
+        const_pointer _next() noexcept
+        {
+          auto head = _parent->_head_accessors();
+          for(;;)
+          {
+            if(0 == _frames)
+            {
+              if(_bin >= _key_type_bits || (_bin = _parent->_next_bin(_bin)) >= _key_type_bits)
+              {
+                return nullptr;
+              }
+              if(nullptr != (_frame[0].node = head.child(_bin)))
+              {
+                _frame[0].keybit = detail::keybit_cursor<key_type>(_bin);
+                _frame[0].pendingbegin = 0;
+                _frames = 1;
+                _pending = 0;
+              }
+              _bin++;
+              continue;
+            }
+            frame_t &f = _frame[--_frames];
+            const unsigned begin = f.pendingbegin;
+            if(nullptr == f.node)
+            {
+              // Return the pending node with the smallest key
+              unsigned smallest = begin;
+              for(unsigned n = begin + 1; n < _pending; n++)
+              {
+                if(_item_accessors(_pendingnode[n]).key() < _item_accessors(_pendingnode[smallest]).key())
+                {
+                  smallest = n;
+                }
+              }
+              const_pointer ret = _pendingnode[smallest];
+              _pendingnode[smallest] = _pendingnode[--_pending];
+              if(_pending != begin)
+              {
+                _frames++;
+              }
+              return ret;
+            }
+            const_pointer node = f.node;
+            auto nodelink = _item_accessors(node);
+            auto keybit = f.keybit;
+            keybit.next();
+            assert(_pending < _sorted_stack_size);
+            _pendingnode[_pending++] = node;
+            // Pending nodes in the upper half of the range go first, as they are visited last
+            unsigned mid = begin;
+            for(unsigned n = begin; n < _pending; n++)
+            {
+              if(keybit.test(_item_accessors(_pendingnode[n]).key()))
+              {
+                std::swap(_pendingnode[mid++], _pendingnode[n]);
+              }
+            }
+            assert(_frames + 2 <= _sorted_stack_size);
+            if(nodelink.child(true) != nullptr || mid != begin)
+            {
+              _frame[_frames++] = {nodelink.child(true), keybit, begin};
+              if(nodelink.child(true) != nullptr)
+              {
+                detail::prefetch(nodelink.child(true));
+              }
+            }
+            if(nodelink.child(false) != nullptr || mid != _pending)
+            {
+              _frame[_frames++] = {nodelink.child(false), keybit, mid};
+            }
+          }
+        }
+
+        explicit _sorted_iterator(const bitwise_trie *parent) noexcept
+            : _parent(parent)
+        {
+        }
+
+      public:
+        using difference_type = typename bitwise_trie::difference_type;
+        using value_type = typename bitwise_trie::value_type;
+        using pointer = typename bitwise_trie::const_pointer;
+        using reference = const ItemType &;
+        using iterator_category = std::forward_iterator_tag;
+        _sorted_iterator() noexcept {}
+
+        explicit operator bool() const noexcept { return _p != nullptr; }
+        bool operator!() const noexcept { return _p == nullptr; }
+        pointer operator->() const noexcept { return _p; }
+        bool operator==(const _sorted_iterator &o) const noexcept { return _parent == o._parent && _p == o._p; }
+        bool operator!=(const _sorted_iterator &o) const noexcept { return _parent != o._parent || _p != o._p; }
+        reference operator*() const noexcept
+        {
+          if(_p == nullptr)
+          {
+            abort();
+          }
+          return *_p;
+        }
+        _sorted_iterator &operator++() noexcept { return _inc(); }
+        _sorted_iterator operator++(int) noexcept
+        {
+          _sorted_iterator ret(*this);
+          ++*this;
+          return ret;
+        }
+      };
+
     public:
       //! The iterator type
       using iterator = iterator_<false, bitwise_trie, pointer, reference>;
@@ -1763,6 +4162,8 @@ namespace algorithm
       using reverse_iterator = std::reverse_iterator<iterator>;
       //! The const reverse iterator type
       using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+      //! The iterator type visiting items in key order
+      using sorted_iterator = _sorted_iterator;
 
       static_assert(std::is_convertible<iterator, const_iterator>::value,
                     "iterator is not implicitly convertible to const_iterator");
@@ -1913,6 +4314,21 @@ namespace algorithm
       const_iterator cend() const noexcept { return const_iterator(this); }
       //! Returns an iterator to the item before the first in the index.
       const_reverse_iterator crend() const noexcept { return const_reverse_iterator(const_iterator(this)); }
+      /*! Returns an iterator to the item with the smallest key, which visits all items in key order
+      rather than in the mostly sorted order of `begin()`. Items with the same key are visited in
+      order of insertion if they are siblings, and in no particular order if they are inline
+      duplicates. Visiting all items is `O(N)`. The iterator carries its own stacks bounded by the
+      depth of the trie, so it is large and allocates nothing, and it cannot be decremented. It is
+      invalidated by any modification of the index.
+      */
+      sorted_iterator sorted_begin() const noexcept
+      {
+        sorted_iterator ret(this);
+        ret._primary = ret._p = ret._next();
+        return ret;
+      }
+      //! Returns an iterator to the item after the last in key order.
+      sorted_iterator sorted_end() const noexcept { return sorted_iterator(this); }
 
       //! Clears the index.
       constexpr void clear() noexcept
@@ -1925,10 +4341,14 @@ namespace algorithm
         head.set_size(0);
       }
       //! Return how many items with key there are.
-      size_type count(key_type k) const noexcept { return count(find(k)); }
+      size_type count(key_type k) const noexcept { return _inline_duplicates ? _count_inline(k) : count(find(k)); }
       //! Return how many items with the same key as iterator there are.
       size_type count(const_iterator it) const noexcept
       {
+        if(_inline_duplicates)
+        {
+          return (it != end()) ? _count_inline(_item_accessors(it._p).key()) : 0;
+        }
         if(it != end())
         {
           size_type ret = 1;
@@ -1942,8 +4362,9 @@ namespace algorithm
         return 0;
       }
       /*! Inserts a new item, returning an iterator to the new item if the key is new. If there
-      is an item with that key already, if sibling storage is enabled, insert a new item with
-      the same key. If sibling storage is disabled, return an iterator to the existing item.
+      is an item with that key already, if sibling storage or inline duplicates are enabled,
+      insert a new item with the same key. Otherwise, or if the key already has the most
+      inline duplicates allowed, return an iterator to the existing item.
 
       If the maximum number of items has been inserted, if C++ exceptions are disabled
       or `QUICKCPPLIB_ALGORITHM_BITWISE_TRIE_DISABLE_EXCEPTION_THROWS != 0`, the returned iterator
@@ -1966,6 +4387,188 @@ namespace algorithm
         }
         return end();
       }
+      //! Inserts a range of items, as if by calling `insert(pointer)` on each.
+      template <class InputIt> void insert(InputIt first, InputIt last)
+      {
+        for(; first != last; ++first)
+        {
+          insert(*first);
+        }
+      }
+      /*! Inserts an array of items, as if by calling `insert(pointer)` on each, using up to
+      `threads` threads, or one per CPU if zero.
+
+      Each top bit bin is split into buckets by the next few bits of its keys, sized from a
+      sample of the items so each thread gets several buckets of similar size. Every bucket's
+      items share a path from their bin's root, so once the few nodes along those paths are
+      inserted, each bucket's subtree can be built independently by whichever thread takes it.
+      Partitioning the items into buckets is itself spread over the threads. Splitting bins
+      further than by top bit matters, as for evenly distributed keys half of all items
+      fall into the topmost bin.
+
+      The array is left as is. Scratch space proportional to `n` is allocated, which may throw.
+      If there are too few items to be worth using threads for, or they might not all fit,
+      this is exactly `insert(items, items + n)`. This is not safe against any concurrent use
+      of the index.
+      */
+      void bulk_build(pointer *items, size_t n, unsigned threads = 0)
+      {
+        static constexpr size_t samples = 4096, buckets_per_thread = 8, prefetch_distance = 8;
+        static constexpr unsigned max_kbits = 12;
+        if(0 == threads)
+        {
+          threads = std::thread::hardware_concurrency();
+        }
+        if(threads > n / _min_items_per_thread)
+        {
+          threads = (unsigned) (n / _min_items_per_thread);
+        }
+        if(threads <= 1 || n + 1 >= (size_t) (max_size() - size()))
+        {
+          insert(items, items + n);
+          return;
+        }
+        // Choose how many bits below the top bit to split each bin's items by
+        unsigned kbits[_key_type_bits];
+        size_t bucketbase[_key_type_bits + 1];
+        {
+          size_t sampled[_key_type_bits], count = 0;
+          memset(sampled, 0, sizeof(sampled));
+          for(size_t i = 0; i < n; i += (n > samples) ? n / samples : 1, count++)
+          {
+            sampled[detail::bitscanr(_item_accessors(items[i]).key())]++;
+          }
+          const size_t target = count / (threads * buckets_per_thread) + 1;
+          bucketbase[0] = 0;
+          for(unsigned bitidx = 0; bitidx < _key_type_bits; bitidx++)
+          {
+            unsigned k = 0;
+            while(k < max_kbits && k < bitidx && (sampled[bitidx] >> k) > target)
+            {
+              k++;
+            }
+            kbits[bitidx] = k;
+            bucketbase[bitidx + 1] = bucketbase[bitidx] + ((size_t) 1 << k);
+          }
+        }
+        const size_t buckets = bucketbase[_key_type_bits];
+        std::vector<_bulk_build_bucket> bucket(buckets);
+        std::vector<uint32_t> ids(n);
+        std::vector<pointer> sorted(n);
+        // Each thread counts the buckets of its slice of the items, then places its slice
+        std::vector<size_t> offsets((size_t) threads * buckets);
+        _for_each_worker(threads, [&](unsigned t) noexcept {
+          size_t *counts = offsets.data() + (size_t) t * buckets;
+          const size_t end = n * (t + 1) / threads;
+          for(size_t i = n * t / threads; i < end; i++)
+          {
+            if(i + prefetch_distance < end)
+            {
+              detail::prefetch(items[i + prefetch_distance]);
+            }
+            const key_type rkey = _item_accessors(items[i]).key();
+            const unsigned bitidx = detail::bitscanr(rkey);
+            detail::keybit_cursor<key_type> keybit(bitidx);
+            uint32_t path = 0;
+            for(unsigned k = 0; k < kbits[bitidx]; k++)
+            {
+              keybit.next();
+              path = (path << 1) | (uint32_t) keybit.test(rkey);
+            }
+            ids[i] = (uint32_t) (bucketbase[bitidx] + path);
+            counts[ids[i]]++;
+          }
+        });
+        for(size_t id = 0, offset = 0; id < buckets; id++)
+        {
+          bucket[id].begin = offset;
+          for(unsigned t = 0; t < threads; t++)
+          {
+            const size_t count = offsets[(size_t) t * buckets + id];
+            offsets[(size_t) t * buckets + id] = offset;
+            offset += count;
+          }
+          bucket[id].end = offset;
+        }
+        for(unsigned bitidx = 0; bitidx < _key_type_bits; bitidx++)
+        {
+          for(unsigned path = 0; path < (1u << kbits[bitidx]); path++)
+          {
+            auto &bk = bucket[bucketbase[bitidx] + path];
+            bk.bitidx = bitidx;
+            bk.kbits = kbits[bitidx];
+            bk.path = path;
+          }
+        }
+        _for_each_worker(threads, [&](unsigned t) noexcept {
+          size_t *offset = offsets.data() + (size_t) t * buckets;
+          const size_t end = n * (t + 1) / threads;
+          for(size_t i = n * t / threads; i < end; i++)
+          {
+            sorted[offset[ids[i]]++] = items[i];
+          }
+        });
+        // Insert the first items of each bucket until the node its subtree hangs from exists
+        for(auto &bk : bucket)
+        {
+          while(nullptr == (bk.root = _bulk_build_root(bk)) && bk.begin != bk.end)
+          {
+            _trieinsert(sorted[bk.begin++]);
+          }
+          bk.deferred = bk.begin;
+        }
+        // Build every bucket's subtree. Items with the key of a node above its root are
+        // duplicates of a node shared with other buckets, so are left for afterwards.
+        std::atomic<size_t> next(0);
+        _for_each_worker(threads, [&](unsigned /*unused*/) noexcept {
+          for(size_t id; (id = next.fetch_add(1, std::memory_order_relaxed)) < buckets;)
+          {
+            auto &bk = bucket[id];
+            detail::keybit_cursor<key_type> keybit(bk.bitidx);
+            for(unsigned k = 0; k < bk.kbits; k++)
+            {
+              keybit.next();
+            }
+            for(size_t i = bk.begin; i < bk.end; i++)
+            {
+              if(i + prefetch_distance < bk.end)
+              {
+                detail::prefetch(sorted[i + prefetch_distance]);
+              }
+              pointer r = sorted[i];
+              if(!_inline_duplicates && _bulk_build_above(bk, _item_accessors(r).key()))
+              {
+                sorted[i] = sorted[bk.deferred];
+                sorted[bk.deferred++] = r;
+                continue;
+              }
+              _reset_links(r);
+              if(_trieinsert_below(bk.root, r, keybit) == r)
+              {
+                bk.inserted++;
+              }
+            }
+          }
+        });
+        auto head = _head_accessors();
+        size_t inserted = 0;
+        for(auto &bk : bucket)
+        {
+          inserted += bk.inserted;
+          if(bk.inserted != 0 && bk.kbits != 0)
+          {
+            _adjust_subtree_counts(_item_accessors(bk.root).parent(), nullptr, true, bk.inserted);
+          }
+        }
+        head.set_size((size_type) (head.size() + inserted));
+        for(auto &bk : bucket)
+        {
+          for(size_t i = bk.begin; i < bk.deferred; i++)
+          {
+            _trieinsert(sorted[i]);
+          }
+        }
+      }
       //! Erases an item.
       iterator erase(const_iterator it) noexcept
       {
@@ -1983,6 +4586,197 @@ namespace algorithm
       void erase(pointer p) noexcept { _trieremove(p); }
       //! Erases an item.
       iterator erase(key_type k) noexcept { return erase(find(k)); }
+      /*! Erases an item, and calls `reclaim(p, context)` once no find which might still be
+      traversing it remains, whereupon its storage may be reused. Requires a `trie_epochs`
+      member in the index head, see `bitwise_trie_epoch_domain`. Never waits for finds.
+      */
+      void retire(pointer p, void (*reclaim)(ItemType *, void *), void *context = nullptr) noexcept
+      {
+        static_assert(detail::has_epochs<HeadAccessors<const Base, const ItemType>>::value,
+                      "retire() requires an index head with trie_epochs");
+        _trieremove(p);
+        _head_accessors().epochs()->retire(p, reclaim, context);
+      }
+      /*! Calls `f(pointer)` for every item with a key in `[a, b)`, returning how many there were.
+      Subtrees whose keys cannot fall within the range are skipped, so the cost is proportional
+      to the items matched plus the depth of the bins spanned, not to the size of the index.
+      Items are visited in ascending order of top bit bin, but not in key order within a bin.
+      `f` must not modify the index.
+      */
+      template <class F> size_type for_each_in_range(key_type a, key_type b, F &&f)
+      {
+        size_type count = 0;
+        _trie_for_each_in_range(a, b, [&](const_pointer p) {
+          f(const_cast<pointer>(p));
+          ++count;
+          return true;
+        });
+        return count;
+      }
+      //! \overload
+      template <class F> size_type for_each_in_range(key_type a, key_type b, F &&f) const
+      {
+        size_type count = 0;
+        _trie_for_each_in_range(a, b, [&](const_pointer p) {
+          f(p);
+          ++count;
+          return true;
+        });
+        return count;
+      }
+      /*! Calls `f(pointer)` for every item using up to `threads` threads, or one per CPU if
+      zero, returning how many items there were. Items are visited in no particular order.
+
+      Each thread starts with some of the top bit bins, and walks the subtree of each. Whenever
+      a thread runs out of subtrees, the others split off the largest pending child subtree of
+      their walk for it to steal, so work is balanced on the fly from the trie's own structure
+      without first gathering the items. `f` is called from many threads at once, must not
+      throw, and must not modify the index. This is not safe against concurrent modification
+      of the index, but other threads may find concurrently.
+
+      Scratch space proportional to `threads` is allocated, which may throw. If there are too
+      few items to be worth using threads for, the items are visited by the calling thread.
+      */
+      template <class F> size_type parallel_for_each(F &&f, unsigned threads = 0)
+      {
+        return _parallel_for_each([&](const_pointer p) { f(const_cast<pointer>(p)); }, threads);
+      }
+      //! \overload
+      template <class F> size_type parallel_for_each(F &&f, unsigned threads = 0) const
+      {
+        return _parallel_for_each(f, threads);
+      }
+      /*! Erases every item with a key in `[a, b)`, returning how many were erased. Items are
+      gathered in batches by the same pruned walk as `for_each_in_range()` and then erased,
+      so the cost is proportional to the items erased plus the depth of the bins spanned.
+      */
+      size_type erase_range(key_type a, key_type b) noexcept
+      {
+        static constexpr size_t batch = 64;
+        size_type count = 0;
+        for(;;)
+        {
+          pointer items[batch];
+          size_t n = 0;
+          const bool done = _trie_for_each_in_range(a, b, [&](const_pointer p) noexcept {
+            items[n++] = const_cast<pointer>(p);
+            return n < batch;
+          });
+          for(size_t i = 0; i < n; i++)
+          {
+            _trieremove(items[i]);
+          }
+          count += n;
+          if(done)
+          {
+            return count;
+          }
+        }
+      }
+      /*! Moves all items from another index into this one. A top bit bin populated only in the
+      other index is moved whole in `O(1)`, so if the two indices populate disjoint bins, merging
+      costs `O(bins)` no matter how many items there are. Items of bins populated in both are
+      reinserted one at a time. Items which cannot be inserted, because their key is already
+      here and duplicates are not stored, or because this index is full, are left in the other.
+      This is not safe against concurrent modification of either index.
+      */
+      void merge(bitwise_trie &o) noexcept
+      {
+        if(&o == this)
+        {
+          return;
+        }
+        auto myhead = _head_accessors();
+        auto ohead = o._head_accessors();
+        size_type kept = 0;
+        for(unsigned n = o._next_bin(0); n < _key_type_bits; n = o._next_bin(n + 1))
+        {
+          pointer root = ohead.child(n);
+          if(nullptr == root)
+          {
+            continue;
+          }
+          ohead.set_child(n, nullptr);
+          if(nullptr == myhead.child(n))
+          {
+            myhead.set_child(n, root);
+            continue;
+          }
+          _drain_subtree(root, [&](pointer p) noexcept {
+            ohead.decr_size();
+            if(_trieinsert(p) != p)
+            {
+              o._trieinsert(p);
+              kept++;
+            }
+          });
+        }
+        // Besides the items kept, the other index still counts only those moved in whole bins
+        myhead.set_size(myhead.size() + ohead.size() - kept);
+        ohead.set_size(kept);
+      }
+      /*! Moves all items with a key of `k` or larger from this index into `out`. Top bit bins
+      wholly above `k` are moved whole if `out` does not populate them, and the single bin
+      which `k` falls within has its items reinserted one at a time. A whole bin move is `O(1)`
+      if items keep a `trie_subtree_count`, otherwise the items of the bin are counted, which
+      reads each of them once but is still far cheaper than reinserting them. Items which
+      cannot be inserted into `out` are left in this index, as for `merge()`. This is not safe
+      against concurrent modification of either index.
+      */
+      void split_at_key(key_type k, bitwise_trie &out) noexcept
+      {
+        if(&out == this)
+        {
+          return;
+        }
+        auto myhead = _head_accessors();
+        auto ohead = out._head_accessors();
+        auto move_item = [&](pointer p) noexcept {
+          myhead.decr_size();
+          if(out._trieinsert(p) != p)
+          {
+            _trieinsert(p);
+          }
+        };
+        const unsigned bitidx = detail::bitscanr(k);
+        assert(bitidx < _key_type_bits);
+        // If k is the smallest key its bin can hold, that bin moves whole too
+        const bool splitbin = k != (key_type) 0 && (bitidx == 0 || k != ((key_type) 1 << bitidx));
+        for(unsigned n = _next_bin(bitidx + splitbin); n < _key_type_bits; n = _next_bin(n + 1))
+        {
+          pointer root = myhead.child(n);
+          if(nullptr == root)
+          {
+            continue;
+          }
+          myhead.set_child(n, nullptr);
+          if(nullptr == ohead.child(n))
+          {
+            const size_type count = _subtree_size(root);
+            ohead.set_child(n, root);
+            myhead.set_size(myhead.size() - count);
+            ohead.set_size(ohead.size() + count);
+            continue;
+          }
+          _drain_subtree(root, move_item);
+        }
+        pointer root = splitbin ? myhead.child(bitidx) : nullptr;
+        if(nullptr != root)
+        {
+          myhead.set_child(bitidx, nullptr);
+          _drain_subtree(root, [&](pointer p) noexcept {
+            if(_item_accessors(p).key() >= k)
+            {
+              move_item(p);
+            }
+            else
+            {
+              myhead.decr_size();
+              _trieinsert(p);
+            }
+          });
+        }
+      }
       //! Finds an item
       iterator find(key_type k) const noexcept
       {
@@ -1992,6 +4786,18 @@ namespace algorithm
         }
         return iterator(this);
       }
+      /*! Finds the items with the `n` keys in `keys`, writing each item found, or a null pointer if
+      not found, into the corresponding element of `out`. Returns how many were found.
+
+      The lookups are interleaved, so the cache misses of up to sixteen traversals are
+      outstanding at once, which is considerably faster than a find loop for large tries.
+      If the head accessors lock branches, this is a find loop.
+      */
+      size_t find_many(const key_type *keys, size_t n, pointer *out) const noexcept
+      {
+        return _find_many(keys, n, out,
+                          detail::has_unlocked_branches<HeadAccessors<const Base, const ItemType>>());
+      }
       /*! Finds either an item with identical key, or an item with a larger key. The higher the value in `rounds`,
       the less average distance between the larger key and the key requested. The complexity of this function
       is bound by `rounds`.
@@ -2014,7 +4820,8 @@ namespace algorithm
       }
       //! Finds either an item with identical key, or an item with the guaranteed next largest key. This is
       //! identical to `close_find(k, INT64_MAX)` and its average case complexity is `O(log N)` where `N` is
-      //! the number of items in the index with the same top bit set. This is equivalent to `upper_bound(k - 1)`.
+      //! the number of items in the index with the same top bit set. Only the search path is ever backtracked,
+      //! so the worst case is the depth of the trie. This is equivalent to `upper_bound(k - 1)`.
       iterator find_equal_or_next_largest(key_type k) const noexcept
       {
         if(auto p = _trieCfind(k, INT64_MAX))
@@ -2041,6 +4848,62 @@ namespace algorithm
         }
         return iterator(this);
       }
+      /*! Finds either an item with identical key, or an item with a smaller key. The higher the value in `rounds`,
+      the less average distance between the smaller key and the key requested. The complexity of this function
+      is bound by `rounds`.
+      */
+      iterator find_equal_or_smaller(key_type k, int64_t rounds) const noexcept
+      {
+        if(auto p = _trieCfindsmaller(k, rounds))
+        {
+          return iterator(this, p);
+        }
+        return iterator(this);
+      }
+      //! Finds either an item with identical key, or an item with the guaranteed next smallest key. This is
+      //! identical to `find_equal_or_smaller(k, INT64_MAX)` and its complexity is `O(depth)` of the bin
+      //! searched, plus a scan of empty bins below it if nothing in that bin is smaller.
+      iterator find_equal_or_next_smallest(key_type k) const noexcept
+      {
+        if(auto p = _trieCfindsmaller(k, INT64_MAX))
+        {
+          return iterator(this, p);
+        }
+        return iterator(this);
+      }
+      /*! Returns how many items have a key smaller than the key, i.e. the position in key order at which
+      an item with that key would be. Complexity is `O(depth)` of the bin the key would be in, plus a
+      visit of each occupied bin below it. Requires the item accessors to provide `subtree_count()`,
+      which the default accessors do if the item type has a `trie_subtree_count` member.
+      */
+      size_type rank(key_type k) const noexcept
+      {
+        static_assert(_subtree_counts, "rank() requires items to keep a trie_subtree_count");
+        return _trierank(k);
+      }
+      /*! Returns an item whose key is the `idx`-th smallest in the index counting from zero, or `end()`
+      if `idx` is not less than `size()`. If several items have that key, which of them is returned is
+      unspecified. Complexity is `O(depth)` of the bin found, plus a visit of each occupied bin below
+      it. Requires the item accessors to provide `subtree_count()`, as for `rank()`.
+      */
+      iterator select(size_type idx) const noexcept
+      {
+        static_assert(_subtree_counts, "select() requires items to keep a trie_subtree_count");
+        if(auto p = _trieselect(idx))
+        {
+          return iterator(this, p);
+        }
+        return iterator(this);
+      }
+      //! Finds the item with the key not less than the key. This is equivalent to `find_equal_or_next_largest(k)`.
+      iterator lower_bound(key_type k) const noexcept
+      {
+        if(auto p = _trieCfind(k, INT64_MAX))
+        {
+          return iterator(this, p);
+        }
+        return iterator(this);
+      }
       //! True if the index contains the key
       bool contains(key_type k) const noexcept { return nullptr != _triefind(k); }
       //! Returns a reference to the specified element, aborting if key not found.
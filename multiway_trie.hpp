@@ -0,0 +1,869 @@
+/* Multiway trie algorithm
+(C) 2026 The nedtries contributors
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef QUICKCPPLIB_ALGORITHM_MULTIWAY_TRIE_HPP
+#define QUICKCPPLIB_ALGORITHM_MULTIWAY_TRIE_HPP
+
+#include "bitwise_trie.hpp"
+
+QUICKCPPLIB_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  namespace multiway_trie
+  {
+    namespace detail
+    {
+      using bitwise_trie::detail::bitscanr;
+      using bitwise_trie::detail::is_unsigned_key;
+      inline constexpr unsigned log2(unsigned x) noexcept { return (x <= 1) ? 0 : (1 + log2(x >> 1)); }
+    }  // namespace detail
+
+    /*! \class multiway_trie_head_accessors
+    \brief Default accessor for a multiway trie index head.
+    \tparam Base The base type from which the multiway trie derives.
+    \tparam ItemType The type of item indexed.
+
+    This default accessor requires the following member variables in the trie index head type:
+
+    - `<unsigned type> trie_count`
+    - `ItemType *trie_children[8 * sizeof(<unsigned type>)]`
+    */
+    template <class Base, class ItemType> class multiway_trie_head_accessors
+    {
+      Base *_v;
+      using _child_array_type = decltype(_v->trie_children);
+
+    public:
+      using size_type = typename std::remove_cv<decltype(_v->trie_count)>::type;
+      constexpr multiway_trie_head_accessors(Base *v)
+          : _v(v)
+      {
+      }
+      constexpr size_type size() const noexcept { return _v->trie_count; }
+      constexpr void incr_size() noexcept { ++_v->trie_count; }
+      constexpr void decr_size() noexcept { --_v->trie_count; }
+      constexpr void set_size(size_type x) noexcept { _v->trie_count = x; }
+      constexpr size_type max_size() const noexcept { return (size_type) -1; }
+
+      constexpr ItemType *child(unsigned idx) const noexcept
+      {
+        assert(idx < sizeof(_child_array_type) / sizeof(_v->trie_children[0]));
+        return _v->trie_children[idx];
+      }
+      constexpr void set_child(unsigned idx, ItemType *x) noexcept
+      {
+        assert(idx < sizeof(_child_array_type) / sizeof(_v->trie_children[0]));
+        _v->trie_children[idx] = x;
+      }
+    };
+
+    /*! \class multiway_trie_item_accessors
+    \brief Default accessor for a multiway trie item.
+    \tparam ItemType The type of item indexed.
+
+    This default accessor requires the following member variables in the trie item type:
+
+    - `ItemType *trie_parent`
+    - `ItemType *trie_child[R]`, where `R` is the radix, i.e. 4 to consume two key bits per
+    level or 16 to consume four.
+    - `KeyType trie_key`
+    */
+    template <class ItemType> class multiway_trie_item_accessors
+    {
+      ItemType *_v;
+
+    public:
+      //! The number of children per item, which must be a power of two
+      static constexpr unsigned radix = (unsigned) (sizeof(ItemType::trie_child) / sizeof(ItemType::trie_child[0]));
+
+      constexpr multiway_trie_item_accessors(ItemType *v)
+          : _v(v)
+      {
+      }
+      constexpr explicit operator bool() const noexcept { return _v != nullptr; }
+
+      constexpr ItemType *parent() const noexcept
+      {
+        assert(!parent_is_index());
+        return _v->trie_parent;
+      }
+      constexpr void set_parent(ItemType *x) noexcept { _v->trie_parent = x; }
+
+      constexpr bool parent_is_index() const noexcept { return ((uintptr_t) _v->trie_parent & 3) == 3; }
+      constexpr unsigned bit_index() const noexcept
+      {
+        assert(parent_is_index());
+        return ((unsigned) (uintptr_t) _v->trie_parent) >> 2;
+      }
+      constexpr void set_parent_is_index(unsigned bit_index) noexcept
+      {
+        _v->trie_parent = (ItemType *) (((uintptr_t) bit_index << 2) | 3);
+      }
+
+      constexpr ItemType *child(unsigned idx) const noexcept { return _v->trie_child[idx]; }
+      constexpr void set_child(unsigned idx, ItemType *x) noexcept { _v->trie_child[idx] = x; }
+
+      constexpr auto key() const noexcept { return _v->trie_key; }
+    };
+
+    /*! \class multiway_trie
+    \brief Never-allocating in-place multiway Fredkin trie index head type.
+    \tparam Base The base type from which this index derives.
+    \tparam ItemType The type of item indexed.
+    \tparam HeadAccessors Accessors for the index head.
+    \tparam ItemAccessors Accessors for the items indexed, whose `radix` sets the children per item.
+
+    This is `bitwise_trie` with each level of the trie consuming `log2(radix)` bits of the key
+    below its top set bit instead of one, so a find for a key with 32 bits below its top set
+    bit walks at most 16 items with a radix of four, or 8 with a radix of sixteen, instead
+    of 32. As each of those steps is a dependent load, large indices which do not fit into
+    cache find proportionately faster. In exchange each item carries `radix` child pointers
+    instead of two, so a radix of sixteen costs 128 bytes of children per item on a 64 bit
+    system, and more of the index needs to be in cache for the same number of items.
+
+    As with `bitwise_trie`, items are bucketed by their top set bit into bins in the index
+    head, each bin holds a trie whose items each have a key consistent with their position,
+    and nothing is ever allocated. Iteration order is only *somewhat* sorted by key, but
+    `find_equal_or_next_largest()` and `find_equal_or_next_smallest()` are exact and their
+    complexity is `O(depth)` plus a scan of empty bins.
+
+    Unlike `bitwise_trie`, keys must be unique and native unsigned integers, there is no
+    nobble direction, and no per bin locking.
+    */
+    template <class Base, class ItemType, template <class, class> class HeadAccessors = multiway_trie_head_accessors,
+              template <class> class ItemAccessors = multiway_trie_item_accessors>
+    class multiway_trie : public Base
+    {
+      constexpr HeadAccessors<const Base, const ItemType> _head_accessors() const noexcept
+      {
+        return HeadAccessors<const Base, const ItemType>(this);
+      }
+      constexpr HeadAccessors<Base, ItemType> _head_accessors() noexcept { return HeadAccessors<Base, ItemType>(this); }
+
+      static constexpr ItemAccessors<const ItemType> _item_accessors(const ItemType *item) noexcept
+      {
+        return ItemAccessors<const ItemType>(item);
+      }
+      static constexpr ItemAccessors<ItemType> _item_accessors(ItemType *item) noexcept
+      {
+        return ItemAccessors<ItemType>(item);
+      }
+
+    public:
+      //! Key type indexing the items
+      using key_type = decltype(_item_accessors(static_cast<ItemType *>(nullptr)).key());
+      //! The type of item indexed
+      using mapped_type = ItemType *;
+      //! The value type
+      using value_type = ItemType *;
+      //! The size type
+      using size_type = decltype(HeadAccessors<const Base, const ItemType>(nullptr).size());
+      //! The type of a difference between pointers to the type of item indexed
+      using difference_type = ptrdiff_t;
+      //! A reference to the type of item indexed
+      using reference = ItemType &;
+      //! A const reference to the type of item indexed
+      using const_reference = const ItemType &;
+      //! A pointer to the type of item indexed
+      using pointer = ItemType *;
+      //! A const pointer to the type of item indexed
+      using const_pointer = const ItemType *;
+      //! The number of children per item
+      static constexpr unsigned radix = ItemAccessors<ItemType>::radix;
+      //! The number of key bits consumed per level of the trie
+      static constexpr unsigned stride = detail::log2(radix);
+
+    private:
+      static constexpr unsigned _key_type_bits = (unsigned) (8 * sizeof(key_type));
+      static_assert(detail::is_unsigned_key<key_type>::value, "key type must be unsigned");
+      static_assert(std::is_unsigned<size_type>::value, "head_accessor size type must be unsigned");
+      static_assert(radix >= 2 && radix <= 256 && (radix & (radix - 1)) == 0, "radix must be a power of two up to 256");
+
+      /* Yields the digits of a key below its top set bit, most significant first, padding the
+      last with zeros if the bits left are fewer than the stride. Bin zero holds the keys zero
+      and one, so it has one bit to consume. */
+      struct _digit_cursor
+      {
+        unsigned shift;
+        explicit _digit_cursor(unsigned bitidx) noexcept
+            : shift(bitidx != 0 ? bitidx : 1)
+        {
+        }
+        bool done() const noexcept { return shift == 0; }
+        unsigned next(key_type key) noexcept
+        {
+          if(shift >= stride)
+          {
+            shift -= stride;
+            return (unsigned) (key >> shift) & (radix - 1);
+          }
+          const unsigned ret = (unsigned) (key << (stride - shift)) & (radix - 1);
+          shift = 0;
+          return ret;
+        }
+      };
+
+      // Which of parent's children is child
+      static unsigned _slot(const_pointer parent, const_pointer child) noexcept
+      {
+        auto parentlink = _item_accessors(parent);
+        for(unsigned n = 0; n < radix; n++)
+        {
+          if(parentlink.child(n) == child)
+          {
+            return n;
+          }
+        }
+        abort();
+      }
+      // The item which is last in iteration order in the subtrie whose root is node
+      static const_pointer _last_in(const_pointer node) noexcept
+      {
+        for(;;)
+        {
+          auto nodelink = _item_accessors(node);
+          unsigned n = radix;
+          while(n > 0 && nodelink.child(n - 1) == nullptr)
+          {
+            n--;
+          }
+          if(n == 0)
+          {
+            return node;
+          }
+          node = nodelink.child(n - 1);
+        }
+      }
+
+      const_pointer _triemin() const noexcept
+      {
+        auto head = _head_accessors();
+        if(0 == head.size())
+        {
+          return nullptr;
+        }
+        for(unsigned bitidx = 0; bitidx < _key_type_bits; bitidx++)
+        {
+          if(auto *node = head.child(bitidx))
+          {
+            return node;
+          }
+        }
+        return nullptr;
+      }
+      pointer _triemin() noexcept { return const_cast<pointer>(static_cast<const multiway_trie *>(this)->_triemin()); }
+      const_pointer _triemax() const noexcept
+      {
+        auto head = _head_accessors();
+        if(0 == head.size())
+        {
+          return nullptr;
+        }
+        for(unsigned bitidx = _key_type_bits; bitidx-- > 0;)
+        {
+          if(auto *node = head.child(bitidx))
+          {
+            return _last_in(node);
+          }
+        }
+        return nullptr;
+      }
+      pointer _triemax() noexcept { return const_cast<pointer>(static_cast<const multiway_trie *>(this)->_triemax()); }
+
+      pointer _trieinsert(pointer r) noexcept
+      {
+        auto head = _head_accessors();
+        auto rlink = _item_accessors(r);
+        const key_type rkey = rlink.key();
+        rlink.set_parent(nullptr);
+        for(unsigned n = 0; n < radix; n++)
+        {
+          rlink.set_child(n, nullptr);
+        }
+        const unsigned bitidx = detail::bitscanr(rkey);
+        assert(bitidx < _key_type_bits);
+        pointer node = head.child(bitidx);
+        if(nullptr == node)
+        { /* Set parent is index flag */
+          rlink.set_parent_is_index(bitidx);
+          head.set_child(bitidx, r);
+          head.incr_size();
+          return r;
+        }
+        _digit_cursor digits(bitidx);
+        for(;;)
+        {
+          auto nodelink = _item_accessors(node);
+          if(nodelink.key() == rkey)
+          {
+            return node;
+          }
+          const unsigned digit = digits.next(rkey);
+          pointer childnode = nodelink.child(digit);
+          if(nullptr == childnode)
+          { /* Insert here */
+            rlink.set_parent(node);
+            nodelink.set_child(digit, r);
+            break;
+          }
+          node = childnode;
+        }
+        head.incr_size();
+        return r;
+      }
+
+      // Returns the item which took my place, if any
+      pointer _trieremove(pointer r) noexcept
+      {
+        auto head = _head_accessors();
+        auto rlink = _item_accessors(r);
+        /* Any leaf below me has a key consistent with my position, so take the one found by
+        always descending into the first child */
+        pointer leaf = r;
+        for(bool descended = true; descended;)
+        {
+          auto leaflink = _item_accessors(leaf);
+          descended = false;
+          for(unsigned n = 0; n < radix; n++)
+          {
+            if(auto *childnode = leaflink.child(n))
+            {
+              leaf = childnode;
+              descended = true;
+              break;
+            }
+          }
+        }
+        if(leaf != r)
+        {
+          auto leaflink = _item_accessors(leaf);
+          pointer leafparent = leaflink.parent();
+          _item_accessors(leafparent).set_child(_slot(leafparent, leaf), nullptr);
+          for(unsigned n = 0; n < radix; n++)
+          {
+            pointer childnode = rlink.child(n);
+            leaflink.set_child(n, childnode);
+            if(childnode != nullptr)
+            {
+              _item_accessors(childnode).set_parent(leaf);
+            }
+          }
+        }
+        else
+        {
+          leaf = nullptr;
+        }
+        if(rlink.parent_is_index())
+        {
+          const unsigned bitidx = rlink.bit_index();
+          assert(head.child(bitidx) == r);
+          head.set_child(bitidx, leaf);
+          if(leaf != nullptr)
+          {
+            _item_accessors(leaf).set_parent_is_index(bitidx);
+          }
+        }
+        else
+        {
+          pointer parent = rlink.parent();
+          _item_accessors(parent).set_child(_slot(parent, r), leaf);
+          if(leaf != nullptr)
+          {
+            _item_accessors(leaf).set_parent(parent);
+          }
+        }
+        rlink.set_parent(nullptr);
+        head.decr_size();
+        return leaf;
+      }
+
+      const_pointer _trienext(const_pointer r) const noexcept
+      {
+        auto rlink = _item_accessors(r);
+        /* My first child is next */
+        for(unsigned n = 0; n < radix; n++)
+        {
+          if(auto *childnode = rlink.child(n))
+          {
+            return childnode;
+          }
+        }
+        /* Otherwise the next sibling of myself or of my nearest parent which has one */
+        while(!rlink.parent_is_index())
+        {
+          const_pointer parent = rlink.parent();
+          auto parentlink = _item_accessors(parent);
+          for(unsigned n = _slot(parent, r) + 1; n < radix; n++)
+          {
+            if(auto *childnode = parentlink.child(n))
+            {
+              return childnode;
+            }
+          }
+          r = parent;
+          rlink = parentlink;
+        }
+        /* I have reached the top of my trie, so on to next bin */
+        auto head = _head_accessors();
+        for(unsigned bitidx = rlink.bit_index() + 1; bitidx < _key_type_bits; bitidx++)
+        {
+          if(auto *node = head.child(bitidx))
+          {
+            return node;
+          }
+        }
+        return nullptr;
+      }
+      const_pointer _trieprev(const_pointer r) const noexcept
+      {
+        auto rlink = _item_accessors(r);
+        if(rlink.parent_is_index())
+        {
+          auto head = _head_accessors();
+          for(unsigned bitidx = rlink.bit_index(); bitidx-- > 0;)
+          {
+            if(auto *node = head.child(bitidx))
+            {
+              return _last_in(node);
+            }
+          }
+          return nullptr;
+        }
+        const_pointer parent = rlink.parent();
+        auto parentlink = _item_accessors(parent);
+        for(unsigned n = _slot(parent, r); n-- > 0;)
+        {
+          if(auto *childnode = parentlink.child(n))
+          {
+            return _last_in(childnode);
+          }
+        }
+        return parent;
+      }
+
+      pointer _triefind(key_type rkey) const noexcept
+      {
+        auto head = _head_accessors();
+        const unsigned bitidx = detail::bitscanr(rkey);
+        assert(bitidx < _key_type_bits);
+        const_pointer node = head.child(bitidx);
+        _digit_cursor digits(bitidx);
+        while(node != nullptr)
+        {
+          auto nodelink = _item_accessors(node);
+          if(nodelink.key() == rkey)
+          {
+            return const_cast<pointer>(node);
+          }
+          if(digits.done())
+          {
+            break;
+          }
+          node = nodelink.child(digits.next(rkey));
+        }
+        return nullptr;
+      }
+
+      /* Every key in a subtrie is larger than every key in the subtries of lower digits of
+      the same parent, so the smallest key in a subtrie is either its root's or the smallest
+      in its lowest occupied child's subtrie. Larger is +1, smaller is -1. */
+      template <int Dir> static void _closest_in(const_pointer node, key_type rkey, const_pointer &ret) noexcept
+      {
+        while(node != nullptr)
+        {
+          auto nodelink = _item_accessors(node);
+          const key_type nodekey = nodelink.key();
+          if(ret == nullptr || ((Dir > 0) ? (nodekey < _item_accessors(ret).key()) : (nodekey > _item_accessors(ret).key())))
+          {
+            if((Dir > 0) ? (nodekey >= rkey) : (nodekey <= rkey))
+            {
+              ret = node;
+            }
+          }
+          const_pointer childnode = nullptr;
+          for(unsigned n = 0; n < radix && childnode == nullptr; n++)
+          {
+            childnode = nodelink.child((Dir > 0) ? n : (radix - 1 - n));
+          }
+          node = childnode;
+        }
+      }
+      template <int Dir> const_pointer _trieclosest(key_type rkey) const noexcept
+      {
+        auto head = _head_accessors();
+        if(0 == head.size())
+        {
+          return nullptr;
+        }
+        const unsigned bitidx = detail::bitscanr(rkey);
+        assert(bitidx < _key_type_bits);
+        const_pointer ret = nullptr, node = head.child(bitidx), fallback = nullptr;
+        _digit_cursor digits(bitidx);
+        /* Walk the path rkey would be inserted at, considering each item on it. The subtries
+        beside the path on the far side of it entirely beat anything further down, so
+        remember the nearest of those at the deepest level. */
+        while(node != nullptr)
+        {
+          auto nodelink = _item_accessors(node);
+          const key_type nodekey = nodelink.key();
+          if(nodekey == rkey)
+          {
+            return node;
+          }
+          if(((Dir > 0) ? (nodekey > rkey) : (nodekey < rkey)) &&
+             (ret == nullptr || ((Dir > 0) ? (nodekey < _item_accessors(ret).key()) : (nodekey > _item_accessors(ret).key()))))
+          {
+            ret = node;
+          }
+          if(digits.done())
+          {
+            break;
+          }
+          const unsigned digit = digits.next(rkey);
+          if(Dir > 0)
+          {
+            for(unsigned n = digit + 1; n < radix; n++)
+            {
+              if(nodelink.child(n) != nullptr)
+              {
+                fallback = nodelink.child(n);
+                break;
+              }
+            }
+          }
+          else
+          {
+            for(unsigned n = digit; n-- > 0;)
+            {
+              if(nodelink.child(n) != nullptr)
+              {
+                fallback = nodelink.child(n);
+                break;
+              }
+            }
+          }
+          node = nodelink.child(digit);
+        }
+        _closest_in<Dir>(fallback, rkey, ret);
+        if(ret != nullptr)
+        {
+          return ret;
+        }
+        /* Nothing in this bin, so the nearest in the nearest occupied bin */
+        if(Dir > 0)
+        {
+          for(unsigned n = bitidx + 1; n < _key_type_bits; n++)
+          {
+            if((node = head.child(n)) != nullptr)
+            {
+              _closest_in<Dir>(node, rkey, ret);
+              return ret;
+            }
+          }
+        }
+        else
+        {
+          for(unsigned n = bitidx; n-- > 0;)
+          {
+            if((node = head.child(n)) != nullptr)
+            {
+              _closest_in<Dir>(node, rkey, ret);
+              return ret;
+            }
+          }
+        }
+        return nullptr;
+      }
+
+#ifndef NDEBUG
+      size_type _triecheckvaliditybranch(const_pointer node, key_type lo, key_type hi, _digit_cursor digits) const noexcept
+      {
+        auto nodelink = _item_accessors(node);
+        const key_type nodekey = nodelink.key();
+        assert(nodekey >= lo && nodekey <= hi);
+        size_type count = 1;
+        if(digits.done())
+        {
+          for(unsigned n = 0; n < radix; n++)
+          {
+            assert(nodelink.child(n) == nullptr);
+          }
+          return count;
+        }
+        const unsigned shift = digits.shift;
+        (void) digits.next(nodekey);
+        for(unsigned n = 0; n < radix; n++)
+        {
+          if(auto *childnode = nodelink.child(n))
+          {
+            assert(_item_accessors(childnode).parent() == node);
+            key_type childlo, childhi;
+            if(shift >= stride)
+            {
+              childlo = lo | ((key_type) n << (shift - stride));
+              childhi = childlo | (((key_type) 1 << (shift - stride)) - 1);
+            }
+            else
+            {
+              childlo = lo | ((key_type) n >> (stride - shift));
+              childhi = childlo;
+            }
+            count += _triecheckvaliditybranch(childnode, childlo, childhi, digits);
+          }
+        }
+        return count;
+      }
+#endif
+    public:
+      //! Asserts that the index is internally consistent.
+      void triecheckvalidity() const noexcept
+      {
+#ifndef NDEBUG
+        auto head = _head_accessors();
+        size_type count = 0;
+        for(unsigned bitidx = 0; bitidx < _key_type_bits; bitidx++)
+        {
+          if(auto *node = head.child(bitidx))
+          {
+            auto nodelink = _item_accessors(node);
+            assert(nodelink.parent_is_index());
+            assert(nodelink.bit_index() == bitidx);
+            const key_type lo = (bitidx != 0) ? ((key_type) 1 << bitidx) : 0;
+            const key_type hi = (bitidx != 0) ? (lo | (lo - 1)) : 1;
+            count += _triecheckvaliditybranch(node, lo, hi, _digit_cursor(bitidx));
+          }
+        }
+        assert(count == head.size());
+#endif
+      }
+
+    private:
+      template <bool is_const, class Parent, class Pointer, class Reference> class iterator_
+      {
+        friend class multiway_trie;
+        template <bool _is_const, class _Parent, class _Pointer, class _Reference> friend class iterator_;
+        Parent *_parent{nullptr};
+        Pointer _p{nullptr};
+
+        constexpr iterator_(const Parent *parent, Pointer p) noexcept
+            : _parent(const_cast<Parent *>(parent))
+            , _p(p)
+        {
+        }
+
+      public:
+        using difference_type = typename Parent::difference_type;
+        using value_type = typename Parent::value_type;
+        using pointer = Pointer;
+        using reference = Reference;
+        using iterator_category = std::bidirectional_iterator_tag;
+        constexpr iterator_() noexcept = default;
+        // Implicit non-const to const iterator
+        QUICKCPPLIB_TEMPLATE(class _Parent, class _Pointer, class _Reference)
+        QUICKCPPLIB_TREQUIRES(
+        QUICKCPPLIB_TPRED(is_const &&std::is_same<typename std::remove_const<Parent>::type, _Parent>::value))
+        constexpr iterator_(const iterator_<false, _Parent, _Pointer, _Reference> &o) noexcept
+            : _parent(o._parent)
+            , _p(o._p)
+        {
+        }
+
+        explicit operator bool() const noexcept { return _parent != nullptr && _p != nullptr; }
+        bool operator!() const noexcept { return _parent == nullptr || _p == nullptr; }
+        Pointer operator->() const noexcept { return _p; }
+        bool operator==(const iterator_ &o) const noexcept { return _parent == o._parent && _p == o._p; }
+        bool operator!=(const iterator_ &o) const noexcept { return _parent != o._parent || _p != o._p; }
+        Reference operator*() const noexcept
+        {
+          if(_parent == nullptr || _p == nullptr)
+          {
+            abort();
+          }
+          return *_p;
+        }
+        iterator_ &operator++() noexcept
+        {
+          if(_parent != nullptr && _p != nullptr)
+          {
+            _p = const_cast<Pointer>(_parent->_trienext(_p));
+          }
+          return *this;
+        }
+        iterator_ operator++(int) noexcept
+        {
+          iterator_ ret(*this);
+          ++*this;
+          return ret;
+        }
+        iterator_ &operator--() noexcept
+        {
+          if(_parent != nullptr)
+          {
+            _p = const_cast<Pointer>((_p == nullptr) ? _parent->_triemax() : _parent->_trieprev(_p));
+          }
+          return *this;
+        }
+        iterator_ operator--(int) noexcept
+        {
+          iterator_ ret(*this);
+          --*this;
+          return ret;
+        }
+      };
+
+    public:
+      //! The iterator type
+      using iterator = iterator_<false, multiway_trie, pointer, reference>;
+      //! The const iterator type
+      using const_iterator = iterator_<true, const multiway_trie, const_pointer, const_reference>;
+      //! The reverse iterator type
+      using reverse_iterator = std::reverse_iterator<iterator>;
+      //! The const reverse iterator type
+      using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+      constexpr multiway_trie() { clear(); }
+      QUICKCPPLIB_TEMPLATE(class Arg, class... Args)
+      QUICKCPPLIB_TREQUIRES(QUICKCPPLIB_TPRED(std::is_constructible<Base, Arg, Args...>::value))
+      constexpr explicit multiway_trie(Arg &&arg, Args &&...args)
+          : Base(static_cast<Arg &&>(arg), static_cast<Args &&>(args)...)
+      {
+        clear();
+      }
+      multiway_trie(const multiway_trie &) = delete;
+      multiway_trie &operator=(const multiway_trie &) = delete;
+
+      //! True if the index is empty
+      QUICKCPPLIB_NODISCARD constexpr bool empty() const noexcept { return size() == 0; }
+      //! Returns the number of items in the index
+      constexpr size_type size() const noexcept { return _head_accessors().size(); }
+      //! Returns the maximum number of items in the index
+      constexpr size_type max_size() const noexcept { return _head_accessors().max_size(); }
+
+      //! Returns an iterator to the first item in the index.
+      iterator begin() noexcept { return iterator(this, _triemin()); }
+      //! Returns an iterator to the first item in the index.
+      const_iterator begin() const noexcept { return const_iterator(this, _triemin()); }
+      //! Returns an iterator to the item after the last in the index.
+      iterator end() noexcept { return iterator(this, nullptr); }
+      //! Returns an iterator to the item after the last in the index.
+      const_iterator end() const noexcept { return const_iterator(this, nullptr); }
+      //! Returns an iterator to the last item in the index.
+      reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+      //! Returns an iterator to the last item in the index.
+      const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+      //! Returns an iterator to the item before the first in the index.
+      reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+      //! Returns an iterator to the item before the first in the index.
+      const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+
+      //! Clears the index.
+      constexpr void clear() noexcept
+      {
+        auto head = _head_accessors();
+        for(unsigned n = 0; n < _key_type_bits; n++)
+        {
+          head.set_child(n, nullptr);
+        }
+        head.set_size(0);
+      }
+      //! Return how many items with key there are.
+      size_type count(key_type k) const noexcept { return nullptr != _triefind(k); }
+      /*! Inserts a new item, returning an iterator to the new item if the key is new. If there
+      is an item with that key already, returns an iterator to the existing item.
+
+      If the maximum number of items has been inserted, if C++ exceptions are disabled
+      or `QUICKCPPLIB_ALGORITHM_BITWISE_TRIE_DISABLE_EXCEPTION_THROWS != 0`, the returned iterator
+      is invalid if there is no more space. Otherwise it throws `std::length_error`.
+      */
+      iterator insert(pointer p)
+      {
+        if(size() == max_size())
+        {
+#if __cpp_exceptions && !QUICKCPPLIB_ALGORITHM_BITWISE_TRIE_DISABLE_EXCEPTION_THROWS
+          throw std::length_error("multiway_trie is full");
+#else
+          return end();
+#endif
+        }
+        return iterator(this, _trieinsert(p));
+      }
+      //! Erases an item, returning an iterator to the item after it.
+      iterator erase(const_iterator it) noexcept
+      {
+        if(it == end())
+        {
+          assert(it != end());
+          return end();
+        }
+        pointer p = const_cast<pointer>(it._p);
+        /* If I had children, the item taking my place is next, else whatever was next */
+        pointer next = const_cast<pointer>(_trienext(p));
+        if(pointer replacement = _trieremove(p))
+        {
+          next = replacement;
+        }
+        return iterator(this, next);
+      }
+      //! Erases an item.
+      void erase(pointer p) noexcept { _trieremove(p); }
+      //! Erases the item with the key.
+      iterator erase(key_type k) noexcept { return erase(find(k)); }
+      //! Finds an item
+      iterator find(key_type k) const noexcept { return iterator(this, _triefind(k)); }
+      //! True if the index contains the key
+      bool contains(key_type k) const noexcept { return nullptr != _triefind(k); }
+      /*! Finds either an item with identical key, or an item with a larger key. This is always
+      the item with the next largest key, as that costs no more than `O(depth)` here. `rounds` is
+      accepted for compatibility with `bitwise_trie`.
+      */
+      iterator find_equal_or_larger(key_type k, int64_t /*unused*/) const noexcept { return find_equal_or_next_largest(k); }
+      //! Finds either an item with identical key, or an item with the guaranteed next largest key.
+      iterator find_equal_or_next_largest(key_type k) const noexcept
+      {
+        return iterator(this, const_cast<pointer>(_trieclosest<1>(k)));
+      }
+      /*! Finds either an item with identical key, or an item with a smaller key. This is always
+      the item with the next smallest key. `rounds` is accepted for compatibility with `bitwise_trie`.
+      */
+      iterator find_equal_or_smaller(key_type k, int64_t /*unused*/) const noexcept { return find_equal_or_next_smallest(k); }
+      //! Finds either an item with identical key, or an item with the guaranteed next smallest key.
+      iterator find_equal_or_next_smallest(key_type k) const noexcept
+      {
+        return iterator(this, const_cast<pointer>(_trieclosest<-1>(k)));
+      }
+      //! Finds the item with the key not less than the key.
+      iterator lower_bound(key_type k) const noexcept { return find_equal_or_next_largest(k); }
+      //! Finds the item next larger than the key.
+      iterator upper_bound(key_type k) const noexcept
+      {
+        return (k == (key_type) -1) ? iterator(this, nullptr) : find_equal_or_next_largest(k + 1);
+      }
+    };
+  }  // namespace multiway_trie
+}  // namespace algorithm
+
+QUICKCPPLIB_NAMESPACE_END
+
+#endif
@@ -138,7 +138,9 @@ Requires assert() to work, so disables itself if NDEBUG is defined.
 #endif
 
 #ifdef __cplusplus
+#include <cstddef>
 #include <list>
+#include <memory>
 #if (defined(_MSC_VER) && _MSC_VER<=1500) || (defined(__GNUC__) && !defined(HAVE_CPP0X))
 // Doesn't have std::move<> by default, so define
 namespace std
@@ -209,6 +211,27 @@ static INLINE unsigned nedtriebitscanr(size_t value)
 #endif
 }
 
+static INLINE unsigned nedtriebitscanf(size_t value)
+{
+  if(!value) return 0;
+#if defined(_MSC_VER) && !defined(__cplusplus_cli)
+  {
+    unsigned long bitpos;
+#if defined(_M_IA64) || defined(_M_X64) || defined(WIN64) || defined(_WIN64) 
+    _BitScanForward64(&bitpos, value);
+#else
+    _BitScanForward(&bitpos, (unsigned) value);
+#endif
+    return (unsigned) bitpos;
+  }
+#elif defined(__GNUC__)
+  return (unsigned) __builtin_ctzl(value);
+#else
+  /* Isolate the lowest set bit and scan that */
+  return nedtriebitscanr(value & (0-value));
+#endif
+}
+
 #ifdef __cplusplus
 } /* Anonymous namespace */
 #endif
@@ -218,11 +241,13 @@ static INLINE unsigned nedtriebitscanr(size_t value)
 */
 #define NEDTRIE_INDEXBINS (8*sizeof(void *))
 /*! \def NEDTRIE_HEAD
-\brief Substitutes the type used to store the head of the trie.
+\brief Substitutes the type used to store the head of the trie. Which bins are occupied is
+also kept as a bitmask, so the next occupied bin is found with a single bitscan.
 */
 #define NEDTRIE_HEAD2(name, type) \
 struct name {                    \
   size_t count;                  \
+  size_t triebinmask;            /* bit x set if triebins[x] is non-null */ \
   type *triebins[NEDTRIE_INDEXBINS]; /* each containing (1<<x)<=bitscanrev(x)<(1<<(x+1)) */ \
   int nobbledir;                 \
 }
@@ -236,6 +261,38 @@ struct {                   \
   struct type *trie_child[2];         /* my children based on whether they are zero or one. */		\
   struct type *trie_prev, *trie_next; /* my siblings of identical key to me. */    \
 }
+/*! \def NEDTRIE_ENTRY_WITHKEY
+\brief Substitutes the type used to store the per-node trie information plus a cached copy of the
+node's key. Occupies 6*sizeof(size_t). Paired with NEDTRIE_LINKKEY() as the key function, walking
+the trie only ever touches the links, never the rest of the item. You must store the key into
+trie_key before inserting or searching with an item.
+*/
+#define NEDTRIE_ENTRY_WITHKEY(type) \
+struct {                   \
+  struct type *trie_parent;           /* parent element */		\
+  struct type *trie_child[2];         /* my children based on whether they are zero or one. */		\
+  struct type *trie_prev, *trie_next; /* my siblings of identical key to me. */    \
+  size_t trie_key;                    /* my key */ \
+}
+/*! \def NEDTRIE_SORTEDCURSOR
+\brief Substitutes the type of the cursor which NEDTRIE_FOREACH_SORTED keeps its state in. A
+node's key may be anywhere within the key range of its subtree rather than between its children,
+so nodes are carried down as pending into the half of the range their key is in, and returned
+by key once no subtree is left in that range. Both stacks are bounded by the depth of the trie,
+so the cursor is about 2Kb on 64 bit and nothing is allocated.
+*/
+#define NEDTRIE_SORTEDCURSOR struct nedtrie_sortedcursor_s
+struct nedtrie_sortedcursor_s {
+  void *item;                         /* the item last returned */
+  unsigned bin;                       /* the next bin to visit */
+  unsigned frames, pending;           /* how many entries are in frame[] and pendingnode[] */
+  struct {
+    void *node;                       /* a subtree still to visit, or null if only pending nodes remain */
+    size_t keybit;                    /* the key bit which chose this subtree */
+    unsigned pendingbegin;            /* this subtree's pending nodes begin here */
+  } frame[NEDTRIE_INDEXBINS+2];
+  void *pendingnode[NEDTRIE_INDEXBINS+2];
+};
 #define NEDTRIE_INITIALIZER(root)
 /*! \def NEDTRIE_INIT
 \brief Initialises a nedtrie for usage.
@@ -298,12 +355,26 @@ namespace nedtries {
     type *trie_child[2];		      /* my children based on whether they are zero or one. */		
     type *trie_prev, *trie_next;  /* my siblings of identical key to me. */
   };
+  template<class type> struct TrieLinkWithKey_t {
+    type *trie_parent;	          /* parent element */		
+    type *trie_child[2];		      /* my children based on whether they are zero or one. */		
+    type *trie_prev, *trie_next;  /* my siblings of identical key to me. */
+    size_t trie_key;              /* my key */
+  };
+  /* A key function which returns the key cached in a TrieLinkWithKey_t */
+  template<class type, size_t fieldoffset> size_t trielinkkey(const type *RESTRICT r)
+  {
+    return ((const TrieLinkWithKey_t<type> *RESTRICT)((size_t) r + fieldoffset))->trie_key;
+  }
   template<class trietype, class type, size_t fieldoffset, size_t (*keyfunct)(const type *RESTRICT)> DEBUGINLINE void triecheckvalidity(trietype *head);
   namespace testtrielinksize {
-    struct foo1; struct foo2;
+    struct foo1; struct foo2; struct foo3; struct foo4;
     struct foo1 { NEDTRIE_ENTRY(foo1) link; size_t n; };
     struct foo2 { TrieLink_t<foo2> link; size_t n; };
     static char test_sizeof_trielink_t_equal[sizeof(foo1)==sizeof(foo2)];
+    struct foo3 { NEDTRIE_ENTRY_WITHKEY(foo3) link; size_t n; };
+    struct foo4 { TrieLinkWithKey_t<foo4> link; size_t n; };
+    typedef char test_sizeof_trielinkwithkey_t_equal[(sizeof(foo3)==sizeof(foo4)) ? 1 : -1];
   }
 
 } /* namespace */
@@ -328,13 +399,14 @@ namespace nedtries {
     int keybitset;
 
     rlink=(TrieLink_t<type> *RESTRICT)((size_t) r + fieldoffset);
-    memset(rlink, 0, sizeof(TrieLink_t<type>));
+    memset(rlink, 0, sizeof(TrieLink_t<type>)); /* leaves any key cached in a TrieLinkWithKey_t alone */
     bitidx=nedtriebitscanr(rkey);
     assert(bitidx<NEDTRIE_INDEXBINS);
     if(!(node=head->triebins[bitidx]))
     { /* Bottom two bits set indicates a node hanging off of head */
       rlink->trie_parent=(type *RESTRICT)(size_t)(3|(bitidx<<2));
       head->triebins[bitidx]=r;
+      head->triebinmask|=(size_t) 1<<bitidx;
       goto end;
     }
     /* Avoid variable bit shifts where possible, their performance can suck */
@@ -379,13 +451,15 @@ end:
     unsigned bitidx; \
     int keybitset; \
 \
-    memset(&r->field, 0, sizeof(r->field)); \
+    /* Leave any key cached in a NEDTRIE_ENTRY_WITHKEY alone */ \
+    r->field.trie_parent=r->field.trie_child[0]=r->field.trie_child[1]=r->field.trie_prev=r->field.trie_next=0; \
     bitidx=nedtriebitscanr(rkey); \
     assert(bitidx<NEDTRIE_INDEXBINS); \
     if(!(node=head->triebins[bitidx])) \
     { /* Bottom two bits set indicates a node hanging off of head */ \
       r->field.trie_parent=(struct type *RESTRICT)(size_t)(3|(bitidx<<2)); \
       head->triebins[bitidx]=r; \
+      head->triebinmask|=(size_t) 1<<bitidx; \
       goto end; \
     } \
     /* Avoid variable bit shifts where possible, their performance can suck */ \
@@ -423,12 +497,40 @@ end: \
 }
 #endif /* NEDTRIEUSEMACROS */
 
+#ifdef __cplusplus
+namespace nedtries {
+  /* Inserts n items, as if by calling trieinsert() on each. */
+  template<class trietype, class type, size_t fieldoffset, size_t (*keyfunct)(const type *RESTRICT)> DEBUGINLINE void trieinsertbatch(trietype *RESTRICT head, type *const *items, size_t n)
+  {
+    size_t i;
+    for(i=0; i<n; i++)
+      trieinsert<trietype, type, fieldoffset, keyfunct>(head, items[i]);
+  }
+}
+#endif /* __cplusplus */
+#if NEDTRIEUSEMACROS
+#define NEDTRIE_GENERATE_INSERTBATCH(proto, name, type, field, keyfunct) \
+  proto INLINE void name##_NEDTRIE_INSERTBATCH(struct name *RESTRICT head, struct type *const *items, size_t n) \
+  { \
+    size_t i; \
+    for(i=0; i<n; i++) \
+      name##_NEDTRIE_INSERT(head, items[i]); \
+  }
+#else /* NEDTRIEUSEMACROS */
+#define NEDTRIE_GENERATE_INSERTBATCH(proto, name, type, field, keyfunct) \
+  proto INLINE void name##_NEDTRIE_INSERTBATCH(struct name *RESTRICT head, struct type *const *items, size_t n) \
+{ \
+  nedtries::trieinsertbatch<struct name, struct type, NEDTRIEFIELDOFFSET(type, field), keyfunct>(head, items, n); \
+}
+#endif /* NEDTRIEUSEMACROS */
+
 #ifdef __cplusplus
 namespace nedtries {
   template<class trietype, class type, size_t fieldoffset, size_t (*keyfunct)(const type *RESTRICT), int (*nobblefunct)(trietype *head)> DEBUGINLINE void trieremove(trietype *RESTRICT head, type *RESTRICT r)
   {
     type *RESTRICT node, **myaddrinparent=0;
     TrieLink_t<type> *RESTRICT nodelink, *RESTRICT childlink, *RESTRICT rlink;
+    size_t binbit=0;
     unsigned bitidx;
 
     rlink=(TrieLink_t<type> *RESTRICT)((size_t) r + fieldoffset);
@@ -456,6 +558,7 @@ namespace nedtries {
       assert(head->triebins[bitidx]==r);
       /* Set the node addr to be modified */
       myaddrinparent=&head->triebins[bitidx];
+      binbit=(size_t) 1<<bitidx;
     }
     else
     { /* Otherwise I am one of my parent's children */
@@ -509,6 +612,8 @@ namespace nedtries {
       }
     }
     *myaddrinparent=node;
+    /* If I was the last item in my bin, mark it unoccupied */
+    if(!node) head->triebinmask&=~binbit;
   functexit:
     head->count--;
 #if NEDTRIEDEBUG
@@ -522,6 +627,7 @@ namespace nedtries {
   proto INLINE void name##_NEDTRIE_REMOVE(struct name *RESTRICT head, struct type *RESTRICT r)		\
   { \
     struct type *RESTRICT node, **myaddrinparent=0; \
+    size_t binbit=0; \
     unsigned bitidx; \
 \
     /* Am I a leaf off the tree? */ \
@@ -546,6 +652,7 @@ namespace nedtries {
       assert(head->triebins[bitidx]==r); \
       /* Set the node addr to be modified */ \
       myaddrinparent=&head->triebins[bitidx]; \
+      binbit=(size_t) 1<<bitidx; \
     } \
     else \
     { /* Otherwise I am one of my parent's children */ \
@@ -594,6 +701,8 @@ namespace nedtries {
       } \
     } \
     *myaddrinparent=node; \
+    /* If I was the last item in my bin, mark it unoccupied */ \
+    if(!node) head->triebinmask&=~binbit; \
   functexit: \
     head->count--; \
   }
@@ -741,13 +850,13 @@ namespace nedtries {
     assert(binbitidx<NEDTRIE_INDEXBINS);
     do
     {
-      size_t retkey=(size_t)-1;
+      size_t retkey=(size_t)-1, binmask;
       unsigned bitidx;
       /* Keeping raising the bin until we find a larger key */
-      while(binbitidx<NEDTRIE_INDEXBINS && !(node=head->triebins[binbitidx]))
-        binbitidx++;
-      if(binbitidx>=NEDTRIE_INDEXBINS)
+      if(binbitidx>=NEDTRIE_INDEXBINS || !(binmask=head->triebinmask & ((size_t)-1<<binbitidx)))
         return 0;
+      binbitidx=nedtriebitscanf(binmask);
+      node=head->triebins[binbitidx];
       bitidx=binbitidx;
       /* Avoid variable bit shifts where possible, their performance can suck */
       keybit=(size_t) 1<<bitidx;
@@ -821,13 +930,13 @@ namespace nedtries {
     assert(binbitidx<NEDTRIE_INDEXBINS); \
     do \
     { \
-      size_t retkey=(size_t)-1; \
+      size_t retkey=(size_t)-1, binmask; \
       unsigned bitidx; \
       /* Keeping raising the bin until we find a larger key */ \
-      while(binbitidx<NEDTRIE_INDEXBINS && !(node=head->triebins[binbitidx])) \
-        binbitidx++; \
-      if(binbitidx>=NEDTRIE_INDEXBINS) \
+      if(binbitidx>=NEDTRIE_INDEXBINS || !(binmask=head->triebinmask & ((size_t)-1<<binbitidx))) \
         return 0; \
+      binbitidx=nedtriebitscanf(binmask); \
+      node=head->triebins[binbitidx]; \
       bitidx=binbitidx; \
       /* Avoid variable bit shifts where possible, their performance can suck */ \
       keybit=(size_t) 1<<bitidx; \
@@ -896,16 +1005,15 @@ namespace nedtries {
   {
     const type *RESTRICT node=0, *RESTRICT child;
     const TrieLink_t<type> *RESTRICT nodelink;
-    unsigned bitidx;
     if(!head->count) return 0;
     if(!dir)
     { /* He wants min */
-      for(bitidx=0; bitidx<NEDTRIE_INDEXBINS && !(node=head->triebins[bitidx]); bitidx++);
+      node=head->triebins[nedtriebitscanf(head->triebinmask)];
       assert(node);
       return (type *) node;
     }
     /* He wants max */
-    for(bitidx=NEDTRIE_INDEXBINS-1; bitidx<NEDTRIE_INDEXBINS && !(node=head->triebins[bitidx]); bitidx--);
+    node=head->triebins[nedtriebitscanr(head->triebinmask)];
     assert(node);
     nodelink=(const TrieLink_t<type> *RESTRICT)((size_t) node + fieldoffset);
     while((child=nodelink->trie_child[1] ? nodelink->trie_child[1] : nodelink->trie_child[0]))
@@ -928,16 +1036,15 @@ namespace nedtries {
   proto INLINE struct type * name##_NEDTRIE_MINMAX(struct name *RESTRICT head, const unsigned dir)		\
   { \
     struct type *RESTRICT node=0, *RESTRICT child; \
-    unsigned bitidx; \
     if(!head->count) return 0; \
     if(!dir) \
     { /* He wants min */ \
-      for(bitidx=0; bitidx<NEDTRIE_INDEXBINS && !(node=head->triebins[bitidx]); bitidx++); \
+      node=head->triebins[nedtriebitscanf(head->triebinmask)]; \
       assert(node); \
       return node; \
     } \
     /* He wants max */ \
-    for(bitidx=NEDTRIE_INDEXBINS-1; bitidx<NEDTRIE_INDEXBINS && !(node=head->triebins[bitidx]); bitidx--); \
+    node=head->triebins[nedtriebitscanr(head->triebinmask)]; \
     assert(node); \
     while((child=node->field.trie_child[1] ? node->field.trie_child[1] : node->field.trie_child[0])) \
     { \
@@ -1007,14 +1114,15 @@ namespace nedtries {
   {
     const type *RESTRICT node=0, *RESTRICT child;
     const TrieLink_t<type> *RESTRICT nodelink, *RESTRICT rlink=0;
+    size_t binmask;
     unsigned bitidx;
 
     if((node=triebranchprev<trietype, type, fieldoffset, keyfunct>(r, &rlink)) || !rlink) return (type *) node;
     /* I have reached the top of my trie, so on to prev bin */
     bitidx=(unsigned)(((size_t) rlink->trie_parent)>>2);
     assert(head->triebins[bitidx]==r);
-    for(bitidx--; bitidx<NEDTRIE_INDEXBINS && !(node=head->triebins[bitidx]); bitidx--);
-    if(bitidx>=NEDTRIE_INDEXBINS) return 0;
+    if(!(binmask=head->triebinmask & (((size_t) 1<<bitidx)-1))) return 0;
+    node=head->triebins[nedtriebitscanr(binmask)];
     nodelink=(const TrieLink_t<type> *RESTRICT)((size_t) node + fieldoffset);
     /* Follow child[1] preferentially downwards */
     while((child=nodelink->trie_child[1] ? nodelink->trie_child[1] : nodelink->trie_child[0]))
@@ -1072,14 +1180,15 @@ namespace nedtries {
   proto INLINE struct type * name##_NEDTRIE_PREV(struct name *RESTRICT head, struct type *RESTRICT r)		\
   { \
     struct type *RESTRICT node=0, *RESTRICT child; \
+    size_t binmask; \
     unsigned bitidx; \
 \
     if((node=name##_NEDTRIE_BRANCHPREV(&r))) return node; \
     /* I have reached the top of my trie, so on to prev bin */ \
     bitidx=(unsigned)(((size_t) r->field.trie_parent)>>2); \
     assert(head->triebins[bitidx]==r); \
-    for(bitidx--; bitidx<NEDTRIE_INDEXBINS && !(node=head->triebins[bitidx]); bitidx--); \
-    if(bitidx>=NEDTRIE_INDEXBINS) return 0; \
+    if(!(binmask=head->triebinmask & (((size_t) 1<<bitidx)-1))) return 0; \
+    node=head->triebins[nedtriebitscanr(binmask)]; \
     /* Follow child[1] preferentially downwards */ \
     while((child=node->field.trie_child[1] ? node->field.trie_child[1] : node->field.trie_child[0])) \
     { \
@@ -1145,14 +1254,14 @@ namespace nedtries {
   {
     const type *RESTRICT node;
     const TrieLink_t<type> *RESTRICT rlink=0;
+    size_t binmask;
     unsigned bitidx;
 
     if((node=triebranchnext<trietype, type, fieldoffset, keyfunct>(r, &rlink))) return (type *) node;
     /* I have reached the top of my trie, so on to next bin */
     bitidx=(unsigned)(((size_t) rlink->trie_parent)>>2);
-    for(bitidx++; bitidx<NEDTRIE_INDEXBINS && !(node=head->triebins[bitidx]); bitidx++);
-    if(bitidx>=NEDTRIE_INDEXBINS) return 0;
-    return (type *) node;
+    if(!(binmask=head->triebinmask & ((size_t)-2<<bitidx))) return 0;
+    return (type *) head->triebins[nedtriebitscanf(binmask)];
   }
 }
 #endif /* __cplusplus */
@@ -1191,15 +1300,15 @@ namespace nedtries {
   proto INLINE struct type * name##_NEDTRIE_NEXT(struct name *RESTRICT head, struct type *RESTRICT r)		\
   { \
     struct type *RESTRICT node; \
+    size_t binmask; \
     unsigned bitidx; \
 \
     if((node=name##_NEDTRIE_BRANCHNEXT(&r))) return node; \
     /* I have reached the top of my trie, so on to next bin */ \
     bitidx=(unsigned)(((size_t) r->field.trie_parent)>>2); \
     assert(head->triebins[bitidx]==r); \
-    for(bitidx++; bitidx<NEDTRIE_INDEXBINS && !(node=head->triebins[bitidx]); bitidx++); \
-    if(bitidx>=NEDTRIE_INDEXBINS) return 0; \
-    return node; \
+    if(!(binmask=head->triebinmask & ((size_t)-2<<bitidx))) return 0; \
+    return head->triebins[nedtriebitscanf(binmask)]; \
   }
 #else /* NEDTRIEUSEMACROS */
 #define NEDTRIE_GENERATE_NEXT(proto, name, type, field, keyfunct) \
@@ -1213,30 +1322,68 @@ namespace nedtries {
 namespace nedtries {
   template<class trietype, class type, size_t fieldoffset, size_t (*keyfunct)(const type *RESTRICT)> DEBUGINLINE type *trieNfind(const trietype *RESTRICT head, const type *RESTRICT r)
   {
-    const type *RESTRICT node=0, *RESTRICT ret=trieCfind<trietype, type, fieldoffset, keyfunct>(head, r, INT_MAX), *RESTRICT stop;
-    const TrieLink_t<type> *RESTRICT rlink;
-    size_t rkey=keyfunct(r), retkey, nodekey;
-
-    if(!ret) return 0;
-    if(!(retkey=keyfunct(ret)-rkey)) return (type *) ret;
-    /* Cfind basically does a find but if it doesn't find an exact match it early outs
-    with the closest result it found during the find. As nodes with children have a key
-    which is only guaranteed to be correct under its parent's constraints and has nothing
-    to do with its children, there may be a closer key in any of the children of the node
-    returned. Hence we iterate the local subbranch, looking for closer fits. */
-    rlink=(const TrieLink_t<type> *RESTRICT)((size_t) ret + fieldoffset);
-    stop=rlink->trie_parent;
-    for(node=triebranchnext<trietype, type, fieldoffset, keyfunct>(ret, 0); node && node!=stop; node=triebranchnext<trietype, type, fieldoffset, keyfunct>(node, 0))
+    const type *RESTRICT node, *RESTRICT childnode, *RESTRICT larger, *RESTRICT ret=0;
+    const TrieLink_t<type> *RESTRICT nodelink, *RESTRICT retlink;
+    size_t rkey=keyfunct(r), retkey=(size_t)-1, keybit, nodekey, binmask;
+    unsigned bitidx;
+    int keybitset;
+
+    if(!head->count) return 0;
+    bitidx=nedtriebitscanr(rkey);
+    assert(bitidx<NEDTRIE_INDEXBINS);
+    for(;;)
     {
-      nodekey=keyfunct(node);
-      /* If nodekey is a closer fit to search key, mark as best result so far */
-      if(nodekey>=rkey && nodekey-rkey<retkey)
+      if((node=head->triebins[bitidx]))
       {
-        ret=node;
-        retkey=nodekey-rkey;
+        larger=0;
+        /* Avoid variable bit shifts where possible, their performance can suck */
+        keybit=(size_t) 1<<bitidx;
+        for(;;node=childnode)
+        {
+          nodelink=(const TrieLink_t<type> *RESTRICT)((size_t) node + fieldoffset);
+          nodekey=keyfunct(node);
+          /* If nodekey is a closer fit to search key, mark as best result so far */
+          if(nodekey>=rkey && nodekey-rkey<retkey)
+          {
+            ret=node;
+            retkey=nodekey-rkey;
+            if(!retkey)
+            {
+              larger=0;
+              break;
+            }
+          }
+          /* Which child branch should we check? */
+          keybit>>=1;
+          keybitset=!!(rkey&keybit);
+          /* Every key under a one child we pass over is larger than rkey, and the deepest
+          such child holds the smallest of them */
+          if(!keybitset && nodelink->trie_child[1])
+            larger=nodelink->trie_child[1];
+          childnode=nodelink->trie_child[keybitset];
+          if(!childnode) break;
+        }
+        /* Walk down the smallest side of the deepest larger branch */
+        for(node=larger; node; node=nodelink->trie_child[0] ? nodelink->trie_child[0] : nodelink->trie_child[1])
+        {
+          nodelink=(const TrieLink_t<type> *RESTRICT)((size_t) node + fieldoffset);
+          nodekey=keyfunct(node);
+          if(nodekey-rkey<retkey)
+          {
+            ret=node;
+            retkey=nodekey-rkey;
+          }
+        }
+        if(ret) break;
       }
-    }
-    return (type *) ret;
+      /* If we didn't find any node larger than rkey, move up to the next
+         occupied bin and look for the smallest possible key in that */
+      if(!(binmask=head->triebinmask & ((size_t)-2<<bitidx))) return 0;
+      bitidx=nedtriebitscanf(binmask);
+      rkey=(size_t) 1<<bitidx;
+    }
+    retlink=(const TrieLink_t<type> *RESTRICT)((size_t) ret + fieldoffset);
+    return retlink->trie_next ? retlink->trie_next : (type *) ret;
   }
 }
 #endif /* __cplusplus */
@@ -1244,28 +1391,64 @@ namespace nedtries {
 #define NEDTRIE_GENERATE_NFIND(proto, name, type, field, keyfunct) \
   proto INLINE struct type * name##_NEDTRIE_NFIND(struct name *RESTRICT head, struct type *RESTRICT r)		\
   { \
-    struct type *RESTRICT node=0, *RESTRICT ret=name##_NEDTRIE_CFIND(head, r, INT_MAX), *RESTRICT stop; \
-    size_t rkey=keyfunct(r), retkey, nodekey; \
-    \
-    if(!ret) return 0; \
-    if(!(retkey=keyfunct(ret)-rkey)) return ret; \
-    /* Cfind basically does a find but if it doesn't find an exact match it early outs    \
-    with the closest result it found during the find. As nodes with children have a key   \
-    which is only guaranteed to be correct under its parent's constraints and has nothing \
-    to do with its children, there may be a closer key in any of the children of the node \
-    returned. Hence we iterate the local subbranch, looking for closer fits. */           \
-    stop=r->field.trie_parent; \
-    for(node=ret, node=name##_NEDTRIE_BRANCHNEXT(&node); node && node!=stop; node=name##_NEDTRIE_BRANCHNEXT(&node)) \
+    struct type *RESTRICT node, *RESTRICT childnode, *RESTRICT larger, *RESTRICT ret=0; \
+    size_t rkey=keyfunct(r), retkey=(size_t)-1, keybit, nodekey, binmask; \
+    unsigned bitidx; \
+    int keybitset; \
+ \
+    if(!head->count) return 0; \
+    bitidx=nedtriebitscanr(rkey); \
+    assert(bitidx<NEDTRIE_INDEXBINS); \
+    for(;;) \
     { \
-      nodekey=keyfunct(node); \
-      /* If nodekey is a closer fit to search key, mark as best result so far */ \
-      if(nodekey>=rkey && nodekey-rkey<retkey) \
+      if((node=head->triebins[bitidx])) \
       { \
-        ret=node; \
-        retkey=nodekey-rkey; \
+        larger=0; \
+        /* Avoid variable bit shifts where possible, their performance can suck */ \
+        keybit=(size_t) 1<<bitidx; \
+        for(;;node=childnode) \
+        { \
+          nodekey=keyfunct(node); \
+          /* If nodekey is a closer fit to search key, mark as best result so far */ \
+          if(nodekey>=rkey && nodekey-rkey<retkey) \
+          { \
+            ret=node; \
+            retkey=nodekey-rkey; \
+            if(!retkey) \
+            { \
+              larger=0; \
+              break; \
+            } \
+          } \
+          /* Which child branch should we check? */ \
+          keybit>>=1; \
+          keybitset=!!(rkey&keybit); \
+          /* Every key under a one child we pass over is larger than rkey, and the deepest \
+          such child holds the smallest of them */ \
+          if(!keybitset && node->field.trie_child[1]) \
+            larger=node->field.trie_child[1]; \
+          childnode=node->field.trie_child[keybitset]; \
+          if(!childnode) break; \
+        } \
+        /* Walk down the smallest side of the deepest larger branch */ \
+        for(node=larger; node; node=node->field.trie_child[0] ? node->field.trie_child[0] : node->field.trie_child[1]) \
+        { \
+          nodekey=keyfunct(node); \
+          if(nodekey-rkey<retkey) \
+          { \
+            ret=node; \
+            retkey=nodekey-rkey; \
+          } \
+        } \
+        if(ret) break; \
       } \
+      /* If we didn't find any node larger than rkey, move up to the next \
+         occupied bin and look for the smallest possible key in that */ \
+      if(!(binmask=head->triebinmask & ((size_t)-2<<bitidx))) return 0; \
+      bitidx=nedtriebitscanf(binmask); \
+      rkey=(size_t) 1<<bitidx; \
     } \
-    return ret; \
+    return ret->field.trie_next ? ret->field.trie_next : ret; \
   }
 #else /* NEDTRIEUSEMACROS */
 #define NEDTRIE_GENERATE_NFIND(proto, name, type, field, keyfunct) \
@@ -1276,12 +1459,343 @@ namespace nedtries {
 #endif /* NEDTRIEUSEMACROS */
 
 
+#ifdef __cplusplus
+namespace nedtries {
+  template<class trietype, class type, size_t fieldoffset, size_t (*keyfunct)(const type *RESTRICT)> DEBUGINLINE type *trieCfindsmaller(const trietype *RESTRICT head, const type *RESTRICT r, int rounds)
+  {
+    const type *RESTRICT node, *RESTRICT childnode, *RESTRICT smaller, *RESTRICT ret=0;
+    const TrieLink_t<type> *RESTRICT nodelink, *RESTRICT retlink;
+    size_t rkey=keyfunct(r), retkey=(size_t)-1, keybit, nodekey, binmask;
+    unsigned bitidx;
+    int keybitset;
+
+    if(!head->count) return 0;
+    bitidx=nedtriebitscanr(rkey);
+    assert(bitidx<NEDTRIE_INDEXBINS);
+    for(;;)
+    {
+      if((node=head->triebins[bitidx]))
+      {
+        smaller=0;
+        /* Avoid variable bit shifts where possible, their performance can suck */
+        keybit=(size_t) 1<<bitidx;
+        for(;;node=childnode)
+        {
+          nodelink=(const TrieLink_t<type> *RESTRICT)((size_t) node + fieldoffset);
+          nodekey=keyfunct(node);
+          /* If nodekey is a closer fit to search key, mark as best result so far */
+          if(nodekey<=rkey && rkey-nodekey<retkey)
+          {
+            ret=node;
+            retkey=rkey-nodekey;
+          }
+          if(ret && (!retkey || rounds--<=0))
+          {
+            smaller=0;
+            break;
+          }
+          /* Which child branch should we check? */
+          keybit>>=1;
+          keybitset=!!(rkey&keybit);
+          /* Every key under a zero child we pass over is smaller than rkey, and the deepest
+          such child holds the largest of them */
+          if(keybitset && nodelink->trie_child[0])
+            smaller=nodelink->trie_child[0];
+          childnode=nodelink->trie_child[keybitset];
+          if(!childnode) break;
+        }
+        /* Walk down the largest side of the deepest smaller branch */
+        for(node=smaller; node; node=nodelink->trie_child[1] ? nodelink->trie_child[1] : nodelink->trie_child[0])
+        {
+          nodelink=(const TrieLink_t<type> *RESTRICT)((size_t) node + fieldoffset);
+          nodekey=keyfunct(node);
+          if(rkey-nodekey<retkey)
+          {
+            ret=node;
+            retkey=rkey-nodekey;
+          }
+          if(rounds--<=0) break;
+        }
+        if(ret) break;
+      }
+      /* If we didn't find any node smaller than rkey, drop down to the next
+         occupied bin and look for the largest possible key in that */
+      if(!(binmask=head->triebinmask & (((size_t) 1<<bitidx)-1))) return 0;
+      bitidx=nedtriebitscanr(binmask);
+      rkey=((size_t) 2<<bitidx)-1;
+    }
+    retlink=(const TrieLink_t<type> *RESTRICT)((size_t) ret + fieldoffset);
+    return retlink->trie_next ? retlink->trie_next : (type *) ret;
+  }
+}
+#endif /* __cplusplus */
+#if NEDTRIEUSEMACROS
+#define NEDTRIE_GENERATE_CFINDSMALLER(proto, name, type, field, keyfunct) \
+  proto INLINE struct type * name##_NEDTRIE_CFINDSMALLER(struct name *RESTRICT head, struct type *RESTRICT r, int rounds)		\
+  { \
+    struct type *RESTRICT node, *RESTRICT childnode, *RESTRICT smaller, *RESTRICT ret=0; \
+    size_t rkey=keyfunct(r), retkey=(size_t)-1, keybit, nodekey, binmask; \
+    unsigned bitidx; \
+    int keybitset; \
+ \
+    if(!head->count) return 0; \
+    bitidx=nedtriebitscanr(rkey); \
+    assert(bitidx<NEDTRIE_INDEXBINS); \
+    for(;;) \
+    { \
+      if((node=head->triebins[bitidx])) \
+      { \
+        smaller=0; \
+        /* Avoid variable bit shifts where possible, their performance can suck */ \
+        keybit=(size_t) 1<<bitidx; \
+        for(;;node=childnode) \
+        { \
+          nodekey=keyfunct(node); \
+          /* If nodekey is a closer fit to search key, mark as best result so far */ \
+          if(nodekey<=rkey && rkey-nodekey<retkey) \
+          { \
+            ret=node; \
+            retkey=rkey-nodekey; \
+          } \
+          if(ret && (!retkey || rounds--<=0)) \
+          { \
+            smaller=0; \
+            break; \
+          } \
+          /* Which child branch should we check? */ \
+          keybit>>=1; \
+          keybitset=!!(rkey&keybit); \
+          /* Every key under a zero child we pass over is smaller than rkey, and the deepest \
+          such child holds the largest of them */ \
+          if(keybitset && node->field.trie_child[0]) \
+            smaller=node->field.trie_child[0]; \
+          childnode=node->field.trie_child[keybitset]; \
+          if(!childnode) break; \
+        } \
+        /* Walk down the largest side of the deepest smaller branch */ \
+        for(node=smaller; node; node=node->field.trie_child[1] ? node->field.trie_child[1] : node->field.trie_child[0]) \
+        { \
+          nodekey=keyfunct(node); \
+          if(rkey-nodekey<retkey) \
+          { \
+            ret=node; \
+            retkey=rkey-nodekey; \
+          } \
+          if(rounds--<=0) break; \
+        } \
+        if(ret) break; \
+      } \
+      /* If we didn't find any node smaller than rkey, drop down to the next \
+         occupied bin and look for the largest possible key in that */ \
+      if(!(binmask=head->triebinmask & (((size_t) 1<<bitidx)-1))) return 0; \
+      bitidx=nedtriebitscanr(binmask); \
+      rkey=((size_t) 2<<bitidx)-1; \
+    } \
+    return ret->field.trie_next ? ret->field.trie_next : ret; \
+  }
+#else /* NEDTRIEUSEMACROS */
+#define NEDTRIE_GENERATE_CFINDSMALLER(proto, name, type, field, keyfunct) \
+  proto INLINE struct type * name##_NEDTRIE_CFINDSMALLER(struct name *RESTRICT head, struct type *RESTRICT r, int rounds)		\
+{ \
+  return nedtries::trieCfindsmaller<struct name, struct type, NEDTRIEFIELDOFFSET(type, field), keyfunct>(head, r, rounds); \
+}
+#endif /* NEDTRIEUSEMACROS */
+
+#ifdef __cplusplus
+namespace nedtries {
+  template<class trietype, class type, size_t fieldoffset, size_t (*keyfunct)(const type *RESTRICT)> DEBUGINLINE type *triesortednext(const trietype *RESTRICT head, struct nedtrie_sortedcursor_s *RESTRICT c)
+  {
+    const type *RESTRICT node;
+    const TrieLink_t<type> *RESTRICT nodelink;
+    size_t keybit, binmask;
+    unsigned begin, mid, n;
+    void *swap;
+
+    /* Items with the same key follow the one last returned */
+    if(c->item)
+    {
+      nodelink=(const TrieLink_t<type> *RESTRICT)((size_t) c->item + fieldoffset);
+      if(nodelink->trie_next) return (type *)(c->item=(void *) nodelink->trie_next);
+    }
+    for(;;)
+    {
+      if(!c->frames)
+      {
+        /* Start on the next occupied bin */
+        if(c->bin>=NEDTRIE_INDEXBINS || !(binmask=head->triebinmask & ((size_t)-1<<c->bin)))
+          return (type *)(c->item=0);
+        c->bin=nedtriebitscanf(binmask);
+        c->frame[0].node=(void *) head->triebins[c->bin];
+        c->frame[0].keybit=(size_t) 1<<c->bin;
+        c->frame[0].pendingbegin=0;
+        c->frames=1;
+        c->pending=0;
+        c->bin++;
+        continue;
+      }
+      begin=c->frame[--c->frames].pendingbegin;
+      if(!(node=(const type *) c->frame[c->frames].node))
+      {
+        /* No subtree is left in this key range, so return its pending nodes smallest key first */
+        for(mid=begin, n=begin+1; n<c->pending; n++)
+        {
+          if(keyfunct((const type *) c->pendingnode[n])<keyfunct((const type *) c->pendingnode[mid]))
+            mid=n;
+        }
+        node=(const type *) c->pendingnode[mid];
+        c->pendingnode[mid]=c->pendingnode[--c->pending];
+        if(c->pending!=begin) c->frames++;
+        return (type *)(c->item=(void *) node);
+      }
+      nodelink=(const TrieLink_t<type> *RESTRICT)((size_t) node + fieldoffset);
+      keybit=c->frame[c->frames].keybit>>1;
+      assert(c->pending<NEDTRIE_INDEXBINS+2);
+      c->pendingnode[c->pending++]=(void *) node;
+      /* Pending nodes in the upper half of the range go first, as they are visited last */
+      for(mid=begin, n=begin; n<c->pending; n++)
+      {
+        if(keyfunct((const type *) c->pendingnode[n]) & keybit)
+        {
+          swap=c->pendingnode[mid];
+          c->pendingnode[mid++]=c->pendingnode[n];
+          c->pendingnode[n]=swap;
+        }
+      }
+      assert(c->frames+2<=NEDTRIE_INDEXBINS+2);
+      if(nodelink->trie_child[1] || mid!=begin)
+      {
+        c->frame[c->frames].node=(void *) nodelink->trie_child[1];
+        c->frame[c->frames].keybit=keybit;
+        c->frame[c->frames++].pendingbegin=begin;
+      }
+      if(nodelink->trie_child[0] || mid!=c->pending)
+      {
+        c->frame[c->frames].node=(void *) nodelink->trie_child[0];
+        c->frame[c->frames].keybit=keybit;
+        c->frame[c->frames++].pendingbegin=mid;
+      }
+    }
+  }
+  template<class trietype, class type, size_t fieldoffset, size_t (*keyfunct)(const type *RESTRICT)> DEBUGINLINE type *triesortedmin(const trietype *RESTRICT head, struct nedtrie_sortedcursor_s *RESTRICT c)
+  {
+    c->item=0;
+    c->bin=0;
+    c->frames=0;
+    c->pending=0;
+    return triesortednext<trietype, type, fieldoffset, keyfunct>(head, c);
+  }
+}
+#endif /* __cplusplus */
+#if NEDTRIEUSEMACROS
+#define NEDTRIE_GENERATE_SORTED(proto, name, type, field, keyfunct) \
+  proto INLINE struct type * name##_NEDTRIE_SORTEDNEXT(struct name *RESTRICT head, struct nedtrie_sortedcursor_s *RESTRICT c)		\
+  { \
+    struct type *RESTRICT node; \
+    size_t keybit, binmask; \
+    unsigned begin, mid, n; \
+    void *swap; \
+ \
+    /* Items with the same key follow the one last returned */ \
+    if(c->item && ((struct type *) c->item)->field.trie_next) \
+      return (struct type *)(c->item=((struct type *) c->item)->field.trie_next); \
+    for(;;) \
+    { \
+      if(!c->frames) \
+      { \
+        /* Start on the next occupied bin */ \
+        if(c->bin>=NEDTRIE_INDEXBINS || !(binmask=head->triebinmask & ((size_t)-1<<c->bin))) \
+          return (struct type *)(c->item=0); \
+        c->bin=nedtriebitscanf(binmask); \
+        c->frame[0].node=head->triebins[c->bin]; \
+        c->frame[0].keybit=(size_t) 1<<c->bin; \
+        c->frame[0].pendingbegin=0; \
+        c->frames=1; \
+        c->pending=0; \
+        c->bin++; \
+        continue; \
+      } \
+      begin=c->frame[--c->frames].pendingbegin; \
+      if(!(node=(struct type *) c->frame[c->frames].node)) \
+      { \
+        /* No subtree is left in this key range, so return its pending nodes smallest key first */ \
+        for(mid=begin, n=begin+1; n<c->pending; n++) \
+        { \
+          if(keyfunct((struct type *) c->pendingnode[n])<keyfunct((struct type *) c->pendingnode[mid])) \
+            mid=n; \
+        } \
+        node=(struct type *) c->pendingnode[mid]; \
+        c->pendingnode[mid]=c->pendingnode[--c->pending]; \
+        if(c->pending!=begin) c->frames++; \
+        return (struct type *)(c->item=node); \
+      } \
+      keybit=c->frame[c->frames].keybit>>1; \
+      assert(c->pending<NEDTRIE_INDEXBINS+2); \
+      c->pendingnode[c->pending++]=node; \
+      /* Pending nodes in the upper half of the range go first, as they are visited last */ \
+      for(mid=begin, n=begin; n<c->pending; n++) \
+      { \
+        if(keyfunct((struct type *) c->pendingnode[n]) & keybit) \
+        { \
+          swap=c->pendingnode[mid]; \
+          c->pendingnode[mid++]=c->pendingnode[n]; \
+          c->pendingnode[n]=swap; \
+        } \
+      } \
+      assert(c->frames+2<=NEDTRIE_INDEXBINS+2); \
+      if(node->field.trie_child[1] || mid!=begin) \
+      { \
+        c->frame[c->frames].node=node->field.trie_child[1]; \
+        c->frame[c->frames].keybit=keybit; \
+        c->frame[c->frames++].pendingbegin=begin; \
+      } \
+      if(node->field.trie_child[0] || mid!=c->pending) \
+      { \
+        c->frame[c->frames].node=node->field.trie_child[0]; \
+        c->frame[c->frames].keybit=keybit; \
+        c->frame[c->frames++].pendingbegin=mid; \
+      } \
+    } \
+  } \
+  proto INLINE struct type * name##_NEDTRIE_SORTEDMIN(struct name *RESTRICT head, struct nedtrie_sortedcursor_s *RESTRICT c)		\
+  { \
+    c->item=0; \
+    c->bin=0; \
+    c->frames=0; \
+    c->pending=0; \
+    return name##_NEDTRIE_SORTEDNEXT(head, c); \
+  }
+#else /* NEDTRIEUSEMACROS */
+#define NEDTRIE_GENERATE_SORTED(proto, name, type, field, keyfunct) \
+  proto INLINE struct type * name##_NEDTRIE_SORTEDNEXT(struct name *RESTRICT head, struct nedtrie_sortedcursor_s *RESTRICT c)		\
+{ \
+  return nedtries::triesortednext<struct name, struct type, NEDTRIEFIELDOFFSET(type, field), keyfunct>(head, c); \
+} \
+  proto INLINE struct type * name##_NEDTRIE_SORTEDMIN(struct name *RESTRICT head, struct nedtrie_sortedcursor_s *RESTRICT c)		\
+{ \
+  return nedtries::triesortedmin<struct name, struct type, NEDTRIEFIELDOFFSET(type, field), keyfunct>(head, c); \
+}
+#endif /* NEDTRIEUSEMACROS */
+
+/*! \def NEDTRIE_GENERATE_LINKKEY
+\brief Substitutes a key function returning the key cached in a NEDTRIE_ENTRY_WITHKEY field. Use it
+before NEDTRIE_GENERATE, passing NEDTRIE_LINKKEY(name) as its key function. In C++ the key
+function is a template argument, which before C++11 must have external linkage, so pass a
+proto of extern rather than static there.
+*/
+#define NEDTRIE_GENERATE_LINKKEY(proto, name, type, field) \
+  proto INLINE size_t name##_NEDTRIE_LINKKEY(const struct type *RESTRICT r) { return r->field.trie_key; }
+/*! \def NEDTRIE_LINKKEY
+\brief The key function generated by NEDTRIE_GENERATE_LINKKEY.
+*/
+#define NEDTRIE_LINKKEY(name)            name##_NEDTRIE_LINKKEY
+
 /*! \def NEDTRIE_GENERATE
 \brief Substitutes a set of nedtrie implementation function definitions specialised according to type.
 */
 #define NEDTRIE_GENERATE(proto, name, type, field, keyfunct, nobblefunct) \
   NEDTRIE_GENERATE_NOBBLES  (proto, name, type, field, keyfunct) \
   NEDTRIE_GENERATE_INSERT   (proto, name, type, field, keyfunct) \
+  NEDTRIE_GENERATE_INSERTBATCH(proto, name, type, field, keyfunct) \
   NEDTRIE_GENERATE_REMOVE   (proto, name, type, field, keyfunct, nobblefunct) \
   NEDTRIE_GENERATE_FIND     (proto, name, type, field, keyfunct) \
   NEDTRIE_GENERATE_EXACTFIND(proto, name, type, field, keyfunct) \
@@ -1290,6 +1804,8 @@ namespace nedtries {
   NEDTRIE_GENERATE_PREV     (proto, name, type, field, keyfunct) \
   NEDTRIE_GENERATE_NEXT     (proto, name, type, field, keyfunct) \
   NEDTRIE_GENERATE_NFIND    (proto, name, type, field, keyfunct) \
+  NEDTRIE_GENERATE_CFINDSMALLER(proto, name, type, field, keyfunct) \
+  NEDTRIE_GENERATE_SORTED   (proto, name, type, field, keyfunct) \
   proto INLINE struct type * name##_NEDTRIE_PREVLEAF(struct type *r) { return (r)->field.trie_prev; } \
   proto INLINE struct type * name##_NEDTRIE_NEXTLEAF(struct type *r) { return (r)->field.trie_next; }
 
@@ -1297,6 +1813,10 @@ namespace nedtries {
 \brief Inserts item y into nedtrie x.
 */
 #define NEDTRIE_INSERT(name, x, y)       name##_NEDTRIE_INSERT(x, y)
+/*! \def NEDTRIE_INSERT_BATCH
+\brief Inserts the n items in array y into nedtrie x, as if by NEDTRIE_INSERT on each.
+*/
+#define NEDTRIE_INSERT_BATCH(name, x, y, n) name##_NEDTRIE_INSERTBATCH(x, y, n)
 /*! \def NEDTRIE_REMOVE
 \brief Removes item y from nedtrie x.
 */
@@ -1320,8 +1840,21 @@ the item returned is the next largest keyed item, use Nfind for that.
 /*! \def NEDTRIE_NFIND
 \brief Finds an item with an equal key to y in nedtrie x, and if none equal then the item with the next
 largest key. If the key is not equal, the returned item is guaranteed to be the next largest keyed item.
+Complexity is O(depth of trie).
 */
 #define NEDTRIE_NFIND(name, x, y)        name##_NEDTRIE_NFIND(x, y)
+/*! \def NEDTRIE_CFINDSMALLER
+\brief Performs \em rounds number of attempts to find an item with an equal key to y in nedtrie x, and
+if none equal then the closest item with a smaller key. Always returns a smaller key if there is a smaller
+key in the trie, if there isn't it returns zero. Like Cfind, \c INT_MAX means "as close as possible", but
+unlike Cfind with \c INT_MAX the item returned is then guaranteed to be the next smallest keyed item.
+*/
+#define NEDTRIE_CFINDSMALLER(name, x, y, rounds) name##_NEDTRIE_CFINDSMALLER(x, y, rounds)
+/*! \def NEDTRIE_NFINDSMALLER
+\brief Finds an item with an equal key to y in nedtrie x, and if none equal then the item with the next
+smallest key, e.g. the largest free block no bigger than y. Complexity is O(depth of trie).
+*/
+#define NEDTRIE_NFINDSMALLER(name, x, y) name##_NEDTRIE_CFINDSMALLER(x, y, INT_MAX)
 /*! \def NEDTRIE_PREV
 \brief Returns the item preceding y in nedtrie x.
 */
@@ -1356,6 +1889,26 @@ items is mostly in key order (enough that a bubble sort is efficient).
 	     (x) != NULL;                             \
 	     (x) = NEDTRIE_NEXT(name, head, x))
 
+/*! \def NEDTRIE_SORTEDMIN
+\brief Returns the item with the smallest key in nedtrie x, starting a visit of all items in
+key order whose state is kept in the NEDTRIE_SORTEDCURSOR c.
+*/
+#define NEDTRIE_SORTEDMIN(name, x, c)    name##_NEDTRIE_SORTEDMIN(x, c)
+/*! \def NEDTRIE_SORTEDNEXT
+\brief Returns the item following in key order the one last returned for the NEDTRIE_SORTEDCURSOR c.
+*/
+#define NEDTRIE_SORTEDNEXT(name, x, c)   name##_NEDTRIE_SORTEDNEXT(x, c)
+/*! \def NEDTRIE_FOREACH_SORTED
+\brief Substitutes a for loop which forward iterates into x all items in nedtrie head in key order,
+keeping its state in the NEDTRIE_SORTEDCURSOR c. The order in which items with the same key
+are visited is unspecified. Visiting all items is O(N), so no sort is needed afterwards, but the
+trie must not be modified during the loop.
+*/
+#define NEDTRIE_FOREACH_SORTED(x, name, head, c) \
+	for ((x) = NEDTRIE_SORTEDMIN(name, head, c);  \
+	     (x) != NULL;                             \
+	     (x) = NEDTRIE_SORTEDNEXT(name, head, c))
+
 /*! \def NEDTRIE_FOREACH_SAFE
 \brief Substitutes a for loop which forward iterates into x all items in
 nedtrie head and is safe against removal of x. Order of items is mostly
@@ -1451,6 +2004,7 @@ namespace nedtries {
     TrieValidityState state={0};
     for(n=0; n<NEDTRIE_INDEXBINS; n++)
     {
+      assert(!head->triebins[n]==!(head->triebinmask & ((size_t) 1<<n)));
       if((node=head->triebins[n]))
       {
         size_t nodekey=keyfunct(node);
@@ -1631,6 +2185,7 @@ namespace nedtries {
   }
   template<class keytype, class type, class keyfunct, class allocator, template<class> class nobblepolicy, class stlcontainer,
     class iteratortype, int dir, class mapvaluetype, class constiteratortype=intern::noconstiteratortype<iteratortype> > class trie_iterator;
+  template<class type, class allocator=std::allocator<type> > class slab_list;
   template<class keytype, class type, class keyfunct=trie_maptype_keyfunct<keytype, type>,
     class allocator=std::allocator<trie_maptype<keytype, type, keyfunct, std::list<size_t>::iterator> >,
     template<class> class nobblepolicy=nedpolicy::nobblezeros, 
@@ -1659,7 +2214,7 @@ namespace nedtries {
       typedef iteratortype trie_iterator_type;
       type trie_value;
       iteratortype trie_iterator;
-      TrieLink_t<type> trie_link;
+      TrieLinkWithKey_t<type> trie_link;
     };
   }
   template<class keytype, class type, class keyfunct, class iteratortype> struct trie_maptype
@@ -1676,7 +2231,7 @@ namespace nedtries {
     typedef fake::trie_maptype<keytype, type, keyfunct, iteratortype> fakemirrorofme_type;
     type trie_value;
     iteratortype trie_iterator;
-    TrieLink_t<type> trie_link;
+    TrieLinkWithKey_t<type> trie_link;
     static const size_t trie_link_offset=NEDTRIEFIELDOFFSET2(fakemirrorofme_type, trie_link);
   public:
     trie_maptype(const type &v) : trie_value(v)
@@ -1705,7 +2260,7 @@ namespace nedtries {
       type trie_value;
       keytype trie_keyvalue; // For when key is overriden using trie_map::operator[]
       iteratortype trie_iterator;
-      TrieLink_t<type> trie_link;
+      TrieLinkWithKey_t<type> trie_link;
     };
   }
   template<class keytype, class type, class iteratortype> struct trie_maptype<keytype, type, trie_maptype_keyfunct<keytype, type>, iteratortype>
@@ -1724,7 +2279,7 @@ namespace nedtries {
     type trie_value;
     keytype trie_keyvalue; // For when key is overriden using trie_map::operator[]
     iteratortype trie_iterator;
-    TrieLink_t<type> trie_link;
+    TrieLinkWithKey_t<type> trie_link;
     static const size_t trie_link_offset=NEDTRIEFIELDOFFSET2(fakemirrorofme_type, trie_link);
   public:
     trie_maptype(const type &v) : trie_value(v)
@@ -1774,8 +2329,8 @@ namespace nedtries {
     trie_iterator &operator++()
     {
       mapvaluetype *r=dir>0 ?
-        trienext<trie_map_head<mapvaluetype>, mapvaluetype, mapvaluetype::trie_link_offset, intern::to_Ckeyfunct<typename mapvaluetype::trie_keyfunct_type> >(&parent->triehead, (mapvaluetype *)(&**this)) :
-        trieprev<trie_map_head<mapvaluetype>, mapvaluetype, mapvaluetype::trie_link_offset, intern::to_Ckeyfunct<typename mapvaluetype::trie_keyfunct_type> >(&parent->triehead, (mapvaluetype *)(&**this));
+        trienext<trie_map_head<mapvaluetype>, mapvaluetype, mapvaluetype::trie_link_offset, trielinkkey<mapvaluetype, mapvaluetype::trie_link_offset> >(&parent->triehead, (mapvaluetype *)(&**this)) :
+        trieprev<trie_map_head<mapvaluetype>, mapvaluetype, mapvaluetype::trie_link_offset, trielinkkey<mapvaluetype, mapvaluetype::trie_link_offset> >(&parent->triehead, (mapvaluetype *)(&**this));
       if(r)
         new(this) iteratortype((iteratortype &) r->trie_iterator); // type pun safe
       else
@@ -1786,8 +2341,8 @@ namespace nedtries {
     trie_iterator &operator--()
     {
       mapvaluetype *r=dir<0 ?
-        trienext<trie_map_head<mapvaluetype>, mapvaluetype, mapvaluetype::trie_link_offset, intern::to_Ckeyfunct<typename mapvaluetype::trie_keyfunct_type> >(&parent->triehead, (mapvaluetype *)(&**this)) :
-        trieprev<trie_map_head<mapvaluetype>, mapvaluetype, mapvaluetype::trie_link_offset, intern::to_Ckeyfunct<typename mapvaluetype::trie_keyfunct_type> >(&parent->triehead, (mapvaluetype *)(&**this));
+        trienext<trie_map_head<mapvaluetype>, mapvaluetype, mapvaluetype::trie_link_offset, trielinkkey<mapvaluetype, mapvaluetype::trie_link_offset> >(&parent->triehead, (mapvaluetype *)(&**this)) :
+        trieprev<trie_map_head<mapvaluetype>, mapvaluetype, mapvaluetype::trie_link_offset, trielinkkey<mapvaluetype, mapvaluetype::trie_link_offset> >(&parent->triehead, (mapvaluetype *)(&**this));
       if(r)
         new(this) iteratortype((iteratortype &) r->trie_iterator);
       else
@@ -1805,20 +2360,361 @@ namespace nedtries {
 
   namespace intern
   {
-      template<class key_type> struct keystore_t { size_t magic; const key_type &key; keystore_t(size_t magic_, const key_type &key_) : magic(magic_), key(key_) { } private: keystore_t &operator=(const keystore_t &); };
-      template<class keytype, class type, class mapvaluetype, class keyfunct> struct findkeyfunct_t : public std::unary_function<type, keytype>
+    template<class type> struct slab_chunk;
+    template<class type> struct slab_slot
+    {
+      size_t header; /* Points at the owning slab_chunk, | 1 if the slot is free */
+      union
+      {
+        char value[sizeof(type)];
+        slab_slot *nextfree;
+        long double _align1;
+        long long _align2;
+      };
+      bool inuse() const { return !(header & 1); }
+      slab_chunk<type> *chunk() const { return (slab_chunk<type> *)(header & ~(size_t) 1); }
+      type *get() { return (type *)(void *) value; }
+      const type *get() const { return (const type *)(const void *) value; }
+    };
+    template<class type> struct slab_chunk
+    {
+      slab_chunk *prev, *next;
+      slab_slot<type> *begin, *end;
+    };
+    /*! \class slab_iterator
+    \ingroup C++
+    \brief Iterator for slab_list. Is a single pointer so trie_maptype can type pun it.
+    */
+    template<class type, class pointertype, class referencetype> class slab_iterator
+    {
+      template<class type_, class allocator> friend class nedtries::slab_list;
+      template<class type_, class pointertype_, class referencetype_> friend class slab_iterator;
+      slab_slot<type> *p;
+      explicit slab_iterator(slab_slot<type> *p_) : p(p_) { }
+      // Returns the first slot in use at or after from, moving through the chunks
+      static slab_slot<type> *firstinuse(slab_chunk<type> *chunk, slab_slot<type> *from)
       {
-        size_t operator()(const mapvaluetype &v) const
+        for(;;)
         {
-          keystore_t<keytype> *r=(keystore_t<keytype> *)(void *)(&v);
-	  // NOTE: This line triggers a "conditional jump or move depends on unintialized value(s)" in valgrind if
-	  // sizeof(type)<sizeof(size_t). This is unavoidable.
-          if(r->magic==*(size_t *)"TRIEFINDKEYSTORE")
-            return r->key;
-          return keyfunct()(v);
+          for(; from!=chunk->end; ++from)
+            if(from->inuse()) return from;
+          chunk=chunk->next;
+          from=chunk->begin;
         }
-      };
+      }
+      // Returns the last slot in use before from, moving through the chunks
+      static slab_slot<type> *lastinuse(slab_chunk<type> *chunk, slab_slot<type> *from)
+      {
+        for(;;)
+        {
+          while(from!=chunk->begin)
+            if((--from)->inuse()) return from;
+          chunk=chunk->prev;
+          from=chunk->end;
+        }
+      }
+    public:
+      typedef type value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef pointertype pointer;
+      typedef referencetype reference;
+      typedef std::bidirectional_iterator_tag iterator_category;
+
+      slab_iterator() : p(0) { }
+      template<class pointertype_, class referencetype_> slab_iterator(const slab_iterator<type, pointertype_, referencetype_> &o) : p(o.p) { }
+      slab_iterator &operator++() { p=firstinuse(p->chunk(), p+1); return *this; }
+      slab_iterator operator++(int) { slab_iterator tmp(*this); operator++(); return tmp; }
+      slab_iterator &operator--() { p=lastinuse(p->chunk(), p); return *this; }
+      slab_iterator operator--(int) { slab_iterator tmp(*this); operator--(); return tmp; }
+      bool operator==(const slab_iterator &o) const { return p==o.p; }
+      bool operator!=(const slab_iterator &o) const { return p!=o.p; }
+      reference operator *() const { return *p->get(); }
+      pointer operator ->() const { return p->get(); }
+    };
   }
+  /*! \class slab_list
+  \ingroup C++
+  \brief A std::list<> replacement for the \em stlcontainer parameter of trie_map and trie_multimap which
+  carves its items out of large chunks.
+
+  std::list<> costs a heap allocation per item, plus a previous and next pointer per item on top of the
+  nedtrie link and the stored iterator. slab_list instead allocates items in chunks of geometrically
+  increasing size, up to about 64Kb each, and keeps a free list of erased slots threaded through the slots
+  themselves, so the only per item overhead is a one word slot header. Inserts and erases therefore almost
+  never touch the heap allocator, and iteration walks each chunk sequentially.
+
+  Items never move once inserted, so iterators and pointers stay valid until their item is erased. The
+  position passed to insert() is ignored, and items are placed into the most recently freed slot or else
+  at the end of the newest chunk. Iteration order is therefore slot order, not insertion order. Erased
+  slots are reused, but chunks are returned to the allocator only by clear() or destruction.
+
+  Use it like this:
+  \code
+  typedef trie_maptype<size_t, Foo, trie_maptype_keyfunct<size_t, Foo>, std::list<size_t>::iterator> FooMapType;
+  trie_map<size_t, Foo, trie_maptype_keyfunct<size_t, Foo>, std::allocator<FooMapType>,
+    nedpolicy::nobblezeros, slab_list<FooMapType> > fooMap;
+  \endcode
+  */
+  template<class type, class allocator> class slab_list
+  {
+    typedef intern::slab_slot<type> slot_type;
+    typedef intern::slab_chunk<type> chunk_type;
+#ifdef HAVE_CPP0XRVALUEREFS
+    typedef typename std::allocator_traits<allocator>::template rebind_alloc<slot_type> slot_allocator;
+    typedef typename std::allocator_traits<allocator>::template rebind_alloc<chunk_type> chunk_allocator;
+#else
+    typedef typename allocator::template rebind<slot_type>::other slot_allocator;
+    typedef typename allocator::template rebind<chunk_type>::other chunk_allocator;
+#endif
+    static const size_t firstchunkitems=16;
+    static const size_t maxchunkitems=(65536/sizeof(slot_type)>firstchunkitems) ? 65536/sizeof(slot_type) : firstchunkitems;
+    allocator alloc;
+    chunk_type sentinel;  /* Circular list head of chunks, whose only slot is endslot */
+    slot_type endslot;
+    slot_type *freelist, *bump, *bumpend;
+    size_t count, nextchunkitems;
+
+    // Allocators are used through std::allocator_traits where available, as C++20 removed most of their members
+    template<class A> static typename A::value_type *allocateof(A &a, size_t n)
+    {
+#ifdef HAVE_CPP0XRVALUEREFS
+      return std::allocator_traits<A>::allocate(a, n);
+#else
+      return a.allocate(n);
+#endif
+    }
+    template<class A> static void deallocateof(A &a, typename A::value_type *p, size_t n)
+    {
+#ifdef HAVE_CPP0XRVALUEREFS
+      std::allocator_traits<A>::deallocate(a, p, n);
+#else
+      a.deallocate(p, n);
+#endif
+    }
+    void init()
+    {
+      sentinel.prev=sentinel.next=&sentinel;
+      sentinel.begin=&endslot;
+      sentinel.end=&endslot+1;
+      endslot.header=(size_t) &sentinel;
+      freelist=bump=bumpend=0;
+      count=0;
+      nextchunkitems=firstchunkitems;
+    }
+    // Points the first and last chunks at this container's sentinel after a swap, where they were at oldsentinel
+    void relink(chunk_type *oldsentinel)
+    {
+      if(sentinel.next==oldsentinel)
+        sentinel.prev=sentinel.next=&sentinel;
+      else
+      {
+        sentinel.next->prev=&sentinel;
+        sentinel.prev->next=&sentinel;
+      }
+      sentinel.begin=&endslot;
+      sentinel.end=&endslot+1;
+      endslot.header=(size_t) &sentinel;
+    }
+    slot_type *allocslot()
+    {
+      slot_type *s;
+      if(freelist)
+      {
+        s=freelist;
+        freelist=s->nextfree;
+        return s;
+      }
+      if(bump==bumpend)
+      {
+        chunk_allocator chunkalloc(alloc);
+        chunk_type *chunk=allocateof(chunkalloc, 1);
+        slot_allocator slotalloc(alloc);
+#if __cpp_exceptions
+        try
+        {
+#endif
+          chunk->begin=allocateof(slotalloc, nextchunkitems);
+#if __cpp_exceptions
+        }
+        catch(...)
+        {
+          deallocateof(chunkalloc, chunk, 1);
+          throw;
+        }
+#endif
+        chunk->end=chunk->begin+nextchunkitems;
+        for(s=chunk->begin; s!=chunk->end; ++s)
+          s->header=(size_t) chunk | 1;
+        chunk->prev=sentinel.prev;
+        chunk->next=&sentinel;
+        sentinel.prev->next=chunk;
+        sentinel.prev=chunk;
+        bump=chunk->begin;
+        bumpend=chunk->end;
+        if(nextchunkitems<maxchunkitems) nextchunkitems*=2;
+      }
+      return bump++;
+    }
+    void freeslot(slot_type *s)
+    {
+      s->header|=1;
+      s->nextfree=freelist;
+      freelist=s;
+    }
+    void destroyall()
+    {
+      chunk_type *chunk, *next;
+      slot_allocator slotalloc(alloc);
+      chunk_allocator chunkalloc(alloc);
+      for(chunk=sentinel.next; chunk!=&sentinel; chunk=next)
+      {
+        next=chunk->next;
+        for(slot_type *s=chunk->begin; s!=chunk->end; ++s)
+          if(s->inuse()) s->get()->~type();
+        deallocateof(slotalloc, chunk->begin, chunk->end-chunk->begin);
+        deallocateof(chunkalloc, chunk, 1);
+      }
+      init();
+    }
+  public:
+    typedef type value_type;
+    typedef allocator allocator_type;
+    typedef type *pointer;
+    typedef const type *const_pointer;
+    typedef type &reference;
+    typedef const type &const_reference;
+    typedef size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef intern::slab_iterator<type, type *, type &> iterator;
+    typedef intern::slab_iterator<type, const type *, const type &> const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    slab_list() { init(); }
+    explicit slab_list(const allocator &a) : alloc(a) { init(); }
+    slab_list(const slab_list &o) : alloc(o.alloc) { init(); insert(end(), o.begin(), o.end()); }
+    template<class inputiterator> slab_list(inputiterator s, inputiterator e, const allocator &a=allocator()) : alloc(a) { init(); insert(end(), s, e); }
+    slab_list &operator=(const slab_list &o)
+    {
+      if(this!=&o)
+      {
+        clear();
+        insert(end(), o.begin(), o.end());
+      }
+      return *this;
+    }
+#ifdef HAVE_CPP0XRVALUEREFS
+    slab_list(slab_list &&o) : alloc(o.alloc)
+    {
+      init();
+      swap(o);
+    }
+    slab_list &operator=(slab_list &&o)
+    {
+      clear();
+      swap(o);
+      return *this;
+    }
+#endif
+    ~slab_list() { destroyall(); }
+
+    iterator begin() { return iterator(iterator::firstinuse(sentinel.next, sentinel.next->begin)); }
+    const_iterator begin() const { return const_cast<slab_list *>(this)->begin(); }
+    iterator end() { return iterator(&endslot); }
+    const_iterator end() const { return const_cast<slab_list *>(this)->end(); }
+    reverse_iterator rbegin() { return reverse_iterator(end()); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+    bool empty() const { return !count; }
+    size_type size() const { return count; }
+#ifdef HAVE_CPP0XRVALUEREFS
+    size_type max_size() const { return std::allocator_traits<slot_allocator>::max_size(slot_allocator(alloc)); }
+#else
+    size_type max_size() const { return slot_allocator(alloc).max_size(); }
+#endif
+    allocator_type get_allocator() const { return alloc; }
+    //! Destroys all items and returns all chunks to the allocator
+    void clear() { destroyall(); }
+    //! Inserts \em v into a free slot. The position is ignored.
+    iterator insert(const_iterator, const value_type &v)
+    {
+      slot_type *s=allocslot();
+#if __cpp_exceptions
+      try
+      {
+#endif
+        new(s->value) type(v);
+#if __cpp_exceptions
+      }
+      catch(...)
+      {
+        freeslot(s);
+        throw;
+      }
+#endif
+      s->header&=~(size_t) 1;
+      count++;
+      return iterator(s);
+    }
+#ifdef HAVE_CPP0XRVALUEREFS
+    //! Inserts \em v into a free slot. The position is ignored.
+    iterator insert(const_iterator, value_type &&v)
+    {
+      slot_type *s=allocslot();
+#if __cpp_exceptions
+      try
+      {
+#endif
+        new(s->value) type(std::move(v));
+#if __cpp_exceptions
+      }
+      catch(...)
+      {
+        freeslot(s);
+        throw;
+      }
+#endif
+      s->header&=~(size_t) 1;
+      count++;
+      return iterator(s);
+    }
+#endif
+    //! Inserts the items between \em first and \em last. The position is ignored.
+    template<class inputiterator> void insert(const_iterator at, inputiterator first, inputiterator last)
+    {
+      for(; first!=last; ++first)
+        insert(at, *first);
+    }
+    //! Erases the item at \em it, returning the item after it
+    iterator erase(const_iterator it)
+    {
+      iterator ret(it.p);
+      ++ret;
+      it.p->get()->~type();
+      freeslot(it.p);
+      count--;
+      return ret;
+    }
+    iterator erase(const_iterator first, const_iterator last)
+    {
+      while(first!=last)
+        first=erase(first);
+      return iterator(last.p);
+    }
+    void swap(slab_list &o)
+    {
+      std::swap(alloc, o.alloc);
+      std::swap(sentinel, o.sentinel);
+      std::swap(freelist, o.freelist);
+      std::swap(bump, o.bump);
+      std::swap(bumpend, o.bumpend);
+      std::swap(count, o.count);
+      std::swap(nextchunkitems, o.nextchunkitems);
+      relink(&o.sentinel);
+      o.relink(&sentinel);
+    }
+  };
 
   /*! \class trie_map
   \ingroup C++
@@ -1855,6 +2751,8 @@ namespace nedtries {
   I would love to see a full bitwise trie implementation submitted to the Boost C++ libraries but I don't have the
   unpaid time to devote to such an endeavour sadly.
 
+  If a heap allocation per item is too slow, use slab_list<> as the STL container instead of std::list<>.
+
   \warning If you use std::vector<> as the STL container, make SURE you resize() it to its maximum size before use.
   Otherwise the iterators trie_map uses to link nedtrie items into the STL items will become invalidated on storage
   expansion.
@@ -1887,39 +2785,45 @@ namespace nedtries {
       void *_it=(void *) &it;
       return *(typename mapvaluetype::trie_iterator_type *)_it;
     }
+    // Caches the key of r in its link and indexes it
+    void triehead_link(mapvaluetype *r)
+    {
+      r->trie_link.trie_key=intern::to_Ckeyfunct<keyfunct>(r);
+      trieinsert<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, trielinkkey<mapvaluetype, trie_fieldoffset> >(&triehead, r);
+    }
     // Wipes and resets the nedtrie index
     void triehead_reindex()
     {
       NEDTRIE_INIT(&triehead);
       for(iterator it=begin(); it!=end(); ++it)
       {
-        trieinsert<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<keyfunct> >(&triehead, &(*it));
+        triehead_link(&(*it));
         it->trie_iterator=it;
       }
     }
     const mapvaluetype *triehead_find(const key_type &key) const
-    { // Avoid a value_type construction using pure unmitigated evil
-      char buffer[sizeof(mapvaluetype)];
-      new(buffer) intern::keystore_t<key_type>(*(size_t *)"TRIEFINDKEYSTORE", key);
-      return triefind<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<intern::findkeyfunct_t<keytype, type, mapvaluetype, keyfunct> > >(&triehead, (mapvaluetype *) buffer);
+    { // Avoid a value_type construction, the search only ever looks at the key cached in the link
+      size_t buffer[(sizeof(mapvaluetype)+sizeof(size_t)-1)/sizeof(size_t)];
+      ((TrieLinkWithKey_t<type> *)((char *) buffer+trie_fieldoffset))->trie_key=key;
+      return triefind<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, trielinkkey<mapvaluetype, trie_fieldoffset> >(&triehead, (mapvaluetype *) buffer);
     }
     const mapvaluetype *triehead_nfind(const key_type &key) const
-    { // Avoid a value_type construction using pure unmitigated evil
-      char buffer[sizeof(mapvaluetype)];
-      new(buffer) intern::keystore_t<key_type>(*(size_t *)"TRIEFINDKEYSTORE", key);
-      return trieNfind<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<intern::findkeyfunct_t<keytype, type, mapvaluetype, keyfunct> > >(&triehead, (mapvaluetype *) buffer);
+    { // Avoid a value_type construction, the search only ever looks at the key cached in the link
+      size_t buffer[(sizeof(mapvaluetype)+sizeof(size_t)-1)/sizeof(size_t)];
+      ((TrieLinkWithKey_t<type> *)((char *) buffer+trie_fieldoffset))->trie_key=key;
+      return trieNfind<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, trielinkkey<mapvaluetype, trie_fieldoffset> >(&triehead, (mapvaluetype *) buffer);
     }
     const mapvaluetype *triehead_cfind(const key_type &key, int rounds) const
-    { // Avoid a value_type construction using pure unmitigated evil
-      char buffer[sizeof(mapvaluetype)];
-      new(buffer) intern::keystore_t<key_type>(*(size_t *)"TRIEFINDKEYSTORE", key);
-      return trieCfind<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<intern::findkeyfunct_t<keytype, type, mapvaluetype, keyfunct> > >(&triehead, (mapvaluetype *) buffer, rounds);
+    { // Avoid a value_type construction, the search only ever looks at the key cached in the link
+      size_t buffer[(sizeof(mapvaluetype)+sizeof(size_t)-1)/sizeof(size_t)];
+      ((TrieLinkWithKey_t<type> *)((char *) buffer+trie_fieldoffset))->trie_key=key;
+      return trieCfind<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, trielinkkey<mapvaluetype, trie_fieldoffset> >(&triehead, (mapvaluetype *) buffer, rounds);
     }
     iterator triehead_insert(const value_type &val)
     {
       iterator it=iterator(this, stlcontainer::insert(stlcontainer::end(), std::move(val)));
       it->trie_iterator=from_iterator(it);
-      trieinsert<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<keyfunct> >(&triehead, const_cast<mapvaluetype *>(&(*it)));
+      triehead_link(const_cast<mapvaluetype *>(&(*it)));
       return it;
     }
 #ifdef HAVE_CPP0XRVALUEREFS
@@ -1927,7 +2831,7 @@ namespace nedtries {
     {
       iterator it=iterator(this, stlcontainer::insert(stlcontainer::end(), std::move(val)));
       it->trie_iterator=from_iterator(it);
-      trieinsert<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<keyfunct> >(&triehead, const_cast<mapvaluetype *>(&(*it)));
+      triehead_link(const_cast<mapvaluetype *>(&(*it)));
       return it;
     }
 #endif
@@ -1936,7 +2840,7 @@ namespace nedtries {
       iterator it=iterator(this, stlcontainer::insert(stlcontainer::end(), std::move(val)));
       it->trie_iterator=from_iterator(it);
       it->trie_keyvalue=key;
-      trieinsert<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<keyfunct> >(&triehead, const_cast<mapvaluetype *>(&(*it)));
+      triehead_link(const_cast<mapvaluetype *>(&(*it)));
       return it;
     }
 #ifdef HAVE_CPP0XRVALUEREFS
@@ -1945,7 +2849,7 @@ namespace nedtries {
       iterator it=iterator(this, stlcontainer::insert(stlcontainer::end(), std::move(val)));
       it->trie_iterator=from_iterator(it);
       it->trie_keyvalue=key;
-      trieinsert<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<keyfunct> >(&triehead, const_cast<mapvaluetype *>(&(*it)));
+      triehead_link(const_cast<mapvaluetype *>(&(*it)));
       return it;
     }
 #endif
@@ -1974,7 +2878,7 @@ namespace nedtries {
     iterator erase(iterator it)
     {
       //int (*nobblefunct)(trietype *head)
-      trieremove<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<keyfunct>,
+      trieremove<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, trielinkkey<mapvaluetype, trie_fieldoffset>,
         // Need to give MSVC a little bit of help
 #ifdef _MSC_VER
         nobblepolicytype::trie_nobblefunction<trie_map_head<mapvaluetype> >
@@ -1990,7 +2894,7 @@ namespace nedtries {
       iterator ret(last); ++ret;
       for(iterator it=first; it!=last; ++it)
       {
-        trieremove<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<keyfunct>,
+        trieremove<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, trielinkkey<mapvaluetype, trie_fieldoffset>,
 #ifdef _MSC_VER
           nobblepolicytype::trie_nobblefunction<trie_map_head<mapvaluetype> >
 #else
@@ -2042,7 +2946,7 @@ namespace nedtries {
     {
       iterator it=stlcontainer::insert(at, val);
       it->trie_iterator=from_iterator(it);
-      trieinsert<trie_map_head, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<keyfunct> >(&triehead, &(*it));
+      triehead_link(&(*it));
       return it;
     }
     //! Inserts the items between \em first and \em last
@@ -2053,7 +2957,7 @@ namespace nedtries {
       for(; it!=end(); ++it)
       {
         it->trie_iterator=from_iterator(it);
-        trieinsert<trie_map_head, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<keyfunct> >(&triehead, &(*it));
+        triehead_link(&(*it));
       }
     }
     //key_compare key_comp() const;
@@ -2170,6 +3074,8 @@ namespace nedtries {
   I would love to see a full bitwise trie implementation submitted to the Boost C++ libraries but I don't have the
   unpaid time to devote to such an endeavour sadly.
 
+  If a heap allocation per item is too slow, use slab_list<> as the STL container instead of std::list<>.
+
   \warning If you use std::vector<> as the STL container, make SURE you resize() it to its maximum size before use.
   Otherwise the iterators trie_multimap uses to link nedtrie items into the STL items will become invalidated on storage
   expansion.
@@ -2202,27 +3108,33 @@ namespace nedtries {
       void *_it=(void *) &it;
       return *(typename mapvaluetype::trie_iterator_type *)_it;
     }
+    // Caches the key of r in its link and indexes it
+    void triehead_link(mapvaluetype *r)
+    {
+      r->trie_link.trie_key=intern::to_Ckeyfunct<keyfunct>(r);
+      trieinsert<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, trielinkkey<mapvaluetype, trie_fieldoffset> >(&triehead, r);
+    }
     // Wipes and resets the nedtrie index
     void triehead_reindex()
     {
       NEDTRIE_INIT(&triehead);
       for(iterator it=begin(); it!=end(); ++it)
       {
-        trieinsert<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<keyfunct> >(&triehead, &(*it));
+        triehead_link(&(*it));
         it->trie_iterator=it;
       }
     }
     const mapvaluetype *triehead_find(const key_type &key) const
-    { // Avoid a value_type construction using pure unmitigated evil
-      char buffer[sizeof(mapvaluetype)];
-      new(buffer) intern::keystore_t<key_type>(*(size_t *)"TRIEFINDKEYSTORE", key);
-      return triefind<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<intern::findkeyfunct_t<keytype, type, mapvaluetype, keyfunct> > >(&triehead, (mapvaluetype *) buffer);
+    { // Avoid a value_type construction, the search only ever looks at the key cached in the link
+      size_t buffer[(sizeof(mapvaluetype)+sizeof(size_t)-1)/sizeof(size_t)];
+      ((TrieLinkWithKey_t<type> *)((char *) buffer+trie_fieldoffset))->trie_key=key;
+      return triefind<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, trielinkkey<mapvaluetype, trie_fieldoffset> >(&triehead, (mapvaluetype *) buffer);
     }
     iterator triehead_insert(const value_type &val)
     {
       iterator it=iterator((trie_map<keytype, type, keyfunct, allocator, nobblepolicy, stlcontainer> *) this, stlcontainer::insert(stlcontainer::end(), std::move(val)));
       it->trie_iterator=from_iterator(it);
-      trieinsert<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<keyfunct> >(&triehead, const_cast<mapvaluetype *>(&(*it)));
+      triehead_link(const_cast<mapvaluetype *>(&(*it)));
       return it;
     }
 #ifdef HAVE_CPP0XRVALUEREFS
@@ -2230,7 +3142,7 @@ namespace nedtries {
     {
       iterator it=iterator((trie_map<keytype, type, keyfunct, allocator, nobblepolicy, stlcontainer> *) this, stlcontainer::insert(stlcontainer::end(), std::move(val)));
       it->trie_iterator=from_iterator(it);
-      trieinsert<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<keyfunct> >(&triehead, const_cast<mapvaluetype *>(&(*it)));
+      triehead_link(const_cast<mapvaluetype *>(&(*it)));
       return it;
     }
 #endif
@@ -2259,7 +3171,7 @@ namespace nedtries {
     iterator erase(iterator it)
     {
       //int (*nobblefunct)(trietype *head)
-      trieremove<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<keyfunct>,
+      trieremove<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, trielinkkey<mapvaluetype, trie_fieldoffset>,
         // Need to give MSVC a little bit of help
 #ifdef _MSC_VER
         nobblepolicytype::trie_nobblefunction<trie_map_head<mapvaluetype> >
@@ -2275,7 +3187,7 @@ namespace nedtries {
       iterator ret(last); ++ret;
       for(iterator it=first; it!=last; ++it)
       {
-        trieremove<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<keyfunct>,
+        trieremove<trie_map_head<mapvaluetype>, mapvaluetype, trie_fieldoffset, trielinkkey<mapvaluetype, trie_fieldoffset>,
 #ifdef _MSC_VER
           nobblepolicytype::trie_nobblefunction<trie_map_head<mapvaluetype> >
 #else
@@ -2321,7 +3233,7 @@ namespace nedtries {
     {
       iterator it=stlcontainer::insert(at, val);
       it->trie_iterator=from_iterator(it);
-      trieinsert<trie_map_head, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<keyfunct> >(&triehead, &(*it));
+      triehead_link(&(*it));
       return it;
     }
     //! Inserts the items between \em first and \em last
@@ -2332,7 +3244,7 @@ namespace nedtries {
       for(; it!=end(); ++it)
       {
         it->trie_iterator=from_iterator(it);
-        trieinsert<trie_map_head, mapvaluetype, trie_fieldoffset, intern::to_Ckeyfunct<keyfunct> >(&triehead, &(*it));
+        triehead_link(&(*it));
       }
     }
     //key_compare key_comp() const;
@@ -0,0 +1,852 @@
+/* Path compressed trie algorithm
+(C) 2026 The nedtries contributors
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef QUICKCPPLIB_ALGORITHM_PATRICIA_TRIE_HPP
+#define QUICKCPPLIB_ALGORITHM_PATRICIA_TRIE_HPP
+
+#include "bitwise_trie.hpp"
+
+QUICKCPPLIB_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  namespace patricia_trie
+  {
+    /*! \class patricia_trie_item_accessors
+    \brief Default accessor for a path compressed trie item.
+    \tparam ItemType The type of item indexed.
+
+    This default accessor requires the following member variables in the trie item type:
+
+    - `ItemType *trie_parent`
+    - `ItemType *trie_child[2]`
+    - `ItemType *trie_sibling[2]` (optional, without it duplicate keys are not stored)
+    - `KeyType trie_key`
+    - `<unsigned type> trie_skip`, which can be as small as `unsigned char`.
+    */
+    template <class ItemType> class patricia_trie_item_accessors : public bitwise_trie::bitwise_trie_item_accessors<ItemType>
+    {
+      ItemType *_v;
+
+    public:
+      constexpr patricia_trie_item_accessors(ItemType *v)
+          : bitwise_trie::bitwise_trie_item_accessors<ItemType>(v)
+          , _v(v)
+      {
+      }
+
+      //! The bit index of the key which this item's children are chosen by
+      constexpr unsigned skip() const noexcept { return _v->trie_skip; }
+      constexpr void set_skip(unsigned bitidx) noexcept { _v->trie_skip = (decltype(_v->trie_skip)) bitidx; }
+    };
+
+    /*! \class patricia_trie
+    \brief Never-allocating in-place path compressed bitwise Fredkin trie index head type.
+    \tparam Base The base type from which this index derives.
+    \tparam ItemType The type of item indexed.
+    \tparam HeadAccessors Accessors for the index head.
+    \tparam ItemAccessors Accessors for the items indexed.
+
+    In `bitwise_trie` each level of the trie consumes exactly one bit of the key, so keys
+    sharing long runs of bits below their top set bit, as pointers into the same region
+    and aligned to pages do, are indexed by long chains of items with a single child. Here
+    each item records in `trie_skip` the index of the bit which chooses between its children,
+    so a single step can pass over any number of bits which every key below it shares, and
+    the depth of the trie is bounded by the number of items rather than by the width of the key.
+
+    Items remain bucketed by their top set bit into bins in the index head, nothing is ever
+    allocated, and items with duplicate keys are kept in insertion order on a ring of siblings
+    off the first inserted, exactly as with `bitwise_trie`. Iteration order is only *somewhat*
+    sorted by key, but `find_equal_or_next_largest()` and `find_equal_or_next_smallest()`
+    are exact and their complexity is `O(depth)` plus a scan of empty bins.
+
+    Unlike `bitwise_trie`, keys must be native unsigned integers, there is no nobble
+    direction, and no per bin locking.
+    */
+    template <class Base, class ItemType,
+              template <class, class> class HeadAccessors = bitwise_trie::bitwise_trie_head_accessors,
+              template <class> class ItemAccessors = patricia_trie_item_accessors>
+    class patricia_trie : public Base
+    {
+      constexpr HeadAccessors<const Base, const ItemType> _head_accessors() const noexcept
+      {
+        return HeadAccessors<const Base, const ItemType>(this);
+      }
+      constexpr HeadAccessors<Base, ItemType> _head_accessors() noexcept { return HeadAccessors<Base, ItemType>(this); }
+
+      static constexpr ItemAccessors<const ItemType> _item_accessors(const ItemType *item) noexcept
+      {
+        return ItemAccessors<const ItemType>(item);
+      }
+      static constexpr ItemAccessors<ItemType> _item_accessors(ItemType *item) noexcept
+      {
+        return ItemAccessors<ItemType>(item);
+      }
+
+    public:
+      //! Key type indexing the items
+      using key_type = decltype(_item_accessors(static_cast<ItemType *>(nullptr)).key());
+      //! The type of item indexed
+      using mapped_type = ItemType *;
+      //! The value type
+      using value_type = ItemType *;
+      //! The size type
+      using size_type = decltype(HeadAccessors<const Base, const ItemType>(nullptr).size());
+      //! The type of a difference between pointers to the type of item indexed
+      using difference_type = ptrdiff_t;
+      //! A reference to the type of item indexed
+      using reference = ItemType &;
+      //! A const reference to the type of item indexed
+      using const_reference = const ItemType &;
+      //! A pointer to the type of item indexed
+      using pointer = ItemType *;
+      //! A const pointer to the type of item indexed
+      using const_pointer = const ItemType *;
+
+    private:
+      static constexpr unsigned _key_type_bits = (unsigned) (8 * sizeof(key_type));
+      static_assert(std::is_unsigned<key_type>::value, "key type must be a native unsigned integer");
+      static_assert(std::is_unsigned<size_type>::value, "head_accessor size type must be unsigned");
+
+      static bool _has_children(const_pointer node) noexcept
+      {
+        auto nodelink = _item_accessors(node);
+        return nodelink.child(false) != nullptr || nodelink.child(true) != nullptr;
+      }
+      // The last item of the ring of siblings of node, which is the last of them to be iterated
+      static const_pointer _ring_last(const_pointer node) noexcept { return _item_accessors(node).sibling(false); }
+      // The last item in iteration order in the subtrie whose root is node
+      static const_pointer _last_in(const_pointer node) noexcept
+      {
+        for(;;)
+        {
+          auto nodelink = _item_accessors(node);
+          const_pointer childnode = (nodelink.child(true) != nullptr) ? nodelink.child(true) : nodelink.child(false);
+          if(nullptr == childnode)
+          {
+            return _ring_last(node);
+          }
+          node = childnode;
+        }
+      }
+      // Detaches and returns a leaf from below node, which must have children
+      static pointer _detach_leaf_below(pointer node) noexcept
+      {
+        pointer leaf = node;
+        for(;;)
+        {
+          auto leaflink = _item_accessors(leaf);
+          pointer childnode = (leaflink.child(false) != nullptr) ? leaflink.child(false) : leaflink.child(true);
+          if(nullptr == childnode)
+          {
+            break;
+          }
+          leaf = childnode;
+        }
+        assert(leaf != node);
+        auto parentlink = _item_accessors(_item_accessors(leaf).parent());
+        parentlink.set_child(parentlink.child(true) == leaf, nullptr);
+        return leaf;
+      }
+      // Makes node take the place of r in its parent, or in the index head
+      void _replace_in_parent(pointer r, pointer node) noexcept
+      {
+        auto rlink = _item_accessors(r);
+        auto nodelink = _item_accessors(node);
+        if(rlink.parent_is_index())
+        {
+          auto head = _head_accessors();
+          const unsigned bitidx = rlink.bit_index();
+          assert(head.child(bitidx) == r);
+          head.set_child(bitidx, node);
+          nodelink.set_parent_is_index(bitidx);
+        }
+        else
+        {
+          auto parentlink = _item_accessors(rlink.parent());
+          parentlink.set_child(parentlink.child(true) == r, node);
+          nodelink.set_parent(rlink.parent());
+        }
+      }
+      // Makes node take the place of r in the trie, including r's children
+      void _replace(pointer r, pointer node) noexcept
+      {
+        auto rlink = _item_accessors(r);
+        auto nodelink = _item_accessors(node);
+        for(bool right : {false, true})
+        {
+          pointer childnode = rlink.child(right);
+          nodelink.set_child(right, childnode);
+          if(childnode != nullptr)
+          {
+            _item_accessors(childnode).set_parent(node);
+          }
+        }
+        nodelink.set_skip(rlink.skip());
+        _replace_in_parent(r, node);
+      }
+
+      const_pointer _triemin() const noexcept
+      {
+        auto head = _head_accessors();
+        if(0 == head.size())
+        {
+          return nullptr;
+        }
+        for(unsigned bitidx = 0; bitidx < _key_type_bits; bitidx++)
+        {
+          if(auto *node = head.child(bitidx))
+          {
+            return node;
+          }
+        }
+        return nullptr;
+      }
+      pointer _triemin() noexcept { return const_cast<pointer>(static_cast<const patricia_trie *>(this)->_triemin()); }
+      const_pointer _triemax() const noexcept
+      {
+        auto head = _head_accessors();
+        if(0 == head.size())
+        {
+          return nullptr;
+        }
+        for(unsigned bitidx = _key_type_bits; bitidx-- > 0;)
+        {
+          if(auto *node = head.child(bitidx))
+          {
+            return _last_in(node);
+          }
+        }
+        return nullptr;
+      }
+      pointer _triemax() noexcept { return const_cast<pointer>(static_cast<const patricia_trie *>(this)->_triemax()); }
+
+      /* Every key below an item with children agrees with the item's key in all the bits above
+      its skip bit, and the skip bit chooses the child. So on the way down, if the key being
+      inserted differs from an item's key above the item's skip bit, that item must instead
+      choose between its children by the highest bit in which they differ. An item without
+      children can have its skip bit set to anything, so the highest differing bit is used.
+      */
+      pointer _trieinsert(pointer r) noexcept
+      {
+        auto head = _head_accessors();
+        auto rlink = _item_accessors(r);
+        const key_type rkey = rlink.key();
+        rlink.set_parent(nullptr);
+        rlink.set_child(false, nullptr);
+        rlink.set_child(true, nullptr);
+        rlink.set_sibling(false, r);
+        rlink.set_sibling(true, r);
+        rlink.set_skip(0);
+        const unsigned bitidx = bitwise_trie::detail::bitscanr(rkey);
+        assert(bitidx < _key_type_bits);
+        pointer node = head.child(bitidx);
+        if(nullptr == node)
+        { /* Set parent is index flag */
+          rlink.set_parent_is_index(bitidx);
+          head.set_child(bitidx, r);
+          head.incr_size();
+          return r;
+        }
+        for(;;)
+        {
+          auto nodelink = _item_accessors(node);
+          const key_type nodekey = nodelink.key();
+          if(nodekey == rkey)
+          { /* Insert into end of ring list */
+            rlink.set_is_secondary_sibling();
+            if(!rlink.set_sibling(true, node))
+            {
+              return node;
+            }
+            auto *newest_sibling = nodelink.sibling(false);
+            _item_accessors(newest_sibling).set_sibling(true, r);
+            rlink.set_sibling(false, newest_sibling);
+            nodelink.set_sibling(false, r);
+            break;
+          }
+          const unsigned diffidx = bitwise_trie::detail::bitscanr(nodekey ^ rkey);
+          if(!_has_children(node))
+          { /* Leaf, so choose children by the first differing bit */
+            nodelink.set_skip(diffidx);
+            rlink.set_parent(node);
+            nodelink.set_child(!!((rkey >> diffidx) & 1), r);
+            break;
+          }
+          const unsigned skip = nodelink.skip();
+          if(diffidx > skip)
+          {
+            /* Split at node. Pushing node down below me would put newer items above older
+            ones, and the top of the trie would no longer be the hot, early inserted items.
+            So instead a leaf from below node takes over node's children, and node chooses
+            between it and me by the differing bit. */
+            pointer leaf = _detach_leaf_below(node);
+            auto leaflink = _item_accessors(leaf);
+            const bool nodekeybitset = !!((nodekey >> diffidx) & 1);
+            for(bool right : {false, true})
+            {
+              pointer childnode = nodelink.child(right);
+              leaflink.set_child(right, childnode);
+              if(childnode != nullptr)
+              {
+                _item_accessors(childnode).set_parent(leaf);
+              }
+            }
+            leaflink.set_skip(skip);
+            leaflink.set_parent(node);
+            nodelink.set_child(nodekeybitset, leaf);
+            nodelink.set_child(!nodekeybitset, r);
+            nodelink.set_skip(diffidx);
+            rlink.set_parent(node);
+            break;
+          }
+          const bool keybitset = !!((rkey >> skip) & 1);
+          pointer childnode = nodelink.child(keybitset);
+          if(nullptr == childnode)
+          { /* Insert here */
+            rlink.set_parent(node);
+            nodelink.set_child(keybitset, r);
+            break;
+          }
+          node = childnode;
+        }
+        head.incr_size();
+        return r;
+      }
+
+      // Returns the item which took my place, if any
+      pointer _trieremove(pointer r) noexcept
+      {
+        auto head = _head_accessors();
+        auto rlink = _item_accessors(r);
+        pointer replacement = nullptr;
+        if(rlink.is_secondary_sibling())
+        { /* Remove from linked list */
+          auto *left = rlink.sibling(false), *right = rlink.sibling(true);
+          _item_accessors(left).set_sibling(true, right);
+          _item_accessors(right).set_sibling(false, left);
+        }
+        else if(rlink.sibling(true) != r)
+        { /* Replace me with my oldest sibling */
+          auto *left = rlink.sibling(false), *right = rlink.sibling(true);
+          _item_accessors(left).set_sibling(true, right);
+          _item_accessors(right).set_sibling(false, left);
+          _replace(r, right);
+          replacement = right;
+        }
+        else if(_has_children(r))
+        { /* Replace me with any leaf below me, as it shares the bits above my skip bit */
+          pointer leaf = _detach_leaf_below(r);
+          _replace(r, leaf);
+          replacement = leaf;
+        }
+        else if(rlink.parent_is_index())
+        {
+          const unsigned bitidx = rlink.bit_index();
+          assert(head.child(bitidx) == r);
+          head.set_child(bitidx, nullptr);
+        }
+        else
+        {
+          auto parentlink = _item_accessors(rlink.parent());
+          parentlink.set_child(parentlink.child(true) == r, nullptr);
+        }
+        head.decr_size();
+#ifndef NDEBUG
+        rlink.set_parent(nullptr);
+        rlink.set_child(false, nullptr);
+        rlink.set_child(true, nullptr);
+        rlink.set_sibling(false, r);
+        rlink.set_sibling(true, r);
+#endif
+        return replacement;
+      }
+
+      const_pointer _trienext(const_pointer r) const noexcept
+      {
+        auto rlink = _item_accessors(r);
+        /* Next on my ring of siblings is next, until the ring returns to the primary */
+        r = rlink.sibling(true);
+        rlink = _item_accessors(r);
+        if(!rlink.is_primary_sibling())
+        {
+          return r;
+        }
+        /* Then my children, preferring child[0] */
+        if(const_pointer childnode = (rlink.child(false) != nullptr) ? rlink.child(false) : rlink.child(true))
+        {
+          return childnode;
+        }
+        /* Trace up my parents to next branch */
+        while(!rlink.parent_is_index())
+        {
+          const_pointer parent = rlink.parent();
+          auto parentlink = _item_accessors(parent);
+          if(parentlink.child(false) == r && parentlink.child(true) != nullptr)
+          {
+            return parentlink.child(true);
+          }
+          r = parent;
+          rlink = parentlink;
+        }
+        /* I have reached the top of my trie, so on to next bin */
+        auto head = _head_accessors();
+        for(unsigned bitidx = rlink.bit_index() + 1; bitidx < _key_type_bits; bitidx++)
+        {
+          if(auto *node = head.child(bitidx))
+          {
+            return node;
+          }
+        }
+        return nullptr;
+      }
+      const_pointer _trieprev(const_pointer r) const noexcept
+      {
+        auto rlink = _item_accessors(r);
+        if(rlink.is_secondary_sibling())
+        {
+          return rlink.sibling(false);
+        }
+        if(rlink.parent_is_index())
+        {
+          auto head = _head_accessors();
+          for(unsigned bitidx = rlink.bit_index(); bitidx-- > 0;)
+          {
+            if(auto *node = head.child(bitidx))
+            {
+              return _last_in(node);
+            }
+          }
+          return nullptr;
+        }
+        const_pointer parent = rlink.parent();
+        auto parentlink = _item_accessors(parent);
+        if(parentlink.child(true) == r && parentlink.child(false) != nullptr)
+        {
+          return _last_in(parentlink.child(false));
+        }
+        return _ring_last(parent);
+      }
+
+      pointer _triefind(key_type rkey) const noexcept
+      {
+        auto head = _head_accessors();
+        const unsigned bitidx = bitwise_trie::detail::bitscanr(rkey);
+        assert(bitidx < _key_type_bits);
+        const_pointer node = head.child(bitidx);
+        while(node != nullptr)
+        {
+          auto nodelink = _item_accessors(node);
+          if(nodelink.key() == rkey)
+          {
+            return const_cast<pointer>(node);
+          }
+          /* Load both children alongside the skip bit rather than after it, which halves the
+          dependent loads per step if they are in different cache lines, and select without
+          a branch as which is taken is unpredictable */
+          const uintptr_t child0 = (uintptr_t) nodelink.child(false), child1 = (uintptr_t) nodelink.child(true);
+          const uintptr_t select = (uintptr_t) 0 - (uintptr_t) ((rkey >> nodelink.skip()) & 1);
+          node = (const_pointer) (child0 ^ ((child0 ^ child1) & select));
+        }
+        return nullptr;
+      }
+
+      /* The nearest key in the subtrie whose root is node, all of whose keys are on the same
+      side of rkey. Every key under child[0] is smaller than every key under child[1], so the
+      smallest is either the root's or the smallest under its lowest child. Larger is +1,
+      smaller is -1. */
+      template <int Dir> static void _closest_in(const_pointer node, const_pointer &ret) noexcept
+      {
+        while(node != nullptr)
+        {
+          auto nodelink = _item_accessors(node);
+          if(ret == nullptr || ((Dir > 0) ? (nodelink.key() < _item_accessors(ret).key()) : (nodelink.key() > _item_accessors(ret).key())))
+          {
+            ret = node;
+          }
+          const bool first = (Dir < 0);
+          node = (nodelink.child(first) != nullptr) ? nodelink.child(first) : nodelink.child(!first);
+        }
+      }
+      template <int Dir> const_pointer _trieclosest(key_type rkey) const noexcept
+      {
+        auto head = _head_accessors();
+        if(0 == head.size())
+        {
+          return nullptr;
+        }
+        const unsigned bitidx = bitwise_trie::detail::bitscanr(rkey);
+        assert(bitidx < _key_type_bits);
+        const_pointer ret = nullptr, node = head.child(bitidx), fallback = nullptr;
+        /* Walk the path rkey would be inserted at, considering each item on it. The subtries
+        beside the path on the far side of it entirely beat anything further down, so
+        remember the nearest of those at the deepest level. */
+        while(node != nullptr)
+        {
+          auto nodelink = _item_accessors(node);
+          const key_type nodekey = nodelink.key();
+          if(nodekey == rkey)
+          {
+            return node;
+          }
+          if(((Dir > 0) ? (nodekey > rkey) : (nodekey < rkey)) &&
+             (ret == nullptr || ((Dir > 0) ? (nodekey < _item_accessors(ret).key()) : (nodekey > _item_accessors(ret).key()))))
+          {
+            ret = node;
+          }
+          if(!_has_children(node))
+          {
+            break;
+          }
+          const unsigned skip = nodelink.skip(), diffidx = bitwise_trie::detail::bitscanr(nodekey ^ rkey);
+          if(diffidx > skip)
+          {
+            /* rkey differs from every key below here above the skip bit, so they are either all
+            on the far side of it or all on the near side */
+            const bool nodekeybitset = !!((nodekey >> diffidx) & 1);
+            if(nodekeybitset == (Dir > 0))
+            {
+              const bool first = (Dir < 0);
+              fallback = (nodelink.child(first) != nullptr) ? nodelink.child(first) : nodelink.child(!first);
+            }
+            break;
+          }
+          const bool keybitset = !!((rkey >> skip) & 1);
+          if(keybitset != (Dir > 0) && nodelink.child(Dir > 0) != nullptr)
+          {
+            fallback = nodelink.child(Dir > 0);
+          }
+          node = nodelink.child(keybitset);
+        }
+        _closest_in<Dir>(fallback, ret);
+        if(ret != nullptr)
+        {
+          return ret;
+        }
+        /* Nothing in this bin, so the nearest in the nearest occupied bin */
+        if(Dir > 0)
+        {
+          for(unsigned n = bitidx + 1; n < _key_type_bits; n++)
+          {
+            if((node = head.child(n)) != nullptr)
+            {
+              _closest_in<Dir>(node, ret);
+              return ret;
+            }
+          }
+        }
+        else
+        {
+          for(unsigned n = bitidx; n-- > 0;)
+          {
+            if((node = head.child(n)) != nullptr)
+            {
+              _closest_in<Dir>(node, ret);
+              return ret;
+            }
+          }
+        }
+        return nullptr;
+      }
+
+#ifndef NDEBUG
+      // Checks that every key in the subtrie agrees with value in the bits of mask, returning the count
+      size_type _triecheckvaliditybranch(const_pointer node, key_type mask, key_type value, unsigned skipbound) const noexcept
+      {
+        auto nodelink = _item_accessors(node);
+        const key_type nodekey = nodelink.key();
+        assert((nodekey & mask) == value);
+        assert(nodelink.is_primary_sibling());
+        size_type count = 1;
+        for(const_pointer sibling = nodelink.sibling(true); sibling != node; sibling = _item_accessors(sibling).sibling(true))
+        {
+          auto siblinglink = _item_accessors(sibling);
+          assert(siblinglink.is_secondary_sibling());
+          assert(siblinglink.key() == nodekey);
+          assert(_item_accessors(siblinglink.sibling(true)).sibling(false) == sibling);
+          count++;
+        }
+        if(!_has_children(node))
+        {
+          return count;
+        }
+        const unsigned skip = nodelink.skip();
+        assert(skip < skipbound);
+        const key_type childmask = (key_type) -1 << skip;
+        for(bool right : {false, true})
+        {
+          if(auto *childnode = nodelink.child(right))
+          {
+            assert(_item_accessors(childnode).parent() == node);
+            const key_type childvalue = (nodekey & (childmask << 1)) | ((key_type) right << skip);
+            count += _triecheckvaliditybranch(childnode, childmask, childvalue, skip);
+          }
+        }
+        return count;
+      }
+#endif
+    public:
+      //! Asserts that the index is internally consistent.
+      void triecheckvalidity() const noexcept
+      {
+#ifndef NDEBUG
+        auto head = _head_accessors();
+        size_type count = 0;
+        for(unsigned bitidx = 0; bitidx < _key_type_bits; bitidx++)
+        {
+          if(auto *node = head.child(bitidx))
+          {
+            auto nodelink = _item_accessors(node);
+            assert(nodelink.parent_is_index());
+            assert(nodelink.bit_index() == bitidx);
+            // Bin zero holds keys zero and one
+            const unsigned lowbit = (bitidx != 0) ? bitidx : 1;
+            count += _triecheckvaliditybranch(node, (key_type) -1 << lowbit, (bitidx != 0) ? ((key_type) 1 << bitidx) : 0, lowbit);
+          }
+        }
+        assert(count == head.size());
+#endif
+      }
+
+    private:
+      template <bool is_const, class Parent, class Pointer, class Reference> class iterator_
+      {
+        friend class patricia_trie;
+        template <bool _is_const, class _Parent, class _Pointer, class _Reference> friend class iterator_;
+        Parent *_parent{nullptr};
+        Pointer _p{nullptr};
+
+        constexpr iterator_(const Parent *parent, Pointer p) noexcept
+            : _parent(const_cast<Parent *>(parent))
+            , _p(p)
+        {
+        }
+
+      public:
+        using difference_type = typename Parent::difference_type;
+        using value_type = typename Parent::value_type;
+        using pointer = Pointer;
+        using reference = Reference;
+        using iterator_category = std::bidirectional_iterator_tag;
+        constexpr iterator_() noexcept = default;
+        // Implicit non-const to const iterator
+        QUICKCPPLIB_TEMPLATE(class _Parent, class _Pointer, class _Reference)
+        QUICKCPPLIB_TREQUIRES(
+        QUICKCPPLIB_TPRED(is_const &&std::is_same<typename std::remove_const<Parent>::type, _Parent>::value))
+        constexpr iterator_(const iterator_<false, _Parent, _Pointer, _Reference> &o) noexcept
+            : _parent(o._parent)
+            , _p(o._p)
+        {
+        }
+
+        explicit operator bool() const noexcept { return _parent != nullptr && _p != nullptr; }
+        bool operator!() const noexcept { return _parent == nullptr || _p == nullptr; }
+        Pointer operator->() const noexcept { return _p; }
+        bool operator==(const iterator_ &o) const noexcept { return _parent == o._parent && _p == o._p; }
+        bool operator!=(const iterator_ &o) const noexcept { return _parent != o._parent || _p != o._p; }
+        Reference operator*() const noexcept
+        {
+          if(_parent == nullptr || _p == nullptr)
+          {
+            abort();
+          }
+          return *_p;
+        }
+        iterator_ &operator++() noexcept
+        {
+          if(_parent != nullptr && _p != nullptr)
+          {
+            _p = const_cast<Pointer>(_parent->_trienext(_p));
+          }
+          return *this;
+        }
+        iterator_ operator++(int) noexcept
+        {
+          iterator_ ret(*this);
+          ++*this;
+          return ret;
+        }
+        iterator_ &operator--() noexcept
+        {
+          if(_parent != nullptr)
+          {
+            _p = const_cast<Pointer>((_p == nullptr) ? _parent->_triemax() : _parent->_trieprev(_p));
+          }
+          return *this;
+        }
+        iterator_ operator--(int) noexcept
+        {
+          iterator_ ret(*this);
+          --*this;
+          return ret;
+        }
+      };
+
+    public:
+      //! The iterator type
+      using iterator = iterator_<false, patricia_trie, pointer, reference>;
+      //! The const iterator type
+      using const_iterator = iterator_<true, const patricia_trie, const_pointer, const_reference>;
+      //! The reverse iterator type
+      using reverse_iterator = std::reverse_iterator<iterator>;
+      //! The const reverse iterator type
+      using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+      constexpr patricia_trie() { clear(); }
+      QUICKCPPLIB_TEMPLATE(class Arg, class... Args)
+      QUICKCPPLIB_TREQUIRES(QUICKCPPLIB_TPRED(std::is_constructible<Base, Arg, Args...>::value))
+      constexpr explicit patricia_trie(Arg &&arg, Args &&...args)
+          : Base(static_cast<Arg &&>(arg), static_cast<Args &&>(args)...)
+      {
+        clear();
+      }
+      patricia_trie(const patricia_trie &) = delete;
+      patricia_trie &operator=(const patricia_trie &) = delete;
+
+      //! True if the index is empty
+      QUICKCPPLIB_NODISCARD constexpr bool empty() const noexcept { return size() == 0; }
+      //! Returns the number of items in the index
+      constexpr size_type size() const noexcept { return _head_accessors().size(); }
+      //! Returns the maximum number of items in the index
+      constexpr size_type max_size() const noexcept { return _head_accessors().max_size(); }
+
+      //! Returns an iterator to the first item in the index.
+      iterator begin() noexcept { return iterator(this, _triemin()); }
+      //! Returns an iterator to the first item in the index.
+      const_iterator begin() const noexcept { return const_iterator(this, _triemin()); }
+      //! Returns an iterator to the item after the last in the index.
+      iterator end() noexcept { return iterator(this, nullptr); }
+      //! Returns an iterator to the item after the last in the index.
+      const_iterator end() const noexcept { return const_iterator(this, nullptr); }
+      //! Returns an iterator to the last item in the index.
+      reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+      //! Returns an iterator to the last item in the index.
+      const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+      //! Returns an iterator to the item before the first in the index.
+      reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+      //! Returns an iterator to the item before the first in the index.
+      const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+
+      //! Clears the index.
+      constexpr void clear() noexcept
+      {
+        auto head = _head_accessors();
+        for(unsigned n = 0; n < _key_type_bits; n++)
+        {
+          head.set_child(n, nullptr);
+        }
+        head.set_size(0);
+      }
+      //! Return how many items with key there are.
+      size_type count(key_type k) const noexcept
+      {
+        const_pointer node = _triefind(k);
+        if(nullptr == node)
+        {
+          return 0;
+        }
+        size_type ret = 1;
+        for(const_pointer sibling = _item_accessors(node).sibling(true); sibling != node; sibling = _item_accessors(sibling).sibling(true))
+        {
+          ret++;
+        }
+        return ret;
+      }
+      /*! Inserts a new item, returning an iterator to the new item if successful, or to an
+      existing item with the same key if the item type has no siblings to store duplicates in.
+
+      If the maximum number of items has been inserted, if C++ exceptions are disabled
+      or `QUICKCPPLIB_ALGORITHM_BITWISE_TRIE_DISABLE_EXCEPTION_THROWS != 0`, the returned iterator
+      is invalid if there is no more space. Otherwise it throws `std::length_error`.
+      */
+      iterator insert(pointer p)
+      {
+        if(size() == max_size())
+        {
+#if __cpp_exceptions && !QUICKCPPLIB_ALGORITHM_BITWISE_TRIE_DISABLE_EXCEPTION_THROWS
+          throw std::length_error("patricia_trie is full");
+#else
+          return end();
+#endif
+        }
+        return iterator(this, _trieinsert(p));
+      }
+      //! Erases an item, returning an iterator to the item after it.
+      iterator erase(const_iterator it) noexcept
+      {
+        if(it == end())
+        {
+          assert(it != end());
+          return end();
+        }
+        pointer p = const_cast<pointer>(it._p);
+        /* If I was replaced, the item taking my place is next, else whatever was next */
+        pointer next = const_cast<pointer>(_trienext(p));
+        if(pointer replacement = _trieremove(p))
+        {
+          next = replacement;
+        }
+        return iterator(this, next);
+      }
+      //! Erases an item.
+      void erase(pointer p) noexcept { _trieremove(p); }
+      //! Erases the first inserted item with the key.
+      iterator erase(key_type k) noexcept { return erase(find(k)); }
+      //! Finds the first inserted item with the key
+      iterator find(key_type k) const noexcept { return iterator(this, _triefind(k)); }
+      //! True if the index contains the key
+      bool contains(key_type k) const noexcept { return nullptr != _triefind(k); }
+      /*! Finds either an item with identical key, or an item with a larger key. This is always
+      the item with the next largest key, as that costs no more than `O(depth)` here. `rounds` is
+      accepted for compatibility with `bitwise_trie`.
+      */
+      iterator find_equal_or_larger(key_type k, int64_t /*unused*/) const noexcept { return find_equal_or_next_largest(k); }
+      //! Finds either an item with identical key, or an item with the guaranteed next largest key.
+      iterator find_equal_or_next_largest(key_type k) const noexcept
+      {
+        return iterator(this, const_cast<pointer>(_trieclosest<1>(k)));
+      }
+      /*! Finds either an item with identical key, or an item with a smaller key. This is always
+      the item with the next smallest key. `rounds` is accepted for compatibility with `bitwise_trie`.
+      */
+      iterator find_equal_or_smaller(key_type k, int64_t /*unused*/) const noexcept { return find_equal_or_next_smallest(k); }
+      //! Finds either an item with identical key, or an item with the guaranteed next smallest key.
+      iterator find_equal_or_next_smallest(key_type k) const noexcept
+      {
+        return iterator(this, const_cast<pointer>(_trieclosest<-1>(k)));
+      }
+      //! Finds the item with the key not less than the key.
+      iterator lower_bound(key_type k) const noexcept { return find_equal_or_next_largest(k); }
+      //! Finds the item next larger than the key.
+      iterator upper_bound(key_type k) const noexcept
+      {
+        return (k == (key_type) -1) ? iterator(this, nullptr) : find_equal_or_next_largest(k + 1);
+      }
+    };
+  }  // namespace patricia_trie
+}  // namespace algorithm
+
+QUICKCPPLIB_NAMESPACE_END
+
+#endif
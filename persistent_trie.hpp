@@ -0,0 +1,609 @@
+/* Persistent copy on write trie algorithm
+(C) 2026 The nedtries contributors
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef QUICKCPPLIB_ALGORITHM_PERSISTENT_TRIE_HPP
+#define QUICKCPPLIB_ALGORITHM_PERSISTENT_TRIE_HPP
+
+#include "bitwise_trie.hpp"
+
+#include <memory>  // for unique_ptr
+
+QUICKCPPLIB_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  namespace persistent_trie
+  {
+    /*! \class persistent_trie_item_accessors
+    \brief Default accessor for a persistent trie item.
+    \tparam ItemType The type of item indexed.
+
+    As the links are kept apart from the items, this default accessor requires only the
+    following member variable in the trie item type:
+
+    - `KeyType trie_key`
+    */
+    template <class ItemType> class persistent_trie_item_accessors
+    {
+      ItemType *_v;
+
+    public:
+      constexpr persistent_trie_item_accessors(ItemType *v)
+          : _v(v)
+      {
+      }
+      constexpr auto key() const noexcept { return _v->trie_key; }
+    };
+
+    /*! \class persistent_trie
+    \brief Copy on write bitwise Fredkin trie index with `O(1)` immutable snapshots.
+    \tparam ItemType The type of item indexed.
+    \tparam ItemAccessors Accessors for the items indexed.
+
+    The same trie as `bitwise_trie`, with items bucketed by their top set bit into bins and
+    each level below choosing a child by the next bit of the key, but the links are kept in
+    link records apart from the items rather than in the items, so many versions of the trie
+    can share them.
+
+    `snapshot()` returns an immutable view of the index as it is now in `O(1)`, which may be
+    read, copied and released on any thread while this index continues to be modified. Link
+    records are reference counted, and an insert or erase copies only those records from its
+    bin root down to the change which some snapshot can still reach, so each write costs at
+    most `O(depth)` allocations of link records, and none at all if no snapshot shares its
+    path. Link records come from an arena shared by the index and its snapshots, which keeps
+    freed records for reuse, so after warming up writes mostly do not call the allocator.
+
+    Items are not modified, so may be `const` and may be indexed by many indices at once. Only
+    one item per key is stored. Any modification of the index, and taking a snapshot, must
+    be serialised by the caller, but snapshots need no synchronisation at all.
+    */
+    template <class ItemType, template <class> class ItemAccessors = persistent_trie_item_accessors> class persistent_trie
+    {
+      static constexpr ItemAccessors<const ItemType> _item_accessors(const ItemType *item) noexcept
+      {
+        return ItemAccessors<const ItemType>(item);
+      }
+
+    public:
+      //! Key type indexing the items
+      using key_type = typename std::decay<decltype(_item_accessors(static_cast<ItemType *>(nullptr)).key())>::type;
+      //! The type of item indexed
+      using mapped_type = ItemType *;
+      //! The value type
+      using value_type = ItemType *;
+      //! The size type
+      using size_type = size_t;
+      //! A pointer to the type of item indexed
+      using pointer = ItemType *;
+
+    private:
+      static constexpr unsigned _key_type_bits = (unsigned) (8 * sizeof(key_type));
+      static_assert(bitwise_trie::detail::is_unsigned_key<key_type>::value, "key type must be unsigned");
+
+      struct _node
+      {
+        std::atomic<size_t> refs{0};  // the roots and nodes which link to this one
+        key_type key{};
+        pointer item{nullptr};
+        _node *child[2]{nullptr, nullptr};
+      };
+      struct _root
+      {
+        std::atomic<size_t> refs{1};  // the index and snapshots of this version
+        size_type count{0};
+        _node *bins[_key_type_bits];
+
+        _root() noexcept { memset(bins, 0, sizeof(bins)); }
+      };
+      /* Link records are carved out of chunks doubling in size, and freed records are kept on
+      a free list threaded through their first child. Records are freed by whichever thread
+      releases the last reference, so the free list is spinlocked. */
+      class _arena
+      {
+        std::atomic<unsigned> _lock{0};
+        _node *_free{nullptr};
+        size_t _next_chunk{16};
+        std::vector<std::unique_ptr<_node[]>> _chunks;
+
+        void _acquire() noexcept
+        {
+          unsigned spins = 0;
+          for(;;)
+          {
+            unsigned expected = 0;
+            if(_lock.compare_exchange_weak(expected, 1, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+              return;
+            }
+            bitwise_trie::detail::spin_pause(spins);
+          }
+        }
+        void _release() noexcept { _lock.store(0, std::memory_order_release); }
+
+      public:
+        std::atomic<size_t> refs{1};  // the index and its snapshots
+
+        // Fills out with n records, or throws having changed nothing
+        void allocate(_node **out, unsigned n)
+        {
+          _acquire();
+          unsigned have = 0;
+          for(_node *i = _free; i != nullptr && have < n; i = i->child[0])
+          {
+            have++;
+          }
+#if __cpp_exceptions
+          try
+          {
+#endif
+            while(have < n)
+            {
+              _chunks.reserve(_chunks.size() + 1);
+              _chunks.emplace_back(new _node[_next_chunk]);
+              _node *chunk = _chunks.back().get();
+              for(size_t i = 0; i < _next_chunk; i++)
+              {
+                chunk[i].child[0] = _free;
+                _free = chunk + i;
+              }
+              have += (unsigned) _next_chunk;
+              _next_chunk += (_next_chunk < 4096) ? _next_chunk : 0;
+            }
+#if __cpp_exceptions
+          }
+          catch(...)
+          {
+            _release();
+            throw;
+          }
+#endif
+          for(unsigned i = 0; i < n; i++)
+          {
+            out[i] = _free;
+            _free = _free->child[0];
+          }
+          _release();
+        }
+        void deallocate(_node *node) noexcept
+        {
+          _acquire();
+          node->child[0] = _free;
+          _free = node;
+          _release();
+        }
+      };
+
+      // Drops a reference to a node, freeing it and dropping its references if it was the last
+      static void _unref(_arena *arena, _node *node) noexcept
+      {
+        if(node != nullptr && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+          _unref(arena, node->child[0]);
+          _unref(arena, node->child[1]);
+          arena->deallocate(node);
+        }
+      }
+      static void _unref(_arena *arena, _root *root) noexcept
+      {
+        if(root != nullptr && root->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+          for(auto *node : root->bins)
+          {
+            _unref(arena, node);
+          }
+          delete root;
+        }
+      }
+      static void _unref(_arena *arena) noexcept
+      {
+        if(arena != nullptr && arena->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+          delete arena;
+        }
+      }
+      static void _ref(_node *node) noexcept
+      {
+        if(node != nullptr)
+        {
+          node->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+
+      // Reading is the same for the index and its snapshots
+      static const _node *_find(const _root *root, key_type k) noexcept
+      {
+        const unsigned bitidx = bitwise_trie::detail::bitscanr(k);
+        bitwise_trie::detail::keybit_cursor<key_type> keybit(bitidx);
+        for(const _node *node = root->bins[bitidx]; node != nullptr;)
+        {
+          if(node->key == k)
+          {
+            return node;
+          }
+          keybit.next();
+          node = node->child[keybit.test(k)];
+        }
+        return nullptr;
+      }
+      template <class F> static void _for_each(const _node *node, F &f)
+      {
+        while(node != nullptr)
+        {
+          f(node->item);
+          if(node->child[0] != nullptr && node->child[1] != nullptr)
+          {
+            _for_each(node->child[0], f);
+            node = node->child[1];
+          }
+          else
+          {
+            node = (node->child[0] != nullptr) ? node->child[0] : node->child[1];
+          }
+        }
+      }
+      template <class F> static void _for_each(const _root *root, F &f)
+      {
+        for(const _node *node : root->bins)
+        {
+          _for_each(node, f);
+        }
+      }
+
+      _arena *_a{nullptr};
+      _root *_r{nullptr};
+
+      /* Makes the root and path[0, depth), a path down from the root of bin bitidx, private to
+      this index so they may be modified in place. Those which a snapshot may also reach are
+      replaced by copies, which take a reference to each child of the original. Also allocates
+      extra fresh nodes into spare. Everything is allocated before anything is changed, so if
+      allocation throws the index is unaltered. */
+      void _make_private(unsigned bitidx, _node **path, unsigned depth, _node **spare, unsigned extra)
+      {
+        // Only this index referring to the root and each node means no snapshot can reach them
+        const bool rootprivate = _r->refs.load(std::memory_order_acquire) == 1;
+        unsigned first = 0;
+        if(rootprivate)
+        {
+          while(first < depth && path[first]->refs.load(std::memory_order_acquire) == 1)
+          {
+            first++;
+          }
+        }
+        std::unique_ptr<_root> newroot(rootprivate ? nullptr : new _root);
+        _node *fresh[_key_type_bits + 2];
+        _a->allocate(fresh, depth - first + extra);
+        if(!rootprivate)
+        {
+          newroot->count = _r->count;
+          for(unsigned n = 0; n < _key_type_bits; n++)
+          {
+            newroot->bins[n] = _r->bins[n];
+            _ref(newroot->bins[n]);
+          }
+          _unref(_a, _r);
+          _r = newroot.release();
+        }
+        _node **link = &_r->bins[bitidx];
+        for(unsigned n = 0; n < depth; n++)
+        {
+          if(n >= first)
+          {
+            _node *copy = fresh[n - first];
+            copy->refs.store(1, std::memory_order_relaxed);
+            copy->key = path[n]->key;
+            copy->item = path[n]->item;
+            for(unsigned c = 0; c < 2; c++)
+            {
+              copy->child[c] = path[n]->child[c];
+              _ref(copy->child[c]);
+            }
+            *link = copy;
+            _unref(_a, path[n]);
+            path[n] = copy;
+          }
+          if(n + 1 < depth)
+          {
+            link = &path[n]->child[path[n]->child[1] == path[n + 1]];
+          }
+        }
+        for(unsigned n = 0; n < extra; n++)
+        {
+          spare[n] = fresh[depth - first + n];
+        }
+      }
+
+    public:
+      /*! \class snapshot_type
+      \brief An immutable view of a `persistent_trie` as it was when the snapshot was taken.
+
+      Copying a snapshot is `O(1)`. Snapshots may be read, copied and destroyed on any thread
+      without synchronisation, and may outlive the index they were taken from.
+      */
+      class snapshot_type
+      {
+        friend class persistent_trie;
+        _arena *_a{nullptr};
+        _root *_r{nullptr};
+
+        snapshot_type(_arena *a, _root *r) noexcept
+            : _a(a)
+            , _r(r)
+        {
+          _a->refs.fetch_add(1, std::memory_order_relaxed);
+          _r->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+      public:
+        //! Constructs an empty snapshot.
+        constexpr snapshot_type() noexcept {}
+        snapshot_type(const snapshot_type &o) noexcept
+            : _a(o._a)
+            , _r(o._r)
+        {
+          if(_r != nullptr)
+          {
+            _a->refs.fetch_add(1, std::memory_order_relaxed);
+            _r->refs.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+        snapshot_type(snapshot_type &&o) noexcept
+            : _a(o._a)
+            , _r(o._r)
+        {
+          o._a = nullptr;
+          o._r = nullptr;
+        }
+        snapshot_type &operator=(const snapshot_type &o) noexcept
+        {
+          if(this != &o)
+          {
+            this->~snapshot_type();
+            new(this) snapshot_type(o);
+          }
+          return *this;
+        }
+        snapshot_type &operator=(snapshot_type &&o) noexcept
+        {
+          if(this != &o)
+          {
+            this->~snapshot_type();
+            new(this) snapshot_type(std::move(o));
+          }
+          return *this;
+        }
+        ~snapshot_type()
+        {
+          _unref(_a, _r);
+          _unref(_a);
+          _a = nullptr;
+          _r = nullptr;
+        }
+
+        //! True if the snapshot is empty
+        bool empty() const noexcept { return size() == 0; }
+        //! Returns the number of items in the snapshot
+        size_type size() const noexcept { return (_r != nullptr) ? _r->count : 0; }
+        //! Finds the item with a key, returning null if there is none
+        pointer find(key_type k) const noexcept
+        {
+          const _node *node = (_r != nullptr) ? _find(_r, k) : nullptr;
+          return (node != nullptr) ? node->item : nullptr;
+        }
+        //! True if there is an item with a key
+        bool contains(key_type k) const noexcept { return find(k) != nullptr; }
+        //! Calls `f(pointer)` for every item, in bin order but not key order within a bin.
+        template <class F> void for_each(F &&f) const
+        {
+          if(_r != nullptr)
+          {
+            _for_each(_r, f);
+          }
+        }
+      };
+
+      //! Constructs an empty index. Throws `std::bad_alloc` if allocation fails.
+      persistent_trie()
+          : _a(new _arena)
+      {
+#if __cpp_exceptions
+        try
+        {
+#endif
+          _r = new _root;
+#if __cpp_exceptions
+        }
+        catch(...)
+        {
+          delete _a;
+          throw;
+        }
+#endif
+      }
+      persistent_trie(const persistent_trie &) = delete;
+      persistent_trie(persistent_trie &&o) noexcept
+          : _a(o._a)
+          , _r(o._r)
+      {
+        o._a = nullptr;
+        o._r = nullptr;
+      }
+      persistent_trie &operator=(const persistent_trie &) = delete;
+      persistent_trie &operator=(persistent_trie &&o) noexcept
+      {
+        if(this != &o)
+        {
+          this->~persistent_trie();
+          new(this) persistent_trie(std::move(o));
+        }
+        return *this;
+      }
+      ~persistent_trie()
+      {
+        _unref(_a, _r);
+        _unref(_a);
+        _a = nullptr;
+        _r = nullptr;
+      }
+
+      //! True if the index is empty
+      bool empty() const noexcept { return size() == 0; }
+      //! Returns the number of items in the index
+      size_type size() const noexcept { return (_r != nullptr) ? _r->count : 0; }
+      //! Finds the item with a key, returning null if there is none
+      pointer find(key_type k) const noexcept
+      {
+        const _node *node = (_r != nullptr) ? _find(_r, k) : nullptr;
+        return (node != nullptr) ? node->item : nullptr;
+      }
+      //! True if there is an item with a key
+      bool contains(key_type k) const noexcept { return find(k) != nullptr; }
+      //! Calls `f(pointer)` for every item, in bin order but not key order within a bin.
+      template <class F> void for_each(F &&f) const
+      {
+        if(_r != nullptr)
+        {
+          _for_each(_r, f);
+        }
+      }
+      //! Returns an immutable view of the index as it is now in `O(1)`.
+      snapshot_type snapshot() const noexcept { return {_a, _r}; }
+
+      /*! Inserts an item, returning it if its key is new, otherwise returning the item
+      already with that key. Copies those link records down to the new item's parent which
+      a snapshot can reach. Throws `std::bad_alloc` if allocation fails, leaving the index
+      unaltered.
+      */
+      pointer insert(pointer p)
+      {
+        const key_type k = _item_accessors(p).key();
+        const unsigned bitidx = bitwise_trie::detail::bitscanr(k);
+        bitwise_trie::detail::keybit_cursor<key_type> keybit(bitidx);
+        assert(bitidx < _key_type_bits);
+        _node *path[_key_type_bits + 1];
+        unsigned depth = 0;
+        bool keybitset = false;
+        for(_node *node = _r->bins[bitidx]; node != nullptr; node = node->child[keybitset])
+        {
+          if(node->key == k)
+          {
+            return node->item;
+          }
+          path[depth++] = node;
+          keybit.next();
+          keybitset = keybit.test(k);
+        }
+        _node *leaf;
+        _make_private(bitidx, path, depth, &leaf, 1);
+        leaf->refs.store(1, std::memory_order_relaxed);
+        leaf->key = k;
+        leaf->item = p;
+        leaf->child[0] = leaf->child[1] = nullptr;
+        if(0 == depth)
+        {
+          _r->bins[bitidx] = leaf;
+        }
+        else
+        {
+          path[depth - 1]->child[keybitset] = leaf;
+        }
+        _r->count++;
+        return p;
+      }
+      /*! Erases the item with a key, returning it, or null if there was none. A leaf from below
+      the item's link record takes its place, and those link records down to the leaf which a
+      snapshot can reach are copied. Throws `std::bad_alloc` if allocation fails, leaving the
+      index unaltered.
+      */
+      pointer erase(key_type k)
+      {
+        const unsigned bitidx = bitwise_trie::detail::bitscanr(k);
+        bitwise_trie::detail::keybit_cursor<key_type> keybit(bitidx);
+        assert(bitidx < _key_type_bits);
+        _node *path[_key_type_bits + 1];
+        unsigned depth = 0, found = 0;
+        for(_node *node = _r->bins[bitidx];; node = node->child[keybit.test(k)])
+        {
+          if(nullptr == node)
+          {
+            return nullptr;
+          }
+          path[depth++] = node;
+          if(node->key == k)
+          {
+            found = depth - 1;
+            break;
+          }
+          keybit.next();
+        }
+        for(_node *node = path[depth - 1]; node->child[0] != nullptr || node->child[1] != nullptr;)
+        {
+          node = (node->child[0] != nullptr) ? node->child[0] : node->child[1];
+          path[depth++] = node;
+        }
+        _make_private(bitidx, path, depth, nullptr, 0);
+        _node *leaf = path[depth - 1];
+        pointer ret = path[found]->item;
+        if(leaf != path[found])
+        {
+          path[found]->key = leaf->key;
+          path[found]->item = leaf->item;
+        }
+        if(1 == depth)
+        {
+          _r->bins[bitidx] = nullptr;
+        }
+        else
+        {
+          path[depth - 2]->child[path[depth - 2]->child[1] == leaf] = nullptr;
+        }
+        _unref(_a, leaf);
+        _r->count--;
+        return ret;
+      }
+      /*! Erases all items. Throws `std::bad_alloc` if allocation fails, leaving the index
+      unaltered.
+      */
+      void clear()
+      {
+        if(_r->refs.load(std::memory_order_acquire) != 1)
+        {
+          _root *newroot = new _root;
+          _unref(_a, _r);
+          _r = newroot;
+          return;
+        }
+        for(auto *&node : _r->bins)
+        {
+          _unref(_a, node);
+          node = nullptr;
+        }
+        _r->count = 0;
+      }
+    };
+  }  // namespace persistent_trie
+}  // namespace algorithm
+
+QUICKCPPLIB_NAMESPACE_END
+
+#endif
@@ -0,0 +1,515 @@
+/* NUMA replicated bitwise trie algorithm
+(C) 2026 The nedtries contributors
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef QUICKCPPLIB_ALGORITHM_REPLICATED_TRIE_HPP
+#define QUICKCPPLIB_ALGORITHM_REPLICATED_TRIE_HPP
+
+#include "bitwise_trie.hpp"
+
+#include <cstdint>
+#include <cstdio>   // for fopen
+#include <cstdlib>  // for strtoul, malloc
+#include <limits>
+#include <new>  // for bad_alloc
+
+#ifdef __linux__
+#include <sched.h>  // for sched_getcpu
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+QUICKCPPLIB_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  namespace replicated_trie
+  {
+    /*! \class numa_topology
+    \brief The NUMA nodes of this machine and the CPUs in each.
+
+    On Linux this is read once from `/sys/devices/system/node`. Elsewhere, or if that cannot
+    be read, the machine is taken to be a single node containing every CPU.
+    */
+    class numa_topology
+    {
+      std::vector<int> _nodes;                   // the id of each node with CPUs
+      std::vector<unsigned> _cpu_node;           // index into _nodes of each CPU
+      std::vector<std::vector<unsigned>> _cpus;  // the CPUs of each node
+
+      // Calls f with each number in a Linux list format file such as "0-3,8-11"
+      template <class F> static bool _parse_list(const char *path, F &&f)
+      {
+        FILE *fh = fopen(path, "r");
+        if(fh == nullptr)
+        {
+          return false;
+        }
+        char buffer[4096];
+        const bool ok = (fgets(buffer, sizeof(buffer), fh) != nullptr);
+        fclose(fh);
+        if(!ok)
+        {
+          return false;
+        }
+        for(const char *p = buffer; *p >= '0' && *p <= '9';)
+        {
+          char *e;
+          const unsigned long a = strtoul(p, &e, 10);
+          unsigned long b = a;
+          if(*e == '-')
+          {
+            b = strtoul(e + 1, &e, 10);
+          }
+          for(unsigned long i = a; i <= b; i++)
+          {
+            f((unsigned) i);
+          }
+          p = (*e == ',') ? e + 1 : e;
+        }
+        return true;
+      }
+
+      numa_topology()
+      {
+#ifdef __linux__
+        std::vector<int> online;
+        if(_parse_list("/sys/devices/system/node/online", [&](unsigned node) { online.push_back((int) node); }))
+        {
+          for(int node : online)
+          {
+            char path[64];
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+            std::vector<unsigned> cpus;
+            if(_parse_list(path, [&](unsigned cpu) { cpus.push_back(cpu); }) && !cpus.empty())
+            {
+              for(unsigned cpu : cpus)
+              {
+                if(cpu >= _cpu_node.size())
+                {
+                  _cpu_node.resize(cpu + 1, 0);
+                }
+                _cpu_node[cpu] = (unsigned) _nodes.size();
+              }
+              _nodes.push_back(node);
+              _cpus.push_back(std::move(cpus));
+            }
+          }
+        }
+#endif
+        if(_nodes.empty())
+        {
+          _nodes.push_back(0);
+          _cpus.emplace_back();
+          for(unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++)
+          {
+            _cpus[0].push_back(cpu);
+          }
+          _cpu_node.clear();
+        }
+      }
+
+    public:
+      //! The topology of this machine.
+      static const numa_topology &current()
+      {
+        static const numa_topology v;
+        return v;
+      }
+      //! The number of NUMA nodes with CPUs, which is at least one.
+      size_t nodes() const noexcept { return _nodes.size(); }
+      //! The operating system's id of the node at an index.
+      int node_id(size_t idx) const noexcept { return _nodes[idx]; }
+      //! The CPUs of the node at an index.
+      const std::vector<unsigned> &cpus(size_t idx) const noexcept { return _cpus[idx]; }
+      //! The index of the node containing a CPU.
+      size_t node_of_cpu(unsigned cpu) const noexcept { return (cpu < _cpu_node.size()) ? _cpu_node[cpu] : 0; }
+      //! The index of the node of the CPU the calling thread is running on, which may change at any time.
+      size_t current_node() const noexcept
+      {
+#ifdef __linux__
+        if(_nodes.size() > 1)
+        {
+          const int cpu = sched_getcpu();
+          if(cpu >= 0)
+          {
+            return node_of_cpu((unsigned) cpu);
+          }
+        }
+#endif
+        return 0;
+      }
+    };
+
+    /*! \class replicated_trie_item_accessors
+    \brief Default accessor for a replicated trie item.
+    \tparam ItemType The type of item indexed.
+
+    As the links are kept apart from the items, this default accessor requires only the
+    following member variable in the trie item type:
+
+    - `KeyType trie_key`
+    */
+    template <class ItemType> class replicated_trie_item_accessors
+    {
+      ItemType *_v;
+
+    public:
+      constexpr replicated_trie_item_accessors(ItemType *v)
+          : _v(v)
+      {
+      }
+      constexpr auto key() const noexcept { return _v->trie_key; }
+    };
+
+    /*! \class replicated_trie
+    \brief Bitwise Fredkin trie index keeping a copy of its links on each NUMA node, for read mostly use.
+    \tparam ItemType The type of item indexed.
+    \tparam ItemAccessors Accessors for the items indexed.
+    \tparam Lock The type of lock guarding each replica, which must meet `SharedMutex`.
+    \tparam OffsetType The signed type of the self relative links within each replica.
+
+    A `bitwise_trie` lookup is a chain of dependent loads, one per level, and when the items
+    holding the links were allocated on another NUMA node each of those loads crosses the
+    interconnect. Here the links are kept in link records apart from the items, one array
+    of records per replica, each replica's memory being placed on its own node by `mbind()`.
+    `find()` traverses the replica of the node the calling thread is running on, so every
+    load but the final one of the item found is local. Link records hold a copy of their
+    item's key, so traversal never touches the items.
+
+    Each replica is a `bitwise_trie` with `offset_bitwise_trie_head_accessors` and
+    `offset_bitwise_trie_item_accessors` over a single allocation holding its head and link
+    records, so its layout is position independent and identical across replicas: an item
+    has the same record index in every replica.
+
+    Readers take a shared lock on their own replica only. A write takes an exclusive lock
+    serialising writers, then applies the change to each replica in turn under that
+    replica's exclusive lock, so writes cost `O(replicas)` and readers on different nodes may
+    briefly disagree about an item being inserted or erased. On machines with one node, or
+    which are not Linux, there is a single replica unless more are asked for.
+
+    The maximum number of items is fixed at construction, as is the memory for every
+    replica. Only one item per key is stored, and items are not modified, so may be `const`.
+    */
+    template <class ItemType, template <class> class ItemAccessors = replicated_trie_item_accessors,
+              class Lock = bitwise_trie::bitwise_trie_branch_lock, class OffsetType = int32_t>
+    class replicated_trie
+    {
+      static constexpr ItemAccessors<const ItemType> _item_accessors(const ItemType *item) noexcept
+      {
+        return ItemAccessors<const ItemType>(item);
+      }
+
+    public:
+      //! Key type indexing the items
+      using key_type = typename std::decay<decltype(_item_accessors(static_cast<ItemType *>(nullptr)).key())>::type;
+      //! The type of item indexed
+      using mapped_type = ItemType *;
+      //! The value type
+      using value_type = ItemType *;
+      //! The size type
+      using size_type = size_t;
+      //! A pointer to the type of item indexed
+      using pointer = ItemType *;
+
+    private:
+      static_assert(bitwise_trie::detail::is_unsigned_key<key_type>::value, "key type must be unsigned");
+      static_assert(std::is_signed<OffsetType>::value, "offset type must be signed");
+
+      struct _link
+      {
+        OffsetType trie_parent;
+        OffsetType trie_child[2];
+        key_type trie_key;
+        pointer item;
+      };
+      struct _head
+      {
+        size_t trie_count;
+        bool trie_nobbledir{false};
+        OffsetType trie_children[8 * sizeof(size_t) > 8 * sizeof(key_type) ? 8 * sizeof(size_t) : 8 * sizeof(key_type)];
+      };
+      using _index_type = bitwise_trie::bitwise_trie<_head, _link, 0, bitwise_trie::offset_bitwise_trie_head_accessors,
+                                                     bitwise_trie::offset_bitwise_trie_item_accessors>;
+      // Each replica is one allocation of this followed by its link records
+      struct alignas(64) _replica
+      {
+        mutable Lock lock;
+        _index_type index;
+        size_t node{0};  // index into numa_topology
+        size_t bytes{0};
+        void *mem{nullptr};  // what was allocated, which may lie before this
+
+        _link *links() noexcept { return reinterpret_cast<_link *>(this + 1); }
+      };
+
+      size_t _capacity{0};
+      std::vector<_replica *> _replicas;
+      std::vector<size_t> _node_replica;  // replica for each node index
+      mutable Lock _write_lock;
+      /* Erased link records are kept on a free list threaded through the parent link of
+      the first replica's records, with -1 for its end. Records after _used are unused. */
+      OffsetType _free{-1};
+      size_t _used{0};
+
+      static void _deallocate(_replica *r) noexcept
+      {
+        const size_t bytes = r->bytes;
+        void *mem = r->mem;
+        r->~_replica();
+#ifdef __linux__
+        (void) mem;
+        ::munmap((void *) r, bytes);
+#else
+        (void) bytes;
+        ::free(mem);
+#endif
+      }
+      _replica *_allocate(size_t node) const
+      {
+        const size_t bytes = sizeof(_replica) + _capacity * sizeof(_link);
+#ifdef __linux__
+        void *mem = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(mem == MAP_FAILED)
+        {
+          mem = nullptr;
+        }
+        else if(numa_topology::current().nodes() > 1)
+        {
+          /* Prefer rather than bind, so a full node spills elsewhere instead of failing.
+          No pages have been touched yet, so all will be allocated under this policy. If
+          this fails the pages land wherever the first thread to touch them runs. */
+          const int id = numa_topology::current().node_id(node);
+          std::vector<unsigned long> mask(id / (8 * sizeof(unsigned long)) + 1, 0);
+          mask[id / (8 * sizeof(unsigned long))] |= 1UL << (id % (8 * sizeof(unsigned long)));
+          (void) ::syscall(SYS_mbind, mem, bytes, 1 /* MPOL_PREFERRED */, mask.data(), mask.size() * 8 * sizeof(unsigned long) + 1, 0);
+        }
+        void *p = mem;
+#else
+        // Over allocate and align by hand, as aligned operator new needs C++ 17
+        void *mem = ::malloc(bytes + alignof(_replica) - 1);
+        void *p = (void *) (((uintptr_t) mem + alignof(_replica) - 1) & ~(uintptr_t) (alignof(_replica) - 1));
+#endif
+        if(mem == nullptr)
+        {
+#if __cpp_exceptions
+          throw std::bad_alloc();
+#else
+          abort();
+#endif
+        }
+        auto *r = new(p) _replica;
+        r->node = node;
+        r->bytes = bytes;
+        r->mem = mem;
+        return r;
+      }
+
+      _replica &_local() const noexcept { return *_replicas[_node_replica[numa_topology::current().current_node()]]; }
+      static pointer _find(_replica &r, key_type k) noexcept
+      {
+        r.lock.lock_shared();
+        auto it = r.index.find(k);
+        pointer ret = (it != r.index.end()) ? it->item : nullptr;
+        r.lock.unlock_shared();
+        return ret;
+      }
+
+    public:
+      /*! Constructs an empty index able to hold `capacity` items, with `replicas` copies of
+      its links, or one per NUMA node if zero. Replicas are spread round robin over the
+      nodes, and readers on a node use one of the replicas on it. Throws `std::bad_alloc` if
+      allocation fails, or `std::length_error` if `capacity` is too large for `OffsetType`.
+      */
+      explicit replicated_trie(size_t capacity, size_t replicas = 0)
+          : _capacity(capacity)
+      {
+        const auto &topology = numa_topology::current();
+        if(replicas == 0)
+        {
+          replicas = topology.nodes();
+        }
+        if(capacity > ((size_t) std::numeric_limits<OffsetType>::max() - sizeof(_replica)) / sizeof(_link))
+        {
+#if __cpp_exceptions
+          throw std::length_error("capacity too large for offset type");
+#else
+          abort();
+#endif
+        }
+        _replicas.reserve(replicas);
+        _node_replica.resize(topology.nodes());
+#if __cpp_exceptions
+        try
+        {
+#endif
+          for(size_t n = 0; n < replicas; n++)
+          {
+            _replicas.push_back(_allocate(n % topology.nodes()));
+          }
+#if __cpp_exceptions
+        }
+        catch(...)
+        {
+          for(auto *r : _replicas)
+          {
+            _deallocate(r);
+          }
+          throw;
+        }
+#endif
+        for(size_t n = 0; n < topology.nodes(); n++)
+        {
+          _node_replica[n] = n % replicas;
+        }
+      }
+      replicated_trie(const replicated_trie &) = delete;
+      replicated_trie &operator=(const replicated_trie &) = delete;
+      ~replicated_trie()
+      {
+        for(auto *r : _replicas)
+        {
+          _deallocate(r);
+        }
+      }
+
+      //! The maximum number of items.
+      size_type capacity() const noexcept { return _capacity; }
+      //! The number of items in the index.
+      size_type size() const noexcept
+      {
+        _replica &first = *_replicas.front();
+        first.lock.lock_shared();
+        const size_type ret = first.index.size();
+        first.lock.unlock_shared();
+        return ret;
+      }
+      //! True if the index is empty.
+      bool empty() const noexcept { return size() == 0; }
+      //! The number of replicas.
+      size_t replicas() const noexcept { return _replicas.size(); }
+      //! The index into `numa_topology::current()` of the node a replica is on.
+      size_t replica_node(size_t replica) const noexcept { return _replicas[replica]->node; }
+      //! The replica which `find()` uses from the CPU the calling thread is running on.
+      size_t local_replica() const noexcept { return _node_replica[numa_topology::current().current_node()]; }
+
+      //! Finds the item with a key in the replica local to the calling thread, returning null if none.
+      pointer find(key_type k) const noexcept { return _find(_local(), k); }
+      //! Finds the item with a key in a specific replica, returning null if none.
+      pointer find(key_type k, size_t replica) const noexcept { return _find(*_replicas[replica], k); }
+      //! True if an item with the key is in the index.
+      bool contains(key_type k) const noexcept { return find(k) != nullptr; }
+
+      /*! Inserts an item into every replica, returning the item now indexed under its key,
+      which is the existing item if there was one.
+
+      If the maximum number of items has been inserted, if C++ exceptions are disabled
+      or `QUICKCPPLIB_ALGORITHM_BITWISE_TRIE_DISABLE_EXCEPTION_THROWS != 0`, returns null.
+      Otherwise it throws `std::length_error`.
+      */
+      pointer insert(pointer p)
+      {
+        const key_type k = _item_accessors(p).key();
+        _write_lock.lock();
+        pointer existing = _find(*_replicas.front(), k);
+        if(existing != nullptr)
+        {
+          _write_lock.unlock();
+          return existing;
+        }
+        if(_free < 0 && _used == _capacity)
+        {
+          _write_lock.unlock();
+#if __cpp_exceptions && !QUICKCPPLIB_ALGORITHM_BITWISE_TRIE_DISABLE_EXCEPTION_THROWS
+          throw std::length_error("too many items");
+#else
+          return nullptr;
+#endif
+        }
+        size_t idx;
+        if(_free >= 0)
+        {
+          idx = (size_t) _free;
+          _free = _replicas.front()->links()[idx].trie_parent;
+        }
+        else
+        {
+          idx = _used++;
+        }
+        for(auto *r : _replicas)
+        {
+          _link *l = r->links() + idx;
+          l->trie_key = k;
+          l->item = p;
+          r->lock.lock();
+          r->index.insert(l);
+          r->lock.unlock();
+        }
+        _write_lock.unlock();
+        return p;
+      }
+      //! Erases the item with a key from every replica, returning how many were erased.
+      size_type erase(key_type k) noexcept
+      {
+        _write_lock.lock();
+        _replica &first = *_replicas.front();
+        auto it = first.index.find(k);
+        if(it == first.index.end())
+        {
+          _write_lock.unlock();
+          return 0;
+        }
+        const size_t idx = (size_t) (&*it - first.links());
+        for(auto *r : _replicas)
+        {
+          r->lock.lock();
+          r->index.erase(r->links() + idx);
+          r->lock.unlock();
+        }
+        first.links()[idx].trie_parent = _free;
+        _free = (OffsetType) idx;
+        _write_lock.unlock();
+        return 1;
+      }
+      //! Erases all items.
+      void clear() noexcept
+      {
+        _write_lock.lock();
+        for(auto *r : _replicas)
+        {
+          r->lock.lock();
+          r->index.clear();
+          r->lock.unlock();
+        }
+        _free = -1;
+        _used = 0;
+        _write_lock.unlock();
+      }
+    };
+  }  // namespace replicated_trie
+}  // namespace algorithm
+
+QUICKCPPLIB_NAMESPACE_END
+
+#endif
@@ -0,0 +1,363 @@
+/* Sharded bitwise trie algorithm
+(C) 2026 The nedtries contributors
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef QUICKCPPLIB_ALGORITHM_SHARDED_BITWISE_TRIE_HPP
+#define QUICKCPPLIB_ALGORITHM_SHARDED_BITWISE_TRIE_HPP
+
+#include "bitwise_trie.hpp"
+
+QUICKCPPLIB_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  namespace bitwise_trie
+  {
+    /*! \class sharded_bitwise_trie
+    \brief Many independent bitwise trie index heads, with keys striped across them by their low bits.
+    \tparam Shards The number of index heads, which must be a power of two.
+    \tparam Base The index head type of each shard.
+    \tparam ItemType The type of item indexed.
+    \tparam NobbleDir -1 to nobble zeros, +1 to nobble ones, 0 to nobble both equally.
+    \tparam HeadAccessors The accessor type for each index head.
+    \tparam ItemAccessors The accessor type for the items.
+    \tparam Lock The type of lock guarding each shard, which must meet `SharedMutex`.
+
+    With per bin locking in `concurrent_bitwise_trie_head_accessors`, modifications of keys
+    with the same top set bit serialise on the same lock. Hash keys almost all have one of
+    their top few bits set, so a write heavy workload on hash keys gets little parallelism
+    from it. Here each key is instead routed by its low bits, which for hash keys are evenly
+    distributed, to one of `Shards` wholly independent `bitwise_trie` indices, each with its
+    own cache line sized lock, so writers on different threads mostly touch different locks
+    and different index heads.
+
+    `find()`, `insert()` and `erase()` lock one shard. `find_equal_or_larger()` and its
+    variants must search every shard for the smallest key, so cost `O(Shards)` times more.
+    Iteration visits each shard in turn, and within a shard is in that shard's iteration
+    order, so it is *not* in key order. Incrementing an iterator holds its shard's shared
+    lock, so is safe against concurrent modification so long as the item currently referred
+    to is not erased, exactly as for `concurrent_bitwise_trie_head_accessors`.
+
+    Keys must be native unsigned integers. Items keep a single set of trie links, so an
+    item can only be in one shard, and so in only one sharded index, at a time.
+    */
+    template <size_t Shards, class Base, class ItemType, int NobbleDir = 0,
+              template <class, class> class HeadAccessors = bitwise_trie_head_accessors,
+              template <class> class ItemAccessors = bitwise_trie_item_accessors, class Lock = bitwise_trie_branch_lock>
+    class sharded_bitwise_trie
+    {
+      static_assert(Shards > 0 && (Shards & (Shards - 1)) == 0, "Shards must be a power of two");
+
+    public:
+      //! The type of each shard's index
+      using index_type = bitwise_trie<Base, ItemType, NobbleDir, HeadAccessors, ItemAccessors>;
+      //! Key type indexing the items
+      using key_type = typename index_type::key_type;
+      //! The type of item indexed
+      using mapped_type = typename index_type::mapped_type;
+      //! The value type
+      using value_type = typename index_type::value_type;
+      //! The size type
+      using size_type = size_t;
+      //! The type of a difference between pointers to the type of item indexed
+      using difference_type = ptrdiff_t;
+      //! A reference to the type of item indexed
+      using reference = typename index_type::reference;
+      //! A pointer to the type of item indexed
+      using pointer = typename index_type::pointer;
+      //! A const pointer to the type of item indexed
+      using const_pointer = typename index_type::const_pointer;
+
+    private:
+      static_assert(detail::is_unsigned_key<key_type>::value && !std::is_class<key_type>::value,
+                    "key type must be a native unsigned integer");
+
+      struct alignas(64) _shard_type
+      {
+        mutable Lock lock;
+        index_type index;
+      };
+      _shard_type _shards[Shards];
+
+      struct _shared_lock
+      {
+        Lock &_lock;
+        explicit _shared_lock(const _shard_type &shard) noexcept
+            : _lock(shard.lock)
+        {
+          _lock.lock_shared();
+        }
+        _shared_lock(const _shared_lock &) = delete;
+        _shared_lock &operator=(const _shared_lock &) = delete;
+        ~_shared_lock() { _lock.unlock_shared(); }
+      };
+      struct _exclusive_lock
+      {
+        Lock &_lock;
+        explicit _exclusive_lock(const _shard_type &shard) noexcept
+            : _lock(shard.lock)
+        {
+          _lock.lock();
+        }
+        _exclusive_lock(const _exclusive_lock &) = delete;
+        _exclusive_lock &operator=(const _exclusive_lock &) = delete;
+        ~_exclusive_lock() { _lock.unlock(); }
+      };
+
+      static key_type _key(const_pointer p) noexcept { return ItemAccessors<const ItemType>(p).key(); }
+      // Shards hand out mutable iterators even when const, as bitwise_trie::find() does
+      index_type &_index(size_t n) const noexcept { return const_cast<index_type &>(_shards[n].index); }
+
+    public:
+      //! The shard index which a key is routed to
+      static constexpr size_t shard_of(key_type k) noexcept { return (size_t) (k & (key_type) (Shards - 1)); }
+      //! Direct access to a shard's index. This takes no lock.
+      index_type &shard(size_t n) noexcept { return _shards[n].index; }
+      //! \overload
+      const index_type &shard(size_t n) const noexcept { return _shards[n].index; }
+
+      //! A forward iterator visiting each shard in turn.
+      class iterator
+      {
+        friend class sharded_bitwise_trie;
+        const sharded_bitwise_trie *_parent{nullptr};
+        size_t _shard{Shards};
+        typename index_type::iterator _it;
+
+        // Moves to the first item of the first non-empty shard from _shard onwards
+        void _skip_empty() noexcept
+        {
+          for(; _shard < Shards; _shard++)
+          {
+            _shared_lock g(_parent->_shards[_shard]);
+            _it = _parent->_index(_shard).begin();
+            if(_it != _parent->_index(_shard).end())
+            {
+              return;
+            }
+          }
+          _it = {};
+        }
+        iterator(const sharded_bitwise_trie *parent, size_t shard, typename index_type::iterator it) noexcept
+            : _parent(parent)
+            , _shard(shard)
+            , _it(it)
+        {
+          if(_it == _parent->_index(_shard).end())
+          {
+            _shard = Shards;
+            _it = {};
+          }
+        }
+
+      public:
+        using difference_type = ptrdiff_t;
+        using value_type = typename sharded_bitwise_trie::value_type;
+        using pointer = typename sharded_bitwise_trie::pointer;
+        using reference = typename sharded_bitwise_trie::reference;
+        using iterator_category = std::forward_iterator_tag;
+
+        constexpr iterator() noexcept {}
+
+        explicit operator bool() const noexcept { return _shard < Shards; }
+        bool operator!() const noexcept { return _shard >= Shards; }
+        pointer operator->() const noexcept { return &*_it; }
+        reference operator*() const noexcept { return *_it; }
+        bool operator==(const iterator &o) const noexcept { return _shard == o._shard && _it == o._it; }
+        bool operator!=(const iterator &o) const noexcept { return !(*this == o); }
+        iterator &operator++() noexcept
+        {
+          if(_shard < Shards)
+          {
+            {
+              _shared_lock g(_parent->_shards[_shard]);
+              if(++_it != _parent->_index(_shard).end())
+              {
+                return *this;
+              }
+            }
+            _shard++;
+            _skip_empty();
+          }
+          return *this;
+        }
+        iterator operator++(int) noexcept
+        {
+          iterator ret(*this);
+          ++*this;
+          return ret;
+        }
+      };
+      //! All iterators are mutable, as the iterators of `bitwise_trie` are.
+      using const_iterator = iterator;
+
+    private:
+      /* Calls f(index) on every shard under its shared lock, and returns an iterator to the
+      item found with the smallest key according to less. */
+      template <class F, class Less> iterator _best_of_shards(F &&f, Less &&less) const noexcept
+      {
+        iterator ret = end();
+        key_type retkey{};  // copied while its shard is locked
+        for(size_t n = 0; n < Shards; n++)
+        {
+          _shared_lock g(_shards[n]);
+          auto it = f(_index(n));
+          if(it != _index(n).end() && (!ret || less(_key(&*it), retkey)))
+          {
+            ret = iterator(this, n, it);
+            retkey = _key(&*it);
+          }
+        }
+        return ret;
+      }
+
+    public:
+      constexpr sharded_bitwise_trie() = default;
+      sharded_bitwise_trie(const sharded_bitwise_trie &) = delete;
+      sharded_bitwise_trie &operator=(const sharded_bitwise_trie &) = delete;
+
+      //! True if the index is empty. Takes every shard's shared lock in turn.
+      bool empty() const noexcept { return size() == 0; }
+      //! The number of items in the index. Takes every shard's shared lock in turn.
+      size_type size() const noexcept
+      {
+        size_type ret = 0;
+        for(auto &i : _shards)
+        {
+          _shared_lock g(i);
+          ret += i.index.size();
+        }
+        return ret;
+      }
+      //! Returns an iterator to the first item of the first non-empty shard.
+      iterator begin() const noexcept
+      {
+        iterator ret;
+        ret._parent = this;
+        ret._shard = 0;
+        ret._skip_empty();
+        return ret;
+      }
+      //! Returns an iterator to after the last item.
+      iterator end() const noexcept
+      {
+        iterator ret;
+        ret._parent = this;
+        return ret;
+      }
+      //! Erases all items. Takes every shard's exclusive lock in turn.
+      void clear() noexcept
+      {
+        for(auto &i : _shards)
+        {
+          _exclusive_lock g(i);
+          i.index.clear();
+        }
+      }
+
+      /*! Inserts a new item into its key's shard, as `bitwise_trie::insert()` does. Returns an
+      iterator to the item, the existing item with the same key if the item's type does not
+      keep duplicates, or `end()` if the shard is full and C++ exceptions are disabled.
+      */
+      iterator insert(pointer p)
+      {
+        auto &shard = _shards[shard_of(_key(p))];
+        _exclusive_lock g(shard);
+        return iterator(this, (size_t) (&shard - _shards), shard.index.insert(p));
+      }
+      //! Erases an item.
+      void erase(pointer p) noexcept
+      {
+        auto &shard = _shards[shard_of(_key(p))];
+        _exclusive_lock g(shard);
+        shard.index.erase(p);
+      }
+      //! Erases an item, returning an iterator to the next item.
+      iterator erase(const_iterator it) noexcept
+      {
+        if(it == end())
+        {
+          assert(it != end());
+          return end();
+        }
+        iterator ret(it);
+        ++ret;
+        erase(&*it);
+        return ret;
+      }
+      //! Erases the first item with a key, returning how many were erased.
+      size_type erase(key_type k) noexcept
+      {
+        auto &shard = _shards[shard_of(k)];
+        _exclusive_lock g(shard);
+        auto it = shard.index.find(k);
+        if(it == shard.index.end())
+        {
+          return 0;
+        }
+        shard.index.erase(it);
+        return 1;
+      }
+      //! Finds an item.
+      iterator find(key_type k) const noexcept
+      {
+        const size_t n = shard_of(k);
+        _shared_lock g(_shards[n]);
+        return iterator(this, n, _index(n).find(k));
+      }
+      //! True if an item with the key is in the index.
+      bool contains(key_type k) const noexcept { return find(k) != end(); }
+      /*! Finds either an item with identical key, or an item with a larger key, as
+      `bitwise_trie::find_equal_or_larger()` does, searching every shard and returning the
+      item with the smallest key found.
+      */
+      iterator find_equal_or_larger(key_type k, int64_t rounds) const noexcept
+      {
+        return _best_of_shards([&](const index_type &index) { return index.find_equal_or_larger(k, rounds); },
+                               [](key_type a, key_type b) { return a < b; });
+      }
+      //! Finds either an item with identical key, or the item with the next largest key.
+      iterator find_equal_or_next_largest(key_type k) const noexcept
+      {
+        return _best_of_shards([&](const index_type &index) { return index.find_equal_or_next_largest(k); },
+                               [](key_type a, key_type b) { return a < b; });
+      }
+      //! Finds the item next larger than the key.
+      iterator upper_bound(key_type k) const noexcept
+      {
+        return _best_of_shards([&](const index_type &index) { return index.upper_bound(k); },
+                               [](key_type a, key_type b) { return a < b; });
+      }
+      //! Finds either an item with identical key, or the item with the next smallest key.
+      iterator find_equal_or_next_smallest(key_type k) const noexcept
+      {
+        return _best_of_shards([&](const index_type &index) { return index.find_equal_or_next_smallest(k); },
+                               [](key_type a, key_type b) { return a > b; });
+      }
+    };
+  }  // namespace bitwise_trie
+}  // namespace algorithm
+
+QUICKCPPLIB_NAMESPACE_END
+
+#endif
@@ -32,6 +32,23 @@ size_t fookeyfunct(const foo_t *r)
 
 NEDTRIE_GENERATE(static, foo_tree_s, foo_s, link, fookeyfunct, NEDTRIE_NOBBLEZEROS(foo_tree_s))
 
+/* Same again, but with the key cached in the link */
+typedef struct bar_s bar_t;
+struct bar_s {
+  NEDTRIE_ENTRY_WITHKEY(bar_s) link;
+  size_t key;
+};
+typedef struct bar_tree_s bar_tree_t;
+NEDTRIE_HEAD(bar_tree_s, bar_s);
+static bar_tree_t bartree;
+
+#ifdef __cplusplus
+NEDTRIE_GENERATE_LINKKEY(extern, bar_tree_s, bar_s, link)
+#else
+NEDTRIE_GENERATE_LINKKEY(static, bar_tree_s, bar_s, link)
+#endif
+NEDTRIE_GENERATE(static, bar_tree_s, bar_s, link, NEDTRIE_LINKKEY(bar_tree_s), NEDTRIE_NOBBLEZEROS(bar_tree_s))
+
 #if defined(__cplusplus) && NEDTRIE_ENABLE_STL_CONTAINERS
 struct keyfunct : public std::unary_function<int, size_t>
 {
@@ -57,7 +74,9 @@ int main(void)
   c.key=5;
   r=NEDTRIE_NFIND(foo_tree_s, &footree, &c);
   assert(r==&b); /* NFIND finds next largest. Invert the key function (i.e. 1-key) to find next smallest. */
+  assert(footree.triebinmask==(((size_t) 1<<1)|((size_t) 1<<2)));
   NEDTRIE_REMOVE(foo_tree_s, &footree, &a);
+  assert(footree.triebinmask==((size_t) 1<<2));
   NEDTRIE_FOREACH(r, foo_tree_s, &footree)
   {
     printf("%p, %u\n", (void *) r, (unsigned) r->key);
@@ -78,10 +97,29 @@ int main(void)
   assert(map.size()==1);
   assert(multimap.size()==2);
   assert(79==*map.find(5));
+  assert(map.end()==map.find(6));
   trie_multimap<size_t, size_t, keyfunct>::const_iterator it=multimap.find(5);
   assert(79==*it);
   --it; // NEDTRIE_PREV
   assert(78==*it);
+  {
+    typedef trie_maptype<size_t, size_t, trie_maptype_keyfunct<size_t, size_t>, std::list<size_t>::iterator> slabmaptype;
+    trie_map<size_t, size_t, trie_maptype_keyfunct<size_t, size_t>, std::allocator<slabmaptype>, nedpolicy::nobblezeros, slab_list<slabmaptype> > slabmap;
+    size_t n, total=0;
+    for(n=0; n<1000; n++)
+      slabmap[n*7]=n;
+    assert(slabmap.size()==1000);
+    for(n=0; n<1000; n+=2)
+      slabmap.erase(slabmap.find(n*7));
+    for(n=1000; n<1250; n++)
+      slabmap[n*7]=n; /* reuses the erased slots */
+    assert(slabmap.size()==750);
+    for(n=0; n<1250; n++)
+      assert((slabmap.find(n*7)==slabmap.end())==(n<1000 && !(n&1)));
+    for(trie_map<size_t, size_t, trie_maptype_keyfunct<size_t, size_t>, std::allocator<slabmaptype>, nedpolicy::nobblezeros, slab_list<slabmaptype> >::iterator sit=slabmap.begin(); sit!=slabmap.end(); ++sit)
+      total++;
+    assert(total==750);
+  }
 #endif
 
   /* From https://github.com/ned14/nedtries/issues/5 */
@@ -182,6 +220,19 @@ int main(void)
           }
         }
       }
+      r=NEDTRIE_NFINDSMALLER(foo_tree_s, &footree, &c);
+      if(c.key<min->key)
+      { /* If search key is smaller than min key, it must always return zero */
+        assert(r==0);
+      }
+      else
+      { /* Assert it correctly clamped to nearest smaller */
+        for(m=RANDOM_NFIND_TEST_ITEMS-1; m>0 && items_sorted[m]->key>c.key; m--);
+        assert(r==items_sorted[m]);
+      }
+      r2=NEDTRIE_CFINDSMALLER(foo_tree_s, &footree, &c, 0);
+      assert((r2==0)==(r==0));
+      assert(!r2 || r2->key<=c.key);
     }
     printf("Nfind returned a different item to Cfind %d of %d (%f%%) iterations\n", promoted, ITERATIONS, 100.0*promoted/ITERATIONS);
 #if 0
@@ -189,5 +240,78 @@ int main(void)
     getchar();
 #endif
   }
+
+  printf("Key in link ...\n");
+  {
+    static bar_t items[256];
+    bar_t t, *r2;
+    int n, m;
+    NEDTRIE_INIT(&bartree);
+    for(n=0; n<256; n++)
+    {
+      items[n].link.trie_key=(size_t) n*3+1;
+      NEDTRIE_INSERT(bar_tree_s, &bartree, &items[n]);
+      assert(items[n].link.trie_key==(size_t) n*3+1); /* insert must not wipe the key */
+    }
+    for(n=0; n<256; n+=2)
+      NEDTRIE_REMOVE(bar_tree_s, &bartree, &items[n]);
+    assert(NEDTRIE_COUNT(&bartree)==128);
+    for(n=0; n<256*3+1; n++)
+    {
+      t.link.trie_key=(size_t) n;
+      r2=NEDTRIE_FIND(bar_tree_s, &bartree, &t);
+      assert(r2==((n%3==1 && (n/3)&1) ? &items[n/3] : 0));
+    }
+    m=0;
+    NEDTRIE_FOREACH(r2, bar_tree_s, &bartree)
+    {
+      assert(r2>=items && r2<items+256 && ((r2-items)&1));
+      m++;
+    }
+    assert(m==128);
+  }
+
+  printf("Batch insert ...\n");
+  {
+    static foo_t items[1024];
+    static foo_t *batch[1024];
+    foo_t *r2;
+    int n, m;
+    NEDTRIE_INIT(&footree);
+    for(n=0; n<1024; n++)
+    {
+      /* Spread keys over every bin, with some duplicates */
+      items[n].key=(size_t) gen_rand32() >> (gen_rand32() & 31);
+      if(n>0 && !(n & 15)) items[n].key=items[n-1].key;
+      batch[n]=&items[n];
+    }
+    NEDTRIE_INSERT_BATCH(foo_tree_s, &footree, batch, 1024);
+    assert(NEDTRIE_COUNT(&footree)==1024);
+    for(n=0; n<1024; n++)
+    {
+      r=NEDTRIE_FIND(foo_tree_s, &footree, &items[n]);
+      assert(r && r->key==items[n].key);
+    }
+    m=0;
+    NEDTRIE_FOREACH(r2, foo_tree_s, &footree)
+    {
+      m++;
+    }
+    assert(m==1024);
+
+    printf("Sorted iteration ...\n");
+    {
+      NEDTRIE_SORTEDCURSOR cursor;
+      size_t lastkey=0;
+      m=0;
+      NEDTRIE_FOREACH_SORTED(r2, foo_tree_s, &footree, &cursor)
+      {
+        assert(r2->key>=lastkey);
+        lastkey=r2->key;
+        m++;
+      }
+      assert(m==1024);
+    }
+  }
   return 0;
 }
@@ -22,6 +22,11 @@ Distributed under the Boost Software License, Version 1.0.
 */
 
 #include "../include/quickcpplib/algorithm/bitwise_trie.hpp"
+#include "../include/quickcpplib/algorithm/multiway_trie.hpp"
+#include "../include/quickcpplib/algorithm/patricia_trie.hpp"
+#include "../include/quickcpplib/algorithm/persistent_trie.hpp"
+#include "../include/quickcpplib/algorithm/replicated_trie.hpp"
+#include "../include/quickcpplib/algorithm/sharded_bitwise_trie.hpp"
 
 #include "../include/quickcpplib/algorithm/hash.hpp"
 #include "../include/quickcpplib/algorithm/small_prng.hpp"
@@ -32,12 +37,136 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include "timing.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <string>
+#include <thread>
+#include <tuple>
 #include <unordered_set>
 #include <vector>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 BOOST_AUTO_TEST_SUITE(bitwise_trie)
 
+// Item types shared by the tests below, with sibling links, inline duplicates, subtree counts or none
+struct foo_t
+{
+  foo_t *trie_parent;
+  foo_t *trie_child[2];
+  foo_t *trie_sibling[2];
+  uint32_t trie_key{0};
+};
+struct inline_foo_t
+{
+  inline_foo_t *trie_parent;
+  inline_foo_t *trie_child[2];
+  uint32_t trie_key{0};
+
+  static constexpr bool trie_inline_duplicates() { return true; }
+};
+struct counted_foo_t
+{
+  counted_foo_t *trie_parent;
+  counted_foo_t *trie_child[2];
+  counted_foo_t *trie_sibling[2];
+  uint32_t trie_key{0};
+  uint32_t trie_subtree_count{0};
+};
+struct counted_inline_foo_t
+{
+  counted_inline_foo_t *trie_parent;
+  counted_inline_foo_t *trie_child[2];
+  uint32_t trie_key{0};
+  uint32_t trie_subtree_count{0};
+
+  static constexpr bool trie_inline_duplicates() { return true; }
+};
+struct unique_foo_t
+{
+  unique_foo_t *trie_parent;
+  unique_foo_t *trie_child[2];
+  uint32_t trie_key{0};
+};
+// Items for multiway_trie of radix 4 and 16
+struct foo4_t
+{
+  foo4_t *trie_parent;
+  foo4_t *trie_child[4];
+  uint32_t trie_key{0};
+};
+struct foo16_t
+{
+  foo16_t *trie_parent;
+  foo16_t *trie_child[16];
+  uint32_t trie_key{0};
+};
+template <class Item> struct foo_tree_t
+{
+  size_t trie_count;
+  size_t trie_occupancy{0};
+  bool trie_nobbledir{false};
+  Item *trie_children[8 * sizeof(size_t)];
+};
+
+/* Times inserting items with random keys into a new Index, and then finding or erasing them all,
+appending the nanoseconds per item of each to results */
+using benchmark_results = std::vector<std::pair<double, double>>;
+template <class Index, class Item> void benchmark_index(benchmark_results &results, std::vector<Item> &storage, bool erase = false)
+{
+  Index index;
+  QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+  for(auto &i : storage)
+  {
+    i.trie_key = rand();
+  }
+  auto begin = nanoclock();
+  for(auto &i : storage)
+  {
+    index.insert(&i);
+  }
+  auto inserted = nanoclock();
+  size_t done = 0;
+  for(auto &i : storage)
+  {
+    if(erase)
+    {
+      index.erase(&i);
+      done++;
+    }
+    else
+    {
+      done += (index.find(i.trie_key) != index.end());
+    }
+  }
+  auto end = nanoclock();
+  BOOST_CHECK(done == storage.size());
+  BOOST_CHECK(index.size() == (erase ? 0 : storage.size()));
+  results.emplace_back((double) (inserted - begin) / storage.size(), (double) (end - inserted) / storage.size());
+}
+// Prints two series of benchmark_index() results side by side, the first of each being for 2^20 items
+inline void print_benchmark_versus(const std::string &title, const benchmark_results &a, const benchmark_results &b,
+                                   const char *second)
+{
+  std::cout << title << ":";
+  for(size_t n = 0; n < a.size(); n++)
+  {
+    std::cout << "\n   " << ((size_t) 1 << (20 + n)) << ": " << a[n].first << " vs " << b[n].first << " ns per item insert, "
+              << a[n].second << " vs " << b[n].second << " ns per item " << second;
+  }
+  std::cout << std::endl;
+}
+
 BOOST_AUTO_TEST_CASE(bitwise_trie / works, "Tests that bitwise_trie works as advertised")
 {
   using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
@@ -60,6 +189,7 @@ BOOST_AUTO_TEST_CASE(bitwise_trie / works, "Tests that bitwise_trie works as adv
   {
     size_t trie_count;
     bool trie_nobbledir{false};
+    size_t trie_occupancy{0};
     foo_t *trie_children[8 * sizeof(size_t)];
   };
 
@@ -71,11 +201,15 @@ BOOST_AUTO_TEST_CASE(bitwise_trie / works, "Tests that bitwise_trie works as adv
     index.insert(&a);
     b.trie_key = 6;
     index.insert(&b);
+    BOOST_CHECK(index.trie_occupancy == ((1U << 1) | (1U << 2)));
     auto it = index.find(6);
     BOOST_CHECK(it->trie_key == 6);
     it = index.find_equal_or_next_largest(5);
     BOOST_CHECK(it->trie_key == 6);
+    BOOST_CHECK(index.find_equal_or_next_smallest(5)->trie_key == 2);
+    BOOST_CHECK(index.find_equal_or_next_smallest(1) == index.end());
     index.erase(2);
+    BOOST_CHECK(index.trie_occupancy == (1U << 2));
     for(auto &i : index)
     {
       std::cout << &i << ", " << i.trie_key << "\n";
@@ -287,6 +421,58 @@ BOOST_AUTO_TEST_CASE(bitwise_trie / works, "Tests that bitwise_trie works as adv
                 << (100.0 * acc_diff / acc_count / UINT32_MAX) << "% from ideal." << std::endl;
     }
   }
+  {
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      auto v = rand();
+      auto it1 = shouldbe.upper_bound(v);
+      auto it2 = index.find_equal_or_next_smallest(v);
+      if(it1 == shouldbe.begin())
+      {
+        BOOST_CHECK(it2 == index.end());
+      }
+      else
+      {
+        BOOST_REQUIRE(it2 != index.end());
+        BOOST_CHECK(*--it1 == it2->trie_key);
+      }
+      it1 = shouldbe.lower_bound(v);
+      it2 = index.lower_bound(v);
+      BOOST_CHECK((it1 == shouldbe.end()) == (it2 == index.end()));
+      if(it1 != shouldbe.end() && it2 != index.end())
+      {
+        BOOST_CHECK(*it1 == it2->trie_key);
+      }
+    }
+  }
+  {
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(int rounds = 0; rounds < 20; rounds += 4)
+    {
+      uint64_t acc_diff = 0, acc_count = 0;
+      for(size_t n = 0; n < ITEMS_COUNT; n++)
+      {
+        auto v = rand();
+        auto it1 = shouldbe.upper_bound(v);
+        auto it2 = index.find_equal_or_smaller(v, rounds);
+        if(it1 == shouldbe.begin())
+        {
+          BOOST_CHECK(it2 == index.end());
+        }
+        else
+        {
+          BOOST_REQUIRE(it2 != index.end());
+          --it1;
+          BOOST_CHECK(it2->trie_key <= *it1);
+          acc_diff += *it1 - it2->trie_key;
+          acc_count++;
+        }
+      }
+      std::cout << "\nFor rounds = " << rounds << " smaller close fit was an average of "
+                << (100.0 * acc_diff / acc_count / UINT32_MAX) << "% from ideal." << std::endl;
+    }
+  }
 }
 
 BOOST_AUTO_TEST_CASE(bitwise_trie / benchmark, "Benchmarks bitwise_trie against other algorithms")
@@ -357,6 +543,39 @@ BOOST_AUTO_TEST_CASE(bitwise_trie / benchmark, "Benchmarks bitwise_trie against
     }
     std::cout << std::endl;
   }
+  {
+    auto benchmark = [&](auto *item, auto *index, const char *desc) {
+      using item_type = typename std::remove_pointer<decltype(item)>::type;
+      using index_type = typename std::remove_pointer<decltype(index)>::type;
+      index_type idx;
+      std::vector<item_type> storage;
+      storage.reserve(ITEMS_COUNT);
+      std::vector<std::pair<size_t, uint64_t>> clocks;
+      clocks.reserve(ITEMS_BITSHIFT + 1);
+      size_t n = 0;
+      for(size_t x = 0, m = 1; x < ITEMS_BITSHIFT; x++, m <<= 1)
+      {
+        clocks.emplace_back(n, nanoclock());
+        for(; n < m; n++)
+        {
+          storage.emplace_back();
+          storage.back().trie_key = randoms[n];
+          idx.insert(&storage.back());
+        }
+      }
+      clocks.emplace_back(n, nanoclock());
+      std::cout << "For " << desc << ":";
+      for(n = 1; n < clocks.size(); n++)
+      {
+        std::cout << "\n   " << clocks[n].first << ": "
+                  << ((double) (clocks[n].second - clocks[0].second) / clocks[n].first) << " ns per item insert";
+      }
+      std::cout << std::endl;
+    };
+    using QUICKCPPLIB_NAMESPACE::algorithm::multiway_trie::multiway_trie;
+    benchmark((foo4_t *) nullptr, (multiway_trie<foo_tree_t<foo4_t>, foo4_t> *) nullptr, "multiway_trie radix 4");
+    benchmark((foo16_t *) nullptr, (multiway_trie<foo_tree_t<foo16_t>, foo16_t> *) nullptr, "multiway_trie radix 16");
+  }
   {
     std::vector<char> buffer;
     buffer.reserve(ITEMS_COUNT * bytes_per_item);
@@ -417,4 +636,2385 @@ BOOST_AUTO_TEST_CASE(bitwise_trie / benchmark, "Benchmarks bitwise_trie against
   }
 }
 
+BOOST_AUTO_TEST_CASE(bitwise_trie / insert_range, "Tests bulk loading a bitwise_trie from a range")
+{
+  using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  using index_type = bitwise_trie<foo_tree_t<foo_t>, foo_t>;
+  static constexpr size_t ITEMS_COUNT = 1 << 20;
+  std::vector<foo_t> storage;
+  storage.reserve(ITEMS_COUNT);
+  std::vector<foo_t *> ptrs;
+  ptrs.reserve(ITEMS_COUNT);
+  {
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      // Spread keys over every bin, as a free list's block sizes would be
+      auto v = rand();
+      storage.emplace_back();
+      storage.back().trie_key = v >> (rand() & 31);
+    }
+    // Visit the items in a scattered order, as a free list would
+    for(auto &i : storage)
+    {
+      ptrs.push_back(&i);
+    }
+    for(size_t n = ITEMS_COUNT - 1; n > 0; n--)
+    {
+      std::swap(ptrs[n], ptrs[rand() % (n + 1)]);
+    }
+  }
+  {
+    index_type index;
+    index.insert(ptrs.begin(), ptrs.end());
+    BOOST_CHECK(index.size() == ITEMS_COUNT);
+    index.triecheckvalidity();
+    for(size_t n = 0; n < ITEMS_COUNT; n += 97)
+    {
+      auto it = index.find(storage[n].trie_key);
+      BOOST_REQUIRE(it != index.end());
+      BOOST_CHECK(it->trie_key == storage[n].trie_key);
+    }
+    size_t count = 0;
+    for(auto &i : index)
+    {
+      (void) i;
+      count++;
+    }
+    BOOST_CHECK(count == ITEMS_COUNT);
+  }
+  {
+    // Any input range works
+    std::set<foo_t *> few;
+    for(size_t n = 0; n < 1000; n++)
+    {
+      few.insert(ptrs[n]);
+    }
+    index_type index;
+    index.insert(few.begin(), few.end());
+    BOOST_CHECK(index.size() == 1000);
+    index.triecheckvalidity();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / range, "Tests and benchmarks visiting and erasing key ranges of a bitwise_trie")
+{
+  using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  static constexpr size_t ITEMS_COUNT = 1 << 20;
+  std::vector<foo_t> storage(ITEMS_COUNT);
+  std::multiset<uint32_t> shouldbe;
+  bitwise_trie<foo_tree_t<foo_t>, foo_t> index;
+  QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+  for(size_t n = 0; n < ITEMS_COUNT; n++)
+  {
+    // Small keys plus some duplicates exercise the low bins and sibling lists
+    storage[n].trie_key = (n & 255) ? (rand() >> (rand() & 31)) : storage[n - (n > 0)].trie_key;
+    shouldbe.insert(storage[n].trie_key);
+    index.insert(&storage[n]);
+  }
+  for(size_t n = 0; n < 1000; n++)
+  {
+    uint32_t a = rand() >> (rand() & 31), b = a + (rand() >> (rand() & 31));
+    if(n < 32)
+    {
+      a = (uint32_t) n;
+      b = a + (uint32_t) (n & 3);
+    }
+    size_t count = 0;
+    bool ok = true;
+    const auto &cindex = index;
+    BOOST_CHECK(cindex.for_each_in_range(a, b, [&](const foo_t *i) {
+      ok = ok && i->trie_key >= a && i->trie_key < b;
+      count++;
+    }) == count);
+    BOOST_CHECK(ok);
+    BOOST_CHECK(count == (size_t) std::distance(shouldbe.lower_bound(a), shouldbe.lower_bound(b)));
+  }
+  {
+    size_t count = 0;
+    auto begin = nanoclock();
+    for(size_t n = 0; n < 1000; n++)
+    {
+      const uint32_t a = rand();
+      index.for_each_in_range(a, a + 4096, [&](foo_t * /*unused*/) { count++; });
+    }
+    auto ranged = nanoclock();
+    for(auto &i : index)
+    {
+      count += (i.trie_key < 4096);
+    }
+    auto end = nanoclock();
+    std::cout << "Visiting a range of 4096 keys out of " << ITEMS_COUNT << " items took "
+              << ((double) (ranged - begin) / 1000) << " ns versus " << (end - ranged)
+              << " ns for a full iteration (" << count << ")." << std::endl;
+  }
+  for(size_t n = 0; n < 100; n++)
+  {
+    const uint32_t a = rand() >> (rand() & 31), b = a + (rand() >> (rand() & 31) >> 4);
+    const size_t shouldcount = (size_t) std::distance(shouldbe.lower_bound(a), shouldbe.lower_bound(b));
+    BOOST_CHECK(index.erase_range(a, b) == shouldcount);
+    shouldbe.erase(shouldbe.lower_bound(a), shouldbe.lower_bound(b));
+    BOOST_CHECK(index.size() == shouldbe.size());
+    BOOST_CHECK(index.for_each_in_range(a, b, [](foo_t * /*unused*/) {}) == 0);
+  }
+  index.triecheckvalidity();
+  BOOST_CHECK(index.erase_range(0, (uint32_t) -1) == shouldbe.size() - shouldbe.count((uint32_t) -1));
+  BOOST_CHECK(index.size() == shouldbe.count((uint32_t) -1));
+  index.triecheckvalidity();
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / find_many, "Tests and benchmarks finding many keys at once in a bitwise_trie")
+{
+  using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  struct locked_foo_tree_t
+  {
+    std::atomic<size_t> trie_count{0};
+    std::atomic<bool> trie_nobbledir{false};
+    std::atomic<size_t> trie_occupancy{0};
+    foo_t *trie_children[8 * sizeof(size_t)];
+    bitwise_trie_branch_lock trie_locks[8 * sizeof(size_t)];
+  };
+  static constexpr size_t ITEMS_COUNT = 1 << 20;
+  std::vector<foo_t> storage;
+  storage.reserve(ITEMS_COUNT);
+  std::vector<uint32_t> keys;
+  keys.reserve(ITEMS_COUNT);
+  bitwise_trie<foo_tree_t<foo_t>, foo_t> index;
+  {
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      storage.emplace_back();
+      storage.back().trie_key = rand();
+      index.insert(&storage.back());
+      // Half the keys looked up will be present, half will probably not be
+      keys.push_back((n & 1) ? storage[rand() % storage.size()].trie_key : rand());
+    }
+  }
+  std::vector<foo_t *> out(ITEMS_COUNT), shouldbe(ITEMS_COUNT);
+  auto begin = nanoclock();
+  for(size_t n = 0; n < ITEMS_COUNT; n++)
+  {
+    auto it = index.find(keys[n]);
+    shouldbe[n] = (it == index.end()) ? nullptr : &*it;
+  }
+  auto oneatatime = nanoclock() - begin;
+  begin = nanoclock();
+  size_t found = index.find_many(keys.data(), keys.size(), out.data());
+  auto many = nanoclock() - begin;
+  BOOST_CHECK(found == (size_t) (ITEMS_COUNT - std::count(shouldbe.begin(), shouldbe.end(), nullptr)));
+  BOOST_CHECK(out == shouldbe);
+  {
+    // Locked branches fall back to one at a time
+    bitwise_trie<locked_foo_tree_t, foo_t, 0, concurrent_bitwise_trie_head_accessors> locked_index;
+    for(size_t n = 0; n < 1000; n++)
+    {
+      locked_index.insert(&storage[n]);
+    }
+    std::vector<foo_t *> out2(1000);
+    locked_index.find_many(keys.data(), 1000, out2.data());
+    for(size_t n = 0; n < 1000; n++)
+    {
+      auto it = locked_index.find(keys[n]);
+      BOOST_CHECK(out2[n] == ((it == locked_index.end()) ? nullptr : &*it));
+    }
+  }
+  {
+    // Empty index finds nothing
+    bitwise_trie<foo_tree_t<foo_t>, foo_t> empty;
+    BOOST_CHECK(0 == empty.find_many(keys.data(), 100, out.data()));
+    BOOST_CHECK(out[99] == nullptr);
+  }
+  std::cout << "Finding " << ITEMS_COUNT << " keys one at a time took " << ((double) oneatatime / ITEMS_COUNT)
+            << " ns per key, with find_many took " << ((double) many / ITEMS_COUNT) << " ns per key." << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / offset, "Tests that a bitwise_trie using offset pointers can be relocated and memory mapped")
+{
+  using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  struct offset_foo_t
+  {
+    int32_t trie_parent;
+    int32_t trie_child[2];
+    int32_t trie_sibling[2];
+    uint32_t trie_key{0};
+  };
+  struct offset_foo_tree_t
+  {
+    size_t trie_count;
+    bool trie_nobbledir{false};
+    int32_t trie_children[8 * sizeof(size_t)];
+  };
+  using index_type =
+  bitwise_trie<offset_foo_tree_t, offset_foo_t, 0, offset_bitwise_trie_head_accessors, offset_bitwise_trie_item_accessors>;
+  static constexpr size_t ITEMS_COUNT = 100000;
+  struct mapped_t
+  {
+    index_type index;
+    offset_foo_t items[ITEMS_COUNT];
+  };
+  // Returns how many keys were not found
+  auto check = [](const mapped_t *m) {
+    size_t failed = 0;
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      auto v = rand();
+      index_type::const_iterator it = m->index.find(v);
+      if(it == m->index.end() || it->trie_key != v || it.operator->() < m->items ||
+         it.operator->() >= m->items + ITEMS_COUNT)
+      {
+        failed++;
+      }
+    }
+    if(m->index.size() != ITEMS_COUNT)
+    {
+      failed++;
+    }
+    return failed;
+  };
+  std::vector<char> buffer(sizeof(mapped_t) + 64);
+  auto *m = new(buffer.data()) mapped_t;
+  {
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      m->items[n].trie_key = rand();
+      m->index.insert(&m->items[n]);
+    }
+  }
+  BOOST_CHECK(check(m) == 0);
+  m->index.triecheckvalidity();
+  {
+    // Erasing and reinserting works
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(size_t n = 0; n < ITEMS_COUNT; n += 2)
+    {
+      m->index.erase(&m->items[n]);
+    }
+    BOOST_CHECK(m->index.size() == ITEMS_COUNT / 2);
+    m->index.triecheckvalidity();
+    for(size_t n = 0; n < ITEMS_COUNT; n += 2)
+    {
+      m->index.insert(&m->items[n]);
+    }
+    BOOST_CHECK(check(m) == 0);
+  }
+  {
+    // Relocate by copying the bytes elsewhere
+    std::vector<char> buffer2(sizeof(mapped_t) + 64);
+    char *dest = buffer2.data() + 32;
+    memcpy(dest, m, sizeof(mapped_t));
+    BOOST_CHECK(check(reinterpret_cast<const mapped_t *>(dest)) == 0);
+  }
+#ifndef _WIN32
+  {
+    // Build the index into a file in this process, then map it in another process
+    FILE *f = tmpfile();
+    BOOST_REQUIRE(f != nullptr);
+    const int fd = fileno(f);
+    BOOST_REQUIRE(0 == ftruncate(fd, sizeof(mapped_t)));
+    void *addr = mmap(nullptr, sizeof(mapped_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    BOOST_REQUIRE(addr != MAP_FAILED);
+    memcpy(addr, buffer.data(), sizeof(mapped_t));
+    BOOST_REQUIRE(0 == msync(addr, sizeof(mapped_t), MS_SYNC));
+    BOOST_REQUIRE(0 == munmap(addr, sizeof(mapped_t)));
+    const pid_t pid = fork();
+    BOOST_REQUIRE(pid >= 0);
+    if(0 == pid)
+    {
+      // Occupy the address the parent used, so the file gets mapped somewhere else
+      void *placeholder = mmap(addr, sizeof(mapped_t), PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      void *mapped = mmap(nullptr, sizeof(mapped_t), PROT_READ, MAP_SHARED, fd, 0);
+      if(mapped == MAP_FAILED || mapped == addr)
+      {
+        _exit(2);
+      }
+      const size_t failed = check(reinterpret_cast<const mapped_t *>(mapped));
+      munmap(mapped, sizeof(mapped_t));
+      munmap(placeholder, sizeof(mapped_t));
+      _exit(failed == 0 ? 0 : 1);
+    }
+    int status = 0;
+    BOOST_REQUIRE(pid == waitpid(pid, &status, 0));
+    BOOST_CHECK(WIFEXITED(status));
+    BOOST_CHECK(WEXITSTATUS(status) == 0);
+    fclose(f);
+  }
+#endif
+  m->~mapped_t();
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / compact, "Tests and benchmarks a bitwise_trie using 32 bit index links")
+{
+  using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  struct compact_foo_t
+  {
+    uint32_t trie_parent;
+    uint32_t trie_child[2];
+    uint32_t trie_sibling[2];
+    uint32_t trie_key{0};
+
+    static compact_foo_t *&base()
+    {
+      static compact_foo_t *v;
+      return v;
+    }
+    static compact_foo_t *trie_index_base() { return base(); }
+  };
+  using compact_index_type =
+  bitwise_trie<foo_tree_t<compact_foo_t>, compact_foo_t, 0, bitwise_trie_head_accessors, compact_bitwise_trie_item_accessors>;
+  {
+    static constexpr size_t ITEMS_COUNT = 100000;
+    std::vector<compact_foo_t> storage(ITEMS_COUNT);
+    compact_foo_t::base() = storage.data();
+    std::multiset<uint32_t> shouldbe;
+    compact_index_type index;
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      // Plenty of duplicate keys
+      storage[n].trie_key = rand() & 0xffff;
+      shouldbe.insert(storage[n].trie_key);
+      index.insert(&storage[n]);
+    }
+    index.triecheckvalidity();
+    for(size_t n = 0; n < ITEMS_COUNT; n += 3)
+    {
+      index.erase(&storage[n]);
+      shouldbe.erase(shouldbe.find(storage[n].trie_key));
+    }
+    index.triecheckvalidity();
+    BOOST_CHECK(index.size() == shouldbe.size());
+    for(uint32_t k = 0; k < 0x10000; k += 7)
+    {
+      BOOST_CHECK(index.count(k) == shouldbe.count(k));
+    }
+    size_t count = 0;
+    for(auto &i : index)
+    {
+      (void) i;
+      count++;
+    }
+    BOOST_CHECK(count == shouldbe.size());
+  }
+  static constexpr size_t ITEMS_BITSHIFT = 22;  // 24 uses 1.2Gb of RAM
+  benchmark_results pointer_results, compact_results;
+  for(size_t shift = 20; shift <= ITEMS_BITSHIFT; shift++)
+  {
+    {
+      std::vector<foo_t> storage((size_t) 1 << shift);
+      benchmark_index<bitwise_trie<foo_tree_t<foo_t>, foo_t>>(pointer_results, storage);
+    }
+    std::vector<compact_foo_t> storage((size_t) 1 << shift);
+    compact_foo_t::base() = storage.data();
+    benchmark_index<compact_index_type>(compact_results, storage);
+  }
+  print_benchmark_versus("Items of " + std::to_string(sizeof(foo_t)) + " bytes with pointer links vs items of " +
+                         std::to_string(sizeof(compact_foo_t)) + " bytes with 32 bit index links",
+                         pointer_results, compact_results, "find");
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / inline_duplicates,
+                     "Tests and benchmarks a bitwise_trie storing duplicate keys as ordinary nodes")
+{
+  using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  using inline_index_type = bitwise_trie<foo_tree_t<inline_foo_t>, inline_foo_t>;
+  {
+    static constexpr size_t ITEMS_COUNT = 100000;
+    std::vector<inline_foo_t> storage(ITEMS_COUNT);
+    std::multiset<uint32_t> shouldbe;
+    inline_index_type index;
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      // Plenty of duplicate keys, including some whose bits run out at once
+      storage[n].trie_key = (n % 5000 == 0) ? (uint32_t) (n / 5000) % 3 : (rand() & 0xffff);
+      shouldbe.insert(storage[n].trie_key);
+      BOOST_CHECK(&*index.insert(&storage[n]) == &storage[n]);
+    }
+    index.triecheckvalidity();
+    BOOST_CHECK(index.size() == ITEMS_COUNT);
+    for(size_t n = 0; n < ITEMS_COUNT; n += 3)
+    {
+      index.erase(&storage[n]);
+      shouldbe.erase(shouldbe.find(storage[n].trie_key));
+    }
+    index.triecheckvalidity();
+    BOOST_CHECK(index.size() == shouldbe.size());
+    for(uint32_t k = 0; k < 0x10000; k++)
+    {
+      auto it = index.find(k);
+      BOOST_CHECK((it != index.end()) == (shouldbe.count(k) != 0));
+      BOOST_CHECK(it == index.end() || it->trie_key == k);
+      BOOST_CHECK(index.count(k) == shouldbe.count(k));
+    }
+    size_t count = 0;
+    for(auto &i : index)
+    {
+      BOOST_CHECK(shouldbe.count(i.trie_key) != 0);
+      count++;
+    }
+    BOOST_CHECK(count == shouldbe.size());
+    for(size_t n = 1; n < ITEMS_COUNT; n++)
+    {
+      if(n % 3 != 0)
+      {
+        index.erase(&storage[n]);
+      }
+    }
+    BOOST_CHECK(index.empty());
+  }
+  {
+    // Duplicates beyond three times the key bits are refused, so paths stay bounded
+    static constexpr size_t DUPLICATES_CAP = 3 * 32, ITEMS_COUNT = 300;
+    std::vector<inline_foo_t> storage(ITEMS_COUNT + 3);
+    inline_index_type index;
+    storage[ITEMS_COUNT].trie_key = 4;
+    storage[ITEMS_COUNT + 1].trie_key = 7;
+    storage[ITEMS_COUNT + 2].trie_key = 0x80000005;
+    for(size_t n = ITEMS_COUNT; n < ITEMS_COUNT + 3; n++)
+    {
+      index.insert(&storage[n]);
+    }
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      storage[n].trie_key = 5;
+      auto it = index.insert(&storage[n]);
+      BOOST_CHECK(&*it == ((n < DUPLICATES_CAP) ? &storage[n] : &storage[0]));
+    }
+    index.triecheckvalidity();
+    BOOST_CHECK(index.count(5) == DUPLICATES_CAP);
+    BOOST_CHECK(index.size() == DUPLICATES_CAP + 3);
+    std::vector<uint32_t> keys;
+    for(auto it = index.sorted_begin(); it != index.sorted_end(); ++it)
+    {
+      keys.push_back(it->trie_key);
+    }
+    BOOST_CHECK(keys.size() == index.size());
+    BOOST_CHECK(std::is_sorted(keys.begin(), keys.end()));
+    BOOST_CHECK(std::count(keys.begin(), keys.end(), 5u) == DUPLICATES_CAP);
+    // Once one is removed, another may be stored
+    index.erase(&storage[DUPLICATES_CAP / 2]);
+    BOOST_CHECK(&*index.insert(&storage[DUPLICATES_CAP]) == &storage[DUPLICATES_CAP]);
+    BOOST_CHECK(index.count(5) == DUPLICATES_CAP);
+    index.triecheckvalidity();
+  }
+  // Hash keyed, so duplicates are rare
+  static constexpr size_t ITEMS_BITSHIFT = 22;
+  benchmark_results sibling_results, inline_results;
+  for(size_t shift = 20; shift <= ITEMS_BITSHIFT; shift++)
+  {
+    {
+      std::vector<foo_t> storage((size_t) 1 << shift);
+      benchmark_index<bitwise_trie<foo_tree_t<foo_t>, foo_t>>(sibling_results, storage);
+    }
+    std::vector<inline_foo_t> storage((size_t) 1 << shift);
+    benchmark_index<inline_index_type>(inline_results, storage);
+  }
+  print_benchmark_versus("Items of " + std::to_string(sizeof(foo_t)) + " bytes with sibling links vs items of " +
+                         std::to_string(sizeof(inline_foo_t)) + " bytes with inline duplicates",
+                         sibling_results, inline_results, "find");
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / rank_select, "Tests and benchmarks rank and select on a bitwise_trie keeping subtree counts")
+{
+  using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  auto test = [](auto *item, uint32_t keymask) {
+    using item_type = typename std::remove_pointer<decltype(item)>::type;
+    static constexpr size_t ITEMS_COUNT = 50000;
+    std::vector<item_type> storage(ITEMS_COUNT);
+    std::multiset<uint32_t> shouldbe;
+    bitwise_trie<foo_tree_t<item_type>, item_type> index;
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      storage[n].trie_key = rand() & keymask;
+      shouldbe.insert(storage[n].trie_key);
+      index.insert(&storage[n]);
+    }
+    // Removals exercise every way of replacing an item in the trie
+    for(size_t n = 0; n < ITEMS_COUNT; n += 3)
+    {
+      index.erase(&storage[n]);
+      shouldbe.erase(shouldbe.find(storage[n].trie_key));
+    }
+    index.triecheckvalidity();
+    std::vector<uint32_t> sorted(shouldbe.begin(), shouldbe.end());
+    for(size_t n = 0; n < 100000; n++)
+    {
+      const uint32_t k = (n < 4) ? (uint32_t) n : (rand() & keymask);
+      BOOST_CHECK(index.rank(k) == (size_t) (std::lower_bound(sorted.begin(), sorted.end(), k) - sorted.begin()));
+    }
+    for(size_t n = 0; n < sorted.size(); n++)
+    {
+      auto it = index.select(n);
+      BOOST_CHECK(it != index.end() && it->trie_key == sorted[n]);
+    }
+    BOOST_CHECK(index.select(sorted.size()) == index.end());
+  };
+  test((counted_foo_t *) nullptr, 0xffffffff);
+  test((counted_foo_t *) nullptr, 0xffff);
+  test((counted_foo_t *) nullptr, 0xf);
+  test((counted_inline_foo_t *) nullptr, 0xffffffff);
+  test((counted_inline_foo_t *) nullptr, 0xffff);
+
+  // What keeping the counts costs insert and erase
+  static constexpr size_t ITEMS_BITSHIFT = 22;
+  benchmark_results uncounted_results, counted_results, rank_select_results;
+  for(size_t shift = 20; shift <= ITEMS_BITSHIFT; shift++)
+  {
+    const size_t count = (size_t) 1 << shift;
+    {
+      std::vector<foo_t> storage(count);
+      benchmark_index<bitwise_trie<foo_tree_t<foo_t>, foo_t>>(uncounted_results, storage, true);
+    }
+    std::vector<counted_foo_t> storage(count);
+    benchmark_index<bitwise_trie<foo_tree_t<counted_foo_t>, counted_foo_t>>(counted_results, storage, true);
+
+    bitwise_trie<foo_tree_t<counted_foo_t>, counted_foo_t> index;
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(auto &i : storage)
+    {
+      index.insert(&i);
+    }
+    size_t total = 0;
+    auto begin = nanoclock();
+    for(size_t n = 0; n < count; n++)
+    {
+      total += index.rank(rand());
+    }
+    auto ranked = nanoclock();
+    for(size_t n = 0; n < count; n++)
+    {
+      total += (index.select(rand() & (count - 1)) != index.end());
+    }
+    auto end = nanoclock();
+    BOOST_CHECK(total != 0);
+    rank_select_results.emplace_back((double) (ranked - begin) / count, (double) (end - ranked) / count);
+  }
+  print_benchmark_versus("Items of " + std::to_string(sizeof(foo_t)) + " bytes without subtree counts vs items of " +
+                         std::to_string(sizeof(counted_foo_t)) + " bytes with",
+                         uncounted_results, counted_results, "erase");
+  std::cout << "With subtree counts:";
+  for(size_t n = 0; n < rank_select_results.size(); n++)
+  {
+    std::cout << "\n   " << ((size_t) 1 << (20 + n)) << ": " << rank_select_results[n].first << " ns per rank, "
+              << rank_select_results[n].second << " ns per select";
+  }
+  std::cout << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / sorted, "Tests and benchmarks visiting a bitwise_trie in key order")
+{
+  using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  auto test = [](auto *item, uint32_t keymask) {
+    using item_type = typename std::remove_pointer<decltype(item)>::type;
+    static constexpr size_t ITEMS_COUNT = 50000;
+    std::vector<item_type> storage(ITEMS_COUNT);
+    std::multiset<uint32_t> shouldbe;
+    bitwise_trie<foo_tree_t<item_type>, item_type> index;
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    BOOST_CHECK(index.sorted_begin() == index.sorted_end());
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      storage[n].trie_key = rand() & keymask;
+      shouldbe.insert(storage[n].trie_key);
+      index.insert(&storage[n]);
+    }
+    for(size_t n = 0; n < ITEMS_COUNT; n += 3)
+    {
+      index.erase(&storage[n]);
+      shouldbe.erase(shouldbe.find(storage[n].trie_key));
+    }
+    auto sit = shouldbe.begin();
+    size_t count = 0;
+    for(auto it = index.sorted_begin(); it != index.sorted_end(); ++it, count++)
+    {
+      BOOST_REQUIRE(sit != shouldbe.end());
+      BOOST_CHECK(it->trie_key == *sit++);
+    }
+    BOOST_CHECK(count == shouldbe.size());
+  };
+  test((foo_t *) nullptr, 0xffffffff);
+  test((foo_t *) nullptr, 0xffff);
+  test((foo_t *) nullptr, 0xf);
+  test((inline_foo_t *) nullptr, 0xffffffff);
+  test((inline_foo_t *) nullptr, 0xffff);
+
+  static constexpr size_t ITEMS_BITSHIFT = 22;
+  std::cout << "Sorted export by sorted_begin() vs by begin() and std::sort:";
+  for(size_t shift = 20; shift <= ITEMS_BITSHIFT; shift++)
+  {
+    const size_t count = (size_t) 1 << shift;
+    std::vector<foo_t> storage(count);
+    bitwise_trie<foo_tree_t<foo_t>, foo_t> index;
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(auto &i : storage)
+    {
+      i.trie_key = rand();
+      index.insert(&i);
+    }
+    std::vector<const foo_t *> exported, sorted;
+    exported.reserve(count);
+    sorted.reserve(count);
+    auto begin = nanoclock();
+    for(auto it = index.sorted_begin(); it != index.sorted_end(); ++it)
+    {
+      exported.push_back(&*it);
+    }
+    auto middle = nanoclock();
+    for(auto it = index.begin(); it != index.end(); ++it)
+    {
+      sorted.push_back(&*it);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const foo_t *a, const foo_t *b) { return a->trie_key < b->trie_key; });
+    auto end = nanoclock();
+    BOOST_CHECK(exported.size() == count);
+    for(size_t n = 0; n < count; n++)
+    {
+      BOOST_CHECK(exported[n]->trie_key == sorted[n]->trie_key);
+    }
+    std::cout << "\n   " << count << ": " << ((double) (middle - begin) / count) << " vs "
+              << ((double) (end - middle) / count) << " ns per item";
+  }
+  std::cout << std::endl;
+}
+
+// The keys of an index in key order
+template <class Index> std::vector<uint32_t> keys_of(const Index &index)
+{
+  std::vector<uint32_t> ret;
+  for(auto it = index.sorted_begin(); it != index.sorted_end(); ++it)
+  {
+    ret.push_back(it->trie_key);
+  }
+  return ret;
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / merge_split, "Tests and benchmarks merging and splitting bitwise_trie indices")
+{
+  using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  auto test = [](auto *item, uint32_t keymask) {
+    using item_type = typename std::remove_pointer<decltype(item)>::type;
+    using index_type = bitwise_trie<foo_tree_t<item_type>, item_type>;
+    static constexpr size_t ITEMS_COUNT = 20000;
+    std::vector<item_type> storage(ITEMS_COUNT);
+    index_type a, b;
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    // b's keys overlap a's in the lower bins, and alone populate the upper ones
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      const uint32_t k = rand() & keymask;
+      storage[n].trie_key = (n & 1) ? k : (k >> 8);
+      ((n & 1) ? b : a).insert(&storage[n]);
+    }
+    std::vector<uint32_t> akeys = keys_of(a), bkeys = keys_of(b), shouldbe;
+    std::merge(akeys.begin(), akeys.end(), bkeys.begin(), bkeys.end(), std::back_inserter(shouldbe));
+    const size_t total = a.size() + b.size();
+    a.merge(b);
+    a.triecheckvalidity();
+    b.triecheckvalidity();
+    BOOST_CHECK(a.size() + b.size() == total);
+    std::vector<uint32_t> merged = keys_of(a), kept = keys_of(b), all;
+    std::merge(merged.begin(), merged.end(), kept.begin(), kept.end(), std::back_inserter(all));
+    BOOST_CHECK(all == shouldbe);
+    // Only items whose key is already present and which cannot be stored as duplicates are kept
+    for(auto k : kept)
+    {
+      BOOST_CHECK(a.contains(k));
+    }
+    BOOST_CHECK(!kept.empty() == (!std::is_same<item_type, foo_t>::value && !std::is_same<item_type, inline_foo_t>::value &&
+                                  !std::is_same<item_type, counted_foo_t>::value));
+    b.clear();
+    const size_t count = a.size();
+    const uint32_t splits[] = {0x10000, 0x12345, 7, 1, 0, 0xffffffff};
+    for(auto k : splits)
+    {
+      index_type out;
+      a.split_at_key(k, out);
+      a.triecheckvalidity();
+      out.triecheckvalidity();
+      BOOST_CHECK(a.size() + out.size() == count);
+      for(auto it = a.sorted_begin(); it != a.sorted_end(); ++it)
+      {
+        BOOST_CHECK(it->trie_key < k);
+      }
+      for(auto it = out.sorted_begin(); it != out.sorted_end(); ++it)
+      {
+        BOOST_CHECK(it->trie_key >= k);
+      }
+      BOOST_CHECK(out.size() == (size_t) (merged.end() - std::lower_bound(merged.begin(), merged.end(), k)));
+      a.merge(out);
+      a.triecheckvalidity();
+      BOOST_CHECK(out.empty());
+      BOOST_CHECK(keys_of(a) == merged);
+    }
+  };
+  test((foo_t *) nullptr, 0xffffffff);
+  test((foo_t *) nullptr, 0xfffff);
+  test((inline_foo_t *) nullptr, 0xffffffff);
+  test((counted_foo_t *) nullptr, 0xffffffff);
+  test((counted_foo_t *) nullptr, 0xfffff);
+  test((unique_foo_t *) nullptr, 0xfffff);
+
+  // The top bin moves whole, which only needs its items counting without subtree counts
+  auto benchmark = [](auto *item, const char *desc) {
+    using item_type = typename std::remove_pointer<decltype(item)>::type;
+    static constexpr size_t ITEMS_BITSHIFT = 22;
+    std::cout << "Migrating the upper half of the keys to another index by split_at_key() and merge() vs by erase and insert, "
+              << desc << ":";
+    for(size_t shift = 20; shift <= ITEMS_BITSHIFT; shift++)
+    {
+      const size_t count = (size_t) 1 << shift;
+      std::vector<item_type> storage(count);
+      bitwise_trie<foo_tree_t<item_type>, item_type> index, out;
+      QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+      for(auto &i : storage)
+      {
+        i.trie_key = rand();
+        index.insert(&i);
+      }
+      auto begin = nanoclock();
+      index.split_at_key(0x80000000, out);
+      auto split = nanoclock();
+      index.merge(out);
+      auto merged = nanoclock();
+      BOOST_CHECK(index.size() == count && out.empty());
+      for(auto &i : storage)
+      {
+        if(i.trie_key >= 0x80000000)
+        {
+          index.erase(&i);
+          out.insert(&i);
+        }
+      }
+      auto end = nanoclock();
+      BOOST_CHECK(index.size() + out.size() == count);
+      std::cout << "\n   " << count << ": " << ((double) (split - begin) / 1000) << " us split + "
+                << ((double) (merged - split) / 1000) << " us merge vs " << ((double) (end - merged) / 1000) << " us";
+    }
+    std::cout << std::endl;
+  };
+  benchmark((foo_t *) nullptr, "without subtree counts");
+  benchmark((counted_foo_t *) nullptr, "with subtree counts");
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / bulk_build, "Tests and benchmarks building a bitwise_trie from an array with many threads")
+{
+  using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  auto test = [](auto *item, uint32_t keymask) {
+    using item_type = typename std::remove_pointer<decltype(item)>::type;
+    using index_type = bitwise_trie<foo_tree_t<item_type>, item_type>;
+    static constexpr size_t ITEMS_COUNT = 100000;
+    std::vector<item_type> storage(ITEMS_COUNT);
+    std::vector<item_type *> items(ITEMS_COUNT);
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      storage[n].trie_key = rand() & keymask;
+      items[n] = &storage[n];
+    }
+    index_type serial;
+    serial.insert(items.begin(), items.end());
+    const std::vector<uint32_t> shouldbe = keys_of(serial);
+    for(unsigned threads : {1u, 2u, 3u, 8u})
+    {
+      // Half is inserted beforehand, so bulk_build() also extends existing bins
+      index_type index;
+      index.insert(items.begin(), items.begin() + ITEMS_COUNT / 2);
+      index.bulk_build(items.data() + ITEMS_COUNT / 2, ITEMS_COUNT / 2, threads);
+      index.triecheckvalidity();
+      BOOST_CHECK(index.size() == serial.size());
+      BOOST_CHECK(keys_of(index) == shouldbe);
+      index.clear();
+      index.bulk_build(items.data(), ITEMS_COUNT, threads);
+      index.triecheckvalidity();
+      BOOST_CHECK(index.size() == serial.size());
+      BOOST_CHECK(keys_of(index) == shouldbe);
+      for(size_t n = 0; n < ITEMS_COUNT; n += 97)
+      {
+        BOOST_CHECK(index.find(storage[n].trie_key) != index.end());
+      }
+    }
+  };
+  test((foo_t *) nullptr, 0xffffffff);
+  test((foo_t *) nullptr, 0xffff);
+  test((inline_foo_t *) nullptr, 0xffffffff);
+  test((inline_foo_t *) nullptr, 0xffff);
+  test((counted_foo_t *) nullptr, 0xffffffff);
+  test((counted_foo_t *) nullptr, 0xffff);
+  test((unique_foo_t *) nullptr, 0xffff);
+
+  static constexpr size_t ITEMS_BITSHIFT = 22;
+  const unsigned threads = std::max(std::thread::hardware_concurrency(), 1u);
+  std::cout << "Building an index with bulk_build() using " << threads << " threads vs an insert loop:";
+  for(size_t shift = 18; shift <= ITEMS_BITSHIFT; shift += 2)
+  {
+    const size_t count = (size_t) 1 << shift;
+    std::vector<foo_t> storage(count);
+    std::vector<foo_t *> items(count);
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(size_t n = 0; n < count; n++)
+    {
+      storage[n].trie_key = rand();
+      items[n] = &storage[n];
+    }
+    bitwise_trie<foo_tree_t<foo_t>, foo_t> index;
+    auto begin = nanoclock();
+    for(auto *i : items)
+    {
+      index.insert(i);
+    }
+    auto serial = nanoclock();
+    index.clear();
+    auto middle = nanoclock();
+    index.bulk_build(items.data(), items.size(), threads);
+    auto end = nanoclock();
+    BOOST_CHECK(index.size() == count);
+    std::cout << "\n   " << count << ": " << ((double) (end - middle) / count) << " ns per item vs "
+              << ((double) (serial - begin) / count) << " ns per item";
+  }
+  std::cout << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / parallel_for_each, "Tests and benchmarks visiting every item of a bitwise_trie with many threads")
+{
+  using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  auto test = [](auto *item, uint32_t keymask) {
+    using item_type = typename std::remove_pointer<decltype(item)>::type;
+    using index_type = bitwise_trie<foo_tree_t<item_type>, item_type>;
+    static constexpr size_t ITEMS_COUNT = 100000;
+    std::vector<item_type> storage(ITEMS_COUNT);
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    index_type index;
+    for(auto &i : storage)
+    {
+      i.trie_key = rand() & keymask;
+      index.insert(&i);
+    }
+    std::vector<std::atomic<unsigned>> visits(ITEMS_COUNT);
+    for(unsigned threads : {1u, 2u, 3u, 8u})
+    {
+      for(auto &i : visits)
+      {
+        i.store(0, std::memory_order_relaxed);
+      }
+      const size_t count = index.parallel_for_each(
+      [&](item_type *p) { visits[(size_t) (p - storage.data())].fetch_add(1, std::memory_order_relaxed); }, threads);
+      BOOST_CHECK(count == index.size());
+      size_t visited = 0;
+      for(auto &i : index)
+      {
+        BOOST_CHECK(visits[(size_t) (&i - storage.data())].load(std::memory_order_relaxed) == 1);
+        visited++;
+      }
+      BOOST_CHECK(visited == index.size());
+      size_t total = 0;
+      for(auto &i : visits)
+      {
+        total += i.load(std::memory_order_relaxed);
+      }
+      BOOST_CHECK(total == index.size());
+    }
+    const index_type &cindex = index;
+    std::atomic<size_t> count(0);
+    BOOST_CHECK(cindex.parallel_for_each([&](const item_type *) { count.fetch_add(1, std::memory_order_relaxed); }, 4) == index.size());
+    BOOST_CHECK(count == index.size());
+    index.clear();
+    BOOST_CHECK(index.parallel_for_each([](item_type *) { abort(); }, 4) == 0);
+  };
+  test((foo_t *) nullptr, 0xffffffff);
+  test((foo_t *) nullptr, 0xfff);
+  test((inline_foo_t *) nullptr, 0xfff);
+  test((unique_foo_t *) nullptr, 0xffffffff);
+
+  // Age every item, as a periodic sweep would
+  struct aged_foo_t
+  {
+    aged_foo_t *trie_parent;
+    aged_foo_t *trie_child[2];
+    aged_foo_t *trie_sibling[2];
+    uint32_t trie_key{0};
+    uint32_t age{0};
+  };
+  using index_type = bitwise_trie<foo_tree_t<aged_foo_t>, aged_foo_t>;
+  static constexpr size_t ITEMS_COUNT = 1 << 22;
+  std::vector<aged_foo_t> storage(ITEMS_COUNT);
+  index_type index;
+  {
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(auto &i : storage)
+    {
+      i.trie_key = rand();
+      index.insert(&i);
+    }
+  }
+  auto begin = nanoclock();
+  for(auto &i : index)
+  {
+    i.age++;
+  }
+  auto end = nanoclock();
+  std::cout << "For bitwise_trie iteration on one thread: " << ((double) (end - begin) / ITEMS_COUNT) << " ns per item";
+  const unsigned maxthreads = std::max(1u, std::thread::hardware_concurrency());
+  uint32_t age = 1;
+  for(unsigned threads = 1; threads <= maxthreads; threads <<= 1)
+  {
+    begin = nanoclock();
+    index.parallel_for_each([](aged_foo_t *p) { p->age++; }, threads);
+    end = nanoclock();
+    age++;
+    std::cout << "\n   parallel_for_each with " << threads << " threads: " << ((double) (end - begin) / ITEMS_COUNT)
+              << " ns per item";
+  }
+  std::cout << std::endl;
+  BOOST_CHECK(std::all_of(storage.begin(), storage.end(), [&](const aged_foo_t &i) { return i.age == age; }));
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / multiway, "Tests and benchmarks multiway_trie against bitwise_trie and other algorithms")
+{
+  namespace bt = QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  namespace mt = QUICKCPPLIB_NAMESPACE::algorithm::multiway_trie;
+  using index4_type = mt::multiway_trie<foo_tree_t<foo4_t>, foo4_t>;
+  using index16_type = mt::multiway_trie<foo_tree_t<foo16_t>, foo16_t>;
+  static_assert(index4_type::stride == 2 && index16_type::stride == 4, "");
+  auto test = [](auto *item, auto *index, uint32_t keymask) {
+    using item_type = typename std::remove_pointer<decltype(item)>::type;
+    using index_type = typename std::remove_pointer<decltype(index)>::type;
+    static constexpr size_t ITEMS_COUNT = 10000;
+    std::vector<item_type> storage(ITEMS_COUNT);
+    std::set<uint32_t> shouldbe;
+    index_type idx;
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    BOOST_CHECK(idx.find_equal_or_next_largest(0) == idx.end());
+    BOOST_CHECK(idx.begin() == idx.end());
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      // Keys of every bit width, including zero and one, with plenty of repeats
+      storage[n].trie_key = (rand() & keymask) >> (rand() % 32);
+      const bool isnew = shouldbe.insert(storage[n].trie_key).second;
+      auto it = idx.insert(&storage[n]);
+      BOOST_CHECK(it->trie_key == storage[n].trie_key);
+      BOOST_CHECK((&*it == &storage[n]) == isnew);
+    }
+    idx.triecheckvalidity();
+    BOOST_CHECK(idx.size() == shouldbe.size());
+    auto check = [&] {
+      size_t count = 0;
+      for(auto &i : idx)
+      {
+        BOOST_CHECK(shouldbe.count(i.trie_key) != 0);
+        count++;
+      }
+      BOOST_CHECK(count == shouldbe.size());
+      count = 0;
+      for(auto it = idx.rbegin(); it != idx.rend(); ++it)
+      {
+        count++;
+      }
+      BOOST_CHECK(count == shouldbe.size());
+      for(size_t n = 0; n < 100000; n++)
+      {
+        const uint32_t k = (n < 1000) ? (uint32_t) n : ((rand() & keymask) >> (rand() % 32));
+        auto it = idx.find(k);
+        BOOST_CHECK((it != idx.end()) == (shouldbe.count(k) != 0));
+        auto it1 = shouldbe.lower_bound(k);
+        auto it2 = idx.find_equal_or_next_largest(k);
+        BOOST_CHECK((it1 == shouldbe.end()) == (it2 == idx.end()));
+        if(it1 != shouldbe.end() && it2 != idx.end())
+        {
+          BOOST_CHECK(*it1 == it2->trie_key);
+        }
+        it1 = shouldbe.upper_bound(k);
+        it2 = idx.find_equal_or_next_smallest(k);
+        BOOST_CHECK((it1 == shouldbe.begin()) == (it2 == idx.end()));
+        if(it1 != shouldbe.begin() && it2 != idx.end())
+        {
+          BOOST_CHECK(*--it1 == it2->trie_key);
+        }
+      }
+    };
+    check();
+    for(size_t n = 0; n < ITEMS_COUNT; n += 3)
+    {
+      auto it = idx.find(storage[n].trie_key);
+      if(it != idx.end())
+      {
+        shouldbe.erase(it->trie_key);
+        idx.erase(it);
+      }
+    }
+    idx.triecheckvalidity();
+    BOOST_CHECK(idx.size() == shouldbe.size());
+    check();
+    // Erasing while iterating visits everything
+    for(auto it = idx.begin(); it != idx.end();)
+    {
+      shouldbe.erase(it->trie_key);
+      it = idx.erase(it);
+    }
+    BOOST_CHECK(shouldbe.empty());
+    BOOST_CHECK(idx.empty());
+  };
+  test((foo4_t *) nullptr, (index4_type *) nullptr, (uint32_t) -1);
+  test((foo16_t *) nullptr, (index16_type *) nullptr, (uint32_t) -1);
+  test((foo4_t *) nullptr, (index4_type *) nullptr, 0xfff);
+  test((foo16_t *) nullptr, (index16_type *) nullptr, 0xfff);
+
+  static constexpr size_t ITEMS_BITSHIFT = 22;
+  std::vector<uint32_t> randoms;
+  {
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    randoms.reserve((size_t) 1 << ITEMS_BITSHIFT);
+    for(size_t n = 0; n < ((size_t) 1 << ITEMS_BITSHIFT); n++)
+    {
+      randoms.push_back(rand());
+    }
+  }
+  auto benchmark = [&](auto *item, auto *index, size_t count, std::vector<double> &results) {
+    using item_type = typename std::remove_pointer<decltype(item)>::type;
+    using index_type = typename std::remove_pointer<decltype(index)>::type;
+    std::vector<item_type> storage(count);
+    index_type idx;
+    for(size_t n = 0; n < count; n++)
+    {
+      storage[n].trie_key = randoms[n];
+      idx.insert(&storage[n]);
+    }
+    size_t found = 0;
+    auto begin = nanoclock();
+    for(size_t n = 0; n < count; n++)
+    {
+      found += (idx.find(randoms[n]) != idx.end());
+    }
+    auto end = nanoclock();
+    BOOST_CHECK(found == count);
+    results.push_back((double) (end - begin) / count);
+  };
+  auto benchmark_std = [&](auto *cont, size_t count, std::vector<double> &results) {
+    using cont_type = typename std::remove_pointer<decltype(cont)>::type;
+    cont_type c(randoms.begin(), randoms.begin() + count);
+    size_t found = 0;
+    auto begin = nanoclock();
+    for(size_t n = 0; n < count; n++)
+    {
+      found += (c.find(randoms[n]) != c.end());
+    }
+    auto end = nanoclock();
+    BOOST_CHECK(found == count);
+    results.push_back((double) (end - begin) / count);
+  };
+  std::vector<double> binary_results, radix4_results, radix16_results, set_results, unordered_set_results;
+  for(size_t shift = 20; shift <= ITEMS_BITSHIFT; shift++)
+  {
+    const size_t count = (size_t) 1 << shift;
+    benchmark((foo_t *) nullptr, (bt::bitwise_trie<foo_tree_t<foo_t>, foo_t> *) nullptr, count, binary_results);
+    benchmark((foo4_t *) nullptr, (index4_type *) nullptr, count, radix4_results);
+    benchmark((foo16_t *) nullptr, (index16_type *) nullptr, count, radix16_results);
+    benchmark_std((std::set<uint32_t> *) nullptr, count, set_results);
+    benchmark_std((std::unordered_set<uint32_t> *) nullptr, count, unordered_set_results);
+  }
+  std::cout << "Find with bitwise_trie vs multiway_trie radix 4 vs radix 16 vs set vs unordered_set:";
+  for(size_t n = 0; n < binary_results.size(); n++)
+  {
+    std::cout << "\n   " << ((size_t) 1 << (20 + n)) << ": " << binary_results[n] << " vs " << radix4_results[n] << " vs "
+              << radix16_results[n] << " vs " << set_results[n] << " vs " << unordered_set_results[n] << " ns per item find";
+  }
+  std::cout << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / patricia, "Tests and benchmarks patricia_trie against bitwise_trie with page aligned pointer keys")
+{
+  namespace bt = QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  namespace pt = QUICKCPPLIB_NAMESPACE::algorithm::patricia_trie;
+  struct foo64_t
+  {
+    foo64_t *trie_parent;
+    foo64_t *trie_child[2];
+    foo64_t *trie_sibling[2];
+    uint64_t trie_key{0};
+  };
+  struct pfoo_t
+  {
+    pfoo_t *trie_parent;
+    pfoo_t *trie_child[2];
+    pfoo_t *trie_sibling[2];
+    uint64_t trie_key{0};
+    unsigned char trie_skip{0};
+  };
+  using index_type = pt::patricia_trie<foo_tree_t<pfoo_t>, pfoo_t>;
+  // Like pointers to the pages of many separate 1Mb mappings spaced 64Mb apart
+  auto pagekey = [](QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng &rand) {
+    return 0x7f0000000000ULL + ((uint64_t) (rand() & 0x3fff) << 26) + ((uint64_t) (rand() & 0xff) << 12);
+  };
+  {
+    static constexpr size_t ITEMS_COUNT = 20000;
+    std::vector<pfoo_t> storage(ITEMS_COUNT);
+    std::multiset<uint64_t> shouldbe;
+    index_type index;
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    BOOST_CHECK(index.find_equal_or_next_largest(0) == index.end());
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      // Mostly page keys, some of them duplicated, and some small keys of every bit width
+      if(n % 7 == 0)
+      {
+        storage[n].trie_key = rand() >> (rand() % 32);
+      }
+      else if(n % 11 == 0)
+      {
+        storage[n].trie_key = storage[n - 1].trie_key;
+      }
+      else
+      {
+        storage[n].trie_key = pagekey(rand);
+      }
+      shouldbe.insert(storage[n].trie_key);
+      BOOST_CHECK(&*index.insert(&storage[n]) == &storage[n]);
+    }
+    index.triecheckvalidity();
+    BOOST_CHECK(index.size() == ITEMS_COUNT);
+    auto check = [&] {
+      size_t count = 0;
+      for(auto &i : index)
+      {
+        BOOST_CHECK(shouldbe.count(i.trie_key) != 0);
+        count++;
+      }
+      BOOST_CHECK(count == shouldbe.size());
+      count = 0;
+      for(auto it = index.rbegin(); it != index.rend(); ++it)
+      {
+        count++;
+      }
+      BOOST_CHECK(count == shouldbe.size());
+      for(size_t n = 0; n < 100000; n++)
+      {
+        const uint64_t k = (n % 3 == 0) ? (uint64_t) (rand() >> (rand() % 32)) : (pagekey(rand) + (rand() % 3) - 1);
+        auto it = index.find(k);
+        BOOST_CHECK((it != index.end()) == (shouldbe.count(k) != 0));
+        BOOST_CHECK(index.count(k) == shouldbe.count(k));
+        auto it1 = shouldbe.lower_bound(k);
+        auto it2 = index.find_equal_or_next_largest(k);
+        BOOST_CHECK((it1 == shouldbe.end()) == (it2 == index.end()));
+        if(it1 != shouldbe.end() && it2 != index.end())
+        {
+          BOOST_CHECK(*it1 == it2->trie_key);
+        }
+        it1 = shouldbe.upper_bound(k);
+        it2 = index.find_equal_or_next_smallest(k);
+        BOOST_CHECK((it1 == shouldbe.begin()) == (it2 == index.end()));
+        if(it1 != shouldbe.begin() && it2 != index.end())
+        {
+          BOOST_CHECK(*--it1 == it2->trie_key);
+        }
+      }
+    };
+    check();
+    for(size_t n = 0; n < ITEMS_COUNT; n += 3)
+    {
+      index.erase(&storage[n]);
+      shouldbe.erase(shouldbe.find(storage[n].trie_key));
+    }
+    index.triecheckvalidity();
+    BOOST_CHECK(index.size() == shouldbe.size());
+    check();
+    // Erasing while iterating visits everything
+    for(auto it = index.begin(); it != index.end();)
+    {
+      shouldbe.erase(shouldbe.find(it->trie_key));
+      it = index.erase(it);
+    }
+    BOOST_CHECK(shouldbe.empty());
+    BOOST_CHECK(index.empty());
+  }
+  auto benchmark = [&](auto *item, auto *index, size_t count, std::vector<std::tuple<double, double, double>> &results) {
+    using item_type = typename std::remove_pointer<decltype(item)>::type;
+    using index_type = typename std::remove_pointer<decltype(index)>::type;
+    std::vector<item_type> storage(count);
+    index_type idx;
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(auto &i : storage)
+    {
+      i.trie_key = pagekey(rand);
+    }
+    auto begin = nanoclock();
+    for(auto &i : storage)
+    {
+      idx.insert(&i);
+    }
+    auto inserted = nanoclock();
+    size_t found = 0;
+    for(auto &i : storage)
+    {
+      found += (idx.find(i.trie_key) != idx.end());
+    }
+    auto end = nanoclock();
+    BOOST_CHECK(found == count);
+    // Depth of each item, counting parent links up to the index head
+    size_t depth = 0;
+    for(auto &i : storage)
+    {
+      for(const item_type *p = &i; p->trie_parent != nullptr && ((uintptr_t) p->trie_parent & 3) != 3; p = p->trie_parent)
+      {
+        depth++;
+      }
+    }
+    results.emplace_back((double) (inserted - begin) / count, (double) (end - inserted) / count, (double) depth / count);
+  };
+  static constexpr size_t ITEMS_BITSHIFT = 21;
+  std::vector<std::tuple<double, double, double>> bitwise_results, patricia_results;
+  for(size_t shift = 16; shift <= ITEMS_BITSHIFT; shift += 5)
+  {
+    benchmark((foo64_t *) nullptr, (bt::bitwise_trie<foo_tree_t<foo64_t>, foo64_t> *) nullptr, (size_t) 1 << shift,
+              bitwise_results);
+    benchmark((pfoo_t *) nullptr, (index_type *) nullptr, (size_t) 1 << shift, patricia_results);
+  }
+  std::cout << "Page aligned pointer keys with bitwise_trie vs patricia_trie:";
+  for(size_t n = 0; n < bitwise_results.size(); n++)
+  {
+    std::cout << "\n   " << ((size_t) 1 << (16 + 5 * n)) << ": " << std::get<0>(bitwise_results[n]) << " vs "
+              << std::get<0>(patricia_results[n]) << " ns per item insert, " << std::get<1>(bitwise_results[n]) << " vs "
+              << std::get<1>(patricia_results[n]) << " ns per item find, " << std::get<2>(bitwise_results[n]) << " vs "
+              << std::get<2>(patricia_results[n]) << " mean depth";
+  }
+  std::cout << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / persistent, "Tests and benchmarks persistent_trie snapshots while modifying")
+{
+  namespace bt = QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  namespace pt = QUICKCPPLIB_NAMESPACE::algorithm::persistent_trie;
+  using index_type = pt::persistent_trie<const foo_t>;
+  auto items_of = [](const auto &index) {
+    std::map<uint32_t, const foo_t *> ret;
+    index.for_each([&](const foo_t *p) { BOOST_CHECK(ret.emplace(p->trie_key, p).second); });
+    return ret;
+  };
+  {
+    static constexpr size_t ITEMS_COUNT = 20000;
+    std::vector<foo_t> storage(ITEMS_COUNT);
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(auto &i : storage)
+    {
+      i.trie_key = rand() >> (rand() % 24);
+    }
+    index_type index;
+    std::map<uint32_t, const foo_t *> shouldbe;
+    std::vector<std::pair<index_type::snapshot_type, std::map<uint32_t, const foo_t *>>> snapshots;
+    BOOST_CHECK(index.empty() && index.find(0) == nullptr && index.erase(0) == nullptr);
+    for(size_t n = 0; n < ITEMS_COUNT * 4; n++)
+    {
+      const foo_t *p = &storage[rand() % ITEMS_COUNT];
+      if(rand() % 3 != 0)
+      {
+        const foo_t *q = index.insert(p);
+        BOOST_CHECK(q == shouldbe.emplace(p->trie_key, p).first->second);
+      }
+      else
+      {
+        const foo_t *q = index.erase(p->trie_key);
+        auto it = shouldbe.find(p->trie_key);
+        BOOST_CHECK(q == ((it != shouldbe.end()) ? it->second : nullptr));
+        if(it != shouldbe.end())
+        {
+          shouldbe.erase(it);
+        }
+        BOOST_CHECK(!index.contains(p->trie_key));
+      }
+      if(n % 997 == 0)
+      {
+        snapshots.emplace_back(index.snapshot(), shouldbe);
+      }
+      if(n % 1499 == 0 && !snapshots.empty())
+      {
+        // Release snapshots out of order
+        snapshots.erase(snapshots.begin() + rand() % snapshots.size());
+      }
+      if(n % 16 == 0)
+      {
+        index.snapshot();
+      }
+    }
+    BOOST_CHECK(index.size() == shouldbe.size());
+    BOOST_CHECK(items_of(index) == shouldbe);
+    for(auto &i : snapshots)
+    {
+      BOOST_CHECK(i.first.size() == i.second.size());
+      BOOST_CHECK(items_of(i.first) == i.second);
+      for(auto &j : i.second)
+      {
+        BOOST_CHECK(i.first.find(j.first) == j.second);
+      }
+    }
+    // Snapshots outlive the index
+    index_type::snapshot_type last = index.snapshot(), copy(last);
+    index.clear();
+    BOOST_CHECK(index.empty() && items_of(index).empty());
+    index = index_type();
+    BOOST_CHECK(items_of(copy) == shouldbe);
+    snapshots.clear();
+  }
+  {
+    // Readers check their snapshots while the writer carries on modifying
+    static constexpr size_t ITEMS_COUNT = 4096;
+    std::vector<foo_t> storage(ITEMS_COUNT);
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      storage[n].trie_key = (uint32_t) n * 7919;
+    }
+    index_type index;
+    std::mutex lock;
+    index_type::snapshot_type published = index.snapshot();
+    std::atomic<bool> done{false};
+    std::atomic<size_t> checked{0};
+    std::vector<std::thread> readers;
+    for(size_t t = 0; t < 3; t++)
+    {
+      readers.emplace_back([&] {
+        while(!done)
+        {
+          index_type::snapshot_type snap;
+          {
+            std::lock_guard<std::mutex> g(lock);
+            snap = published;
+          }
+          // Were the writer to modify the snapshot's links, these would disagree
+          size_t count = 0;
+          snap.for_each([&](const foo_t *p) {
+            BOOST_CHECK(snap.find(p->trie_key) == p);
+            count++;
+          });
+          BOOST_CHECK(count == snap.size());
+          checked++;
+        }
+      });
+    }
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(size_t round = 0; round < 64; round++)
+    {
+      for(size_t n = 0; n < ITEMS_COUNT; n++)
+      {
+        const foo_t *p = &storage[rand() % ITEMS_COUNT];
+        if(rand() & 1)
+        {
+          index.insert(p);
+        }
+        else
+        {
+          index.erase(p->trie_key);
+        }
+        if(n % 64 == 0)
+        {
+          auto snap = index.snapshot();
+          std::lock_guard<std::mutex> g(lock);
+          published = std::move(snap);
+        }
+      }
+    }
+    done = true;
+    for(auto &i : readers)
+    {
+      i.join();
+    }
+    BOOST_CHECK(checked > 0);
+  }
+
+  static constexpr size_t ITEMS_COUNT = 1 << 20;
+  std::vector<foo_t> storage(ITEMS_COUNT);
+  QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+  for(auto &i : storage)
+  {
+    i.trie_key = rand();
+  }
+  std::cout << "For " << ITEMS_COUNT << " items, ns per operation:";
+  {
+    bt::bitwise_trie<foo_tree_t<foo_t>, foo_t> index;
+    auto begin = nanoclock();
+    for(auto &i : storage)
+    {
+      index.insert(&i);
+    }
+    auto inserted = nanoclock();
+    size_t found = 0;
+    for(auto &i : storage)
+    {
+      found += index.find(i.trie_key) != index.end();
+    }
+    auto end = nanoclock();
+    BOOST_CHECK(found == ITEMS_COUNT);
+    std::cout << "\n   bitwise_trie: " << ((double) (inserted - begin) / ITEMS_COUNT) << " insert "
+              << ((double) (end - inserted) / ITEMS_COUNT) << " find";
+  }
+  for(size_t snapshot_every : {(size_t) 0, (size_t) 64, (size_t) 1})
+  {
+    index_type index;
+    index_type::snapshot_type snap;
+    auto begin = nanoclock();
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      index.insert(&storage[n]);
+      if(snapshot_every != 0 && n % snapshot_every == 0)
+      {
+        snap = index.snapshot();
+      }
+    }
+    auto inserted = nanoclock();
+    size_t found = 0;
+    for(auto &i : storage)
+    {
+      found += index.find(i.trie_key) != nullptr;
+    }
+    auto end = nanoclock();
+    BOOST_CHECK(found == ITEMS_COUNT);
+    std::cout << "\n   persistent_trie with a snapshot ";
+    if(snapshot_every == 0)
+    {
+      std::cout << "never";
+    }
+    else
+    {
+      std::cout << "every " << snapshot_every << " inserts";
+    }
+    std::cout << ": " << ((double) (inserted - begin) / ITEMS_COUNT) << " insert " << ((double) (end - inserted) / ITEMS_COUNT)
+              << " find";
+  }
+  {
+    index_type index;
+    for(auto &i : storage)
+    {
+      index.insert(&i);
+    }
+    static constexpr size_t SNAPSHOTS = 1000;
+    auto begin = nanoclock();
+    for(size_t n = 0; n < SNAPSHOTS; n++)
+    {
+      auto snap = index.snapshot();
+      BOOST_CHECK(snap.size() == index.size());
+    }
+    auto end = nanoclock();
+    std::cout << "\n   persistent_trie snapshot: " << ((double) (end - begin) / SNAPSHOTS);
+  }
+  std::cout << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / replicated, "Tests and benchmarks replicated_trie local against remote replica finds")
+{
+  namespace rt = QUICKCPPLIB_NAMESPACE::algorithm::replicated_trie;
+  struct foo_t
+  {
+    uint32_t trie_key{0};
+  };
+  const auto &topology = rt::numa_topology::current();
+  std::cout << "This machine has " << topology.nodes() << " NUMA nodes with CPUs." << std::endl;
+  {
+    static constexpr size_t ITEMS_COUNT = 20000;
+    std::vector<foo_t> storage(ITEMS_COUNT);
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(auto &i : storage)
+    {
+      i.trie_key = rand() >> (rand() % 24);
+    }
+    rt::replicated_trie<const foo_t> index(ITEMS_COUNT / 2, 3);
+    std::map<uint32_t, const foo_t *> shouldbe;
+    BOOST_CHECK(index.replicas() == 3 && index.capacity() == ITEMS_COUNT / 2);
+    BOOST_CHECK(index.local_replica() < index.replicas());
+    BOOST_CHECK(index.empty() && index.find(0) == nullptr && index.erase(0) == 0);
+    auto check = [&] {
+      BOOST_CHECK(index.size() == shouldbe.size());
+      for(size_t n = 0; n < ITEMS_COUNT; n += 7)
+      {
+        auto it = shouldbe.find(storage[n].trie_key);
+        const foo_t *p = (it == shouldbe.end()) ? nullptr : it->second;
+        BOOST_CHECK(index.find(storage[n].trie_key) == p);
+        for(size_t r = 0; r < index.replicas(); r++)
+        {
+          BOOST_CHECK(index.find(storage[n].trie_key, r) == p);
+        }
+      }
+    };
+    for(size_t n = 0; n < ITEMS_COUNT * 4; n++)
+    {
+      const foo_t *p = &storage[rand() % ITEMS_COUNT];
+      if(rand() % 3 != 0 && shouldbe.size() < index.capacity())
+      {
+        auto it = shouldbe.emplace(p->trie_key, p).first;
+        BOOST_CHECK(index.insert(p) == it->second);
+      }
+      else
+      {
+        BOOST_CHECK(index.erase(p->trie_key) == shouldbe.erase(p->trie_key));
+      }
+      if(n % 8192 == 0)
+      {
+        check();
+      }
+    }
+    check();
+    for(auto &i : storage)
+    {
+      if(shouldbe.size() == index.capacity())
+      {
+        break;
+      }
+      shouldbe.emplace(i.trie_key, &i);
+      index.insert(&i);
+    }
+    check();
+    bool threw = false;
+    try
+    {
+      static const foo_t absent{0xffffffff};
+      index.insert(&absent);
+    }
+    catch(const std::length_error &)
+    {
+      threw = true;
+    }
+    BOOST_CHECK(threw);
+    index.clear();
+    shouldbe.clear();
+    check();
+  }
+
+  // Pin a thread to each node in turn, and time finds in its local replica against each remote one
+  static constexpr size_t ITEMS_COUNT = 1 << 20;
+  std::vector<foo_t> storage(ITEMS_COUNT);
+  {
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(auto &i : storage)
+    {
+      i.trie_key = rand();
+    }
+  }
+  std::vector<uint32_t> tofind(ITEMS_COUNT / 4);
+  {
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand(42);
+    for(auto &i : tofind)
+    {
+      i = storage[rand() % ITEMS_COUNT].trie_key;
+    }
+  }
+  rt::replicated_trie<const foo_t> index(ITEMS_COUNT, std::max<size_t>(2, topology.nodes()));
+  for(auto &i : storage)
+  {
+    index.insert(&i);
+  }
+  for(size_t node = 0; node < topology.nodes(); node++)
+  {
+    std::thread worker([&] {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      for(unsigned cpu : topology.cpus(node))
+      {
+        CPU_SET(cpu, &cpus);
+      }
+      if(sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+      {
+        std::cout << "Could not pin to node " << topology.node_id(node) << std::endl;
+        return;
+      }
+      std::cout << "For replicated_trie from a thread on node " << topology.node_id(node) << ":";
+      for(size_t replica = 0; replica < index.replicas(); replica++)
+      {
+        size_t found = 0;
+        auto begin = nanoclock();
+        for(auto k : tofind)
+        {
+          found += (index.find(k, replica) != nullptr);
+        }
+        auto end = nanoclock();
+        BOOST_CHECK(found == tofind.size());
+        std::cout << "\n   replica on node " << topology.node_id(index.replica_node(replica))
+                  << ((index.replica_node(replica) == node) ? " (local): " : " (remote): ")
+                  << ((double) (end - begin) / tofind.size()) << " ns per find";
+      }
+      std::cout << std::endl;
+    });
+    worker.join();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / wide_keys, "Tests and benchmarks bitwise_trie with keys wider than 64 bits")
+{
+  using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  using key128_type = bitwise_trie_wide_key<16>;
+  using key256_type = bitwise_trie_wide_key<32>;
+  {
+    // Arithmetic carries and borrows across words
+    key128_type a = (key128_type) 1 << 64, b = (key128_type) -1;
+    BOOST_CHECK(a.word(1) == 1 && a.word(0) == 0);
+    BOOST_CHECK(a - 1 == ((key128_type) 1 << 64) - 1);
+    BOOST_CHECK((a - 1).word(0) == (uint64_t) -1 && (a - 1).word(1) == 0);
+    BOOST_CHECK((a - 1) + 1 == a);
+    BOOST_CHECK(b + 1 == 0);
+    BOOST_CHECK(b > a && a > 0 && !(a < 1));
+    BOOST_CHECK((a >> 64) == 1 && (b >> 127) == 1 && ((b << 127) >> 127) == 1);
+    BOOST_CHECK(a.bitscanr() == 64 && key128_type(5).bitscanr() == 2);
+    const unsigned char bytes[] = {0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+    auto c = key128_type::from_bytes(bytes);
+    BOOST_CHECK(c.word(1) == 0x8000000000000000ULL && c.word(0) == 1);
+    BOOST_CHECK(key256_type::from_bytes("ab", 2) < key256_type::from_bytes("b", 1));
+  }
+  static constexpr size_t ITEMS_COUNT = 1 << 18;
+  auto test = [](auto *item, auto *index, auto makekey, const char *desc) {
+    using item_type = typename std::remove_pointer<decltype(item)>::type;
+    using index_type = typename std::remove_pointer<decltype(index)>::type;
+    using key_type = typename index_type::key_type;
+    std::vector<item_type> storage(ITEMS_COUNT);
+    std::vector<key_type> keys;
+    keys.reserve(ITEMS_COUNT);
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      storage[n].trie_key = makekey(rand);
+      keys.push_back(storage[n].trie_key);
+    }
+    index_type idx;
+    auto begin = nanoclock();
+    for(auto &i : storage)
+    {
+      idx.insert(&i);
+    }
+    auto inserted = nanoclock();
+    size_t found = 0;
+    for(auto &k : keys)
+    {
+      auto it = idx.find(k);
+      found += (it != idx.end() && it->trie_key == k);
+    }
+    auto end = nanoclock();
+    BOOST_CHECK(found == ITEMS_COUNT);
+    idx.triecheckvalidity();
+    std::sort(keys.begin(), keys.end());
+    for(size_t n = 0; n < 1000; n++)
+    {
+      // Next largest of a key just above an existing key is the following key
+      const size_t i = rand() % (ITEMS_COUNT - 1);
+      if(keys[i] != keys[i + 1])
+      {
+        auto it = idx.find_equal_or_next_largest(keys[i] + 1);
+        BOOST_REQUIRE(it != idx.end());
+        BOOST_CHECK(it->trie_key == keys[i + 1]);
+        it = idx.find_equal_or_next_smallest(keys[i + 1] - 1);
+        BOOST_REQUIRE(it != idx.end());
+        BOOST_CHECK(it->trie_key == keys[i]);
+      }
+    }
+    for(size_t n = 0; n < ITEMS_COUNT; n += 2)
+    {
+      idx.erase(&storage[n]);
+    }
+    idx.triecheckvalidity();
+    BOOST_CHECK(idx.size() == ITEMS_COUNT / 2);
+    size_t visited = 0;
+    const key_type *lastkey = nullptr;
+    for(auto it = idx.sorted_begin(); it != idx.sorted_end(); ++it, visited++)
+    {
+      BOOST_CHECK(lastkey == nullptr || !(it->trie_key < *lastkey));
+      lastkey = &it->trie_key;
+    }
+    BOOST_CHECK(visited == ITEMS_COUNT / 2);
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      auto it = idx.find(storage[n].trie_key);
+      // Duplicate keys are possible, but vanishingly unlikely
+      BOOST_CHECK((it == idx.end()) == !(n & 1));
+    }
+    std::cout << desc << ": " << ((double) (inserted - begin) / ITEMS_COUNT) << " ns per item insert, "
+              << ((double) (end - inserted) / ITEMS_COUNT) << " ns per item find" << std::endl;
+  };
+  {
+    struct foo_t
+    {
+      foo_t *trie_parent;
+      foo_t *trie_child[2];
+      foo_t *trie_sibling[2];
+      uint64_t trie_key;
+    };
+    struct foo_tree_t
+    {
+      size_t trie_count;
+      bool trie_nobbledir{false};
+      foo_t *trie_children[64];
+    };
+    test((foo_t *) nullptr, (bitwise_trie<foo_tree_t, foo_t> *) nullptr,
+         [](auto &rand) { return ((uint64_t) rand() << 32) | rand(); }, "64 bit keys");
+  }
+#if defined(__SIZEOF_INT128__)
+  {
+    struct foo_t
+    {
+      foo_t *trie_parent;
+      foo_t *trie_child[2];
+      foo_t *trie_sibling[2];
+      unsigned __int128 trie_key;
+    };
+    struct foo_tree_t
+    {
+      size_t trie_count;
+      bool trie_nobbledir{false};
+      foo_t *trie_children[128];
+    };
+    test((foo_t *) nullptr, (bitwise_trie<foo_tree_t, foo_t> *) nullptr,
+         [](auto &rand) {
+           return ((unsigned __int128) rand() << 96) | ((unsigned __int128) rand() << 64) | ((uint64_t) rand() << 32) | rand();
+         },
+         "unsigned __int128 keys");
+  }
+#endif
+  {
+    struct foo_t
+    {
+      foo_t *trie_parent;
+      foo_t *trie_child[2];
+      foo_t *trie_sibling[2];
+      key128_type trie_key;
+    };
+    struct foo_tree_t
+    {
+      size_t trie_count;
+      bool trie_nobbledir{false};
+      foo_t *trie_children[128];
+    };
+    test((foo_t *) nullptr, (bitwise_trie<foo_tree_t, foo_t> *) nullptr,
+         [](auto &rand) {
+           uint32_t uuid[4] = {rand(), rand(), 0, rand()};
+           return key128_type::from_bytes(uuid, sizeof(uuid));
+         },
+         "bitwise_trie_wide_key<16> keys");
+  }
+  {
+    struct foo_t
+    {
+      foo_t *trie_parent;
+      foo_t *trie_child[2];
+      foo_t *trie_sibling[2];
+      key256_type trie_key;
+    };
+    struct foo_tree_t
+    {
+      size_t trie_count;
+      bool trie_nobbledir{false};
+      foo_t *trie_children[256];
+    };
+    test((foo_t *) nullptr, (bitwise_trie<foo_tree_t, foo_t> *) nullptr,
+         [](auto &rand) {
+           uint32_t hash[8] = {rand(), rand(), rand(), rand(), rand(), rand(), rand(), rand()};
+           return key256_type::from_bytes(hash, sizeof(hash));
+         },
+         "bitwise_trie_wide_key<32> keys");
+  }
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / concurrent, "Tests that bitwise_trie with per bin locks works from many threads")
+{
+  using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  struct foo_t
+  {
+    foo_t *trie_parent;
+    foo_t *trie_child[2];
+    foo_t *trie_sibling[2];
+    uint32_t trie_key{0};
+
+    foo_t() = default;
+
+    foo_t(uint32_t key)
+        : trie_key(key)
+    {
+    }
+  };
+  struct foo_tree_t
+  {
+    std::atomic<size_t> trie_count{0};
+    std::atomic<bool> trie_nobbledir{false};
+    foo_t *trie_children[8 * sizeof(size_t)];
+    bitwise_trie_branch_lock trie_locks[8 * sizeof(size_t)];
+  };
+
+  static constexpr size_t ITEMS_PER_THREAD = 50000;
+  const size_t threads = std::min(std::max(4u, std::thread::hardware_concurrency()), 16u);
+  bitwise_trie<foo_tree_t, foo_t, 0, concurrent_bitwise_trie_head_accessors> index;
+  std::vector<std::vector<foo_t>> storage(threads);
+  std::atomic<size_t> failures{0};
+  {
+    std::vector<std::thread> workers;
+    for(size_t t = 0; t < threads; t++)
+    {
+      workers.emplace_back([&, t] {
+        QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand((uint32_t) t + 1);
+        auto &mine = storage[t];
+        mine.reserve(ITEMS_PER_THREAD);
+        for(size_t n = 0; n < ITEMS_PER_THREAD; n++)
+        {
+          mine.emplace_back(rand());
+          index.insert(&mine.back());
+        }
+        for(auto &i : mine)
+        {
+          auto it = index.find(i.trie_key);
+          if(it == index.end() || it->trie_key != i.trie_key)
+          {
+            failures++;
+          }
+        }
+        // Remove every odd item, while the other threads are doing the same
+        for(size_t n = 1; n < ITEMS_PER_THREAD; n += 2)
+        {
+          index.erase(&mine[n]);
+        }
+        for(size_t n = 0; n < ITEMS_PER_THREAD; n += 2)
+        {
+          auto it = index.find_equal_or_next_largest(mine[n].trie_key);
+          if(it == index.end() || it->trie_key != mine[n].trie_key)
+          {
+            failures++;
+          }
+        }
+      });
+    }
+    for(auto &i : workers)
+    {
+      i.join();
+    }
+  }
+  BOOST_CHECK(failures == 0);
+  BOOST_CHECK(index.size() == threads * ((ITEMS_PER_THREAD + 1) / 2));
+  index.triecheckvalidity();
+  size_t count = 0;
+  for(auto it = index.begin(); it != index.end(); ++it)
+  {
+    count++;
+  }
+  BOOST_CHECK(count == index.size());
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / optimistic, "Tests that bitwise_trie with seqlocked bins finds correctly during modification")
+{
+  using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  struct foo_t
+  {
+    foo_t *trie_parent;
+    foo_t *trie_child[2];
+    foo_t *trie_sibling[2];
+    uint32_t trie_key{0};
+
+    foo_t() = default;
+
+    foo_t(uint32_t key)
+        : trie_key(key)
+    {
+    }
+  };
+  struct foo_tree_t
+  {
+    std::atomic<size_t> trie_count{0};
+    std::atomic<bool> trie_nobbledir{false};
+    foo_t *trie_children[8 * sizeof(size_t)];
+    bitwise_trie_branch_seqlock trie_locks[8 * sizeof(size_t)];
+  };
+
+  static constexpr size_t STABLE_COUNT = 20000, CHURN_COUNT = 5000, WRITERS = 2, READERS = 2;
+  bitwise_trie<foo_tree_t, foo_t, 0, concurrent_bitwise_trie_head_accessors> index;
+  std::vector<foo_t> stable;
+  std::vector<std::vector<foo_t>> churn(WRITERS);
+  {
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    stable.reserve(STABLE_COUNT);
+    for(size_t n = 0; n < STABLE_COUNT; n++)
+    {
+      stable.emplace_back(rand());
+      index.insert(&stable.back());
+    }
+    for(auto &i : churn)
+    {
+      for(size_t n = 0; n < CHURN_COUNT; n++)
+      {
+        i.emplace_back(rand());
+      }
+    }
+  }
+  std::atomic<size_t> failures{0}, finds{0}, writers_running{WRITERS};
+  std::vector<std::thread> workers;
+  for(size_t t = 0; t < WRITERS; t++)
+  {
+    workers.emplace_back([&, t] {
+      for(int round = 0; round < 20; round++)
+      {
+        for(auto &i : churn[t])
+        {
+          index.insert(&i);
+        }
+        for(auto &i : churn[t])
+        {
+          index.erase(&i);
+        }
+      }
+      --writers_running;
+    });
+  }
+  for(size_t t = 0; t < READERS; t++)
+  {
+    workers.emplace_back([&] {
+      do
+      {
+        for(auto &i : stable)
+        {
+          auto it = index.find(i.trie_key);
+          if(it == index.end() || it->trie_key != i.trie_key)
+          {
+            failures++;
+          }
+          it = index.find_equal_or_next_largest(i.trie_key);
+          if(it == index.end() || it->trie_key != i.trie_key)
+          {
+            failures++;
+          }
+        }
+        finds += 2 * STABLE_COUNT;
+      } while(writers_running > 0);
+    });
+  }
+  for(auto &i : workers)
+  {
+    i.join();
+  }
+  std::cout << "Performed " << finds << " optimistic finds during concurrent modification." << std::endl;
+  BOOST_CHECK(failures == 0);
+  BOOST_CHECK(index.size() == STABLE_COUNT);
+  index.triecheckvalidity();
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / epochs, "Tests that bitwise_trie retired items are only reclaimed once no optimistic find can see them")
+{
+  using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  struct foo_t
+  {
+    foo_t *trie_parent;
+    foo_t *trie_child[2];
+    foo_t *trie_sibling[2];
+    uint32_t trie_key{0};
+  };
+  struct foo_tree_t
+  {
+    std::atomic<size_t> trie_count{0};
+    std::atomic<bool> trie_nobbledir{false};
+    foo_t *trie_children[8 * sizeof(size_t)];
+    bitwise_trie_branch_seqlock trie_locks[8 * sizeof(size_t)];
+    bitwise_trie_epoch_domain<foo_t> trie_epochs;
+  };
+  using index_type = bitwise_trie<foo_tree_t, foo_t, 0, concurrent_bitwise_trie_head_accessors>;
+  static constexpr uint32_t POISON = 0xdeadbeef;
+  // Reclaiming scribbles over the item, so a find still traversing it would crash or fail
+  auto reclaim = [](foo_t *p, void *freelist) {
+    memset((void *) p, 0xff, sizeof(foo_t));
+    p->trie_key = POISON;
+    static_cast<std::vector<foo_t *> *>(freelist)->push_back(p);
+  };
+  {
+    index_type index;
+    std::vector<foo_t *> freelist;
+    foo_t a, b;
+    a.trie_key = 5;
+    b.trie_key = 6;
+    index.insert(&a);
+    index.insert(&b);
+    {
+      bitwise_trie_epoch_domain<foo_t>::read_guard g(index.trie_epochs);
+      index.retire(&a, reclaim, &freelist);
+      index.trie_epochs.reclaim();
+      BOOST_CHECK(freelist.empty());
+      BOOST_CHECK(index.trie_epochs.retired() == 1);
+      BOOST_CHECK(a.trie_key == 5);
+      BOOST_CHECK(index.find(5) == index.end());
+    }
+    index.trie_epochs.reclaim();
+    BOOST_CHECK(freelist.size() == 1 && freelist.front() == &a && a.trie_key == POISON);
+    BOOST_CHECK(index.trie_epochs.retired() == 0);
+    index.retire(&b, reclaim, &freelist);
+    index.trie_epochs.synchronize();
+    index.trie_epochs.reclaim();
+    BOOST_CHECK(freelist.size() == 2 && index.empty());
+  }
+
+  static constexpr size_t STABLE_COUNT = 20000, CHURN_COUNT = 5000, READERS = 3;
+  index_type index;
+  std::vector<foo_t> stable(STABLE_COUNT), churn(CHURN_COUNT);
+  std::vector<foo_t *> freelist;
+  {
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    for(auto &i : stable)
+    {
+      i.trie_key = rand() | 1;
+      index.insert(&i);
+    }
+    for(auto &i : churn)
+    {
+      freelist.push_back(&i);
+    }
+  }
+  std::atomic<size_t> failures{0}, finds{0};
+  std::atomic<bool> done{false};
+  std::vector<std::thread> readers;
+  for(size_t t = 0; t < READERS; t++)
+  {
+    readers.emplace_back([&, t] {
+      QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand((uint32_t) t + 1);
+      do
+      {
+        for(size_t n = 0; n < 1000; n++)
+        {
+          // Finds walk through churned items, so only happen within a critical section which
+          // prevents those items being reclaimed and reused under us
+          bitwise_trie_epoch_domain<foo_t>::read_guard g(index.trie_epochs);
+          const uint32_t k = stable[rand() % STABLE_COUNT].trie_key;
+          auto it = index.find(k);
+          if(it == index.end() || it->trie_key != k)
+          {
+            failures++;
+          }
+          const uint32_t ck = rand() & ~(uint32_t) 1;
+          it = index.find(ck);
+          if(it != index.end() && it->trie_key != ck)
+          {
+            failures++;
+          }
+        }
+        finds += 2000;
+      } while(!done);
+    });
+  }
+  {
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    std::vector<foo_t *> live;
+    for(size_t round = 0; round < 200000; round++)
+    {
+      if(!freelist.empty() && (live.empty() || (rand() & 1)))
+      {
+        foo_t *p = freelist.back();
+        freelist.pop_back();
+        p->trie_key = rand() & ~(uint32_t) 1;
+        index.insert(p);
+        live.push_back(p);
+      }
+      else if(!live.empty())
+      {
+        const size_t idx = rand() % live.size();
+        foo_t *p = live[idx];
+        live[idx] = live.back();
+        live.pop_back();
+        index.retire(p, reclaim, &freelist);
+      }
+    }
+    done = true;
+    for(auto &i : readers)
+    {
+      i.join();
+    }
+    for(auto *p : live)
+    {
+      index.retire(p, reclaim, &freelist);
+    }
+  }
+  index.trie_epochs.reclaim();
+  std::cout << "Performed " << finds << " optimistic finds while recycling retired items." << std::endl;
+  BOOST_CHECK(failures == 0);
+  BOOST_CHECK(freelist.size() == CHURN_COUNT);
+  BOOST_CHECK(index.size() == STABLE_COUNT);
+  index.triecheckvalidity();
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / sharded, "Tests and benchmarks sharded_bitwise_trie inserting from many threads")
+{
+  using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  struct foo_t
+  {
+    foo_t *trie_parent;
+    foo_t *trie_child[2];
+    uint32_t trie_key{0};
+
+    foo_t() = default;
+
+    foo_t(uint32_t key)
+        : trie_key(key)
+    {
+    }
+  };
+  struct foo_tree_t
+  {
+    size_t trie_count{0};
+    foo_t *trie_children[8 * sizeof(size_t)];
+    bool trie_nobbledir{false};
+  };
+  using index_type = sharded_bitwise_trie<16, foo_tree_t, foo_t>;
+
+  static constexpr size_t ITEMS_COUNT = 1 << 16;
+  std::vector<foo_t> storage;
+  std::map<uint32_t, const foo_t *> model;
+  {
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    storage.reserve(ITEMS_COUNT);
+    for(size_t n = 0; n < ITEMS_COUNT; n++)
+    {
+      storage.emplace_back(rand() >> 8);
+    }
+  }
+  {
+    auto index = std::make_unique<index_type>();
+    BOOST_CHECK(index->empty());
+    BOOST_CHECK(index->begin() == index->end());
+    BOOST_CHECK(index->find_equal_or_next_largest(0) == index->end());
+    for(auto &i : storage)
+    {
+      auto it = index->insert(&i);
+      BOOST_REQUIRE(it != index->end());
+      if(model.emplace(i.trie_key, &i).second)
+      {
+        BOOST_CHECK(&*it == &i);
+      }
+      else
+      {
+        BOOST_CHECK(&*it == model[i.trie_key]);
+      }
+    }
+    BOOST_CHECK(index->size() == model.size());
+    for(size_t n = 0; n < 16; n++)
+    {
+      index->shard(n).triecheckvalidity();
+      for(auto &i : index->shard(n))
+      {
+        BOOST_CHECK(index_type::shard_of(i.trie_key) == n);
+      }
+    }
+    size_t visited = 0;
+    for(auto it = index->begin(); it != index->end(); ++it)
+    {
+      BOOST_CHECK(model[it->trie_key] == &*it);
+      visited++;
+    }
+    BOOST_CHECK(visited == model.size());
+
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand(42);
+    for(size_t n = 0; n < 1024; n++)
+    {
+      const uint32_t k = rand() >> 8;
+      auto mit = model.find(k);
+      BOOST_CHECK(index->contains(k) == (mit != model.end()));
+      auto lit = model.lower_bound(k);
+      auto it = index->find_equal_or_next_largest(k);
+      BOOST_CHECK((lit == model.end()) ? (it == index->end()) : (it != index->end() && &*it == lit->second));
+      auto uit = model.upper_bound(k);
+      it = index->upper_bound(k);
+      BOOST_CHECK((uit == model.end()) ? (it == index->end()) : (it != index->end() && &*it == uit->second));
+      it = index->find_equal_or_next_smallest(k);
+      BOOST_CHECK((uit == model.begin()) ? (it == index->end()) : (it != index->end() && &*it == std::prev(uit)->second));
+    }
+    for(auto mit = model.begin(); mit != model.end();)
+    {
+      BOOST_CHECK(index->erase(mit->first) == 1);
+      BOOST_CHECK(!index->contains(mit->first));
+      mit = model.erase(mit);
+      for(int skip = 0; skip < 3 && mit != model.end(); skip++)
+      {
+        ++mit;
+      }
+      if(mit == model.end())
+      {
+        mit = model.begin();
+      }
+    }
+    BOOST_CHECK(index->empty());
+  }
+
+  // Benchmark against a single index with per bin locks, which serialises hash keys on a few bins
+  struct locked_tree_t
+  {
+    std::atomic<size_t> trie_count{0};
+    std::atomic<bool> trie_nobbledir{false};
+    foo_t *trie_children[8 * sizeof(size_t)];
+    bitwise_trie_branch_lock trie_locks[8 * sizeof(size_t)];
+  };
+  auto benchmark = [&](auto *index, const char *desc) {
+    std::cout << "For " << desc << ":";
+    const unsigned maxthreads = std::max(1u, std::min(64u, std::thread::hardware_concurrency()));
+    for(unsigned threads = 1; threads <= maxthreads; threads <<= 1)
+    {
+      std::vector<std::thread> workers;
+      const size_t per_thread = ITEMS_COUNT / threads;
+      auto begin = nanoclock();
+      for(unsigned t = 0; t < threads; t++)
+      {
+        workers.emplace_back([&, t] {
+          for(size_t n = t * per_thread; n < (t + 1) * per_thread; n++)
+          {
+            index->insert(&storage[n]);
+          }
+        });
+      }
+      for(auto &i : workers)
+      {
+        i.join();
+      }
+      auto end = nanoclock();
+      index->clear();
+      std::cout << "\n   " << threads << " threads: " << (1000.0 * threads * per_thread / (end - begin))
+                << " million inserts/sec";
+    }
+    std::cout << std::endl;
+  };
+  {
+    auto index = std::make_unique<bitwise_trie<locked_tree_t, foo_t, 0, concurrent_bitwise_trie_head_accessors>>();
+    benchmark(index.get(), "bitwise_trie with per bin locks");
+  }
+  {
+    auto index = std::make_unique<sharded_bitwise_trie<64, foo_tree_t, foo_t>>();
+    benchmark(index.get(), "sharded_bitwise_trie with 64 shards");
+  }
+}
+
+BOOST_AUTO_TEST_CASE(bitwise_trie / concurrent_benchmark, "Benchmarks concurrent bitwise_trie scaling with threads")
+{
+  using namespace QUICKCPPLIB_NAMESPACE::algorithm::bitwise_trie;
+  struct foo_t
+  {
+    foo_t *trie_parent;
+    foo_t *trie_child[2];
+    uint32_t trie_key{0};
+
+    foo_t() = default;
+
+    foo_t(uint32_t key)
+        : trie_key(key)
+    {
+    }
+  };
+  struct foo_tree_t
+  {
+    std::atomic<size_t> trie_count{0};
+    std::atomic<bool> trie_nobbledir{false};
+    foo_t *trie_children[8 * sizeof(size_t)];
+    bitwise_trie_branch_lock trie_locks[8 * sizeof(size_t)];
+  };
+
+  /* Random keys would mostly fall into the top two bins, so all threads would contend on their
+  locks. Instead spread unique keys evenly over the top sixteen bins, item n going into bin
+  16 + n % 16, and have thread t modify items n % threads == t, so that with up to sixteen
+  threads each thread modifies only bins of its own. */
+  static constexpr size_t ITEMS_COUNT = 1 << 20;
+  std::vector<foo_t> storage;
+  storage.reserve(ITEMS_COUNT);
+  for(size_t n = 0; n < ITEMS_COUNT; n++)
+  {
+    const unsigned bitidx = 16 + n % 16;
+    const uint32_t lowbits = (uint32_t) ((n / 16) * 2654435761u) & ((1u << bitidx) - 1);
+    storage.emplace_back((1u << bitidx) | lowbits);
+  }
+  std::cout << "For concurrent bitwise_trie:";
+  const unsigned maxthreads = std::max(1u, std::thread::hardware_concurrency());
+  for(unsigned threads = 1; threads <= maxthreads; threads <<= 1)
+  {
+    bitwise_trie<foo_tree_t, foo_t, 0, concurrent_bitwise_trie_head_accessors> index;
+    std::vector<std::thread> workers;
+    const size_t per_thread = ITEMS_COUNT / threads;
+    auto begin = nanoclock();
+    for(unsigned t = 0; t < threads; t++)
+    {
+      workers.emplace_back([&, t] {
+        for(size_t n = t; n < threads * per_thread; n += threads)
+        {
+          index.insert(&storage[n]);
+        }
+        for(size_t n = t; n < threads * per_thread; n += threads)
+        {
+          index.erase(&storage[n]);
+        }
+      });
+    }
+    for(auto &i : workers)
+    {
+      i.join();
+    }
+    auto end = nanoclock();
+    std::cout << "\n   " << threads << " threads: " << ((double) (end - begin) / (threads * per_thread))
+              << " ns per item insert and remove (" << (2000.0 * threads * per_thread / (end - begin))
+              << " million ops/sec)";
+  }
+  std::cout << std::endl;
+
+  // Finds by all threads whilst one thread keeps modifying the index
+  auto readers_benchmark = [&](auto *index, const char *desc) {
+    const size_t half = ITEMS_COUNT / 2;
+    for(size_t n = 0; n < half; n++)
+    {
+      index->insert(&storage[n]);
+    }
+    std::cout << "For concurrent bitwise_trie finds with " << desc << ":";
+    for(unsigned threads = 1; threads <= maxthreads; threads <<= 1)
+    {
+      std::atomic<bool> done{false};
+      std::thread writer([&] {
+        while(!done)
+        {
+          for(size_t n = half; n < half + 1024 && !done; n++)
+          {
+            index->insert(&storage[n]);
+          }
+          for(size_t n = half; n < half + 1024; n++)
+          {
+            index->erase(&storage[n]);
+          }
+        }
+      });
+      std::vector<std::thread> workers;
+      const size_t per_thread = half / threads;
+      auto begin = nanoclock();
+      for(unsigned t = 0; t < threads; t++)
+      {
+        workers.emplace_back([&, t] {
+          for(size_t n = t * per_thread; n < (t + 1) * per_thread; n++)
+          {
+            if(index->find(storage[n].trie_key) == index->end())
+            {
+              abort();
+            }
+          }
+        });
+      }
+      for(auto &i : workers)
+      {
+        i.join();
+      }
+      auto end = nanoclock();
+      done = true;
+      writer.join();
+      std::cout << "\n   " << threads << " threads: " << (1000.0 * threads * per_thread / (end - begin))
+                << " million finds/sec";
+    }
+    std::cout << std::endl;
+  };
+  {
+    struct rwlock_tree_t
+    {
+      std::atomic<size_t> trie_count{0};
+      std::atomic<bool> trie_nobbledir{false};
+      foo_t *trie_children[8 * sizeof(size_t)];
+      bitwise_trie_branch_lock trie_locks[8 * sizeof(size_t)];
+    };
+    bitwise_trie<rwlock_tree_t, foo_t, 0, concurrent_bitwise_trie_head_accessors> index;
+    readers_benchmark(&index, "reader-writer locks");
+  }
+  {
+    struct seqlock_tree_t
+    {
+      std::atomic<size_t> trie_count{0};
+      std::atomic<bool> trie_nobbledir{false};
+      foo_t *trie_children[8 * sizeof(size_t)];
+      bitwise_trie_branch_seqlock trie_locks[8 * sizeof(size_t)];
+    };
+    bitwise_trie<seqlock_tree_t, foo_t, 0, concurrent_bitwise_trie_head_accessors> index;
+    readers_benchmark(&index, "seqlocks");
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()